@@ -20,6 +20,7 @@
 #include "Particle.h"
 #include "CTF.h"
 #include "Optimiser.h"
+#include "Topology.h"
 
 using namespace std;
 
@@ -226,11 +227,15 @@ int main(int argc, char* argv[])
 
         return 0;
     }
-    else if (argc != 2)
+    else if ((argc != 2) &&
+             !((argc == 3) && (strcmp(argv[2], "--resume") == 0)))
     {
         cout << "Wrong Number of Parameters Input!"
              << endl;
 
+        cout << "Usage: thunder PARAMETER_FILE [--resume]"
+             << endl;
+
         return -1;
     }
 
@@ -313,6 +318,8 @@ int main(int argc, char* argv[])
         abort();
     }
 
+    para.resume = (argc == 3);
+
     if (rank == 0)
     {
         CLOG(INFO, "LOGGER_SYS") << "Logging JSON Parameters";
@@ -320,10 +327,72 @@ int main(int argc, char* argv[])
         logPara(root);
     }
 
+    if (rank == 0) CLOG(INFO, "LOGGER_SYS") << "Detecting Topology of Processes";
+
+    Topology topo;
+
+    detectTopology(topo);
+
+    // the slave processes of the same CPUs on a node share them, the master
+    // process staying on all its CPUs
+
+    MPI_Comm node;
+
+    MPI_Comm_split_type(MPI_COMM_WORLD,
+                        (rank == 0) ? MPI_UNDEFINED : MPI_COMM_TYPE_SHARED,
+                        rank,
+                        MPI_INFO_NULL,
+                        &node);
+
+    if (node != MPI_COMM_NULL)
+    {
+        MPI_Comm same;
+
+        MPI_Comm_split(node, hashTopology(topo), rank, &same);
+
+        int sameRank, sameSize;
+
+        MPI_Comm_rank(same, &sameRank);
+        MPI_Comm_size(same, &sameSize);
+
+        Topology share;
+
+        shareTopology(share, topo, sameRank, sameSize);
+
+        topo = share;
+
+        MPI_Comm_free(&same);
+        MPI_Comm_free(&node);
+    }
+
+    if (rank == 1) CLOG(INFO, "LOGGER_SYS") << "Process 1 Takes "
+                                            << topo.nCore
+                                            << " Cores on "
+                                            << topo.nNode
+                                            << " NUMA Nodes and "
+                                            << topo.nSocket
+                                            << " Sockets";
+
     if (rank == 0) CLOG(INFO, "LOGGER_SYS") << "Setting Maximum Number of Threads Per Process";
 
+    // a non-positive number of threads takes one thread per core
+
+    bool autoThreads = (para.nThreadsPerProcess <= 0);
+
+    if (autoThreads)
+        para.nThreadsPerProcess = GSL_MAX_INT(1, topo.nCore);
+
     omp_set_num_threads(para.nThreadsPerProcess);
 
+#ifdef PARALLEL_BIND_THREADS
+    // an explicit number of threads beyond the CPUs of the share is left to the
+    // scheduler, as binding would stack several threads on a CPU
+
+    if ((rank != 0) &&
+        (autoThreads || (para.nThreadsPerProcess <= (int)topo.cpu.size())))
+        bindThreads(topo);
+#endif
+
     if (rank == 0) CLOG(INFO, "LOGGER_SYS") << "Maximum Number of Threads in a Process is " << omp_get_max_threads();
 
     if (rank == 0) CLOG(INFO, "LOGGER_SYS") << "Initialising Threads Setting in FFTW";
@@ -335,6 +404,12 @@ int main(int argc, char* argv[])
         abort();
     }
 
+#ifdef OPTIMISER_MASTER_SAVE_MAP
+    // the master process writes references in a background thread
+
+    TSFFTW_make_planner_thread_safe();
+#endif
+
     if (rank == 0) CLOG(INFO, "LOGGER_SYS") << "Setting Time Limit for Creating FFTW Plan";
 
     TSFFTW_set_timelimit(60);
@@ -0,0 +1,94 @@
+/*******************************************************************************
+ * Author:
+ * Dependecy:
+ * Test:
+ * Execution: thunder_fsc OUTPUT_FSC HALF_MAP_A HALF_MAP_B PIXEL_SIZE [SCRATCH_DIR]
+ * Description: FSC between two half maps, computed slice by slice from the
+ *              MRC files, thus in bounded memory for any box size
+ *
+ * The FSC is written in the format of thunder_postprocess, thus can be used by
+ * fscweight of thunder_mapops.
+ * ****************************************************************************/
+
+#include <iostream>
+
+#include "Spectrum.h"
+#include "SlabVolume.h"
+
+INITIALIZE_EASYLOGGINGPP
+
+int main(int argc, char* argv[])
+{
+    if ((argc != 5) && (argc != 6))
+    {
+        std::cout << "Usage: thunder_fsc OUTPUT_FSC HALF_MAP_A HALF_MAP_B PIXEL_SIZE [SCRATCH_DIR]"
+                  << std::endl;
+
+        return -1;
+    }
+
+    loggerInit(argc, argv);
+
+    TSFFTW_init_threads();
+
+    RFLOAT pixelSize = atof(argv[4]);
+
+    const char* scratch = (argc == 6) ? argv[5] : ".";
+
+    SlabVolume A, B;
+
+    A.openMRC(argv[2], false, scratch);
+    B.openMRC(argv[3], false, scratch);
+
+    if ((A.nColRL() != B.nColRL()) ||
+        (A.nRowRL() != B.nRowRL()) ||
+        (A.nSlcRL() != B.nSlcRL()))
+    {
+        REPORT_ERROR("HALF MAPS OF DIFFERENT SIZES");
+        abort();
+    }
+
+    int size = A.nColRL();
+
+    CLOG(INFO, "LOGGER_SYS") << "Transforming Half Map A";
+
+    A.openFT(scratch);
+    A.fw();
+
+    CLOG(INFO, "LOGGER_SYS") << "Transforming Half Map B";
+
+    B.openFT(scratch);
+    B.fw();
+
+    CLOG(INFO, "LOGGER_SYS") << "Calculating FSC";
+
+    vec fsc(size / 2 - 1);
+
+    FSC(fsc, A, B);
+
+    FILE* file = fopen(argv[1], "w");
+
+    if (file == NULL)
+    {
+        REPORT_ERROR("FAIL TO OPEN OUTPUT FILE");
+        abort();
+    }
+
+    for (int i = 1; i < fsc.size(); i++)
+        fprintf(file,
+                "%05d   %10.6lf   %10.6lf\n",
+                i,
+                1.0 / resP2A(i, size, pixelSize),
+                fsc(i));
+
+    fclose(file);
+
+    int res = resP(fsc, 0.143, 1, 1, false);
+
+    CLOG(INFO, "LOGGER_SYS") << "Resolution: "
+                             << 1.0 / resP2A(res, size, pixelSize);
+
+    TSFFTW_cleanup_threads();
+
+    return 0;
+}
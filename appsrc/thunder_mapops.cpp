@@ -0,0 +1,607 @@
+/*******************************************************************************
+ * Author:
+ * Dependecy:
+ * Test:
+ * Execution: thunder_mapops PARAMETER_FILE
+ * Description: a chain of operations on a map, performed in memory
+ *
+ * The parameter file is a JSON object with the pixel size (Angstrom) and an
+ * ordered list of operations, e.g.
+ *
+ * {
+ *     "Pixel Size" : 1.32,
+ *     "Operations" : [
+ *         {"Op" : "read", "File" : "Reference_Average.mrc"},
+ *         {"Op" : "fscweight", "File" : "Postprocess_FSC.txt"},
+ *         {"Op" : "bfactor", "B-Factor" : -100},
+ *         {"Op" : "lowpass", "Resolution" : 3.5},
+ *         {"Op" : "mask", "File" : "Mask.mrc"},
+ *         {"Op" : "write", "File" : "Reference_Sharp.mrc"}
+ *     ]
+ * }
+ *
+ * Operations
+ *
+ * read      File                          replace the map
+ * write     File                          write the map
+ * lowpass   Resolution (A), Edge Width    low pass filtering
+ * highpass  Resolution (A), Edge Width    high pass filtering
+ * bfactor   B-Factor (A^2)                B-factor filtering
+ * fscweight File                          FSC weighting, by a FSC file as
+ *                                         written by thunder_postprocess
+ * mask      Radius (A) or File            soft mask by a sphere or a mask
+ * average   File                          average with another map
+ * resize    Size                          pad or crop in Fourier space, the
+ *                                         pixel size is rescaled to
+ *                                         old * old size / Size for the
+ *                                         operations after it, until the
+ *                                         next read
+ * alignz    Axis                          rotate the axis to Z
+ * genmask   Threshold, Extension, Edge Width
+ *                                         replace the map by its mask
+ *
+ * Edge widths are in pixel. The map is kept in memory between operations and
+ * only transformed between real and Fourier space when an operation requires.
+ * Adjacent Fourier filters are fused into one sweep.
+ *
+ * With "Out of Core" set true, the map is kept in files in "Scratch Directory"
+ * (the current directory by default) and processed slice by slice, see
+ * SlabVolume, for maps which do not fit in memory. MRC files of modes other
+ * than 2 are converted into scratch files first. resize, alignz and genmask are
+ * not supported out of core.
+ * ****************************************************************************/
+
+#include <fstream>
+#include <iostream>
+
+#include <json/json.h>
+
+#include "FFT.h"
+#include "ImageFile.h"
+#include "Volume.h"
+#include "Filter.h"
+#include "Mask.h"
+#include "SlabVolume.h"
+#include "Euler.h"
+#include "Transformation.h"
+
+using std::cout;
+using std::endl;
+using std::ifstream;
+using std::ios;
+using std::string;
+
+inline Json::Value JSONCPP_READ_ERROR_HANDLER(const Json::Value src)
+{
+    if (src == Json::nullValue)
+    {
+        REPORT_ERROR("INVALID JSON PARAMETER FILE KEY");
+        abort();
+    }
+    else
+    {
+        return src;
+    }
+}
+
+INITIALIZE_EASYLOGGINGPP
+
+class MapOps
+{
+    private:
+
+        /**
+         * pixel size of the maps read, as in the parameter file
+         */
+        RFLOAT _pixelSizeRead;
+
+        /**
+         * pixel size of the current map, changed by resize
+         */
+        RFLOAT _pixelSize;
+
+        Volume _map;
+
+        /**
+         * whether the map is in Fourier space
+         */
+        bool _ft;
+
+        /**
+         * Fourier filters not applied yet
+         */
+        vector<FilterStage> _stage;
+
+        FFT _fft;
+
+        /**
+         * whether the map is kept in files instead of _map
+         */
+        bool _ooc;
+
+        /**
+         * the directory of the working files out of core
+         */
+        string _scratch;
+
+        /**
+         * the map out of core, its real space is always up to date
+         */
+        SlabVolume _slab;
+
+    public:
+
+        MapOps(const RFLOAT pixelSize,
+               const bool ooc,
+               const string& scratch) : _pixelSizeRead(pixelSize),
+                                        _pixelSize(pixelSize),
+                                        _ft(false),
+                                        _ooc(ooc),
+                                        _scratch(scratch) {}
+
+        void run(const Json::Value& op)
+        {
+            string name = JSONCPP_READ_ERROR_HANDLER(op["Op"]).asString();
+
+            if (name == "lowpass")
+                lowPass(op, FILTER_LOW_PASS);
+            else if (name == "highpass")
+                lowPass(op, FILTER_HIGH_PASS);
+            else if (name == "bfactor")
+                bFactor(op);
+            else if (name == "fscweight")
+                fscWeight(op);
+            else
+            {
+                // every other operation sees the map with all the filters in
+                // front of it applied
+
+                flush();
+
+                CLOG(INFO, "LOGGER_SYS") << "Performing " << name;
+
+                if (_ooc &&
+                    ((name == "resize") || (name == "alignz") || (name == "genmask")))
+                {
+                    REPORT_ERROR("OPERATION NOT SUPPORTED OUT OF CORE");
+                    abort();
+                }
+
+                if (name == "read")
+                    read(op);
+                else if (name == "write")
+                    write(op);
+                else if (name == "mask")
+                    mask(op);
+                else if (name == "average")
+                    average(op);
+                else if (name == "resize")
+                    resize(op);
+                else if (name == "alignz")
+                    alignZ(op);
+                else if (name == "genmask")
+                    genMask(op);
+                else
+                {
+                    REPORT_ERROR("INEXISTENT OPERATION");
+                    abort();
+                }
+            }
+        }
+
+        void finish() const
+        {
+            if (!_stage.empty())
+                CLOG(WARNING, "LOGGER_SYS") << "FOURIER FILTER(S) AFTER THE LAST OUTPUT ARE DROPPED";
+        }
+
+    private:
+
+        void toRL()
+        {
+            if (!_ft) return;
+
+            _fft.bwMT(_map);
+
+            _ft = false;
+        }
+
+        void toFT()
+        {
+            if (_ft) return;
+
+            _fft.fwMT(_map);
+
+            _ft = true;
+        }
+
+        int nCol() const
+        {
+            return _ooc ? _slab.nColRL() : _map.nColRL();
+        }
+
+        void checkMap() const
+        {
+            if (nCol() == 0)
+            {
+                REPORT_ERROR("NO MAP READ BEFORE THIS OPERATION");
+                abort();
+            }
+        }
+
+        void flush()
+        {
+            if (_stage.empty()) return;
+
+            CLOG(INFO, "LOGGER_SYS") << "Performing "
+                                     << _stage.size()
+                                     << " Fourier Filter(s) in One Sweep";
+
+            checkMap();
+
+            if (_ooc)
+            {
+                _slab.fw();
+
+                fusedFilter(_slab, _stage);
+
+                _slab.bw();
+            }
+            else
+            {
+                toFT();
+
+                fusedFilter(_map, _map, _stage);
+            }
+
+            _stage.clear();
+        }
+
+        static void copy(SlabVolume& dst,
+                         const SlabVolume& src)
+        {
+            #pragma omp parallel for
+            for (int k = 0; k < src.nSlcRL(); k++)
+                memcpy(dst.slcRL(k), src.slcRL(k), src.slcSizeRL() * sizeof(float));
+        }
+
+        void readSlab(const string& file)
+        {
+            SlabVolume src;
+            src.openMRC(file.c_str(), false, _scratch.c_str());
+
+            // the working copy is removed from the directory right away
+
+            char path[FILE_NAME_LENGTH];
+
+            snprintf(path, FILE_NAME_LENGTH, "%s/.thunder_map_XXXXXX", _scratch.c_str());
+
+            int fd = mkstemp(path);
+
+            if (fd == -1)
+            {
+                REPORT_ERROR("FAIL TO CREATE SCRATCH FILE");
+                abort();
+            }
+
+            close(fd);
+
+            _slab.createMRC(path, src.nColRL(), src.nRowRL(), src.nSlcRL(), _pixelSize);
+
+            unlink(path);
+
+            copy(_slab, src);
+
+            _slab.openFT(_scratch.c_str());
+        }
+
+        void writeSlab(const string& file)
+        {
+            SlabVolume dst;
+            dst.createMRC(file.c_str(), _slab.nColRL(), _slab.nRowRL(), _slab.nSlcRL(), _pixelSize);
+
+            copy(dst, _slab);
+        }
+
+        void read(const Json::Value& op)
+        {
+            string file = JSONCPP_READ_ERROR_HANDLER(op["File"]).asString();
+
+            _pixelSize = _pixelSizeRead;
+
+            if (_ooc)
+            {
+                readSlab(file);
+
+                return;
+            }
+
+            ImageFile imf(file.c_str(), "rb");
+            imf.readMetaData();
+            imf.readVolume(_map);
+
+            _ft = false;
+        }
+
+        void write(const Json::Value& op)
+        {
+            checkMap();
+
+            string file = JSONCPP_READ_ERROR_HANDLER(op["File"]).asString();
+
+            if (_ooc)
+            {
+                writeSlab(file);
+
+                return;
+            }
+
+            toRL();
+
+            ImageFile imf;
+            imf.readMetaData(_map);
+            imf.writeVolume(file.c_str(), _map, _pixelSize);
+        }
+
+        void lowPass(const Json::Value& op,
+                     const FilterType type)
+        {
+            checkMap();
+
+            FilterStage stage;
+
+            stage.type = type;
+            stage.thres = _pixelSize / JSONCPP_READ_ERROR_HANDLER(op["Resolution"]).asDouble();
+            stage.ew = op.get("Edge Width", 2).asDouble() / nCol();
+
+            _stage.push_back(stage);
+        }
+
+        void bFactor(const Json::Value& op)
+        {
+            FilterStage stage;
+
+            stage.type = FILTER_B_FACTOR;
+            stage.bFactor = JSONCPP_READ_ERROR_HANDLER(op["B-Factor"]).asDouble()
+                          / TSGSL_pow_2(_pixelSize);
+
+            _stage.push_back(stage);
+        }
+
+        void fscWeight(const Json::Value& op)
+        {
+            string file = JSONCPP_READ_ERROR_HANDLER(op["File"]).asString();
+
+            FILE* fd = fopen(file.c_str(), "r");
+
+            if (fd == NULL)
+            {
+                REPORT_ERROR("FAIL TO OPEN FSC FILE");
+                abort();
+            }
+
+            vector<RFLOAT> fsc(1, 1);
+
+            int i;
+            double res, val;
+
+            while (fscanf(fd, "%d %lf %lf", &i, &res, &val) == 3)
+            {
+                if (i >= (int)fsc.size()) fsc.resize(i + 1, 0);
+
+                fsc[i] = val;
+            }
+
+            fclose(fd);
+
+            FilterStage stage;
+
+            stage.type = FILTER_FSC_WEIGHTING;
+            stage.fsc.resize(fsc.size());
+
+            for (size_t l = 0; l < fsc.size(); l++)
+                stage.fsc(l) = fsc[l];
+
+            _stage.push_back(stage);
+        }
+
+        void mask(const Json::Value& op)
+        {
+            checkMap();
+
+            if (_ooc)
+            {
+                if (op.isMember("File"))
+                {
+                    SlabVolume alpha;
+                    alpha.openMRC(op["File"].asString().c_str(), false, _scratch.c_str());
+
+                    softMask(_slab, alpha, 0);
+                }
+                else
+                    softMask(_slab,
+                             JSONCPP_READ_ERROR_HANDLER(op["Radius"]).asDouble() / _pixelSize,
+                             op.get("Edge Width", EDGE_WIDTH_RL).asDouble(),
+                             0);
+
+                return;
+            }
+
+            toRL();
+
+            if (op.isMember("File"))
+            {
+                string file = op["File"].asString();
+
+                ImageFile imf(file.c_str(), "rb");
+                imf.readMetaData();
+
+                Volume alpha;
+                imf.readVolume(alpha);
+
+                softMask(_map, _map, alpha, 0);
+            }
+            else
+                softMask(_map,
+                         _map,
+                         JSONCPP_READ_ERROR_HANDLER(op["Radius"]).asDouble() / _pixelSize,
+                         op.get("Edge Width", EDGE_WIDTH_RL).asDouble(),
+                         0);
+        }
+
+        void average(const Json::Value& op)
+        {
+            checkMap();
+
+            string file = JSONCPP_READ_ERROR_HANDLER(op["File"]).asString();
+
+            if (_ooc)
+            {
+                SlabVolume that;
+                that.openMRC(file.c_str(), false, _scratch.c_str());
+
+                #pragma omp parallel for
+                for (int k = 0; k < _slab.nSlcRL(); k++)
+                {
+                    float* dst = _slab.slcRL(k);
+                    const float* src = that.slcRL(k);
+
+                    for (size_t i = 0; i < _slab.slcSizeRL(); i++)
+                        dst[i] = (dst[i] + src[i]) / 2;
+                }
+
+                return;
+            }
+
+            toRL();
+
+            ImageFile imf(file.c_str(), "rb");
+            imf.readMetaData();
+
+            Volume that;
+            imf.readVolume(that);
+
+            #pragma omp parallel for
+            FOR_EACH_PIXEL_RL(_map)
+                _map(i) = (_map(i) + that(i)) / 2;
+        }
+
+        void resize(const Json::Value& op)
+        {
+            checkMap();
+
+            toFT();
+
+            int size = JSONCPP_READ_ERROR_HANDLER(op["Size"]).asInt();
+
+            Volume dst(size, size, size, FT_SPACE);
+
+            if (_map.nColRL() < dst.nColRL())
+            {
+                #pragma omp parallel for
+                SET_0_FT(dst);
+            }
+
+            Volume& src = (_map.nColRL() >= dst.nColRL()) ? dst : _map;
+
+            #pragma omp parallel for
+            VOLUME_FOR_EACH_PIXEL_FT(src)
+                dst.setFTHalf(_map.getFTHalf(i, j, k), i, j, k);
+
+            // the box in Angstrom is kept, so the pixel size scales inversely
+            // with the size
+
+            _pixelSize = _pixelSize * _map.nColRL() / size;
+
+            _map.swap(dst);
+        }
+
+        void alignZ(const Json::Value& op)
+        {
+            checkMap();
+
+            toRL();
+
+            const Json::Value axis = JSONCPP_READ_ERROR_HANDLER(op["Axis"]);
+
+            dvec3 v;
+            v << axis[0].asDouble(), axis[1].asDouble(), axis[2].asDouble();
+
+            dmat33 rot;
+            ::alignZ(rot, v);
+
+            Volume dst(_map.nColRL(), _map.nRowRL(), _map.nSlcRL(), RL_SPACE);
+
+            VOL_TRANSFORM_MAT_RL(dst, _map, rot, _map.nColRL() / 2 - 1, LINEAR_INTERP);
+
+            _map.swap(dst);
+        }
+
+        void genMask(const Json::Value& op)
+        {
+            checkMap();
+
+            toRL();
+
+            #pragma omp parallel for
+            VOLUME_FOR_EACH_PIXEL_RL(_map)
+                if (QUAD_3(i, j, k) >= TSGSL_pow_2(_map.nColRL() / 2))
+                    _map.setRL(0, i, j, k);
+
+            Volume dst(_map.nColRL(), _map.nRowRL(), _map.nSlcRL(), RL_SPACE);
+
+            ::genMask(dst,
+                      _map,
+                      JSONCPP_READ_ERROR_HANDLER(op["Threshold"]).asDouble(),
+                      JSONCPP_READ_ERROR_HANDLER(op["Extension"]).asDouble(),
+                      JSONCPP_READ_ERROR_HANDLER(op["Edge Width"]).asDouble());
+
+            _map.swap(dst);
+        }
+};
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2)
+    {
+        cout << "Usage: thunder_mapops PARAMETER_FILE" << endl;
+
+        return -1;
+    }
+
+    loggerInit(argc, argv);
+
+    TSFFTW_init_threads();
+
+    ifstream in(argv[1], ios::binary);
+
+    if (!in.is_open())
+    {
+        REPORT_ERROR("FAIL TO OPEN PARAMETER FILE");
+        abort();
+    }
+
+    Json::Reader reader;
+    Json::Value root;
+
+    if (!reader.parse(in, root))
+    {
+        REPORT_ERROR("FAIL TO PARSE PARAMETER FILE");
+        abort();
+    }
+
+    MapOps ops(JSONCPP_READ_ERROR_HANDLER(root["Pixel Size"]).asDouble(),
+               root.get("Out of Core", false).asBool(),
+               root.get("Scratch Directory", ".").asString());
+
+    const Json::Value list = JSONCPP_READ_ERROR_HANDLER(root["Operations"]);
+
+    for (Json::ArrayIndex i = 0; i < list.size(); i++)
+        ops.run(list[i]);
+
+    ops.finish();
+
+    TSFFTW_cleanup_threads();
+
+    return 0;
+}
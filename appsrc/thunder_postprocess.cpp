@@ -2,28 +2,66 @@
  * Author: Ice
  * Dependecy:
  * Test:
- * Execution:
- * Description:
+ * Execution: thunder_postprocess HALF_MAP_A HALF_MAP_B MASK PIXEL_SIZE [SCRATCH_DIR]
+ * Description: FSC, B-factor estimation and sharpening of two half maps
+ *
+ * The maps are processed in memory. When SCRATCH_DIR is given, or the box is
+ * larger than POSTPROCESS_MAX_IN_CORE_SIZE, they are processed slice by slice
+ * from the MRC files instead, with the scratch files in SCRATCH_DIR, or the
+ * working directory by default, see SlabPostprocess.
  * ****************************************************************************/
 
 #include <iostream>
 
 #include "Postprocess.h"
+#include "SlabPostprocess.h"
 
 INITIALIZE_EASYLOGGINGPP
 
 int main(int argc, char* argv[])
 {   
+    if ((argc != 5) && (argc != 6))
+    {
+        std::cout << "Usage: thunder_postprocess HALF_MAP_A HALF_MAP_B MASK PIXEL_SIZE [SCRATCH_DIR]"
+                  << std::endl;
+
+        return -1;
+    }
+
     loggerInit(argc, argv);
 
     TSFFTW_init_threads();
 
-    Postprocess pp(argv[1],
-                   argv[2],
-                   argv[3],
-                   atof(argv[4]));
+    int size;
+
+    {
+        ImageFile imf(argv[1], "rb");
+        imf.readMetaData();
+
+        size = imf.nCol();
+    }
+
+    if ((argc == 6) || (size > POSTPROCESS_MAX_IN_CORE_SIZE))
+    {
+        CLOG(INFO, "LOGGER_SYS") << "Postprocessing Out of Core";
+
+        SlabPostprocess pp(argv[1],
+                           argv[2],
+                           argv[3],
+                           atof(argv[4]),
+                           (argc == 6) ? argv[5] : ".");
+
+        pp.run();
+    }
+    else
+    {
+        Postprocess pp(argv[1],
+                       argv[2],
+                       argv[3],
+                       atof(argv[4]));
 
-    pp.run();
+        pp.run();
+    }
 
     TSFFTW_cleanup_threads();
 
@@ -0,0 +1,448 @@
+/*******************************************************************************
+ * Author:
+ * Dependecy:
+ * Test:
+ * Execution: thunder_tune PARAMETER_FILE [N_NODE] [N_PARTICLE]
+ * Description: recommends the number of processes per node and the number of
+ *              threads per process of thunder for a parameter file on the
+ *              machine it runs on
+ *
+ * Each layout of R slave processes of T threads on a node takes the cores in
+ * contiguous blocks, as thunder does. The throughput of projecting and scoring,
+ * the bulk of the expectation, is measured with the R blocks of T threads, each
+ * bound to its block, running concurrently, and summed over them, thus with the
+ * contention for the memory bandwidth and the caches shared. Layouts of which the memory, estimated from the size of
+ * image, the number of classes, the padding factor and the number of particles,
+ * exceeds the memory available are dropped.
+ *
+ * The number of particles is counted from the .thu file of the parameter file,
+ * unless N_PARTICLE is given.
+ * ****************************************************************************/
+
+#include <cstdio>
+#include <fstream>
+
+#include <json/json.h>
+
+#include "Config.h"
+#include "Logging.h"
+#include "Macro.h"
+#include "Projector.h"
+#include "Kernel.h"
+#include "Euler.h"
+#include "Optimiser.h"
+#include "Topology.h"
+
+/**
+ * bytes per pixel of an image held by a process, the image and the original
+ * image in both spaces, and the pre-calculated data, CTF and sigma
+ */
+#define TUNE_BYTES_PER_IMAGE_PIXEL 32
+
+/**
+ * bytes per voxel of the padded Fourier space of a reconstructor, F, T, W and C
+ */
+#define TUNE_BYTES_PER_RECO_VOXEL 20
+
+/**
+ * fraction of the memory available which can be taken by thunder
+ */
+#define TUNE_MEMORY_FRACTION 0.8
+
+/**
+ * number of images scored against each projection in the benchmark
+ */
+#define TUNE_N_IMAGE 64
+
+/**
+ * seconds of each benchmark
+ */
+#define TUNE_BENCH_TIME 1.0
+
+INITIALIZE_EASYLOGGINGPP
+
+using std::cout;
+using std::endl;
+
+static int countParticle(const char* thu)
+{
+    FILE* file = fopen(thu, "r");
+
+    if (file == NULL) return 0;
+
+    int n = 0;
+
+    char line[FILE_LINE_LENGTH];
+
+    while (fgets(line, FILE_LINE_LENGTH, file) != NULL)
+        if ((line[0] != '\n') && (line[0] != '\0')) n++;
+
+    fclose(file);
+
+    return n;
+}
+
+/**
+ * This function binds the calling thread to the cpu, or to all the CPUs of the
+ * topology if cpu is negative.
+ */
+static void bindSelf(const Topology& topo,
+                     const int cpu)
+{
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+
+    if (cpu < 0)
+    {
+        for (size_t i = 0; i < topo.cpu.size(); i++)
+            CPU_SET(topo.cpu[i], &set);
+    }
+    else
+        CPU_SET(cpu, &set);
+
+    sched_setaffinity(0, sizeof(cpu_set_t), &set);
+}
+
+/**
+ * This function measures the rotations projected and scored per second by the
+ * nThread threads bound to the i-th block of cores out of n, while the other
+ * blocks run alike. It is called by the thread of the block in a parallel
+ * region of n threads.
+ */
+static double benchBlock(const Projector& proj,
+                         const Topology& topo,
+                         const int i,
+                         const int n,
+                         const int nThread,
+                         const int* iCol,
+                         const int* iRow,
+                         const int nPxl,
+                         const Complex* datSrc,
+                         const RFLOAT* ctfSrc,
+                         const RFLOAT* sigRcpSrc)
+{
+    Topology share;
+
+    shareTopology(share, topo, i, n);
+
+    const KernelTable& kt = kernel();
+
+    // each process holds its own images, touched by the threads of the block
+
+    size_t nDat = (size_t)nPxl * TUNE_N_IMAGE;
+
+    Complex* dat = (Complex*)TSFFTW_malloc(nDat * sizeof(Complex));
+    RFLOAT* ctf = (RFLOAT*)TSFFTW_malloc(nDat * sizeof(RFLOAT));
+    RFLOAT* sigRcp = (RFLOAT*)TSFFTW_malloc(nDat * sizeof(RFLOAT));
+
+    long nRot = 0;
+
+    double elapse = 0;
+
+    #pragma omp parallel num_threads(nThread) reduction(+:nRot) reduction(max:elapse)
+    {
+        int t = omp_get_thread_num();
+
+        bindSelf(share, share.cpu[t % share.cpu.size()]);
+
+        #pragma omp for schedule(static)
+        for (size_t j = 0; j < nDat; j++)
+        {
+            dat[j] = datSrc[j];
+            ctf[j] = ctfSrc[j];
+            sigRcp[j] = sigRcpSrc[j];
+        }
+
+        Complex* pri = (Complex*)TSFFTW_malloc((size_t)nPxl * sizeof(Complex));
+        RFLOAT* result = (RFLOAT*)TSFFTW_malloc(TUNE_N_IMAGE * sizeof(RFLOAT));
+
+        // the threads of the block start together
+
+        #pragma omp barrier
+
+        double start = omp_get_wtime();
+
+        int k = t;
+
+        do
+        {
+            dmat33 rot;
+
+            rotate3D(rot, 2 * M_PI * k / (nThread * 16), M_PI * k / (nThread * 16), 0);
+
+            proj.project(pri, rot, iCol, iRow, nPxl);
+
+            memset(result, 0, TUNE_N_IMAGE * sizeof(RFLOAT));
+
+            kt.logDataVSPrior_m_n(dat, pri, ctf, sigRcp, TUNE_N_IMAGE, nPxl, result);
+
+            nRot += 1;
+
+            k += nThread;
+
+            elapse = omp_get_wtime() - start;
+        } while (elapse < TUNE_BENCH_TIME);
+
+        TSFFTW_free(pri);
+        TSFFTW_free(result);
+
+        bindSelf(topo, -1);
+    }
+
+    TSFFTW_free(dat);
+    TSFFTW_free(ctf);
+    TSFFTW_free(sigRcp);
+
+    return nRot / elapse;
+}
+
+/**
+ * This function measures the rotations projected and scored per second by n
+ * blocks of nThread threads running concurrently, each bound to its block of
+ * cores, the sum of their rates.
+ */
+static double benchLayout(const Projector& proj,
+                          const Topology& topo,
+                          const int n,
+                          const int nThread,
+                          const int* iCol,
+                          const int* iRow,
+                          const int nPxl,
+                          const Complex* dat,
+                          const RFLOAT* ctf,
+                          const RFLOAT* sigRcp)
+{
+    double rate = 0;
+
+    #pragma omp parallel num_threads(n) reduction(+:rate)
+    rate += benchBlock(proj,
+                       topo,
+                       omp_get_thread_num(),
+                       n,
+                       nThread,
+                       iCol,
+                       iRow,
+                       nPxl,
+                       dat,
+                       ctf,
+                       sigRcp);
+
+    return rate;
+}
+
+int main(int argc, char* argv[])
+{
+    if ((argc < 2) || (argc > 4))
+    {
+        cout << "Usage: thunder_tune PARAMETER_FILE [N_NODE] [N_PARTICLE]"
+             << endl;
+
+        return -1;
+    }
+
+    loggerInit(argc, argv);
+
+    std::ifstream in(argv[1], std::ios::binary);
+
+    Json::Reader reader;
+    Json::Value root;
+
+    if (!in.is_open() || !reader.parse(in, root))
+    {
+        REPORT_ERROR("FAIL TO PARSE PARAMETER FILE");
+        abort();
+    }
+
+    int size = root[KEY_SIZE].asInt();
+    int nClass = root[KEY_K].asInt();
+    int pf = root["Advanced"][KEY_PF].asInt();
+
+    bool mode2D = (root[KEY_MODE].asString() == "2D");
+
+    int nNode = (argc >= 3) ? atoi(argv[2]) : 1;
+
+    int nPart = (argc == 4) ? atoi(argv[3]) : countParticle(root[KEY_DB].asString().c_str());
+
+    if ((size <= 0) || (nClass <= 0) || (pf <= 0) || (nNode <= 0))
+    {
+        REPORT_ERROR("INVALID PARAMETERS");
+        abort();
+    }
+
+    Topology topo;
+
+    detectTopology(topo);
+
+    int coresPerNode = GSL_MAX_INT(1, topo.nCore / topo.nNode);
+    int coresPerSocket = GSL_MAX_INT(1, topo.nCore / topo.nSocket);
+
+    printf("%d Cores, %d NUMA Nodes, %d Sockets, %.1f GB Available\n",
+           topo.nCore,
+           topo.nNode,
+           topo.nSocket,
+           topo.memAvailable / gsl_pow_3(1024.0));
+
+    printf("Size %d, %d Classes, Padding Factor %d, %d Particles on %d Nodes\n",
+           size,
+           nClass,
+           pf,
+           nPart,
+           nNode);
+
+    // memory, the padded projectees shared by the processes of a node
+
+    double sizePad = (double)pf * size;
+
+    double voxelPad = mode2D ? sizePad * (sizePad / 2 + 1)
+                             : sizePad * sizePad * (sizePad / 2 + 1);
+
+#ifdef PARALLEL_NODE_SHARED
+    double memShared = nClass * voxelPad * sizeof(Complex);
+    double memProj = 0;
+#else
+    double memShared = 0;
+    double memProj = nClass * voxelPad * sizeof(Complex);
+#endif
+
+    double memReco = nClass * voxelPad * TUNE_BYTES_PER_RECO_VOXEL;
+
+    // the data for benchmarking
+
+    Volume vol(size, size, size, FT_SPACE);
+
+    VOLUME_FOR_EACH_PIXEL_FT(vol)
+        vol.setFTHalf(COMPLEX(gsl_ran_gaussian(get_random_engine(), 1),
+                              gsl_ran_gaussian(get_random_engine(), 1)),
+                      i,
+                      j,
+                      k);
+
+    Projector proj;
+
+    proj.setPf(pf);
+    proj.setProjectee(vol.copyVolume(), size / 2 - 1);
+
+    vector<int> iCol, iRow;
+
+    int r = size / 2 - 1;
+
+    for (int j = -r; j < r; j++)
+        for (int i = 0; i <= r; i++)
+            if (i * i + j * j < r * r)
+            {
+                iCol.push_back(i);
+                iRow.push_back(j);
+            }
+
+    int nPxl = iCol.size();
+
+    Complex* dat = (Complex*)mallocFirstTouch((size_t)nPxl * TUNE_N_IMAGE * sizeof(Complex));
+    RFLOAT* ctf = (RFLOAT*)mallocFirstTouch((size_t)nPxl * TUNE_N_IMAGE * sizeof(RFLOAT));
+    RFLOAT* sigRcp = (RFLOAT*)mallocFirstTouch((size_t)nPxl * TUNE_N_IMAGE * sizeof(RFLOAT));
+
+    for (size_t i = 0; i < (size_t)nPxl * TUNE_N_IMAGE; i++)
+    {
+        dat[i] = COMPLEX(gsl_ran_gaussian(get_random_engine(), 1),
+                         gsl_ran_gaussian(get_random_engine(), 1));
+        ctf[i] = 1;
+        sigRcp[i] = -0.5;
+    }
+
+    // candidates of threads per process
+
+    vector<int> cand;
+
+    for (int t = 1; t <= topo.nCore; t *= 2) cand.push_back(t);
+
+    cand.push_back(coresPerNode);
+    cand.push_back(coresPerSocket);
+    cand.push_back(topo.nCore);
+
+    std::sort(cand.begin(), cand.end());
+    cand.erase(std::unique(cand.begin(), cand.end()), cand.end());
+
+    printf("\n%10s %10s %16s %16s %12s\n",
+           "Processes",
+           "Threads",
+           "Rotations/s",
+           "Memory (GB)",
+           "Fits");
+
+    // a team of threads for each block of cores
+
+    omp_set_max_active_levels(2);
+
+    int bestR = 1;
+    int bestT = topo.nCore;
+
+    double bestRate = -1;
+
+    for (size_t c = 0; c < cand.size(); c++)
+    {
+        int nThread = cand[c];
+
+        int nProcess = topo.nCore / nThread;
+
+        double rate = benchLayout(proj,
+                                  topo,
+                                  nProcess,
+                                  nThread,
+                                  &iCol[0],
+                                  &iRow[0],
+                                  nPxl,
+                                  dat,
+                                  ctf,
+                                  sigRcp);
+
+        // the particles are split over the slave processes
+
+        double memImage = (double)nPart / (nProcess * nNode)
+                        * size * size * TUNE_BYTES_PER_IMAGE_PIXEL;
+
+        double mem = memShared + nProcess * (memProj + memReco + memImage);
+
+        bool fit = (topo.memAvailable == 0)
+                || (mem < TUNE_MEMORY_FRACTION * topo.memAvailable);
+
+        printf("%10d %10d %16.1f %16.2f %12s\n",
+               nProcess,
+               nThread,
+               rate,
+               mem / gsl_pow_3(1024.0),
+               fit ? "Yes" : "No");
+
+        if (fit && (rate > bestRate))
+        {
+            bestR = nProcess;
+            bestT = nThread;
+            bestRate = rate;
+        }
+    }
+
+    TSFFTW_free(dat);
+    TSFFTW_free(ctf);
+    TSFFTW_free(sigRcp);
+
+    if (bestRate < 0)
+    {
+        printf("\nNo Layout Fits in Memory, Try More Nodes\n");
+
+        return 1;
+    }
+
+    // thunder takes at least 3 processes, one master and two slaves
+
+    int nSlave = GSL_MAX_INT(2, bestR * nNode);
+
+    printf("\n\"%s\" : %d\n", KEY_N_THREADS_PER_PROCESS, bestT);
+
+    printf("%d Slave Processes per Node, the Master Process on the First Node\n",
+           bestR);
+
+    printf("mpirun -np %d --bind-to none thunder %s\n",
+           nSlave + 1,
+           argv[1]);
+
+    return 0;
+}
@@ -0,0 +1,203 @@
+/*******************************************************************************
+ * Author:
+ * Dependecy:
+ * Test:
+ * Execution: thunder_bench_acg [nR] [nRound]
+ * Description: inference of the parameter matrix of ACG by inferACG, against
+ *              the plain fixed-point iteration, in time and in result
+ *
+ * Besides nRound sets of nR quaternions sampled from ACG, sets of few unique
+ * rows, as the resampled rotation particles are, on which extrapolating the
+ * fixed-point iteration falls into cycles, are inferred. The program returns
+ * 1 if inferACG does not agree with the plain iteration on any of them.
+ * ****************************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <omp_compat.h>
+
+#include "Logging.h"
+#include "Random.h"
+#include "DirectionalStat.h"
+
+/**
+ * relative deviation tolerated between inferACG and the plain iteration, both
+ * stopping at ACG_INFER_THRES
+ */
+#define BENCH_TOL 1e-2
+
+INITIALIZE_EASYLOGGINGPP
+
+struct BenchRow
+{
+    int count;
+
+    double quat[4];
+};
+
+/**
+ * 125 quaternions of 5 and 6 unique rows
+ */
+static const BenchRow cycle0[] = {
+    {28, {-0.21251812439280579, -0.87751905065801594, 0.42948992859567864, 0.018296550814213879}},
+    {28, {0.43712766803157005, -0.89860455211642976, 0.030511443866729202, 0.022322915357983225}},
+    {19, {0.64207004559079373, -0.76620617907649724, -1.2851372221154607e-05, 0.025964351231505898}},
+    {28, {0.97259586346878824, 0.2219444348181982, -0.00061962934631395572, 0.069264495061366699}},
+    {22, {0.99706937256102979, 0.03709617716880742, 0.03701230672235957, -0.055737142834063447}}};
+
+static const BenchRow cycle1[] = {
+    {16, {-0.32065492661210032, -0.88670303344701384, -0.31450967862976964, 0.10964401745399287}},
+    {15, {-0.75812954228609963, 0.59775446883480421, 0.24797757710855342, 0.080226637424619371}},
+    {28, {-0.95301283534849002, -0.26501613612799058, 0.10141071947194563, -0.10606059225275306}},
+    {21, {0.30586407228212725, -0.048206330638949892, 0.94807425765319675, 0.072653430398445643}},
+    {28, {0.92750837454798041, -0.34149266006924917, -0.15198677808022718, -0.0033162555666337301}},
+    {17, {0.96260491016580385, -0.23918996532090606, -0.026325585483081837, 0.12444641804182748}}};
+
+static void fill(dmat4& dst,
+                 const BenchRow* row,
+                 const int nRow)
+{
+    int n = 0;
+
+    for (int i = 0; i < nRow; i++)
+        n += row[i].count;
+
+    dst.resize(n, 4);
+
+    int k = 0;
+
+    for (int i = 0; i < nRow; i++)
+        for (int j = 0; j < row[i].count; j++)
+            dst.row(k++) << row[i].quat[0], row[i].quat[1], row[i].quat[2], row[i].quat[3];
+}
+
+/**
+ * the plain fixed-point iteration, inverting the parameter matrix in each
+ * step, returning the number of steps
+ */
+static int inferACGPlain(dmat44& dst,
+                         const dmat4& src)
+{
+    dmat44 A = dmat44::Identity();
+    dmat44 B;
+
+    int nStep = 0;
+
+    do
+    {
+        B = A;
+
+        dmat44 inv = B.inverse();
+
+        dvec w = (src * inv).cwiseProduct(src).rowwise().sum().cwiseInverse();
+
+        A = src.transpose() * (src.array().colwise() * w.array()).matrix();
+
+        A *= 4.0 / w.sum();
+
+        nStep += 1;
+    } while ((abs((A - B).array())).sum() > ACG_INFER_THRES);
+
+    dst = A;
+
+    return nStep;
+}
+
+static bool check(const char* name,
+                  const dmat4& src)
+{
+    dmat44 A, P;
+
+    double start = omp_get_wtime();
+
+    inferACG(A, src);
+
+    double t = omp_get_wtime() - start;
+
+    start = omp_get_wtime();
+
+    int nStep = inferACGPlain(P, src);
+
+    double tPlain = omp_get_wtime() - start;
+
+    double dev = (A - P).norm() / P.norm();
+
+    printf("%-16s %10.1f us %10.1f us, %4d plain steps, deviation %.2e %s\n",
+           name,
+           t * 1e6,
+           tPlain * 1e6,
+           nStep,
+           dev,
+           (dev < BENCH_TOL) ? "ok" : "FAIL");
+
+    return dev < BENCH_TOL;
+}
+
+int main(int argc, char* argv[])
+{
+    loggerInit(argc, argv);
+
+    int nR = (argc > 1) ? atoi(argv[1]) : 125;
+    int nRound = (argc > 2) ? atoi(argv[2]) : 100;
+
+    omp_set_num_threads(1);
+
+    printf("%-16s %13s %13s\n", "Set", "inferACG", "plain");
+
+    bool pass = true;
+
+    dmat4 src;
+
+    fill(src, cycle0, sizeof(cycle0) / sizeof(BenchRow));
+    pass = check("cycle 0", src) && pass;
+
+    fill(src, cycle1, sizeof(cycle1) / sizeof(BenchRow));
+    pass = check("cycle 1", src) && pass;
+
+    // sampled from ACG of increasing concentration
+
+    src.resize(nR, 4);
+
+    double t = 0, tPlain = 0;
+
+    for (int i = 0; i < nRound; i++)
+    {
+        dmat44 A = dmat44::Zero();
+
+        A(0, 0) = 1;
+        A(1, 1) = A(2, 2) = A(3, 3) = 1.0 / (1 + i);
+
+        sampleACG(src, A, nR);
+
+        dmat44 B, P;
+
+        double start = omp_get_wtime();
+
+        inferACG(B, src);
+
+        t += omp_get_wtime() - start;
+
+        start = omp_get_wtime();
+
+        inferACGPlain(P, src);
+
+        tPlain += omp_get_wtime() - start;
+
+        if ((B - P).norm() / P.norm() >= BENCH_TOL)
+        {
+            printf("Sampled Set %d Deviates\n", i);
+
+            pass = false;
+        }
+    }
+
+    printf("%-16s %10.1f us %10.1f us\n",
+           "sampled",
+           t / nRound * 1e6,
+           tPlain / nRound * 1e6);
+
+    printf("\n%s\n", pass ? "inferACG Agrees" : "inferACG Deviates");
+
+    return pass ? 0 : 1;
+}
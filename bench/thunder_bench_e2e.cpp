@@ -0,0 +1,606 @@
+/*******************************************************************************
+ * Author:
+ * Dependecy:
+ * Test:
+ * Execution: mpirun -np 3 thunder_bench_e2e [SIZE] [N_PARTICLE] [SYMMETRY] [SNR]
+ *                                          [N_ITER] [DIR]
+ * Description: end-to-end benchmark of a refinement of a synthetic dataset,
+ *              the wall time of each stage of the optimiser and the accuracy
+ *              of the result, written as JSON to DIR/result.json
+ *
+ * The dataset is generated by the master process from a fixed seed, thus the
+ * same for the same arguments. A phantom of gaussian blobs, symmetrised, is
+ * projected by Projector at random poses and translations, multiplied by CTFs
+ * of random defocus and added gaussian noise of the given SNR, and written to
+ * DIR as an MRC stack, a .thu file and the true poses. The phantom is also the
+ * initial model, low-passed by the optimiser to its initial resolution.
+ *
+ * The pose error of each particle is the angle between the estimated rotation
+ * and the nearest symmetry counterpart of the true one. The FSC is taken
+ * between the final reference of hemisphere A and the phantom.
+ *
+ * The migration of images among the processes of a hemisphere by
+ * OPTIMISER_BALANCE_LOAD is exercised in every iteration by building with
+ * -DBALANCE_LOAD_THRES=0 and running with at least 5 processes, the accuracy
+ * of which shall match that of a run without migration.
+ * ****************************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <algorithm>
+
+#include <gsl/gsl_rng.h>
+#include <gsl/gsl_randist.h>
+
+#include "Config.h"
+#include "Logging.h"
+#include "Macro.h"
+#include "FFT.h"
+#include "CTF.h"
+#include "Euler.h"
+#include "Symmetry.h"
+#include "Spectrum.h"
+#include "ImageFile.h"
+#include "Projector.h"
+#include "Optimiser.h"
+
+#define BENCH_SEED 20170101
+
+#define BENCH_PIXEL_SIZE 2.0
+
+#define BENCH_N_BLOB 24
+
+#define BENCH_VOLTAGE 300000.0
+
+#define BENCH_CS 2.7e7
+
+#define BENCH_AMPLITUDE_CONTRAST 0.1
+
+#define BENCH_DEFOCUS_MIN 10000.0
+
+#define BENCH_DEFOCUS_MAX 30000.0
+
+/**
+ * the initial resolution, as the shell of the box, to which the phantom is
+ * low-passed as the initial model
+ */
+#define BENCH_INIT_SHELL 6
+
+/**
+ * standard deviation of the true translations (pixel)
+ */
+#define BENCH_TRANS_S 2.0
+
+/**
+ * a pose within this angle (degree) counts as recovered
+ */
+#define BENCH_POSE_TOL 5.0
+
+INITIALIZE_EASYLOGGINGPP
+
+static const char* stageName[OPTIMISER_N_STAGE] = {"initImg",
+                                                   "global",
+                                                   "local",
+                                                   "insert",
+                                                   "reconstruct",
+                                                   "fsc",
+                                                   "save"};
+
+struct TruePose
+{
+    dvec4 quat;
+
+    dvec2 tran;
+};
+
+static void makePhantom(Volume& dst,
+                        const int size,
+                        const Symmetry& sym,
+                        gsl_rng* engine)
+{
+    dst.alloc(size, size, size, RL_SPACE);
+
+    #pragma omp parallel for
+    SET_0_RL(dst);
+
+    vector<dmat33> rot(1, dmat33::Identity());
+
+    for (int s = 0; s < sym.nSymmetryElement(); s++)
+    {
+        dmat33 L, R;
+
+        sym.get(L, R, s);
+
+        rot.push_back(R);
+    }
+
+    for (int b = 0; b < BENCH_N_BLOB; b++)
+    {
+        dvec3 centre;
+
+        do
+        {
+            for (int d = 0; d < 3; d++)
+                centre(d) = gsl_ran_flat(engine, -size / 4.0, size / 4.0);
+        } while (centre.norm() > size / 4.0);
+
+        double sigma = gsl_ran_flat(engine, size / 40.0, size / 16.0);
+        double height = gsl_ran_flat(engine, 0.5, 1);
+
+        for (size_t r = 0; r < rot.size(); r++)
+        {
+            dvec3 c = rot[r] * centre;
+
+            #pragma omp parallel for
+            VOLUME_FOR_EACH_PIXEL_RL(dst)
+            {
+                double d2 = gsl_pow_2(i - c(0))
+                          + gsl_pow_2(j - c(1))
+                          + gsl_pow_2(k - c(2));
+
+                if (d2 < gsl_pow_2(4 * sigma))
+                    dst.addRL(height * exp(-d2 / (2 * gsl_pow_2(sigma))), i, j, k);
+            }
+        }
+    }
+}
+
+static void generate(vector<TruePose>& truth,
+                     const char dir[],
+                     const int size,
+                     const int nPart,
+                     const char symName[],
+                     const RFLOAT snr)
+{
+    gsl_rng* engine = gsl_rng_alloc(gsl_rng_mt19937);
+
+    gsl_rng_set(engine, BENCH_SEED);
+
+    Symmetry sym(symName);
+
+    Volume phantom;
+
+    makePhantom(phantom, size, sym, engine);
+
+    char filename[FILE_NAME_LENGTH];
+
+    ImageFile imf;
+
+    sprintf(filename, "%s/phantom.mrc", dir);
+
+    imf.readMetaData(phantom);
+    imf.writeVolume(filename, phantom, BENCH_PIXEL_SIZE);
+
+    FFT fft;
+
+    fft.fw(phantom);
+
+    Projector proj;
+
+    proj.setPf(2);
+    proj.setProjectee(phantom.copyVolume());
+
+    sprintf(filename, "%s/particles.mrcs", dir);
+
+    ImageFile stack;
+
+    stack.openStack(filename, size, nPart, BENCH_PIXEL_SIZE);
+
+    sprintf(filename, "%s/particles.thu", dir);
+
+    FILE* thu = fopen(filename, "w");
+
+    sprintf(filename, "%s/truth.txt", dir);
+
+    FILE* pose = fopen(filename, "w");
+
+    if ((thu == NULL) || (pose == NULL))
+    {
+        REPORT_ERROR("FAIL TO WRITE OUT DATASET");
+        abort();
+    }
+
+    truth.resize(nPart);
+
+    Image img(size, size, FT_SPACE);
+    Image ctf(size, size, FT_SPACE);
+
+    for (int l = 0; l < nPart; l++)
+    {
+        TruePose& p = truth[l];
+
+        for (int d = 0; d < 4; d++)
+            p.quat(d) = gsl_ran_gaussian(engine, 1);
+
+        p.quat /= p.quat.norm();
+
+        p.tran(0) = gsl_ran_gaussian(engine, BENCH_TRANS_S);
+        p.tran(1) = gsl_ran_gaussian(engine, BENCH_TRANS_S);
+
+        double defocus = gsl_ran_flat(engine, BENCH_DEFOCUS_MIN, BENCH_DEFOCUS_MAX);
+
+        dmat33 rot;
+
+        rotate3D(rot, p.quat);
+
+        SET_0_FT(img);
+
+        proj.project(img, rot, p.tran);
+
+        CTF(ctf,
+            BENCH_PIXEL_SIZE,
+            BENCH_VOLTAGE,
+            defocus,
+            defocus,
+            0,
+            BENCH_CS,
+            BENCH_AMPLITUDE_CONTRAST,
+            0);
+
+        FOR_EACH_PIXEL_FT(img)
+            img[i] *= REAL(ctf[i]);
+
+        fft.bw(img);
+
+        // noise of the given SNR against the variance of the signal
+
+        double mean = 0, var = 0;
+
+        FOR_EACH_PIXEL_RL(img)
+        {
+            mean += img(i);
+            var += gsl_pow_2(img(i));
+        }
+
+        mean /= img.sizeRL();
+        var = var / img.sizeRL() - gsl_pow_2(mean);
+
+        double sigma = sqrt(var / snr);
+
+        FOR_EACH_PIXEL_RL(img)
+            img(i) += gsl_ran_gaussian(engine, sigma);
+
+        stack.writeStack(img, l);
+
+        img.alloc(size, size, FT_SPACE);
+
+        fprintf(thu,
+                "%12.6f %12.6f %12.6f %12.6f %12.6f %12.6f %12.6f %06d@particles.mrcs %s %12.6f %12.6f %6d %6d %12.6f %12.6f %12.6f %12.6f %12.6f %12.6f %12.6f %12.6f %12.6f %12.6f %12.6f %12.6f %12.6f %12.6f\n",
+                BENCH_VOLTAGE,
+                defocus,
+                defocus,
+                0.0,
+                BENCH_CS,
+                BENCH_AMPLITUDE_CONTRAST,
+                0.0,
+                l + 1,
+                "micrograph",
+                0.0,
+                0.0,
+                1,
+                0,
+                1.0,
+                0.0,
+                0.0,
+                0.0,
+                0.0,
+                0.0,
+                0.0,
+                0.0,
+                0.0,
+                0.0,
+                0.0,
+                1.0,
+                0.0,
+                0.0);
+
+        fprintf(pose,
+                "%06d %12.6f %12.6f %12.6f %12.6f %12.6f %12.6f\n",
+                l + 1,
+                p.quat(0),
+                p.quat(1),
+                p.quat(2),
+                p.quat(3),
+                p.tran(0),
+                p.tran(1));
+    }
+
+    stack.closeStack();
+
+    fclose(thu);
+    fclose(pose);
+
+    gsl_rng_free(engine);
+}
+
+/**
+ * This function reads the poses of the particles from a .thu file, indexed by
+ * the slice of the particle in the stack.
+ */
+static void readPose(std::map<int, TruePose>& dst,
+                     const char filename[])
+{
+    FILE* file = fopen(filename, "r");
+
+    if (file == NULL)
+    {
+        REPORT_ERROR("FAIL TO OPEN FINAL .THU FILE");
+        abort();
+    }
+
+    char line[FILE_LINE_LENGTH];
+
+    while (fgets(line, FILE_LINE_LENGTH, file) != NULL)
+    {
+        vector<char*> word;
+
+        for (char* w = strtok(line, " \n"); w != NULL; w = strtok(NULL, " \n"))
+            word.push_back(w);
+
+        if ((int)word.size() <= THU_TRANSLATION_Y) continue;
+
+        TruePose& p = dst[atoi(word[THU_PARTICLE_PATH])];
+
+        for (int d = 0; d < 4; d++)
+            p.quat(d) = atof(word[THU_QUATERNION_0 + d]);
+
+        p.tran(0) = atof(word[THU_TRANSLATION_X]);
+        p.tran(1) = atof(word[THU_TRANSLATION_Y]);
+    }
+
+    fclose(file);
+}
+
+int main(int argc, char* argv[])
+{
+    int size = (argc > 1) ? atoi(argv[1]) : 64;
+    int nPart = (argc > 2) ? atoi(argv[2]) : 500;
+    const char* symName = (argc > 3) ? argv[3] : "C4";
+    RFLOAT snr = (argc > 4) ? atof(argv[4]) : 0.1;
+    int nIter = (argc > 5) ? atoi(argv[5]) : 6;
+    const char* dir = (argc > 6) ? argv[6] : "bench_e2e";
+
+    loggerInit(argc, argv);
+
+    MPI_Init(&argc, &argv);
+
+    int rank, nProc;
+
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nProc);
+
+    if (nProc < 3)
+    {
+        if (rank == 0)
+            CLOG(FATAL, "LOGGER_SYS") << "THUNDER REQUIRES AT LEAST 3 PROCESSES IN MPI";
+
+        abort();
+    }
+
+    TSFFTW_init_threads();
+
+    vector<TruePose> truth;
+
+    double genTime = MPI_Wtime();
+
+    if (rank == 0)
+    {
+        char cmd[FILE_NAME_LENGTH];
+
+        sprintf(cmd, "mkdir -p %s/out", dir);
+
+        if (system(cmd) != 0)
+        {
+            REPORT_ERROR("FAIL TO CREATE BENCHMARK DIRECTORY");
+            abort();
+        }
+
+        CLOG(INFO, "LOGGER_SYS") << "Generating " << nPart << " Particles of Size " << size;
+
+        generate(truth, dir, size, nPart, symName, snr);
+    }
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    genTime = MPI_Wtime() - genTime;
+
+    OptimiserPara para;
+
+    para.nThreadsPerProcess = omp_get_max_threads();
+    para.mode = MODE_3D;
+    para.gSearch = true;
+    para.lSearch = true;
+    para.cSearch = false;
+    para.k = 1;
+    para.size = size;
+    para.pixelSize = BENCH_PIXEL_SIZE;
+    para.maskRadius = size * BENCH_PIXEL_SIZE * 0.4;
+    para.transS = 3 * BENCH_TRANS_S;
+    para.initRes = size * BENCH_PIXEL_SIZE / BENCH_INIT_SHELL;
+    para.globalSearchRes = 4 * BENCH_PIXEL_SIZE;
+    strcpy(para.sym, symName);
+    sprintf(para.initModel, "%s/phantom.mrc", dir);
+    sprintf(para.db, "%s/particles.thu", dir);
+    sprintf(para.parPrefix, "%s/", dir);
+    sprintf(para.dstPrefix, "%s/out/", dir);
+    para.coreFSC = false;
+    para.maskFSC = false;
+    para.parGra = false;
+    para.performMask = false;
+    para.globalMask = false;
+    strcpy(para.mask, "");
+    para.subtract = false;
+    strcpy(para.regionCentre, "");
+    para.iterMax = nIter;
+    para.goldenStandard = true;
+    para.pf = 2;
+    para.a = 1.9;
+    para.alpha = 15;
+    para.mS = 5000;
+    para.mLR = 125;
+    para.mLT = 9;
+    para.mLD = 9;
+    para.mReco = 100;
+    para.ignoreRes = 200;
+    para.sclCorRes = 40;
+    para.groupSig = false;
+    para.groupScl = false;
+    para.zeroMask = true;
+    para.saveRefEachIter = false;
+    para.saveTHUEachIter = false;
+
+    double runTime = MPI_Wtime();
+
+    Optimiser opt;
+
+    opt.setPara(para);
+    opt.setMPIEnv();
+    opt.run();
+
+    runTime = MPI_Wtime() - runTime;
+
+    // the slowest process of each stage
+
+    double stage[OPTIMISER_N_STAGE];
+
+    for (int i = 0; i < OPTIMISER_N_STAGE; i++)
+        stage[i] = opt.stageTime(i);
+
+    MPI_Allreduce(MPI_IN_PLACE, stage, OPTIMISER_N_STAGE, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+    if (rank == 0)
+    {
+        // pose error against the nearest symmetry counterpart of the truth
+
+        char filename[FILE_NAME_LENGTH];
+
+        sprintf(filename, "%s/out/Meta_Final.thu", dir);
+
+        std::map<int, TruePose> est;
+
+        readPose(est, filename);
+
+        Symmetry sym(symName);
+
+        vector<double> rotErr;
+
+        double tranErr = 0;
+
+        for (int l = 0; l < nPart; l++)
+        {
+            if (est.count(l + 1) == 0) continue;
+
+            const TruePose& e = est[l + 1];
+
+            dmat4 orbit;
+
+            symmetryOrbit(orbit, sym, &truth[l].quat);
+
+            double dot = fabs(e.quat.dot(truth[l].quat));
+
+            for (int s = 0; s < orbit.rows(); s++)
+                dot = GSL_MAX(dot, fabs(orbit.row(s).dot(e.quat.transpose())));
+
+            rotErr.push_back(2 * acos(GSL_MIN(dot, 1.0)) / M_PI * 180);
+
+            tranErr += (e.tran - truth[l].tran).norm();
+        }
+
+        int nMatch = rotErr.size();
+
+        std::sort(rotErr.begin(), rotErr.end());
+
+        double rotErrMean = 0;
+        int nRecover = 0;
+
+        for (int l = 0; l < nMatch; l++)
+        {
+            rotErrMean += rotErr[l];
+
+            if (rotErr[l] < BENCH_POSE_TOL) nRecover++;
+        }
+
+        if (nMatch > 0)
+        {
+            rotErrMean /= nMatch;
+            tranErr /= nMatch;
+        }
+
+        // FSC between the final reference and the phantom
+
+        Volume phantom, ref;
+
+        sprintf(filename, "%s/phantom.mrc", dir);
+
+        ImageFile imf(filename, "rb");
+
+        imf.readMetaData();
+        imf.readVolume(phantom);
+
+        sprintf(filename, "%s/out/Reference_000_A_Final.mrc", dir);
+
+        ImageFile imfRef(filename, "rb");
+
+        imfRef.readMetaData();
+        imfRef.readVolume(ref);
+
+        FFT fft;
+
+        fft.fw(phantom);
+        fft.fw(ref);
+
+        vec fsc(size / 2 - 1);
+
+        FSC(fsc, ref, phantom);
+
+        double res05 = 1.0 / resP2A(resP(fsc, 0.5, 1, 1, false), size, BENCH_PIXEL_SIZE);
+        double res0143 = 1.0 / resP2A(resP(fsc, 0.143, 1, 1, false), size, BENCH_PIXEL_SIZE);
+
+        sprintf(filename, "%s/result.json", dir);
+
+        FILE* file = fopen(filename, "w");
+
+        FILE* out[2] = {stdout, file};
+
+        for (int f = 0; f < 2; f++)
+        {
+            if (out[f] == NULL) continue;
+
+            fprintf(out[f], "{\n");
+            fprintf(out[f], "  \"size\": %d,\n", size);
+            fprintf(out[f], "  \"particles\": %d,\n", nPart);
+            fprintf(out[f], "  \"symmetry\": \"%s\",\n", symName);
+            fprintf(out[f], "  \"snr\": %g,\n", snr);
+            fprintf(out[f], "  \"iterations\": %d,\n", nIter);
+            fprintf(out[f], "  \"processes\": %d,\n", nProc);
+            fprintf(out[f], "  \"threads\": %d,\n", omp_get_max_threads());
+            fprintf(out[f], "  \"seconds\": {\n");
+            fprintf(out[f], "    \"generate\": %.3f,\n", genTime);
+
+            for (int i = 0; i < OPTIMISER_N_STAGE; i++)
+                fprintf(out[f], "    \"%s\": %.3f,\n", stageName[i], stage[i]);
+
+            fprintf(out[f], "    \"run\": %.3f\n", runTime);
+            fprintf(out[f], "  },\n");
+            fprintf(out[f], "  \"accuracy\": {\n");
+            fprintf(out[f], "    \"matched\": %d,\n", nMatch);
+            fprintf(out[f], "    \"rotation_error_mean_deg\": %.3f,\n", rotErrMean);
+            fprintf(out[f], "    \"rotation_error_median_deg\": %.3f,\n", nMatch > 0 ? rotErr[nMatch / 2] : 0.0);
+            fprintf(out[f], "    \"recovered_fraction\": %.4f,\n", nMatch > 0 ? (double)nRecover / nMatch : 0.0);
+            fprintf(out[f], "    \"translation_error_mean_px\": %.3f,\n", tranErr);
+            fprintf(out[f], "    \"fsc_0.5_angstrom\": %.3f,\n", res05);
+            fprintf(out[f], "    \"fsc_0.143_angstrom\": %.3f\n", res0143);
+            fprintf(out[f], "  }\n");
+            fprintf(out[f], "}\n");
+        }
+
+        if (file != NULL) fclose(file);
+    }
+
+    MPI_Finalize();
+
+    TSFFTW_cleanup_threads();
+
+    return 0;
+}
@@ -0,0 +1,1251 @@
+/*******************************************************************************
+ * Author:
+ * Dependecy:
+ * Test:
+ * Execution: thunder_bench_kernel [SIZES] [THREADS] [TIME]
+ * Description: throughput of the scoring, translation, projection, insertion,
+ *              CTF, tabulated function and FFT primitives over box sizes,
+ *              numbers of threads, kernel paths and precisions, against a
+ *              roofline of the machine, and the agreement of the variants of
+ *              each primitive
+ *
+ * SIZES and THREADS are comma separated lists, by default 64,128,256 and the
+ * powers of 2 up to the number of threads of OpenMP. Each measurement runs for
+ * TIME seconds, 0.5 by default.
+ *
+ * Each thread runs the primitive on its own output over the pixels of a Fourier
+ * half image within radius SIZE / 2 - 1, as the expectation does, the kernels
+ * of Kernel.h on every path supported. ns/pixel is the time of a thread per
+ * pixel, thus the same for perfect scaling. The FLOPs and the bytes of a pixel
+ * are counted from the code of the primitive, a transcendental function as one
+ * FLOP, the bytes being those of the arrays streamed through, the gathers of
+ * projection and insertion counted in full. The roofline is the minimum of the
+ * peak, measured by chains of FMAs on the widest path, and the intensity times
+ * the bandwidth, measured by a triad by the same threads. The GFLOP/s are given
+ * as fractions of the roofline of the bandwidth of memory and of that of cache,
+ * as the data of the smaller sizes stay in cache.
+ *
+ * Each variant is compared against a reference, scoring and translation
+ * evaluated in double, Volume / Image::getByInterpolationFT for projection, the
+ * sum of the values for insertion, CTF for CTFFromTerm, the function itself for
+ * TabFunction and the image itself for a round trip of FFT. The program returns
+ * 1 if any deviates beyond its tolerance.
+ *
+ * RFLOAT is float or double as SINGLE_PRECISION is set at compile time, the
+ * scoring is also measured with the data, CTF and sigma in bfloat16.
+ * ****************************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include <boost/bind.hpp>
+
+#include <omp_compat.h>
+
+#include "Config.h"
+#include "Logging.h"
+#include "Macro.h"
+#include "Random.h"
+#include "Euler.h"
+#include "FFT.h"
+#include "CTF.h"
+#include "Kernel.h"
+#include "Projector.h"
+#include "Functions.h"
+#include "TabFunction.h"
+#include "Topology.h"
+
+/**
+ * the images scored against each projection, as a batch of the expectation
+ */
+#define BENCH_N_IMAGE 64
+
+/**
+ * the rotations cycled through by projection and insertion
+ */
+#define BENCH_N_ROT 32
+
+/**
+ * RFLOATs of each array of the triad per thread, out of cache and in cache
+ */
+#define BENCH_STREAM_SIZE (1 << 22)
+
+#define BENCH_CACHE_SIZE (1 << 13)
+
+/**
+ * seconds of each measurement by default
+ */
+#define BENCH_TIME 0.5
+
+/**
+ * relative deviation tolerated in RFLOAT, in bfloat16, and of the CTF by terms
+ * and the tabulated function, which approximate by polynomial and by table
+ */
+#define BENCH_TOL 1e-4
+
+#define BENCH_TOL_BF16 (4 * BF16_EPSILON)
+
+#define BENCH_TOL_APPROX 1e-3
+
+#define BENCH_PIXEL_SIZE 1.0
+
+#define BENCH_VOLTAGE 300000.0
+
+#define BENCH_DEFOCUS_U 20000.0
+
+#define BENCH_DEFOCUS_V 18000.0
+
+#define BENCH_THETA 0.3
+
+#define BENCH_CS 2.7e7
+
+#define BENCH_AMPLITUDE_CONTRAST 0.1
+
+/**
+ * the FLOPs of each pixel of each primitive, a transcendental function as one
+ */
+#define BENCH_FLOP_SCORE 9
+
+#define BENCH_FLOP_TRANSLATE 30
+
+#define BENCH_FLOP_PROJECT_3D 57
+
+#define BENCH_FLOP_PROJECT_2D 28
+
+#define BENCH_FLOP_INSERT 56
+
+#define BENCH_FLOP_CTF 24
+
+#define BENCH_FLOP_CTF_TERM 20
+
+#define BENCH_FLOP_TAB 3
+
+#define BENCH_FLOP_MKB 7
+
+/**
+ * the bytes of each pixel of each primitive
+ */
+#define BENCH_BYTE_SCORE (4 * sizeof(RFLOAT))
+
+#define BENCH_BYTE_SCORE_BF16 (4 * sizeof(bf16))
+
+#define BENCH_BYTE_SCORE_ONE (6 * sizeof(RFLOAT))
+
+#define BENCH_BYTE_TRANSLATE (2 * sizeof(int) + sizeof(Complex))
+
+#define BENCH_BYTE_PROJECT_3D (2 * sizeof(int) + 9 * sizeof(Complex))
+
+#define BENCH_BYTE_PROJECT_2D (2 * sizeof(int) + 5 * sizeof(Complex))
+
+#define BENCH_BYTE_INSERT (2 * sizeof(int) + 17 * sizeof(Complex))
+
+#define BENCH_BYTE_CTF (2 * sizeof(int) + sizeof(RFLOAT))
+
+#define BENCH_BYTE_CTF_TERM (3 * sizeof(RFLOAT))
+
+#define BENCH_BYTE_TAB (2 * sizeof(RFLOAT))
+
+#define BENCH_BYTE_FFT (4 * sizeof(RFLOAT))
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BENCH_MULTIVERSION
+#endif
+
+INITIALIZE_EASYLOGGINGPP
+
+struct BenchData
+{
+    int size;
+
+    int pf;
+
+    int nPxl;
+
+    vector<int> iCol;
+
+    vector<int> iRow;
+
+    const KernelTable* kt;
+
+    /**
+     * BENCH_N_IMAGE images, CTFs and sigmas, pixel-major as the expectation
+     * stores them, and the same in bfloat16
+     */
+    Complex* dat;
+
+    RFLOAT* ctf;
+
+    RFLOAT* sigRcp;
+
+    ComplexBF16* datBF16;
+
+    bf16* ctfBF16;
+
+    bf16* sigRcpBF16;
+
+    /**
+     * a projection, the value scored and inserted
+     */
+    Complex* pri;
+
+    /**
+     * the outputs of the threads, nPxl each, or BENCH_N_IMAGE for the scores
+     */
+    Complex* outC;
+
+    RFLOAT* outR;
+
+    RFLOAT* score;
+
+    Projector proj3D;
+
+    Projector proj2D;
+
+    Volume reco;
+
+    dmat33 rot3D[BENCH_N_ROT];
+
+    dmat22 rot2D[BENCH_N_ROT];
+
+    RFLOAT* dfTerm;
+
+    RFLOAT* cTerm;
+
+    /**
+     * the kernel of the reconstructor in Fourier space, tabulated, and the
+     * squared radii it is looked up at
+     */
+    TabFunction tab;
+
+    RFLOAT a;
+
+    RFLOAT alpha;
+
+    RFLOAT* r2;
+
+    /**
+     * an image in real space of each thread
+     */
+    Image* img;
+};
+
+/**
+ * the peak GFLOP/s, and the bandwidth in GB/s out of cache and in cache
+ */
+struct Roofline
+{
+    double peak;
+
+    double memory;
+
+    double cache;
+};
+
+typedef void (*BenchKernel)(BenchData& d,
+                            const int t,
+                            const int c);
+
+/* ******************************* ROOFLINE ******************************** */
+
+#define BENCH_FMA_CHAIN(v) v = v * a + b
+
+template <typename V>
+static inline __attribute__((always_inline)) double peakChain(const long nRep)
+{
+    V zero = {};
+
+    V a = zero + (RFLOAT)0.999999;
+    V b = zero + (RFLOAT)1e-7;
+
+    // 8 independent chains, enough to fill the FMA units
+
+    V v0 = zero + (RFLOAT)0.1, v1 = zero + (RFLOAT)0.2;
+    V v2 = zero + (RFLOAT)0.3, v3 = zero + (RFLOAT)0.4;
+    V v4 = zero + (RFLOAT)0.5, v5 = zero + (RFLOAT)0.6;
+    V v6 = zero + (RFLOAT)0.7, v7 = zero + (RFLOAT)0.8;
+
+    for (long r = 0; r < nRep; r++)
+    {
+        BENCH_FMA_CHAIN(v0);
+        BENCH_FMA_CHAIN(v1);
+        BENCH_FMA_CHAIN(v2);
+        BENCH_FMA_CHAIN(v3);
+        BENCH_FMA_CHAIN(v4);
+        BENCH_FMA_CHAIN(v5);
+        BENCH_FMA_CHAIN(v6);
+        BENCH_FMA_CHAIN(v7);
+    }
+
+    V sum = v0 + v1 + v2 + v3 + v4 + v5 + v6 + v7;
+
+    return sum[0];
+}
+
+typedef RFLOAT BenchVec128 __attribute__((vector_size(16)));
+
+static double peakChainDefault(const long nRep)
+{
+    return peakChain<BenchVec128>(nRep);
+}
+
+#ifdef BENCH_MULTIVERSION
+
+typedef RFLOAT BenchVec256 __attribute__((vector_size(32)));
+
+typedef RFLOAT BenchVec512 __attribute__((vector_size(64)));
+
+__attribute__((target("avx2,fma")))
+static double peakChainAVX2(const long nRep)
+{
+    return peakChain<BenchVec256>(nRep);
+}
+
+__attribute__((target("avx512f,avx2,fma")))
+static double peakChainAVX512(const long nRep)
+{
+    return peakChain<BenchVec512>(nRep);
+}
+
+#endif
+
+/**
+ * This function measures the peak GFLOP/s of nThread threads by chains of FMAs
+ * of the widest vectors of the path selected.
+ */
+static double measurePeak(const int nThread,
+                          const double benchTime)
+{
+    double (*chain)(const long) = peakChainDefault;
+
+    int width = 16;
+
+#ifdef BENCH_MULTIVERSION
+    if (strcmp(kernel().name, "avx512") == 0)
+    {
+        chain = peakChainAVX512;
+        width = 64;
+    }
+    else if (strcmp(kernel().name, "avx2") == 0)
+    {
+        chain = peakChainAVX2;
+        width = 32;
+    }
+#endif
+
+    const long nRep = 1 << 20;
+
+    long nCall = 0;
+
+    double sink = 0;
+
+    double start = omp_get_wtime();
+
+    #pragma omp parallel num_threads(nThread) reduction(+:nCall, sink)
+    {
+        do
+        {
+            sink += chain(nRep);
+
+            nCall += 1;
+        } while (omp_get_wtime() - start < benchTime);
+    }
+
+    double elapse = omp_get_wtime() - start;
+
+    if (sink == 0) printf("%g", sink);
+
+    return nCall * nRep * 8.0 * 2 * (width / sizeof(RFLOAT)) / elapse / 1e9;
+}
+
+/**
+ * This function measures the bandwidth in GB/s of nThread threads by a triad of
+ * arrays of n RFLOATs per thread, each thread on its own slice of the arrays,
+ * placed by first touch.
+ */
+static double measureBandwidth(const int nThread,
+                               const size_t n,
+                               const double benchTime)
+{
+    omp_set_num_threads(nThread);
+
+    RFLOAT* x = (RFLOAT*)mallocFirstTouch(n * nThread * sizeof(RFLOAT));
+    RFLOAT* y = (RFLOAT*)mallocFirstTouch(n * nThread * sizeof(RFLOAT));
+    RFLOAT* z = (RFLOAT*)mallocFirstTouch(n * nThread * sizeof(RFLOAT));
+
+    long nPass = 0;
+
+    double start = omp_get_wtime();
+
+    #pragma omp parallel reduction(+:nPass)
+    {
+        size_t begin = n * omp_get_thread_num();
+
+        for (size_t i = begin; i < begin + n; i++)
+        {
+            y[i] = 1;
+            z[i] = 2;
+        }
+
+        #pragma omp barrier
+
+        #pragma omp single
+        start = omp_get_wtime();
+
+        do
+        {
+            #pragma omp simd
+            for (size_t i = begin; i < begin + n; i++)
+                x[i] = y[i] + (RFLOAT)0.5 * z[i];
+
+            nPass += 1;
+        } while (omp_get_wtime() - start < benchTime);
+    }
+
+    double elapse = omp_get_wtime() - start;
+
+    TSFFTW_free(x);
+    TSFFTW_free(y);
+    TSFFTW_free(z);
+
+    return nPass * 3.0 * n * sizeof(RFLOAT) / elapse / 1e9;
+}
+
+/* ******************************* KERNELS ********************************* */
+
+static void runScore(BenchData& d,
+                     const int t,
+                     const int c)
+{
+    RFLOAT* score = d.score + BENCH_N_IMAGE * t;
+
+    memset(score, 0, BENCH_N_IMAGE * sizeof(RFLOAT));
+
+    d.kt->logDataVSPrior_m_n(d.dat, d.pri, d.ctf, d.sigRcp, BENCH_N_IMAGE, d.nPxl, score);
+}
+
+static void runScoreBF16(BenchData& d,
+                         const int t,
+                         const int c)
+{
+    RFLOAT* score = d.score + BENCH_N_IMAGE * t;
+
+    memset(score, 0, BENCH_N_IMAGE * sizeof(RFLOAT));
+
+    d.kt->logDataVSPrior_m_n_BF16(d.datBF16, d.pri, d.ctfBF16, d.sigRcpBF16, BENCH_N_IMAGE, d.nPxl, score);
+}
+
+/**
+ * scoring of one image, of which the data, CTF and sigma are the first nPxl
+ * elements of those of the batch
+ */
+static void runScoreOne(BenchData& d,
+                        const int t,
+                        const int c)
+{
+    d.score[BENCH_N_IMAGE * t] = d.kt->logDataVSPrior_m(d.dat, d.pri, d.ctf, d.sigRcp, d.nPxl);
+}
+
+static void transOf(RFLOAT& x,
+                    RFLOAT& y,
+                    const int c)
+{
+    x = 0.37 + (c % 7);
+    y = -1.21 - (c % 5);
+}
+
+static void runTranslate(BenchData& d,
+                         const int t,
+                         const int c)
+{
+    RFLOAT x, y;
+
+    transOf(x, y, c);
+
+    d.kt->translate(d.outC + (size_t)d.nPxl * t, x, y, d.size, d.size, &d.iCol[0], &d.iRow[0], d.nPxl);
+}
+
+static void runProject3D(BenchData& d,
+                         const int t,
+                         const int c)
+{
+    const Volume& src = d.proj3D.projectee3D();
+
+    d.kt->project3D(d.outC + (size_t)d.nPxl * t,
+                    src.dataFT(),
+                    src.nColFT(),
+                    src.nRowFT(),
+                    src.nSlcFT(),
+                    d.rot3D[c % BENCH_N_ROT].data(),
+                    d.pf,
+                    &d.iCol[0],
+                    &d.iRow[0],
+                    d.nPxl);
+}
+
+static void runProject2D(BenchData& d,
+                         const int t,
+                         const int c)
+{
+    const Image& src = d.proj2D.projectee2D();
+
+    d.kt->project2D(d.outC + (size_t)d.nPxl * t,
+                    src.dataFT(),
+                    src.nColFT(),
+                    src.nRowFT(),
+                    d.rot2D[c % BENCH_N_ROT].data(),
+                    d.pf,
+                    &d.iCol[0],
+                    &d.iRow[0],
+                    d.nPxl);
+}
+
+/**
+ * projection pixel by pixel by Volume::getByInterpolationFT, as Projector does
+ * without the kernels
+ */
+static void runInterp3D(BenchData& d,
+                        const int t,
+                        const int c)
+{
+    const Volume& src = d.proj3D.projectee3D();
+    const dmat33& mat = d.rot3D[c % BENCH_N_ROT];
+
+    Complex* dst = d.outC + (size_t)d.nPxl * t;
+
+    for (int i = 0; i < d.nPxl; i++)
+    {
+        dvec3 newCor((double)(d.iCol[i] * d.pf), (double)(d.iRow[i] * d.pf), 0);
+        dvec3 oldCor = mat * newCor;
+
+        dst[i] = src.getByInterpolationFT(oldCor(0), oldCor(1), oldCor(2), LINEAR_INTERP);
+    }
+}
+
+static void runInterp2D(BenchData& d,
+                        const int t,
+                        const int c)
+{
+    const Image& src = d.proj2D.projectee2D();
+    const dmat22& mat = d.rot2D[c % BENCH_N_ROT];
+
+    Complex* dst = d.outC + (size_t)d.nPxl * t;
+
+    for (int i = 0; i < d.nPxl; i++)
+    {
+        dvec2 newCor((double)(d.iCol[i] * d.pf), (double)(d.iRow[i] * d.pf));
+        dvec2 oldCor = mat * newCor;
+
+        dst[i] = src.getByInterpolationFT(oldCor(0), oldCor(1), LINEAR_INTERP);
+    }
+}
+
+/**
+ * insertion of a projection by Volume::addFT into the padded volume shared by
+ * the threads, as the reconstructor does
+ */
+static void runInsert(BenchData& d,
+                      const int t,
+                      const int c)
+{
+    const dmat33& mat = d.rot3D[c % BENCH_N_ROT];
+
+    for (int i = 0; i < d.nPxl; i++)
+    {
+        dvec3 newCor((double)(d.iCol[i] * d.pf), (double)(d.iRow[i] * d.pf), 0);
+        dvec3 oldCor = mat * newCor;
+
+        d.reco.addFT(d.pri[i], (RFLOAT)oldCor(0), (RFLOAT)oldCor(1), (RFLOAT)oldCor(2));
+    }
+}
+
+static void runCTF(BenchData& d,
+                   const int t,
+                   const int c)
+{
+    CTF(d.outR + (size_t)d.nPxl * t,
+        BENCH_PIXEL_SIZE,
+        BENCH_VOLTAGE,
+        BENCH_DEFOCUS_U,
+        BENCH_DEFOCUS_V,
+        BENCH_THETA,
+        BENCH_CS,
+        BENCH_AMPLITUDE_CONTRAST,
+        0,
+        d.size,
+        d.size,
+        &d.iCol[0],
+        &d.iRow[0],
+        d.nPxl);
+}
+
+static void runCTFTerm(BenchData& d,
+                       const int t,
+                       const int c)
+{
+    CTFFromTerm(d.outR + (size_t)d.nPxl * t, d.dfTerm, d.cTerm, 1, d.nPxl);
+}
+
+static void runTab(BenchData& d,
+                   const int t,
+                   const int c)
+{
+    RFLOAT* dst = d.outR + (size_t)d.nPxl * t;
+
+    for (int i = 0; i < d.nPxl; i++)
+        dst[i] = d.tab(d.r2[i]);
+}
+
+static void runMKB(BenchData& d,
+                   const int t,
+                   const int c)
+{
+    RFLOAT* dst = d.outR + (size_t)d.nPxl * t;
+
+    for (int i = 0; i < d.nPxl; i++)
+        dst[i] = MKB_FT_R2(d.r2[i], d.a, d.alpha);
+}
+
+/**
+ * a forward and a backward FFT of an image, planned on each call as FFT::fw and
+ * FFT::bw do
+ */
+static void runFFT(BenchData& d,
+                   const int t,
+                   const int c)
+{
+    FFT fft;
+
+    fft.fw(d.img[t]);
+    fft.bw(d.img[t]);
+}
+
+/* ******************************* HARNESS ********************************* */
+
+/**
+ * This function returns the calls per second of a primitive run by nThread
+ * threads concurrently.
+ */
+static double timeKernel(BenchKernel f,
+                         BenchData& d,
+                         const int nThread,
+                         const double benchTime)
+{
+    // warm up, touching the outputs of each thread
+
+    #pragma omp parallel num_threads(nThread)
+    f(d, omp_get_thread_num(), 0);
+
+    long nCall = 0;
+
+    double start = omp_get_wtime();
+
+    #pragma omp parallel num_threads(nThread) reduction(+:nCall)
+    {
+        int t = omp_get_thread_num();
+
+        int c = 0;
+
+        do
+        {
+            f(d, t, c++);
+        } while (omp_get_wtime() - start < benchTime);
+
+        nCall += c;
+    }
+
+    return nCall / (omp_get_wtime() - start);
+}
+
+/**
+ * This function returns max |dst - ref| / max |ref|.
+ */
+static double deviation(const Complex* dst,
+                        const Complex* ref,
+                        const int n)
+{
+    double diff = 0;
+    double norm = 0;
+
+    for (int i = 0; i < n; i++)
+    {
+        diff = GSL_MAX(diff, ABS(dst[i] - ref[i]));
+        norm = GSL_MAX(norm, ABS(ref[i]));
+    }
+
+    return (norm > 0) ? diff / norm : diff;
+}
+
+static double deviation(const RFLOAT* dst,
+                        const double* ref,
+                        const int n)
+{
+    double diff = 0;
+    double norm = 0;
+
+    for (int i = 0; i < n; i++)
+    {
+        diff = GSL_MAX(diff, fabs(dst[i] - ref[i]));
+        norm = GSL_MAX(norm, fabs(ref[i]));
+    }
+
+    return (norm > 0) ? diff / norm : diff;
+}
+
+static double deviation(const RFLOAT* dst,
+                        const RFLOAT* ref,
+                        const int n)
+{
+    vector<double> refD(ref, ref + n);
+
+    return deviation(dst, &refD[0], n);
+}
+
+static bool pass = true;
+
+/**
+ * This function reports a measurement against the roofline, and whether the
+ * deviation is within the tolerance, a negative deviation marking a reference.
+ */
+static void report(const char* name,
+                   const char* variant,
+                   const int size,
+                   const int nThread,
+                   const double rate,
+                   const double nPixel,
+                   const double flop,
+                   const double byte,
+                   const Roofline& roof,
+                   const double dev,
+                   const double tol)
+{
+    double pixelRate = rate * nPixel;
+
+    double gflops = pixelRate * flop / 1e9;
+    double gbs = pixelRate * byte / 1e9;
+
+    double roofMemory = GSL_MIN(roof.peak, flop / byte * roof.memory);
+    double roofCache = GSL_MIN(roof.peak, flop / byte * roof.cache);
+
+    const char* check = "ref";
+
+    if (dev >= 0)
+    {
+        check = (dev <= tol) ? "ok" : "FAIL";
+
+        if (dev > tol) pass = false;
+    }
+
+    printf("%-16s %-12s %6d %4d %10.3f %10.2f %10.2f %10.2f %7.1f%% %7.1f%% %10.2e %6s\n",
+           name,
+           variant,
+           size,
+           nThread,
+           1e9 * nThread / pixelRate,
+           gflops,
+           gbs,
+           roofMemory,
+           100 * gflops / roofMemory,
+           100 * gflops / roofCache,
+           GSL_MAX(dev, 0.0),
+           check);
+}
+
+static void parseList(vector<int>& dst,
+                      char* list)
+{
+    for (char* w = strtok(list, ","); w != NULL; w = strtok(NULL, ","))
+        if (atoi(w) > 0) dst.push_back(atoi(w));
+}
+
+static void initData(BenchData& d,
+                     const int size,
+                     const int nThread)
+{
+    gsl_rng* engine = get_random_engine();
+
+    d.size = size;
+    d.pf = 2;
+
+    // the pixels within the radius of the Fourier half image
+
+    d.iCol.clear();
+    d.iRow.clear();
+
+    int r = size / 2 - 1;
+
+    for (int j = -r; j < r; j++)
+        for (int i = 0; i <= r; i++)
+            if (i * i + j * j < r * r)
+            {
+                d.iCol.push_back(i);
+                d.iRow.push_back(j);
+            }
+
+    d.nPxl = d.iCol.size();
+
+    size_t nBatch = (size_t)d.nPxl * BENCH_N_IMAGE;
+
+    d.dat = (Complex*)TSFFTW_malloc(nBatch * sizeof(Complex));
+    d.ctf = (RFLOAT*)TSFFTW_malloc(nBatch * sizeof(RFLOAT));
+    d.sigRcp = (RFLOAT*)TSFFTW_malloc(nBatch * sizeof(RFLOAT));
+
+    d.datBF16 = (ComplexBF16*)TSFFTW_malloc(nBatch * sizeof(ComplexBF16));
+    d.ctfBF16 = (bf16*)TSFFTW_malloc(nBatch * sizeof(bf16));
+    d.sigRcpBF16 = (bf16*)TSFFTW_malloc(nBatch * sizeof(bf16));
+
+    for (size_t i = 0; i < nBatch; i++)
+    {
+        d.dat[i] = COMPLEX(gsl_ran_gaussian(engine, 1), gsl_ran_gaussian(engine, 1));
+        d.ctf[i] = gsl_ran_flat(engine, -1, 1);
+        d.sigRcp[i] = -gsl_ran_flat(engine, 0.1, 1);
+
+        d.datBF16[i] = COMPLEX_BF16(d.dat[i]);
+        d.ctfBF16[i] = BF16(d.ctf[i]);
+        d.sigRcpBF16[i] = BF16(d.sigRcp[i]);
+    }
+
+    d.pri = (Complex*)TSFFTW_malloc(d.nPxl * sizeof(Complex));
+
+    for (int i = 0; i < d.nPxl; i++)
+        d.pri[i] = COMPLEX(gsl_ran_gaussian(engine, 1), gsl_ran_gaussian(engine, 1));
+
+    d.outC = (Complex*)TSFFTW_malloc((size_t)d.nPxl * nThread * sizeof(Complex));
+    d.outR = (RFLOAT*)TSFFTW_malloc((size_t)d.nPxl * nThread * sizeof(RFLOAT));
+    d.score = (RFLOAT*)TSFFTW_malloc(BENCH_N_IMAGE * nThread * sizeof(RFLOAT));
+
+    // the projectees, padded by the projectors
+
+    Volume vol(size, size, size, FT_SPACE);
+
+    VOLUME_FOR_EACH_PIXEL_FT(vol)
+        vol.setFTHalf(COMPLEX(gsl_ran_gaussian(engine, 1),
+                              gsl_ran_gaussian(engine, 1)),
+                      i,
+                      j,
+                      k);
+
+    d.proj3D.setPf(d.pf);
+    d.proj3D.setProjectee(boost::move(vol), r);
+
+    Image img(size, size, FT_SPACE);
+
+    IMAGE_FOR_EACH_PIXEL_FT(img)
+        img.setFTHalf(COMPLEX(gsl_ran_gaussian(engine, 1),
+                              gsl_ran_gaussian(engine, 1)),
+                      i,
+                      j);
+
+    d.proj2D.setPf(d.pf);
+    d.proj2D.setProjectee(boost::move(img), r);
+
+    d.reco.alloc(d.pf * size, d.pf * size, d.pf * size, FT_SPACE);
+
+    #pragma omp parallel for
+    SET_0_FT(d.reco);
+
+    for (int i = 0; i < BENCH_N_ROT; i++)
+    {
+        dvec4 quat;
+
+        for (int k = 0; k < 4; k++)
+            quat(k) = gsl_ran_gaussian(engine, 1);
+
+        quat /= quat.norm();
+
+        rotate3D(d.rot3D[i], quat);
+
+        rotate2D(d.rot2D[i], gsl_ran_flat(engine, 0, 2 * M_PI));
+    }
+
+    d.dfTerm = (RFLOAT*)TSFFTW_malloc(d.nPxl * sizeof(RFLOAT));
+    d.cTerm = (RFLOAT*)TSFFTW_malloc(d.nPxl * sizeof(RFLOAT));
+
+    CTFTerm(d.dfTerm,
+            d.cTerm,
+            BENCH_PIXEL_SIZE,
+            BENCH_VOLTAGE,
+            BENCH_DEFOCUS_U,
+            BENCH_DEFOCUS_V,
+            BENCH_THETA,
+            BENCH_CS,
+            BENCH_AMPLITUDE_CONTRAST,
+            0,
+            size,
+            size,
+            &d.iCol[0],
+            &d.iRow[0],
+            d.nPxl);
+
+    // the kernel of the reconstructor of the default a and alpha
+
+    d.a = d.pf * 1.9;
+    d.alpha = 15;
+
+    d.tab.init(boost::bind(MKB_FT_R2,
+                           boost::placeholders::_1,
+                           d.a,
+                           d.alpha),
+               0,
+               gsl_pow_2(d.a),
+               1e5);
+
+    d.r2 = (RFLOAT*)TSFFTW_malloc(d.nPxl * sizeof(RFLOAT));
+
+    for (int i = 0; i < d.nPxl; i++)
+        d.r2[i] = gsl_ran_flat(engine, 0, gsl_pow_2(d.a));
+
+    d.img = new Image[nThread];
+
+    for (int t = 0; t < nThread; t++)
+    {
+        d.img[t].alloc(size, size, RL_SPACE);
+
+        FOR_EACH_PIXEL_RL(d.img[t])
+            d.img[t](i) = gsl_ran_gaussian(engine, 1);
+    }
+}
+
+static void freeData(BenchData& d)
+{
+    TSFFTW_free(d.dat);
+    TSFFTW_free(d.ctf);
+    TSFFTW_free(d.sigRcp);
+    TSFFTW_free(d.datBF16);
+    TSFFTW_free(d.ctfBF16);
+    TSFFTW_free(d.sigRcpBF16);
+    TSFFTW_free(d.pri);
+    TSFFTW_free(d.outC);
+    TSFFTW_free(d.outR);
+    TSFFTW_free(d.score);
+    TSFFTW_free(d.dfTerm);
+    TSFFTW_free(d.cTerm);
+    TSFFTW_free(d.r2);
+
+    delete[] d.img;
+
+    d.reco.clear();
+}
+
+int main(int argc, char* argv[])
+{
+    loggerInit(argc, argv);
+
+    vector<int> sizes, threads;
+
+    char sizeList[] = "64,128,256";
+
+    parseList(sizes, (argc > 1) ? argv[1] : sizeList);
+
+    if (argc > 2)
+        parseList(threads, argv[2]);
+    else
+    {
+        for (int t = 1; t < omp_get_max_threads(); t *= 2)
+            threads.push_back(t);
+
+        threads.push_back(omp_get_max_threads());
+    }
+
+    double benchTime = (argc > 3) ? atof(argv[3]) : BENCH_TIME;
+
+    if (sizes.empty() || threads.empty() || (benchTime <= 0))
+    {
+        printf("Usage: thunder_bench_kernel [SIZES] [THREADS] [TIME]\n");
+
+        return -1;
+    }
+
+    int nThreadMax = *std::max_element(threads.begin(), threads.end());
+
+    TSFFTW_init_threads();
+
+    vector<int> paths;
+
+    for (int p = 0; p < KERNEL_N_PATH; p++)
+        if (kernelSupported(p)) paths.push_back(p);
+
+    printf("RFLOAT of %d Bytes, Path %s Selected, %d Paths Supported\n",
+           (int)sizeof(RFLOAT),
+           kernel().name,
+           (int)paths.size());
+
+    // the roofline of each number of threads
+
+    vector<Roofline> roof(threads.size());
+
+    for (size_t n = 0; n < threads.size(); n++)
+    {
+        roof[n].peak = measurePeak(threads[n], benchTime);
+        roof[n].memory = measureBandwidth(threads[n], BENCH_STREAM_SIZE, benchTime);
+        roof[n].cache = measureBandwidth(threads[n], BENCH_CACHE_SIZE, benchTime);
+
+        printf("%4d Threads, Peak %10.2f GFLOP/s, Bandwidth %10.2f GB/s of Memory, %10.2f GB/s of Cache\n",
+               threads[n],
+               roof[n].peak,
+               roof[n].memory,
+               roof[n].cache);
+    }
+
+    omp_set_num_threads(nThreadMax);
+
+    printf("\n%-16s %-12s %6s %4s %10s %10s %10s %10s %8s %8s %10s %6s\n",
+           "Kernel",
+           "Variant",
+           "Size",
+           "Thr",
+           "ns/pixel",
+           "GFLOP/s",
+           "GB/s",
+           "Roofline",
+           "Memory",
+           "Cache",
+           "Deviation",
+           "Check");
+
+    for (size_t s = 0; s < sizes.size(); s++)
+    {
+        int size = sizes[s];
+
+        BenchData d;
+
+        initData(d, size, nThreadMax);
+
+        int m = d.nPxl;
+
+        // the references and the deviations of the variants, by thread 0
+
+        vector<double> refScore(BENCH_N_IMAGE, 0);
+
+        for (int i = 0; i < m; i++)
+            for (int j = 0; j < BENCH_N_IMAGE; j++)
+            {
+                size_t idx = (size_t)i * BENCH_N_IMAGE + j;
+
+                double re = (double)d.dat[idx].dat[0] - (double)d.ctf[idx] * d.pri[i].dat[0];
+                double im = (double)d.dat[idx].dat[1] - (double)d.ctf[idx] * d.pri[i].dat[1];
+
+                refScore[j] += (re * re + im * im) * d.sigRcp[idx];
+            }
+
+        // the first image of the batch, strided by BENCH_N_IMAGE in memory, is
+        // scored by logDataVSPrior_m as the first m elements
+
+        double refOne = 0;
+
+        for (int i = 0; i < m; i++)
+        {
+            double re = (double)d.dat[i].dat[0] - (double)d.ctf[i] * d.pri[i].dat[0];
+            double im = (double)d.dat[i].dat[1] - (double)d.ctf[i] * d.pri[i].dat[1];
+
+            refOne += (re * re + im * im) * d.sigRcp[i];
+        }
+
+        vector<Complex> refTrans(m), refProj3D(m), refProj2D(m);
+
+        RFLOAT tx, ty;
+
+        transOf(tx, ty, 0);
+
+        for (int i = 0; i < m; i++)
+        {
+            double phase = 2 * M_PI * ((double)d.iCol[i] * tx / size + (double)d.iRow[i] * ty / size);
+
+            refTrans[i] = COMPLEX(cos(phase), -sin(phase));
+        }
+
+        runInterp3D(d, 0, 0);
+        memcpy(&refProj3D[0], d.outC, m * sizeof(Complex));
+
+        runInterp2D(d, 0, 0);
+        memcpy(&refProj2D[0], d.outC, m * sizeof(Complex));
+
+        vector<double> devScore(KERNEL_N_PATH), devScoreBF16(KERNEL_N_PATH), devScoreOne(KERNEL_N_PATH);
+        vector<double> devTrans(KERNEL_N_PATH), devProj3D(KERNEL_N_PATH), devProj2D(KERNEL_N_PATH);
+
+        for (size_t p = 0; p < paths.size(); p++)
+        {
+            d.kt = &kernel(paths[p]);
+
+            runScore(d, 0, 0);
+            devScore[paths[p]] = deviation(d.score, &refScore[0], BENCH_N_IMAGE);
+
+            runScoreBF16(d, 0, 0);
+            devScoreBF16[paths[p]] = deviation(d.score, &refScore[0], BENCH_N_IMAGE);
+
+            runScoreOne(d, 0, 0);
+            devScoreOne[paths[p]] = deviation(d.score, &refOne, 1);
+
+            runTranslate(d, 0, 0);
+            devTrans[paths[p]] = deviation(d.outC, &refTrans[0], m);
+
+            runProject3D(d, 0, 0);
+            devProj3D[paths[p]] = deviation(d.outC, &refProj3D[0], m);
+
+            runProject2D(d, 0, 0);
+            devProj2D[paths[p]] = deviation(d.outC, &refProj2D[0], m);
+        }
+
+        // the trilinear weights of insertion add up to 1, thus the real parts,
+        // kept by the conjugation of the half volume, sum up to those inserted
+
+        runInsert(d, 0, 0);
+
+        double sumIn = 0, sumOut = 0;
+
+        for (int i = 0; i < m; i++)
+            sumIn += REAL(d.pri[i]);
+
+        FOR_EACH_PIXEL_FT(d.reco)
+            sumOut += REAL(d.reco[i]);
+
+        double devInsert = fabs(sumOut - sumIn) / fabs(sumIn);
+
+        vector<RFLOAT> refCTF(m), refMKB(m);
+
+        runCTF(d, 0, 0);
+        memcpy(&refCTF[0], d.outR, m * sizeof(RFLOAT));
+
+        runCTFTerm(d, 0, 0);
+        double devCTF = deviation(d.outR, &refCTF[0], m);
+
+        runMKB(d, 0, 0);
+        memcpy(&refMKB[0], d.outR, m * sizeof(RFLOAT));
+
+        runTab(d, 0, 0);
+        double devTab = deviation(d.outR, &refMKB[0], m);
+
+        vector<RFLOAT> refImg(&d.img[0](0), &d.img[0](0) + d.img[0].sizeRL());
+
+        runFFT(d, 0, 0);
+        double devFFT = deviation(&d.img[0](0), &refImg[0], d.img[0].sizeRL());
+
+        // the sweep over the threads and the variants
+
+        double nFFT = (double)size * size;
+
+        for (size_t n = 0; n < threads.size(); n++)
+        {
+            int nThread = threads[n];
+
+            const Roofline& rf = roof[n];
+
+            for (size_t p = 0; p < paths.size(); p++)
+            {
+                d.kt = &kernel(paths[p]);
+
+                const char* v = d.kt->name;
+
+                int q = paths[p];
+
+                report("logDataVSPrior", v, size, nThread,
+                       timeKernel(runScore, d, nThread, benchTime),
+                       (double)m * BENCH_N_IMAGE, BENCH_FLOP_SCORE, BENCH_BYTE_SCORE,
+                       rf, devScore[q], BENCH_TOL);
+            }
+
+            for (size_t p = 0; p < paths.size(); p++)
+            {
+                d.kt = &kernel(paths[p]);
+
+                char v[FILE_WORD_LENGTH];
+
+                sprintf(v, "%s_bf16", d.kt->name);
+
+                report("logDataVSPrior", v, size, nThread,
+                       timeKernel(runScoreBF16, d, nThread, benchTime),
+                       (double)m * BENCH_N_IMAGE, BENCH_FLOP_SCORE, BENCH_BYTE_SCORE_BF16,
+                       rf, devScoreBF16[paths[p]], BENCH_TOL_BF16);
+            }
+
+            for (size_t p = 0; p < paths.size(); p++)
+            {
+                d.kt = &kernel(paths[p]);
+
+                report("logDataVSPrior_m", d.kt->name, size, nThread,
+                       timeKernel(runScoreOne, d, nThread, benchTime),
+                       m, BENCH_FLOP_SCORE, BENCH_BYTE_SCORE_ONE,
+                       rf, devScoreOne[paths[p]], BENCH_TOL);
+            }
+
+            for (size_t p = 0; p < paths.size(); p++)
+            {
+                d.kt = &kernel(paths[p]);
+
+                report("translate", d.kt->name, size, nThread,
+                       timeKernel(runTranslate, d, nThread, benchTime),
+                       m, BENCH_FLOP_TRANSLATE, BENCH_BYTE_TRANSLATE,
+                       rf, devTrans[paths[p]], BENCH_TOL);
+            }
+
+            report("project3D", "volume", size, nThread,
+                   timeKernel(runInterp3D, d, nThread, benchTime),
+                   m, BENCH_FLOP_PROJECT_3D, BENCH_BYTE_PROJECT_3D,
+                   rf, -1, 0);
+
+            for (size_t p = 0; p < paths.size(); p++)
+            {
+                d.kt = &kernel(paths[p]);
+
+                report("project3D", d.kt->name, size, nThread,
+                       timeKernel(runProject3D, d, nThread, benchTime),
+                       m, BENCH_FLOP_PROJECT_3D, BENCH_BYTE_PROJECT_3D,
+                       rf, devProj3D[paths[p]], BENCH_TOL);
+            }
+
+            report("project2D", "image", size, nThread,
+                   timeKernel(runInterp2D, d, nThread, benchTime),
+                   m, BENCH_FLOP_PROJECT_2D, BENCH_BYTE_PROJECT_2D,
+                   rf, -1, 0);
+
+            for (size_t p = 0; p < paths.size(); p++)
+            {
+                d.kt = &kernel(paths[p]);
+
+                report("project2D", d.kt->name, size, nThread,
+                       timeKernel(runProject2D, d, nThread, benchTime),
+                       m, BENCH_FLOP_PROJECT_2D, BENCH_BYTE_PROJECT_2D,
+                       rf, devProj2D[paths[p]], BENCH_TOL);
+            }
+
+            report("addFT", "volume", size, nThread,
+                   timeKernel(runInsert, d, nThread, benchTime),
+                   m, BENCH_FLOP_INSERT, BENCH_BYTE_INSERT,
+                   rf, devInsert, BENCH_TOL);
+
+            report("CTF", "direct", size, nThread,
+                   timeKernel(runCTF, d, nThread, benchTime),
+                   m, BENCH_FLOP_CTF, BENCH_BYTE_CTF,
+                   rf, -1, 0);
+
+            report("CTF", "term", size, nThread,
+                   timeKernel(runCTFTerm, d, nThread, benchTime),
+                   m, BENCH_FLOP_CTF_TERM, BENCH_BYTE_CTF_TERM,
+                   rf, devCTF, BENCH_TOL_APPROX);
+
+            report("MKB_FT_R2", "direct", size, nThread,
+                   timeKernel(runMKB, d, nThread, benchTime),
+                   m, BENCH_FLOP_MKB, BENCH_BYTE_TAB,
+                   rf, -1, 0);
+
+            report("MKB_FT_R2", "table", size, nThread,
+                   timeKernel(runTab, d, nThread, benchTime),
+                   m, BENCH_FLOP_TAB, BENCH_BYTE_TAB,
+                   rf, devTab, BENCH_TOL_APPROX);
+
+            report("FFT fw + bw", "2D", size, nThread,
+                   timeKernel(runFFT, d, nThread, benchTime),
+                   nFFT, 5 * log2(nFFT), BENCH_BYTE_FFT,
+                   rf, devFFT, BENCH_TOL);
+        }
+
+        freeData(d);
+    }
+
+    TSFFTW_cleanup_threads();
+
+    printf("\n%s\n", pass ? "All Variants Agree" : "Variants Deviate beyond Tolerance");
+
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,197 @@
+/*******************************************************************************
+ * Author:
+ * Dependecy:
+ * Test:
+ * Execution: thunder_bench_sampler [nR] [nRound]
+ * Description: throughput of sampling and perturbing the rotation particles,
+ *              the per-row path used before against the batched one, in
+ *              quaternions per second per core
+ * ****************************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <omp_compat.h>
+
+#include "Logging.h"
+#include "Random.h"
+#include "Euler.h"
+#include "DirectionalStat.h"
+
+INITIALIZE_EASYLOGGINGPP
+
+/**
+ * the per-row ACG perturbation, as Particle::perturb did it before the batched
+ * samplers
+ */
+static void perturbACGRow(dmat4& dst,
+                          const dmat44& src,
+                          const dvec4& mean)
+{
+    LLT<dmat44> llt(src);
+    dmat44 L = llt.matrixL();
+
+    gsl_rng* engine = get_random_engine();
+
+    dvec4 g, quat;
+
+    for (int i = 0; i < dst.rows(); i++)
+    {
+        for (int j = 0; j < 4; j++)
+            g(j) = gsl_ran_gaussian(engine, 1);
+
+        g = L * g;
+        g /= g.norm();
+
+        quat = dst.row(i).transpose();
+
+        quaternion_mul(quat, quaternion_conj(mean), quat);
+        quaternion_mul(quat, g, quat);
+        quaternion_mul(quat, mean, quat);
+
+        dst.row(i) = quat.transpose();
+    }
+}
+
+static void perturbVMSRow(dmat4& dst,
+                          const double k)
+{
+    dmat4 d(dst.rows(), 4);
+
+    sampleVMS(d, dvec4(1, 0, 0, 0), k, dst.rows());
+
+    dvec4 quat;
+
+    for (int i = 0; i < dst.rows(); i++)
+    {
+        quat = dst.row(i).transpose();
+
+        quaternion_mul(quat, quat, d.row(i).transpose());
+
+        dst.row(i) = quat.transpose();
+    }
+}
+
+/**
+ * mean of |<q, mean>|, which only depends on the distribution of the
+ * perturbation, thus comparable between the two paths
+ */
+static double concentration(const dmat4& src,
+                            const dvec4& mean)
+{
+    return (src * mean).cwiseAbs().mean();
+}
+
+static void report(const char* name,
+                   const int nR,
+                   const int nRound,
+                   const double t,
+                   const double c)
+{
+    printf("%-16s %12.4g quat/s/core    <|q.mean|> = %.4f\n",
+           name,
+           (double)nR * nRound / t,
+           c);
+}
+
+int main(int argc, char* argv[])
+{
+    loggerInit(argc, argv);
+
+    int nR = (argc > 1) ? atoi(argv[1]) : 5000;
+    int nRound = (argc > 2) ? atoi(argv[2]) : 200;
+
+    omp_set_num_threads(1);
+
+    dmat44 A = dmat44::Zero();
+
+    A(0, 0) = 1;
+    A(1, 1) = 50;
+    A(2, 2) = 80;
+    A(3, 3) = 120;
+
+    dvec4 mean(1, 1, -1, 2);
+    mean /= mean.norm();
+
+    dmat4 r(nR, 4);
+
+    double start, c;
+
+    // ACG, per row
+
+    r.col(0).setOnes();
+    r.rightCols(3).setZero();
+
+    start = omp_get_wtime();
+
+    for (int i = 0; i < nRound; i++)
+        perturbACGRow(r, A, mean);
+
+    double t = omp_get_wtime() - start;
+
+    r.col(0).setOnes();
+    r.rightCols(3).setZero();
+    perturbACGRow(r, A, mean);
+    c = concentration(r, mean);
+
+    report("ACG per row", nR, nRound, t, c);
+
+    // ACG, batched
+
+    r.col(0).setOnes();
+    r.rightCols(3).setZero();
+
+    start = omp_get_wtime();
+
+    for (int i = 0; i < nRound; i++)
+        perturbACG(r, A, mean);
+
+    t = omp_get_wtime() - start;
+
+    r.col(0).setOnes();
+    r.rightCols(3).setZero();
+    perturbACG(r, A, mean);
+    c = concentration(r, mean);
+
+    report("ACG batched", nR, nRound, t, c);
+
+    // VMS
+
+    dvec4 unit(1, 0, 0, 0);
+
+    r.col(0).setOnes();
+    r.rightCols(3).setZero();
+
+    start = omp_get_wtime();
+
+    for (int i = 0; i < nRound; i++)
+        perturbVMSRow(r, 20);
+
+    t = omp_get_wtime() - start;
+
+    r.col(0).setOnes();
+    r.rightCols(3).setZero();
+    perturbVMSRow(r, 20);
+    c = concentration(r, unit);
+
+    report("VMS per row", nR, nRound, t, c);
+
+    r.col(0).setOnes();
+    r.rightCols(3).setZero();
+
+    start = omp_get_wtime();
+
+    for (int i = 0; i < nRound; i++)
+        perturbVMS(r, 20);
+
+    t = omp_get_wtime() - start;
+
+    r.col(0).setOnes();
+    r.rightCols(3).setZero();
+    perturbVMS(r, 20);
+    c = concentration(r, unit);
+
+    report("VMS batched", nR, nRound, t, c);
+
+    return 0;
+}
@@ -0,0 +1,80 @@
+/*******************************************************************************
+ * Author:
+ * Dependency:
+ * Test:
+ * Execution:
+ * Description: bfloat16, the upper 16 bits of an IEEE single precision number,
+ *              for compact storage of the data streamed by the scoring kernels
+ *
+ * Manual:
+ * ****************************************************************************/
+
+#ifndef BFLOAT16_H
+#define BFLOAT16_H
+
+#include <stdint.h>
+#include <cstring>
+
+#include "Complex.h"
+
+typedef uint16_t bf16;
+
+struct ComplexBF16
+{
+    bf16 dat[2];
+};
+
+/**
+ * relative error of rounding a number to bfloat16
+ */
+#define BF16_EPSILON (1.0 / 256)
+
+/**
+ * This function rounds a number to the nearest bfloat16, ties to even.
+ *
+ * @param x the number
+ */
+inline bf16 BF16(const RFLOAT x)
+{
+    float f = (float)x;
+
+    uint32_t u;
+
+    memcpy(&u, &f, sizeof(u));
+
+    // keep NaN as NaN
+
+    if ((u & 0x7FFFFFFF) > 0x7F800000) return (bf16)((u >> 16) | 0x40);
+
+    u += 0x7FFF + ((u >> 16) & 1);
+
+    return (bf16)(u >> 16);
+}
+
+/**
+ * This function widens a bfloat16 to a number.
+ *
+ * @param x the bfloat16
+ */
+inline RFLOAT RFLOAT_BF16(const bf16 x)
+{
+    uint32_t u = (uint32_t)x << 16;
+
+    float f;
+
+    memcpy(&f, &u, sizeof(f));
+
+    return (RFLOAT)f;
+}
+
+inline ComplexBF16 COMPLEX_BF16(const Complex& x)
+{
+    ComplexBF16 z;
+
+    z.dat[0] = BF16(x.dat[0]);
+    z.dat[1] = BF16(x.dat[1]);
+
+    return z;
+}
+
+#endif // BFLOAT16_H
@@ -70,4 +70,78 @@ void CTF(RFLOAT* dst,
          const int* iRow,
          const int _nPxl);
 
+/**
+ * upper boundary of the absolute error of CTFFastCos
+ */
+#define CTF_FAST_COS_MAX_ERROR 1e-7
+
+/**
+ * This function evaluates cos(x) without calling the math library, so that the
+ * loops using it can be vectorised. x is reduced to r in [-pi / 4, pi / 4] in
+ * double precision, and cos(r) / sin(r) are evaluated by polynomials of degree
+ * 8 / 9. The absolute error, including rounding to RFLOAT, is bounded by
+ * CTF_FAST_COS_MAX_ERROR for |x| < 1e6.
+ *
+ * @param x the angle (rad)
+ */
+inline RFLOAT CTFFastCos(const RFLOAT x)
+{
+    double q = floor(x * M_2_PI + 0.5);
+    double r = x - q * M_PI_2;
+
+    double r2 = r * r;
+
+    double c = 1 + r2 * (-1.0 / 2 + r2 * (1.0 / 24 + r2 * (-1.0 / 720 + r2 * (1.0 / 40320))));
+    double s = r * (1 + r2 * (-1.0 / 6 + r2 * (1.0 / 120 + r2 * (-1.0 / 5040 + r2 * (1.0 / 362880)))));
+
+    // cos(x) = cos(r), -sin(r), -cos(r), sin(r) in quadrant 0, 1, 2, 3
+
+    int iq = (int)q & 3;
+
+    double v = (iq & 1) ? s : c;
+
+    return (RFLOAT)(((iq + 1) & 2) ? -v : v);
+}
+
+/**
+ * This function factors the CTF of a micrograph into a defocus dependent term
+ * and a defocus independent term, such that the CTF with defocus scaled by df
+ * is cos(df * dfTerm + cTerm). The terms only depend on the CTF parameters, thus
+ * can be shared by all the particles of a micrograph.
+ *
+ * @param dfTerm  K1 * defocus * f^2 of each pixel
+ * @param cTerm   K2 * f^4 - phaseShift + atan2(w1, w2) of each pixel
+ */
+void CTFTerm(RFLOAT* dfTerm,
+             RFLOAT* cTerm,
+             const RFLOAT pixelSize,
+             const RFLOAT voltage,
+             const RFLOAT defocusU,
+             const RFLOAT defocusV,
+             const RFLOAT theta,
+             const RFLOAT Cs,
+             const RFLOAT amplitudeContrast,
+             const RFLOAT phaseShift,
+             const int nCol,
+             const int nRow,
+             const int* iCol,
+             const int* iRow,
+             const int nPxl);
+
+/**
+ * This function evaluates the CTF of nPxl pixels from the terms given by
+ * CTFTerm with defocus scaled by df.
+ *
+ * @param dst    the CTF of each pixel
+ * @param dfTerm the defocus dependent term
+ * @param cTerm  the defocus independent term
+ * @param df     the scale of defocus
+ * @param nPxl   the number of pixels
+ */
+void CTFFromTerm(RFLOAT* dst,
+                 const RFLOAT* dfTerm,
+                 const RFLOAT* cTerm,
+                 const RFLOAT df,
+                 const int nPxl);
+
 #endif // CTF_H
@@ -50,6 +50,10 @@
 
 #define NOISE_ZERO_MEAN
 
+#define PARALLEL_NODE_SHARED
+
+#define PARALLEL_BIND_THREADS
+
 #define DATABASE_SHUFFLE
 
 #define PARTICLE_TRANS_INIT_GAUSSIAN
@@ -144,6 +148,20 @@
 
 #define OPTIMISER_CTF_ON_THE_FLY
 
+//#define OPTIMISER_COMPACT_PRE_CAL
+
+//#define OPTIMISER_GLOBAL_PRUNE
+
+#define OPTIMISER_GLOBAL_TRANS_FFT
+
+#define OPTIMISER_SELECTIVE_SEARCH
+
+#define OPTIMISER_BALANCE_LOAD
+
+#define OPTIMISER_CHECKPOINT
+
+#define OPTIMISER_IMG_CACHE
+
 #define OPTIMISER_LOG_MEM_USAGE
 
 #define OPTIMISER_PARTICLE_FILTER
@@ -230,6 +248,10 @@
 
 //#define OPTIMISER_SAVE_LOW_PASS_REFERENCE
 
+#define OPTIMISER_MASTER_SAVE_MAP
+
+#define OPTIMISER_SAVE_DATABASE_MPI_IO
+
 //#define OPTIMISER_SAVE_IMAGES
 
 //#define OPTIMISER_SAVE_PARTICLES
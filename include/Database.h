@@ -122,6 +122,25 @@ struct CTFAttr
     RFLOAT phaseShift;
 };
 
+/**
+ * lexicographical order of CTF parameters, for grouping the particles sharing
+ * the same CTF
+ */
+struct CTFAttrLess
+{
+    bool operator()(const CTFAttr& a, const CTFAttr& b) const
+    {
+        if (a.voltage != b.voltage) return a.voltage < b.voltage;
+        if (a.defocusU != b.defocusU) return a.defocusU < b.defocusU;
+        if (a.defocusV != b.defocusV) return a.defocusV < b.defocusV;
+        if (a.defocusTheta != b.defocusTheta) return a.defocusTheta < b.defocusTheta;
+        if (a.Cs != b.Cs) return a.Cs < b.Cs;
+        if (a.amplitudeContrast != b.amplitudeContrast) return a.amplitudeContrast < b.amplitudeContrast;
+
+        return a.phaseShift < b.phaseShift;
+    }
+};
+
 class Database : public Parallel
 {
     private:
@@ -197,6 +216,16 @@ class Database : public Parallel
 
         void shuffle();
 
+        /**
+         * the order of particles after shuffling
+         */
+        const vector<int>& reg() const { return _reg; };
+
+        /**
+         * restore the order of particles of a previous run, from the master
+         */
+        void setReg(const vector<int>& reg);
+
         long offset(const int i) const;
 
         RFLOAT coordX(const int i) const;
@@ -208,6 +237,16 @@ class Database : public Parallel
         string path(const int i) const;
 
         string micrographPath(const int i) const;
+
+        /**
+         * path, micrograph path and coordinate of a particle, parsed from one
+         * read of its line
+         */
+        void source(string& path,
+                    string& micrographPath,
+                    RFLOAT& coordX,
+                    RFLOAT& coordY,
+                    const int i) const;
         
         void ctf(RFLOAT& voltage,
                  RFLOAT& defocusU,
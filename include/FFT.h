@@ -320,6 +320,40 @@ class FFT
          */
         void bwMT(Volume& vol);
 
+        /**
+         * This function performs Fourier transform on an image zero padded by
+         * pf in real space, without forming the padded image. Only the
+         * frequencies no higher than r on each axis of the padded image are
+         * calculated, the others are set to 0. The destination is reused if it
+         * is already of the padded size.
+         *
+         * @param dst the padded image in Fourier space
+         * @param src the image in real space
+         * @param pf  the padding factor
+         * @param r   the highest frequency to be calculated
+         */
+        void fwPadMT(Image& dst,
+                     const Image& src,
+                     const int pf,
+                     const int r);
+
+        /**
+         * This function performs Fourier transform on a volume zero padded by
+         * pf in real space, without forming the padded volume. Only the
+         * frequencies no higher than r on each axis of the padded volume are
+         * calculated, the others are set to 0. The destination is reused if it
+         * is already of the padded size.
+         *
+         * @param dst the padded volume in Fourier space
+         * @param src the volume in real space
+         * @param pf  the padding factor
+         * @param r   the highest frequency to be calculated
+         */
+        void fwPadMT(Volume& dst,
+                     const Volume& src,
+                     const int pf,
+                     const int r);
+
         void fwCreatePlan(const int nCol,
                           const int nRow);
 
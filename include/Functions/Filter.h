@@ -17,6 +17,7 @@
 
 #include "Image.h"
 #include "Volume.h"
+#include "SlabVolume.h"
 
 /**
  * This function performs a B-factor filtering on an image.
@@ -104,4 +105,64 @@ void fscWeightingFilter(Volume& dst,
                         const Volume& src,
                         const vec& fsc);
 
+enum FilterType
+{
+    FILTER_LOW_PASS,
+    FILTER_HIGH_PASS,
+    FILTER_B_FACTOR,
+    FILTER_FSC_WEIGHTING
+};
+
+/**
+ * a pointwise filter in Fourier space, only the fields of its type are used
+ */
+struct FilterStage
+{
+    FilterType type;
+
+    /**
+     * threshold of spatial frequency, low / high pass
+     */
+    RFLOAT thres;
+
+    /**
+     * edge width, low / high pass
+     */
+    RFLOAT ew;
+
+    /**
+     * B-factor in spatial frequency, B-factor
+     */
+    RFLOAT bFactor;
+
+    /**
+     * FSC, FSC weighting
+     */
+    vec fsc;
+};
+
+/**
+ * This function performs a series of filterings on a volume in one sweep. The
+ * weights of the stages at each voxel are multiplied, thus the result is the
+ * same as applying the filters one by one, while the volume is only read and
+ * written once.
+ *
+ * @param dst   destination volume in Fourier space
+ * @param src   source volume in Fourier space
+ * @param stage the filters, in order
+ */
+void fusedFilter(Volume& dst,
+                 const Volume& src,
+                 const vector<FilterStage>& stage);
+
+/**
+ * This function performs a series of filterings on a volume in files, slice by
+ * slice in Fourier space.
+ *
+ * @param vol   the volume, transformed to Fourier space
+ * @param stage the filters, in order
+ */
+void fusedFilter(SlabVolume& vol,
+                 const vector<FilterStage>& stage);
+
 #endif // FILTER_H
@@ -21,6 +21,7 @@
 #include "Precision.h"
 #include "Random.h"
 #include "Volume.h"
+#include "SlabVolume.h"
 #include "Macro.h"
 
 /**
@@ -257,6 +258,32 @@ void softMask(Volume& dst,
               const Volume& alpha,
               const RFLOAT bg);
 
+/**
+ * This function performs a soft mask of a sphere on a volume in files, slice by
+ * slice in real space.
+ *
+ * @param vol the volume, mapped for writing
+ * @param r   radius of the sphere
+ * @param ew  edge width
+ * @param bg  background
+ */
+void softMask(SlabVolume& vol,
+              const RFLOAT r,
+              const RFLOAT ew,
+              const RFLOAT bg);
+
+/**
+ * This function performs a soft mask of a mask volume on a volume in files,
+ * slice by slice in real space.
+ *
+ * @param vol   the volume, mapped for writing
+ * @param alpha the mask, of the same size
+ * @param bg    background
+ */
+void softMask(SlabVolume& vol,
+              const SlabVolume& alpha,
+              const RFLOAT bg);
+
 void regionBgSoftMask(Image& dst,
                       const Image& src,
                       const RFLOAT r,
@@ -20,6 +20,7 @@
 
 #include "Image.h"
 #include "Volume.h"
+#include "SlabVolume.h"
 #include "Filter.h"
 
 /**
@@ -146,6 +147,18 @@ void powerSpectrum(vec& dst,
                    const Volume& src,
                    const int r);
 
+/**
+ * This function calculates the power spectrum of a volume in files within a
+ * given spatial frequency, slice by slice.
+ *
+ * @param dst power spectrum
+ * @param src volume, transformed to Fourier space
+ * @param r   upper boundary of spatial frequency in pixel
+ */
+void powerSpectrum(vec& dst,
+                   const SlabVolume& src,
+                   const int r);
+
 /**
  * This functions calculates the FRC (Fourier Ring Coefficient) between two
  * images.
@@ -177,6 +190,19 @@ void FSC(vec& dst,
          const Volume& A,
          const Volume& B);
 
+/**
+ * This function calculates the FSC between two volumes in files, slice by slice.
+ * The shells are accumulated by each thread and summed at the end.
+ *
+ * @param dst vector for storing the FSC size of which is the upper boundary of
+ *            spatial frequency in pixel
+ * @param A   volume, transformed to Fourier space
+ * @param B   volume, transformed to Fourier space
+ */
+void FSC(vec& dst,
+         const SlabVolume& A,
+         const SlabVolume& B);
+
 /**
  * This function determines the resolution based on FSC given.
  *
@@ -204,6 +230,18 @@ void randomPhase(Volume& dst,
                  const Volume& src,
                  const int r);
 
+/**
+ * This function randomizes the phase of a volume in files above a certain
+ * frequency, slice by slice.
+ *
+ * @param dst the destination volume, in Fourier space
+ * @param src the source volume, transformed to Fourier space
+ * @param r   the lower boundary of frequency for randomizing phase
+ */
+void randomPhase(SlabVolume& dst,
+                 const SlabVolume& src,
+                 const int r);
+
 /**
  * This function sharpens up a volume by three steps: estimating B-factor,
  * performing B-factor filtering and performing low-pass filtering.
@@ -251,4 +289,17 @@ void bFactorEst(RFLOAT& bFactor,
                 const int rU,
                 const int rL);
 
+/**
+ * This function estimates B-factor of a volume in files, slice by slice.
+ *
+ * @param bFactor B-factor
+ * @param vol     the volume, transformed to Fourier space
+ * @param rU      the upper boundary for B-factor estimation
+ * @param rL      the lower boundary for B-factor estimation
+ */
+void bFactorEst(RFLOAT& bFactor,
+                const SlabVolume& vol,
+                const int rU,
+                const int rL);
+
 #endif // SPECTRUM_H
@@ -25,6 +25,19 @@
 #include "Precision.h"
 #include "Random.h"
 #include "Functions.h"
+#include "Euler.h"
+
+/**
+ * the fixed-point iteration of inferring the parameter matrix of ACG stops
+ * when the sum of the absolute changes of its elements is below it
+ */
+#define ACG_INFER_THRES 1e-3
+
+/**
+ * the maximum number of iterations of inferring the parameter matrix of ACG,
+ * after which the estimate is returned unconverged with a warning
+ */
+#define ACG_INFER_MAX_ITER 1000
 
 /**
  * Probabilty Density Function of Angular Central Gaussian Distribution
@@ -103,6 +116,19 @@ void sampleACG(dmat4& dst,
                const double k3,
                const int n);
 
+/**
+ * Perturb quaternions by samples from an Angular Central Gaussian Distribution
+ * around a mean, i.e. dst.row(i) <- mean * d_i * mean^-1 * dst.row(i), in place
+ * and with one sample per row
+ *
+ * @param dst  the quaternions to be perturbed
+ * @param src  the symmetric positive definite parameter matrix
+ * @param mean the mean
+ */
+void perturbACG(dmat4& dst,
+                const dmat44& src,
+                const dvec4& mean);
+
 /**
  * Paramter Matrix Inference from Data Assuming the Distribution Follows an
  * Angular Central Gaussian Distribution
@@ -113,6 +139,20 @@ void sampleACG(dmat4& dst,
 void inferACG(dmat44& dst,
               const dmat4& src);
 
+/**
+ * Paramter Matrix Inference from Data Assuming the Distribution Follows an
+ * Angular Central Gaussian Distribution, starting from a given estimate, e.g.
+ * the one of the previous phase. The result does not depend on the start,
+ * only the number of iterations does.
+ *
+ * @param dst  the paramter matrix
+ * @param src  the data
+ * @param init the starting estimate
+ */
+void inferACG(dmat44& dst,
+              const dmat4& src,
+              const dmat44& init);
+
 /**
  * Parameter Inference from Data Assuming the Distribution Follows an Angular
  * Central Gaussian Distribution
@@ -133,6 +173,12 @@ void inferACG(double& k1,
               double& k3,
               const dmat4& src);
 
+void inferACG(double& k1,
+              double& k2,
+              double& k3,
+              const dmat4& src,
+              const dmat44& init);
+
 /**
  * Parameter Inference from Data Assuming the Distribution Follows an Angular
  * Central Gaussian Distribution
@@ -143,6 +189,10 @@ void inferACG(double& k1,
 void inferACG(dvec4& mean,
               const dmat4& src);
 
+void inferACG(dvec4& mean,
+              const dmat4& src,
+              const dmat44& init);
+
 /**
  * Probabilty Density Function of von Mises Distribution M(mu, kappa)
  *
@@ -173,6 +223,17 @@ void sampleVMS(dmat4& dst,
                const double k,
                const double n);
 
+/**
+ * Perturb quaternions of in-plane rotations by samples from a von Mises
+ * Distribution around the identity, i.e. dst.row(i) <- dst.row(i) * d_i, in
+ * place and with one sample per row
+ *
+ * @param dst the quaternions to be perturbed
+ * @param k   the concentration parameter
+ */
+void perturbVMS(dmat4& dst,
+                const double k);
+
 /**
  * Mode and Concentration Paramter Inference from Data Assuming the Distribution
  * Follows a von Mises Distribution
@@ -32,6 +32,19 @@ void quaternion_mul(dvec4& dst,
                     const dvec4& a,
                     const dvec4& b);
 
+/**
+ * Multiplication between quaternions row by row, dst.row(i) = a.row(i) *
+ * b.row(i). The quaternions are processed column by column, thus vectorised
+ * over rows. dst may be a or b.
+ *
+ * @param dst result
+ * @param a   left multipliers
+ * @param b   right multipliers
+ */
+void quaternion_mul(dmat4& dst,
+                    const dmat4& a,
+                    const dmat4& b);
+
 dvec4 quaternion_conj(const dvec4& quat);
 
 /**
@@ -265,10 +265,47 @@ void display(const Symmetry& sym);
 
 bool asymmetry(const Symmetry& sym);
 
+/**
+ * This function calculates the orbit of an anchor under the symmetry group,
+ * i.e. dst.row(i) = quat(i) * anchor. As |<quat(i)^-1 * q, anchor>| equals
+ * |<q, quat(i) * anchor>|, the orbit is the set of face normals of the Voronoi
+ * cell of the anchor, against which the symmetry counterpart of a quaternion is
+ * found by dot products only.
+ *
+ * @param dst    the orbit, one row per symmetry element
+ * @param sym    the symmetry group
+ * @param anchor the anchor, ANCHOR_POINT_2 by default
+ */
+void symmetryOrbit(dmat4& dst,
+                   const Symmetry& sym,
+                   const dvec4* anchor = NULL);
+
+/**
+ * This function replaces a quaternion by its symmetry counterpart nearest to
+ * the anchor.
+ *
+ * @param dst    the quaternion
+ * @param sym    the symmetry group
+ * @param anchor the anchor, ANCHOR_POINT_2 by default
+ */
 void symmetryCounterpart(dvec4& dst,
                          const Symmetry& sym,
                          const dvec4* anchor = NULL);
 
+/**
+ * This function replaces each row of dst by its symmetry counterpart nearest to
+ * the anchor. The orbit of the anchor is calculated once, the dot products of
+ * all the rows against it are taken as one matrix product and the counterparts
+ * are composed column by column.
+ *
+ * @param dst    the quaternions, one per row
+ * @param sym    the symmetry group
+ * @param anchor the anchor, ANCHOR_POINT_2 by default
+ */
+void symmetryCounterpart(dmat4& dst,
+                         const Symmetry& sym,
+                         const dvec4* anchor = NULL);
+
 void symmetryRotation(vector<dmat33>& sr,
                       const dmat33 rot,
                       const Symmetry* sym = NULL);
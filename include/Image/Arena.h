@@ -0,0 +1,154 @@
+/*******************************************************************************
+ * Author:
+ * Dependency:
+ * Test:
+ * Execution:
+ * Description: thread-local, size-class based arena for the pixel buffers of
+ *              Image / Volume
+ *
+ * Manual:
+ * ****************************************************************************/
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstdlib>
+#include <cstring>
+
+#include <boost/noncopyable.hpp>
+
+#include <omp_compat.h>
+
+#include "Macro.h"
+
+/**
+ * alignment of the buffers handed out by the arena (one cache line, also
+ * sufficient for AVX512 loads and FFTW new-array execution)
+ */
+#define ARENA_ALIGNMENT 64
+
+/**
+ * the smallest size class (byte)
+ */
+#define ARENA_MIN_BLOCK 256
+
+/**
+ * log2 of ARENA_MIN_BLOCK
+ */
+#define ARENA_MIN_BLOCK_LOG2 8
+
+/**
+ * number of size classes in each octave, the internal fragmentation of a size
+ * class is thus bounded by 1 / ARENA_N_CLASS_PER_OCTAVE
+ */
+#define ARENA_N_CLASS_PER_OCTAVE 4
+
+/**
+ * log2 of the largest pooled block, buffers larger than it (e.g. volumes) are
+ * allocated from and returned to the system directly
+ */
+#define ARENA_MAX_BLOCK_LOG2 24
+
+#define ARENA_N_SIZE_CLASS (1 + (ARENA_MAX_BLOCK_LOG2 - ARENA_MIN_BLOCK_LOG2) * ARENA_N_CLASS_PER_OCTAVE)
+
+/**
+ * the maximum bytes a thread keeps in its free lists, blocks freed beyond it
+ * are returned to the system
+ */
+#define ARENA_MAX_CACHED_BYTES_PER_THREAD (64 * MEGABYTE)
+
+struct ArenaStat
+{
+    /**
+     * number of allocations served from a free list
+     */
+    size_t hit;
+
+    /**
+     * number of allocations served by the system
+     */
+    size_t miss;
+
+    /**
+     * bytes currently handed out to Image / Volume
+     */
+    size_t bytesInUse;
+
+    /**
+     * sum of the peaks of the threads since the last arenaResetStat(); as the
+     * threads peak at different moments, it is only an upper bound of the peak
+     * of bytesInUse
+     */
+    size_t peakBytesBound;
+
+    /**
+     * bytes kept in the free lists of all threads
+     */
+    size_t bytesCached;
+
+    ArenaStat() : hit(0), miss(0), bytesInUse(0), peakBytesBound(0), bytesCached(0) {}
+};
+
+/**
+ * This function allocates a buffer of at least size bytes, aligned to
+ * ARENA_ALIGNMENT. The buffer is taken from the free list of the calling thread
+ * when possible, thus no lock is involved in the fast path.
+ *
+ * @param size the number of bytes
+ */
+void* arenaMalloc(const size_t size);
+
+/**
+ * This function gives back a buffer allocated by arenaMalloc. It is kept in the
+ * free list of the calling thread, which is not necessarily the thread
+ * allocating it.
+ *
+ * @param ptr the buffer
+ */
+void arenaFree(void* ptr);
+
+/**
+ * This function returns all the cached blocks of all threads to the system.
+ * It takes the lock of each thread cache in turn, thus other threads, e.g. a
+ * background writer, may keep allocating and freeing meanwhile. Buffers still
+ * in use are not affected.
+ */
+void arenaReset();
+
+/**
+ * This function returns the cached blocks of the calling thread to the system
+ * and removes its cache, e.g. before a background thread exits, as the cache
+ * of a thread is otherwise kept until the process exits.
+ */
+void arenaRelease();
+
+/**
+ * This function gathers the statistics of all threads. The counters are kept
+ * per thread and summed here, the statistics are only approximate when other
+ * threads are allocating meanwhile.
+ *
+ * @param dst the statistics
+ */
+void arenaStat(ArenaStat& dst);
+
+/**
+ * This function resets the hit / miss counters and sets the peak to the bytes
+ * currently in use.
+ */
+void arenaResetStat();
+
+/**
+ * A reset point of the arena. Cached blocks are returned to the system when it
+ * goes out of scope, e.g. at the end of an iteration, so that scratch buffers
+ * sized for the previous iteration do not pile up.
+ */
+class ArenaScope : private boost::noncopyable
+{
+    public:
+
+        ArenaScope();
+
+        ~ArenaScope();
+};
+
+#endif // ARENA_H
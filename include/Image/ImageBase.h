@@ -15,7 +15,7 @@
 #define FFTW_PTR
 
 #ifdef FFTW_PTR
-#define FFTW_PTR_THREAD_SAFETY
+#define FFTW_PTR_ARENA
 #endif
 
 #include <functional>
@@ -44,6 +44,36 @@
 #include "Functions.h"
 #include "Utils.h"
 #include "Logging.h"
+#include "Arena.h"
+
+/**
+ * the allocator of the pixel buffers, the arena is thread-safe and lock-free in
+ * its fast path, while FFTW only guarantees the thread safety of its execute
+ * routines, thus its allocation is serialised
+ */
+#ifdef FFTW_PTR_ARENA
+#define IMAGE_BASE_MALLOC(size) arenaMalloc(size)
+#define IMAGE_BASE_FREE(ptr) arenaFree(ptr)
+#else
+inline void* imageBaseMalloc(const size_t size)
+{
+    void* ptr;
+
+    #pragma omp critical (imageBaseAlloc)
+    ptr = TSFFTW_malloc(size);
+
+    return ptr;
+}
+
+inline void imageBaseFree(void* ptr)
+{
+    #pragma omp critical (imageBaseAlloc)
+    TSFFTW_free(ptr);
+}
+
+#define IMAGE_BASE_MALLOC(size) imageBaseMalloc(size)
+#define IMAGE_BASE_FREE(ptr) imageBaseFree(ptr)
+#endif
 
 #define RL_SPACE 0
 
@@ -235,16 +265,25 @@ class ImageBase
 
         size_t _sizeFT;
 
+        /**
+         * whether _dataFT is attached from a buffer owned by others, e.g. a
+         * shared memory window, thus not freed
+         */
+        bool _attachedFT;
+
         ImageBase();
 
         ImageBase(BOOST_RV_REF(ImageBase) that) : _dataRL(boost::move(that._dataRL)),
                                                   _dataFT(boost::move(that._dataFT)),
                                                   _sizeRL(that._sizeRL),
-                                                  _sizeFT(that._sizeFT)
+                                                  _sizeFT(that._sizeFT),
+                                                  _attachedFT(that._attachedFT)
         {
             that._sizeRL = 0;
             that._sizeFT = 0;
 
+            that._attachedFT = false;
+
 #ifdef FFTW_PTR
             that._dataRL = NULL;
             that._dataFT = NULL;
@@ -351,10 +390,17 @@ class ImageBase
         void clearRL();
 
         /**
-         * free the allocated space in Fourier space
+         * free the allocated space in Fourier space, or detach it when it is
+         * attached
          */
         void clearFT();
 
+        /**
+         * check whether the space in Fourier space is attached from a buffer
+         * owned by others
+         */
+        bool isAttachedFT() const;
+
         void copyBase(ImageBase&) const;
 
         ImageBase copyBase() const;
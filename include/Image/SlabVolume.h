@@ -0,0 +1,225 @@
+/*******************************************************************************
+ * Author:
+ * Dependency:
+ * Test:
+ * Execution:
+ * Description: a volume kept in files and processed slab by slab, for boxes
+ *              which do not fit in memory
+ *
+ * Manual: The real space is a memory-mapped MRC file (mode 2), in the layout of
+ *         the file, i.e. the centre of the box at (n / 2, n / 2, n / 2). The
+ *         Fourier space is a memory-mapped scratch file in the layout of
+ *         Volume, thus getFTHalf(i, j, k) of Volume and ftHalf(i, j, k) of
+ *         SlabVolume return the same value. The pages of both are cached by
+ *         the kernel and written back or dropped under memory pressure, so that
+ *         the resident memory is bounded by the working buffers.
+ * ****************************************************************************/
+
+#ifndef SLAB_VOLUME_H
+#define SLAB_VOLUME_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <boost/noncopyable.hpp>
+
+#include <gsl/gsl_math.h>
+
+#include <omp_compat.h>
+
+#include "Macro.h"
+#include "Complex.h"
+#include "Logging.h"
+#include "Precision.h"
+
+#include "MRCHeader.h"
+
+/**
+ * the maximum bytes of the buffer of the transform along Z, which gathers a
+ * block of rows of all the slices
+ */
+#define SLAB_BUFFER_SIZE (512 * MEGABYTE)
+
+class SlabVolume : private boost::noncopyable
+{
+    private:
+
+        int _nCol;
+
+        int _nRow;
+
+        int _nSlc;
+
+        int _nColFT;
+
+        /**
+         * the MRC file in real space
+         */
+        int _fdRL;
+
+        char* _mapRL;
+
+        size_t _mapSizeRL;
+
+        /**
+         * the data of the MRC file, past the header and the symmetry data
+         */
+        float* _dataRL;
+
+        /**
+         * the scratch file in Fourier space, unlinked once mapped
+         */
+        int _fdFT;
+
+        Complex* _dataFT;
+
+        size_t _mapSizeFT;
+
+        /**
+         * bytes of the buffer of the transform along Z
+         */
+        size_t _bufferSize;
+
+    public:
+
+        SlabVolume();
+
+        ~SlabVolume();
+
+        /**
+         * This function maps an existing MRC file of mode 2. A file of mode 0
+         * or 1 is only read, it is converted into a scratch file of mode 2
+         * first, which is removed when it is closed.
+         *
+         * @param file    the MRC file
+         * @param write   whether the data will be modified in place
+         * @param scratch the directory of the scratch file of conversion
+         */
+        void openMRC(const char file[],
+                     const bool write = false,
+                     const char scratch[] = ".");
+
+        /**
+         * This function creates and maps an MRC file of mode 2, filled by 0.
+         *
+         * @param file      the MRC file
+         * @param nCol      number of columns
+         * @param nRow      number of rows
+         * @param nSlc      number of slices
+         * @param pixelSize pixel size (Angstrom)
+         */
+        void createMRC(const char file[],
+                       const int nCol,
+                       const int nRow,
+                       const int nSlc,
+                       const RFLOAT pixelSize);
+
+        /**
+         * This function creates the scratch file of Fourier space in a
+         * directory. The scratch file is removed when it is closed.
+         *
+         * @param dir the directory
+         */
+        void openFT(const char dir[] = ".");
+
+        void closeMRC();
+
+        void closeFT();
+
+        /**
+         * This function sets the bytes of the buffer of the transform along Z,
+         * SLAB_BUFFER_SIZE by default. At least a row of all the slices is
+         * buffered.
+         */
+        void setBufferSize(const size_t bufferSize) { _bufferSize = bufferSize; };
+
+        int nColRL() const { return _nCol; };
+
+        int nRowRL() const { return _nRow; };
+
+        int nSlcRL() const { return _nSlc; };
+
+        int nColFT() const { return _nColFT; };
+
+        /**
+         * number of voxels of a slice in real space
+         */
+        size_t slcSizeRL() const { return (size_t)_nCol * _nRow; };
+
+        /**
+         * number of voxels of a slice in Fourier space
+         */
+        size_t slcSizeFT() const { return (size_t)_nColFT * _nRow; };
+
+        /**
+         * This function returns the k-th slice of the MRC file, k in [0, nSlc).
+         */
+        float* slcRL(const int k) const
+        {
+            return _dataRL + k * slcSizeRL();
+        };
+
+        /**
+         * This function returns the k-th stored slice in Fourier space, k in
+         * [0, nSlc), i.e. frequency k for k < nSlc / 2, and k - nSlc otherwise.
+         */
+        Complex* slcFT(const int k) const
+        {
+            return _dataFT + k * slcSizeFT();
+        };
+
+        /**
+         * This function returns the Fourier component of frequency (i, j, k),
+         * i in [0, nCol / 2], j and k in [-n / 2, n / 2).
+         */
+        Complex& ftHalf(const int i,
+                        const int j,
+                        const int k) const
+        {
+            return slcFT(k >= 0 ? k : k + _nSlc)[(j >= 0 ? j : j + _nRow) * _nColFT + i];
+        };
+
+        /**
+         * This function performs the Fourier transform from the MRC file to the
+         * scratch file. Each slice is transformed in 2D, then the blocks of
+         * rows are gathered from all the slices and transformed along Z. The
+         * MRC file is not modified.
+         */
+        void fw();
+
+        /**
+         * This function performs the inverse Fourier transform from the scratch
+         * file to the MRC file, in the reverse order of fw(). The content of the
+         * scratch file is destroyed.
+         */
+        void bw();
+
+    private:
+
+        /**
+         * This function performs the transform along Z of every line of the
+         * scratch file, in place.
+         *
+         * @param sign FFTW_FORWARD or FFTW_BACKWARD
+         */
+        void transformZ(const int sign);
+};
+
+/**
+ * This function returns the frequency of the stored index s along a dimension
+ * of n.
+ */
+inline int SLAB_FREQ(const int s,
+                     const int n)
+{
+    return s < n / 2 ? s : s - n;
+}
+
+#endif // SLAB_VOLUME_H
@@ -235,6 +235,21 @@ class Volume : public ImageBase
                    const int nSlc,
                    const int space);
 
+        /**
+         * This function takes a buffer owned by others as the space in Fourier
+         * space, which is not freed by this volume. The buffer shall hold
+         * (nCol / 2 + 1) x nRow x nSlc elements and outlive this volume.
+         *
+         * @param data the buffer
+         * @param nCol number of columns of this volume
+         * @param nRow number of rows of this volume
+         * @param nSlc number of slices of this volume
+         */
+        void attachFT(Complex* data,
+                      const int nCol,
+                      const int nRow,
+                      const int nSlc);
+
         /**
          * This function returns the number of columns of this volume in real
          * space.
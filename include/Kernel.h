@@ -0,0 +1,217 @@
+/*******************************************************************************
+ * Author:
+ * Dependency:
+ * Test:
+ * Execution:
+ * Description: registry of the scoring, projection and translation kernels,
+ *              each of which has a scalar, an AVX2 + FMA and an AVX512 variant,
+ *              the best one supported by the CPU is selected at run time
+ *
+ * Manual: The path can be forced by setting the environment variable
+ *         THUNDER_KERNEL to scalar, avx2 or avx512. An unsupported path falls
+ *         back to the best supported one.
+ * ****************************************************************************/
+
+#ifndef KERNEL_H
+#define KERNEL_H
+
+#include "Config.h"
+#include "Macro.h"
+#include "Complex.h"
+#include "Logging.h"
+#include "Precision.h"
+#include "BFloat16.h"
+
+#define KERNEL_SCALAR 0
+
+#define KERNEL_AVX2 1
+
+#define KERNEL_AVX512 2
+
+#define KERNEL_N_PATH 3
+
+/**
+ * the environment variable overriding the path detected from CPUID
+ */
+#define KERNEL_ENV "THUNDER_KERNEL"
+
+struct KernelTable
+{
+    /**
+     * name of the path, scalar, avx2 or avx512
+     */
+    const char* name;
+
+    /**
+     * result[j] += sum_i |dat[i * n + j] - ctf[i * n + j] * pri[i]|^2
+     *                    * sigRcp[i * n + j]
+     *
+     * dat, ctf and sigRcp are stored pixel-major, n images and m pixels.
+     */
+    RFLOAT* (*logDataVSPrior_m_n)(const Complex* dat,
+                                  const Complex* pri,
+                                  const RFLOAT* ctf,
+                                  const RFLOAT* sigRcp,
+                                  const int n,
+                                  const int m,
+                                  RFLOAT* result);
+
+    /**
+     * the same as logDataVSPrior_m_n, except that dat, ctf and sigRcp are
+     * stored in bfloat16
+     */
+    RFLOAT* (*logDataVSPrior_m_n_BF16)(const ComplexBF16* dat,
+                                       const Complex* pri,
+                                       const bf16* ctf,
+                                       const bf16* sigRcp,
+                                       const int n,
+                                       const int m,
+                                       RFLOAT* result);
+
+    /**
+     * the same as logDataVSPrior_m_n, except that the n images are grouped into
+     * nSeg segments sharing the same row of CTF and sigma, see
+     * logDataVSPrior_m_n_seg in Optimiser.h
+     */
+    RFLOAT* (*logDataVSPrior_m_n_seg)(const Complex* dat,
+                                      const Complex* pri,
+                                      const RFLOAT* ctf,
+                                      const RFLOAT* sigRcp,
+                                      const int n,
+                                      const int m,
+                                      const int nCTF,
+                                      const int nSig,
+                                      const int nSeg,
+                                      const int* seg,
+                                      const int* segCTF,
+                                      const int* segSig,
+                                      RFLOAT* result);
+
+    RFLOAT* (*logDataVSPrior_m_n_seg_BF16)(const ComplexBF16* dat,
+                                           const Complex* pri,
+                                           const RFLOAT* ctf,
+                                           const RFLOAT* sigRcp,
+                                           const int n,
+                                           const int m,
+                                           const int nCTF,
+                                           const int nSig,
+                                           const int nSeg,
+                                           const int* seg,
+                                           const int* segCTF,
+                                           const int* segSig,
+                                           RFLOAT* result);
+
+    /**
+     * the same as logDataVSPrior_m_n, except that only the nIdx columns listed
+     * in idx are calculated and stored consecutively in result. Column j takes
+     * row colCTF[j] of CTF (nCTF rows per pixel) and row colSig[j] of sigma
+     * (nSig rows per pixel).
+     */
+    RFLOAT* (*logDataVSPrior_m_n_idx)(const Complex* dat,
+                                      const Complex* pri,
+                                      const RFLOAT* ctf,
+                                      const RFLOAT* sigRcp,
+                                      const int n,
+                                      const int m,
+                                      const int nCTF,
+                                      const int nSig,
+                                      const int* colCTF,
+                                      const int* colSig,
+                                      const int nIdx,
+                                      const int* idx,
+                                      RFLOAT* result);
+
+    RFLOAT* (*logDataVSPrior_m_n_idx_BF16)(const ComplexBF16* dat,
+                                           const Complex* pri,
+                                           const RFLOAT* ctf,
+                                           const RFLOAT* sigRcp,
+                                           const int n,
+                                           const int m,
+                                           const int nCTF,
+                                           const int nSig,
+                                           const int* colCTF,
+                                           const int* colSig,
+                                           const int nIdx,
+                                           const int* idx,
+                                           RFLOAT* result);
+
+    /**
+     * sum_i |dat[i] - ctf[i] * pri[i]|^2 * sigRcp[i] of one image of m pixels
+     */
+    RFLOAT (*logDataVSPrior_m)(const Complex* dat,
+                               const Complex* pri,
+                               const RFLOAT* ctf,
+                               const RFLOAT* sigRcp,
+                               const int m);
+
+    /**
+     * phase shift of translating (nTransCol, nTransRow) on nPxl pixels
+     */
+    void (*translate)(Complex* dst,
+                      const RFLOAT nTransCol,
+                      const RFLOAT nTransRow,
+                      const int nCol,
+                      const int nRow,
+                      const int* iCol,
+                      const int* iRow,
+                      const int nPxl);
+
+    /**
+     * central slice of a Fourier half volume of nColFT x nRow x nSlc, rotated
+     * by mat (3 x 3, column-major as stored by Eigen) and padded by pf, by
+     * linear interpolation
+     */
+    void (*project3D)(Complex* dst,
+                      const Complex* src,
+                      const int nColFT,
+                      const int nRow,
+                      const int nSlc,
+                      const double* mat,
+                      const int pf,
+                      const int* iCol,
+                      const int* iRow,
+                      const int nPxl);
+
+    /**
+     * rotated Fourier half image of nColFT x nRow, by mat (2 x 2, column-major
+     * as stored by Eigen) and padded by pf, by linear interpolation
+     */
+    void (*project2D)(Complex* dst,
+                      const Complex* src,
+                      const int nColFT,
+                      const int nRow,
+                      const double* mat,
+                      const int pf,
+                      const int* iCol,
+                      const int* iRow,
+                      const int nPxl);
+};
+
+/**
+ * This function selects the path of the kernels, by CPUID unless overridden by
+ * KERNEL_ENV, and logs it. It is called by kernel() on first use, calling it
+ * again has no effect.
+ */
+void kernelInit();
+
+/**
+ * This function returns the kernels of the selected path.
+ */
+const KernelTable& kernel();
+
+/**
+ * This function returns whether a path is supported by the CPU and compiled in.
+ *
+ * @param path KERNEL_SCALAR, KERNEL_AVX2 or KERNEL_AVX512
+ */
+bool kernelSupported(const int path);
+
+/**
+ * This function returns the kernels of a certain path, regardless of the
+ * selected one. The path must be supported.
+ *
+ * @param path KERNEL_SCALAR, KERNEL_AVX2 or KERNEL_AVX512
+ */
+const KernelTable& kernel(const int path);
+
+#endif // KERNEL_H
@@ -168,6 +168,14 @@ class Model : public Parallel
          */
         boost::container::vector<Projector> _proj;
 
+        /**
+         * windows of the padded projectees shared by the processes on a node,
+         * and their addresses, one per reference
+         */
+        boost::container::vector<MPI_Win> _projWin;
+
+        boost::container::vector<Complex*> _projShared;
+
         /**
          * reconstructors
          */
@@ -660,14 +668,6 @@ class Model : public Parallel
          */
         RFLOAT resolutionA(const RFLOAT thres = 0.143) const;
 
-        /**
-         * This function sets the max radius of all projector to a certain
-         * value.
-         *
-         * @param maxRadius max radius
-         */
-        void setProjMaxRadius(const int maxRadius);
-
         /**
          * This function refreshs the projectors by resetting the projectee, the
          * frequency threshold and padding factor, respectively.
@@ -856,6 +856,25 @@ class Model : public Parallel
 
         void avgHemi();
 
+        /**
+         * This function appends the state of the model evolving over the
+         * iterations, i.e. the frequencies, FSC, SNR, tau, sigma, the search
+         * type and the statistics determining them, to dst, e.g. for
+         * checkpointing. References, projectors and reconstructors are not
+         * included.
+         *
+         * @param dst the destination buffer
+         */
+        void pack(vector<double>& dst) const;
+
+        /**
+         * This function restores the state packed by pack() and returns the
+         * position right after it.
+         *
+         * @param src the packed state
+         */
+        const double* unpack(const double* src);
+
     private:
 
         /**
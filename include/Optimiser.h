@@ -16,12 +16,20 @@
 #include <string>
 #include <climits>
 #include <queue>
+#include <map>
+#include <algorithm>
 #include <functional>
 
 #include <gsl/gsl_sort.h>
 #include <gsl/gsl_statistics.h>
 #include <gsl/gsl_cdf.h>
 
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include <omp_compat.h>
 
 #include "Config.h"
@@ -35,10 +43,13 @@
 #include "Spectrum.h"
 #include "Symmetry.h"
 #include "CTF.h"
+#include "BFloat16.h"
+#include "Kernel.h"
 #include "Mask.h"
 #include "Particle.h"
 #include "Database.h"
 #include "Model.h"
+#include "Topology.h"
 
 #ifdef GPU_VERSION
 #include "Interface.h"
@@ -64,6 +75,148 @@
 
 #define N_SAVE_IMG 20 
 
+/**
+ * in local search, an image is stable when its top class is unchanged and its
+ * top rotation and translation move less than SELECTIVE_ROT_TOL (degree) and
+ * SELECTIVE_TRANS_TOL (pixel) since the previous iteration
+ */
+#define SELECTIVE_ROT_TOL 1
+
+#define SELECTIVE_TRANS_TOL 0.5
+
+/**
+ * an image stable for this many iterations in a row is searched by only
+ * N_PHASE_REDUCED_SEARCH phases
+ */
+#define SELECTIVE_N_ITER_REDUCE 2
+
+/**
+ * an image stable for this many iterations in a row is not searched at all in
+ * the next iteration, unless the resolution changes, and is searched by the
+ * reduced schedule in the one after
+ */
+#define SELECTIVE_N_ITER_SKIP 4
+
+/**
+ * number of phases of the reduced schedule, which shall be less than
+ * MIN_N_PHASE_PER_ITER_LOCAL, thus it never stops earlier
+ */
+#define N_PHASE_REDUCED_SEARCH 2
+
+/**
+ * images are moved among the processes of a hemisphere before expectation when
+ * the busiest one took longer than this factor of the average in the previous
+ * iteration, 0 moving them in every iteration, as for testing the migration
+ */
+#ifndef BALANCE_LOAD_THRES
+#define BALANCE_LOAD_THRES 1.1
+#endif
+
+/**
+ * bytes of references held by the master process to be written, beyond which
+ * receiving another one waits for the previous ones to be written
+ */
+#define MAP_QUEUE_MEMORY (4096 * (size_t)MEGABYTE)
+
+/**
+ * number of threads the master process writes the references on, alongside
+ * expectation
+ */
+#define MAP_WRITER_N_THREAD 2
+
+/**
+ * number of checkpoint files kept by each process, the older one is kept until
+ * all the processes complete the newer one
+ */
+#define CHECKPOINT_N_SLOT 2
+
+#define CHECKPOINT_MAGIC 0x54484350
+
+/**
+ * magic, number of processes, mode, number of classes, size of images, the
+ * iteration to resume from and the generation of the image stack it refers to
+ */
+#define CHECKPOINT_N_HEAD 7
+
+/**
+ * the .thu file is written collectively in pieces of at most this number of
+ * bytes per process, as the count of MPI-IO is an int
+ */
+#define SAVE_DATABASE_CHUNK (1024 * MEGABYTE)
+
+/**
+ * the environment variable naming the directory of the cache of preprocessed
+ * images, images are not cached when it is not set
+ */
+#define IMG_CACHE_ENV "THUNDER_CACHE"
+
+#define IMG_CACHE_MAGIC 0x5448494d47434348UL
+
+/**
+ * the header of the cache takes a page, followed by one record per line of the
+ * .thu file
+ */
+#define IMG_CACHE_HEAD 4096
+
+/**
+ * mean of the centre, standard deviation of noise, standard deviation of data
+ * and the scale of normalisation of an image, leading its record
+ */
+#define IMG_CACHE_N_STAT 4
+
+#define SEARCH_BUDGET_FULL 0
+
+#define SEARCH_BUDGET_REDUCED 1
+
+#define SEARCH_BUDGET_SKIP 2
+
+/**
+ * the minimum average number of images in a segment of the pixel major
+ * pre-calculated data for sharing CTF and sigma among images in the global
+ * search, below which each image keeps its own CTF and sigma
+ */
+#define PRE_CAL_MIN_AVG_SEG_LEN 8
+
+/**
+ * the global search first scores all the poses on the pixels within this
+ * fraction of the current resolution, and then scores at the full resolution
+ * only the rotations which are still likely for at least one image
+ */
+#define GLOBAL_PRUNE_R_FACTOR 0.5
+
+/**
+ * a rotation survives the coarse scoring of an image when its log-likelihood is
+ * within this margin of the best one of the image
+ */
+#define GLOBAL_PRUNE_MARGIN 30
+
+/**
+ * the minimum fraction of the rotations kept for each image regardless of the
+ * margin
+ */
+#define GLOBAL_PRUNE_KEEP 0.05
+
+/**
+ * the coarse scoring is skipped when its pixels are more than this fraction of
+ * all the pixels, as it would hardly save anything
+ */
+#define GLOBAL_PRUNE_MAX_PXL_FRACTION 0.5
+
+/**
+ * the global search scores the translations by cross-correlation when the
+ * explicit scoring, nT x nPxl per image, costs more than this times the inverse
+ * Fourier transform of an image, N^2 x log2(N^2), about twice the break-even
+ * point measured
+ */
+#define GLOBAL_TRANS_FFT_COST 1
+
+/**
+ * draws of an image for reconstruction sharing the same class, translation and
+ * defocus factor are merged into one insertion when their rotations differ
+ * less than this angle (degree), 0 for merging identical draws only
+ */
+#define RECO_MERGE_ROT_TOL 0
+
 #define TRANS_Q 0.05
 
 #define MIN_STD_FACTOR 1
@@ -74,6 +227,28 @@
 
 #define AVERAGE_TWO_HEMISPHERE_THRES 0.95
 
+/**
+ * stages of the wall time recorded by the optimiser, each moment of the run
+ * counted in at most one of them
+ */
+#define OPTIMISER_STAGE_NONE -1
+
+#define OPTIMISER_STAGE_INIT_IMG 0
+
+#define OPTIMISER_STAGE_GLOBAL 1
+
+#define OPTIMISER_STAGE_LOCAL 2
+
+#define OPTIMISER_STAGE_INSERT 3
+
+#define OPTIMISER_STAGE_RECONSTRUCT 4
+
+#define OPTIMISER_STAGE_FSC 5
+
+#define OPTIMISER_STAGE_SAVE 6
+
+#define OPTIMISER_N_STAGE 7
+
 struct OptimiserPara
 {
 
@@ -403,6 +578,12 @@ struct OptimiserPara
 
     char regionCentre[FILE_NAME_LENGTH];
 
+    /**
+     * whether to resume from the checkpoint of a previous run with the same
+     * destination prefix and number of processes, given on the command line
+     */
+    bool resume;
+
     OptimiserPara()
     {
         nThreadsPerProcess = 1;
@@ -434,11 +615,111 @@ struct OptimiserPara
         saveRefEachIter = true;
         saveTHUEachIter = true;
         subtract = false;
+        resume = false;
     }
 };
 
 void display(const OptimiserPara& para);
 
+/**
+ * a pose of an image to be inserted into the reconstructor, with the summed
+ * weight and the number of the draws merged into it
+ */
+struct RecoPose
+{
+    size_t cls;
+
+    double quat[4];
+
+    double tran[2];
+
+    double d;
+
+    RFLOAT w;
+
+    int count;
+};
+
+/**
+ * convergence of an image in local search across iterations
+ */
+struct ParticleTrack
+{
+    /**
+     * number of iterations in a row in which the image is stable, -1 for no
+     * previous top pose
+     */
+    int nStable;
+
+    size_t cls;
+
+    double quat[4];
+
+    double tran[2];
+};
+
+/**
+ * a checkpoint of a process, written to disk by a background thread
+ */
+struct CheckpointWriter
+{
+    char filename[FILE_NAME_LENGTH];
+
+    vector<char> buf;
+
+    char stackFilename[FILE_NAME_LENGTH];
+
+    /**
+     * the original images of the process, only packed when they are changed
+     * since the last checkpoint, and written before buf
+     */
+    vector<char> stack;
+
+    /**
+     * generation of the image stack last written, -1 if none
+     */
+    int stackGen;
+
+    /**
+     * whether the images of the process are changed since the image stack
+     * last written
+     */
+    bool stackStale;
+
+    /**
+     * set by the thread, whether the image stack handed to it is written
+     */
+    bool stackDone;
+
+    pthread_t thread;
+
+    bool pending;
+};
+
+/**
+ * references in Fourier space written to disk by a background thread of the
+ * master process, each low-pass filtered at lowPass unless it is not positive
+ */
+struct MapWriter
+{
+    vector<Volume> map;
+
+    vector<string> name;
+
+    vector<RFLOAT> lowPass;
+
+    RFLOAT pixelSize;
+
+    pthread_t thread;
+
+    bool pending;
+
+    /**
+     * set by the thread once all the references are written
+     */
+    volatile int done;
+};
+
 class Optimiser : public Parallel
 {
     private:
@@ -500,6 +781,16 @@ class Optimiser : public Parallel
          */
         int _searchType;
 
+        /**
+         * the wall time spent in each stage, the current stage and when it
+         * began
+         */
+        double _stageTime[OPTIMISER_N_STAGE];
+
+        int _stage;
+
+        double _stageStart;
+
         /**
          * model containting references, projectors, reconstruuctors, information 
          * about FSC, SNR and determining the cutoff frequency and search type
@@ -555,6 +846,67 @@ class Optimiser : public Parallel
 
         vector<int> _nP;
 
+        /**
+         * convergence of each image in local search, deciding how much of the
+         * search it takes in the next iteration, see searchBudget()
+         */
+        vector<ParticleTrack> _track;
+
+        /**
+         * the resolution at which _track is measured
+         */
+        int _rTrack;
+
+        /**
+         * references of the round in Fourier space received by the master
+         * process, which are handed to _mapWriter as soon as it is idle, and
+         * written to _mapQueueName, low-pass filtered at _mapQueueLowPass
+         * unless it is not positive
+         */
+        vector<Volume> _mapQueue;
+
+        vector<string> _mapQueueName;
+
+        vector<RFLOAT> _mapQueueLowPass;
+
+        /**
+         * the references being written by the master process
+         */
+        MapWriter _mapWriter;
+
+        /**
+         * time spent on each image in the previous expectation (second), for
+         * balancing the load among the processes of a hemisphere
+         */
+        vector<double> _cost;
+
+        /**
+         * the checkpoint of the previous iteration, which may be still being
+         * written
+         */
+        CheckpointWriter _ckpt;
+
+        /**
+         * path of the cache of preprocessed images, empty when images are not
+         * cached
+         */
+        char _cachePath[FILE_NAME_LENGTH];
+
+        size_t _cacheKey;
+
+        /**
+         * the cache mapped into memory on a hit, NULL otherwise
+         */
+        char* _cache;
+
+        size_t _cacheSize;
+
+        /**
+         * IMG_CACHE_N_STAT statistics of each image, gathered by statImg() and
+         * normaliseImg() for writing the cache
+         */
+        vector<double> _imgStat;
+
         /**
          * Each row stands for power spectrum of signal VS power spectrum of data of a certain group, thus
          * the size of this matrix is _nGroup x (maxR() + 1)
@@ -655,6 +1007,19 @@ class Optimiser : public Parallel
 
         int* _iRowPad;
 
+        /**
+         * the pixels of _iPxl are sorted by shell, pixels of shell v being
+         * [_offShellP[v], _offShellP[v + 1]), thus the pixels below any radius
+         * are a prefix of _iPxl, as well as of the pixel major _datP, _ctfP
+         * and _sigRcpP
+         */
+        int* _offShellP;
+
+        /**
+         * number of shells of _offShellP
+         */
+        int _nShellP;
+
         Complex* _datP;
 
         RFLOAT* _ctfP;
@@ -663,6 +1028,66 @@ class Optimiser : public Parallel
 
         RFLOAT* _sigRcpP;
 
+        /**
+         * _datP, _ctfP and _sigRcpP in bfloat16, taking their place in the
+         * pixel major layout when OPTIMISER_COMPACT_PRE_CAL is defined, the
+         * rows of CTF and sigma are only compacted when they are not shared
+         */
+        ComplexBF16* _datPC;
+
+        bf16* _ctfPC;
+
+        bf16* _sigRcpPC;
+
+        /**
+         * number of rows of _ctfP
+         */
+        int _nCTFP;
+
+        /**
+         * row of _ctfP of each image, images sharing the same CTF parameters
+         * share the same row
+         */
+        int* _iCTFP;
+
+        /**
+         * number of rows of _sigP and _sigRcpP
+         */
+        int _nSigP;
+
+        /**
+         * row of _sigP and _sigRcpP of each image, images of the same group
+         * share the same row
+         */
+        int* _iSigP;
+
+        /**
+         * column of each image in _datP when it is pixel major, images are
+         * sorted by sigma group and CTF
+         */
+        int* _jImgP;
+
+        /**
+         * number of segments of the columns of pixel major _datP, each of which
+         * shares a row of _ctfP and a row of _sigRcpP
+         */
+        int _nSegP;
+
+        /**
+         * the first column of each segment, followed by the number of columns
+         */
+        int* _segP;
+
+        /**
+         * row of _ctfP of each segment
+         */
+        int* _segCTFP;
+
+        /**
+         * row of _sigRcpP of each segment
+         */
+        int* _segSigP;
+
         /**
          * spatial frequency of each pixel
          */
@@ -683,6 +1108,28 @@ class Optimiser : public Parallel
          */
         RFLOAT* _K2;
 
+        /**
+         * number of distinct sets of CTF parameters among the images
+         */
+        int _nCTFTerm;
+
+        /**
+         * defocus dependent term of CTF of each distinct set of CTF
+         * parameters, see CTFTerm()
+         */
+        RFLOAT* _ctfTermDf;
+
+        /**
+         * defocus independent term of CTF of each distinct set of CTF
+         * parameters, see CTFTerm()
+         */
+        RFLOAT* _ctfTermC;
+
+        /**
+         * index of the CTF terms of each image
+         */
+        int* _iCTFTerm;
+
         FFT _fftImg;
 
         vec3 _regionCentre;
@@ -700,8 +1147,28 @@ class Optimiser : public Parallel
             _nI = 0;
             _nR = 0;
 
+            _rTrack = 0;
+
+            _ckpt.pending = false;
+            _ckpt.stackGen = -1;
+            _ckpt.stackStale = true;
+            _ckpt.stackDone = true;
+
+            _mapWriter.pending = false;
+
+            _cachePath[0] = '\0';
+            _cacheKey = 0;
+            _cache = NULL;
+            _cacheSize = 0;
+
             _searchType = SEARCH_TYPE_GLOBAL;
 
+            for (int i = 0; i < OPTIMISER_N_STAGE; i++)
+                _stageTime[i] = 0;
+
+            _stage = OPTIMISER_STAGE_NONE;
+            _stageStart = 0;
+
             _nPxl = 0;
             _iPxl = NULL;
             _iCol = NULL;
@@ -710,9 +1177,16 @@ class Optimiser : public Parallel
             _iColPad = NULL;
             _iRowPad = NULL;
 
+            _offShellP = NULL;
+            _nShellP = 0;
+
             _datP = NULL;
             _ctfP = NULL;
             _sigRcpP = NULL;
+
+            _datPC = NULL;
+            _ctfPC = NULL;
+            _sigRcpPC = NULL;
         }
 
 #ifdef GPU_VERSION
@@ -739,6 +1213,14 @@ class Optimiser : public Parallel
 
         void clear();
 
+        /**
+         * This function returns the wall time (second) spent in a stage so far
+         * by this process.
+         *
+         * @param stage the stage, OPTIMISER_STAGE_*
+         */
+        double stageTime(const int stage) const;
+
     private:
 
         /**
@@ -746,6 +1228,12 @@ class Optimiser : public Parallel
          */
         void bCastNPar();
 
+        /**
+         * close the current stage, adding its wall time, and enter another
+         * one, OPTIMISER_STAGE_NONE for none
+         */
+        void switchStage(const int stage);
+
         /**
          * allreduce the total number of images
          */
@@ -791,6 +1279,12 @@ class Optimiser : public Parallel
          */
         void statImg();
 
+        /**
+         * sum up the statistics of the images over the hemisphere and average
+         * them
+         */
+        void allReduceStatImg();
+
         /**
          * display the statistics result of the signal and noise of the images
          */
@@ -828,6 +1322,39 @@ class Optimiser : public Parallel
          */
         void initCTF();
 
+        /**
+         * This function looks up the cache of preprocessed images in the
+         * directory named by IMG_CACHE_ENV and maps it into memory. The cache
+         * is keyed by the content of the .thu file, the size of images, the
+         * pixel size, the radius of mask and the options of normalisation. The
+         * image files themselves are not hashed. It returns whether every
+         * process hits.
+         */
+        bool openImgCache();
+
+        /**
+         * This function takes the images from the mapped cache, in place of
+         * reading, masking, normalising and transforming them.
+         */
+        void loadImgCache();
+
+        /**
+         * This function writes the images, and the CTFs unless they are
+         * calculated on the fly, of all the processes into the cache, after a
+         * miss.
+         */
+        void saveImgCache();
+
+        /**
+         * This function unmaps the cache.
+         */
+        void closeImgCache();
+
+        /**
+         * number of bytes of a record of the cache
+         */
+        size_t imgCacheStride() const;
+
         /**
          * correct the intensity scale
          *
@@ -936,8 +1463,134 @@ class Optimiser : public Parallel
 
         void freePreCalIdx();
 
+        /**
+         * This function returns the number of pixels of the pre-calculated
+         * pixel lists below a certain radius, which are the first ones.
+         *
+         * @param r the radius (pixel)
+         */
+        int nPxlBelow(const RFLOAT r) const;
+
         void freePreCal(const bool ctf);
 
+        /**
+         * This function assigns the same index to the images sharing the same
+         * CTF parameters, e.g. those from the same micrograph, and returns the
+         * number of distinct CTFs.
+         *
+         * @param iCTF the index of CTF of each image
+         * @param rep  an image of each distinct CTF
+         */
+        int groupCTF(int* iCTF,
+                     vector<int>& rep) const;
+
+        /**
+         * This function draws _para.mReco poses of an image from its particle
+         * filter and merges the duplicates, see RECO_MERGE_ROT_TOL. The poses
+         * are sorted by translation and defocus factor. It returns the number
+         * of poses, i.e., the effective number of insertions of the image.
+         *
+         * @param dst the poses
+         * @param l   the index of the image
+         * @param w   the weight of each draw
+         */
+        int planInsert(vector<RecoPose>& dst,
+                       const int l,
+                       const RFLOAT w) const;
+
+        /**
+         * This function returns how much of the local search an image takes,
+         * SEARCH_BUDGET_FULL, SEARCH_BUDGET_REDUCED or SEARCH_BUDGET_SKIP, by
+         * the number of iterations in a row in which it is stable.
+         *
+         * @param l    the index of the image
+         * @param skip whether skipping is allowed or not
+         */
+        int searchBudget(const int l,
+                         const bool skip) const;
+
+        /**
+         * This function appends image l, along with its particle filter, CTF
+         * attributes, group, offset and the records of the previous iterations,
+         * to dst.
+         *
+         * @param dst the destination buffer
+         * @param l   the index of the image
+         * @param ctf whether the CTF image is included or to be re-generated by
+         *            the receiver
+         */
+        void packImg(vector<char>& dst,
+                     const int l,
+                     const bool ctf) const;
+
+        /**
+         * This function appends an image packed by packImg() to those of this
+         * process and returns the position right after it.
+         *
+         * @param src the packed image
+         * @param ctf whether the CTF image is included
+         */
+        const char* unpackImg(const char* src,
+                              const bool ctf);
+
+        /**
+         * This function moves images, along with their particle filters, CTFs
+         * and groups, from the processes which took longer in the previous
+         * expectation to those which took shorter, within each hemisphere.
+         */
+        void balanceLoad();
+
+        /**
+         * This function compares the top pose of an image with that of the
+         * previous iteration, and records whether it is stable.
+         *
+         * @param l the index of the image
+         */
+        void refreshTrack(const int l);
+
+        /**
+         * This function compares the log-likelihood of each image against the
+         * projection of the reference at its most likely pose computed from the
+         * compact pre-calculated data with that from the data in full
+         * precision, and logs the deviation.
+         *
+         * @param mask whether the data is from the masked images or not
+         */
+        void reportCompactPreCal(const bool mask);
+
+        /**
+         * This function adds the log-likelihood of each column of the pixel
+         * major pre-calculated data against a projection on its first nPxl
+         * pixels to dst, choosing the kernel by the layout of the data.
+         *
+         * @param dst  the log-likelihood of each column
+         * @param pri  the projection
+         * @param nPxl the number of pixels
+         */
+        RFLOAT* logDataVSPriorP(RFLOAT* dst,
+                                const Complex* pri,
+                                const int nPxl) const;
+
+        /**
+         * This function adds the log-likelihood of the nIdx columns in idx
+         * against a projection on all the pixels to dst, consecutively. The
+         * rows of CTF and sigma of column j are colCTF[j] and colSig[j].
+         * Compact rows of CTF and sigma are not supported.
+         *
+         * @param dst    the log-likelihood of each listed column
+         * @param pri    the projection
+         * @param nIdx   the number of listed columns
+         * @param idx    the listed columns
+         * @param colCTF the row of CTF of each column
+         * @param colSig the row of sigma of each column
+         */
+        RFLOAT* logDataVSPriorP(RFLOAT* dst,
+                                const Complex* pri,
+                                const int nIdx,
+                                const int* idx,
+                                const int* colCTF,
+                                const int* colSig) const;
+
         void saveDatabase(const bool finished = false,
                           const bool subtract = false) const;
 
@@ -967,6 +1620,57 @@ class Optimiser : public Parallel
 
         void saveMapJoin(const bool finished = false);
 
+        /**
+         * This function packs the state of this process at the end of an
+         * iteration, i.e. particle filters, sigma, intensity scales, the state
+         * of the model and, on the leads of the hemispheres, the references,
+         * and writes it to disk in a background thread, so that the next
+         * iteration goes on meanwhile. The original images are only written
+         * when they are changed since the last checkpoint, i.e. at the first
+         * one and after balancing the load.
+         */
+        void saveCheckpoint();
+
+        /**
+         * This function waits for the checkpoint being written, if any.
+         */
+        void joinCheckpoint();
+
+        /**
+         * This function restores the state saved by saveCheckpoint() from the
+         * latest iteration completed by all the processes, in place of reading,
+         * normalising and estimating everything from scratch in init().
+         */
+        void loadCheckpoint();
+
+        /**
+         * This function re-generates the images from the original ones, the
+         * offsets and the mask, in the same way as the iterations do.
+         */
+        void reloadImg();
+
+        /**
+         * This function hands the references queued by saveMapHalf() and
+         * saveMapJoin() in 3D to _mapWriter if it is idle. It waits for the
+         * references being written if they, the queue and another reference
+         * of bytes to be received exceed MAP_QUEUE_MEMORY.
+         *
+         * @param bytes the bytes of the reference to be received
+         */
+        void writeMapQueue(const size_t bytes);
+
+        /**
+         * This function waits for the references being written by _mapWriter.
+         */
+        void joinMapWriter();
+
+        /**
+         * This function makes the master process write the references queued
+         * by saveMapHalf() and saveMapJoin() in 3D, and waits for them. It
+         * returns at once on the other processes.
+         */
+        void flushMapQueue();
+
         /**
          * save FSC
          */
@@ -1026,6 +1730,118 @@ RFLOAT logDataVSPrior(const Complex* dat,
                       const RFLOAT* sigRcp,
                       const int m);
 
+/**
+ * This function calculates the logarithm of the possibility that each of n
+ * images is from the projection. The data is pixel major. The columns are
+ * divided into segments, and the columns of a segment share a row of CTF and a
+ * row of the reciprocal of sigma, both of which are pixel major as well.
+ *
+ * @param dat    images, m x n
+ * @param pri    projection
+ * @param ctf    CTF, m x nCTF
+ * @param sigRcp reciprocal of sigma of noise, m x nSig
+ * @param n      the number of images
+ * @param m      the number of pixels
+ * @param nCTF   the number of rows of CTF
+ * @param nSig   the number of rows of sigma
+ * @param nSeg   the number of segments
+ * @param seg    the first column of each segment, followed by n
+ * @param segCTF the row of CTF of each segment
+ * @param segSig the row of sigma of each segment
+ * @param result the result of each image
+ */
+RFLOAT* logDataVSPrior_m_n_seg(const Complex* dat,
+                               const Complex* pri,
+                               const RFLOAT* ctf,
+                               const RFLOAT* sigRcp,
+                               const int n,
+                               const int m,
+                               const int nCTF,
+                               const int nSig,
+                               const int nSeg,
+                               const int* seg,
+                               const int* segCTF,
+                               const int* segSig,
+                               RFLOAT* result);
+
+RFLOAT* logDataVSPrior_m_n_seg(const ComplexBF16* dat,
+                               const Complex* pri,
+                               const RFLOAT* ctf,
+                               const RFLOAT* sigRcp,
+                               const int n,
+                               const int m,
+                               const int nCTF,
+                               const int nSig,
+                               const int nSeg,
+                               const int* seg,
+                               const int* segCTF,
+                               const int* segSig,
+                               RFLOAT* result);
+
+/**
+ * This function calculates the logarithm of the possibility that each of n
+ * images is from the projection, the same as KernelTable::logDataVSPrior_m_n,
+ * except that the pixel major images, CTF and sigma are stored in bfloat16 and
+ * widened on the fly. The accumulation is in RFLOAT.
+ *
+ * @param dat    images, m x n
+ * @param pri    projection
+ * @param ctf    CTF, m x n
+ * @param sigRcp reciprocal of sigma of noise, m x n
+ * @param n      the number of images
+ * @param m      the number of pixels
+ * @param result the result of each image
+ */
+RFLOAT* logDataVSPrior_m_n_huabin_BF16(const ComplexBF16* dat,
+                                       const Complex* pri,
+                                       const bf16* ctf,
+                                       const bf16* sigRcp,
+                                       const int n,
+                                       const int m,
+                                       RFLOAT* result);
+
+/**
+ * This function calculates the logarithm of the possibility that the image is
+ * from the projection at every translation of whole pixels at once. Only the
+ * cross term of |dat - ctf * tra * pri|^2 depends on the translation, which is
+ * the correlation of dat and ctf * pri weighted by sigRcp, thus given at all
+ * the translations by an inverse Fourier transform of their product. The
+ * result of translation (x, y) is stored at
+ * ((y + nRow) % nRow) * nCol + (x + nCol) % nCol, the same as logDataVSPrior
+ * against the phase image of translate() of (x, y) up to rounding.
+ *
+ * @param dst    the result of each translation, nRow x nCol
+ * @param buf    buffer in Fourier space, nRow x (nCol / 2 + 1), destroyed
+ * @param plan   the complex to real plan of nRow x nCol from buf to dst
+ * @param dat    image, pixel i at dat[i * sDat]
+ * @param pri    projection
+ * @param ctf    CTF, pixel i at ctf[i * sCTF]
+ * @param sigRcp reciprocal of sigma of noise, pixel i at sigRcp[i * sSig]
+ * @param sDat   the stride of dat
+ * @param sCTF   the stride of ctf
+ * @param sSig   the stride of sigRcp
+ * @param nCol   the number of columns of the image
+ * @param nRow   the number of rows of the image
+ * @param iCol   the column of each pixel
+ * @param iRow   the row of each pixel
+ * @param m      the number of pixels
+ */
+void logDataVSPriorTrans(RFLOAT* dst,
+                         Complex* buf,
+                         TSFFTW_PLAN plan,
+                         const Complex* dat,
+                         const Complex* pri,
+                         const RFLOAT* ctf,
+                         const RFLOAT* sigRcp,
+                         const int sDat,
+                         const int sCTF,
+                         const int sSig,
+                         const int nCol,
+                         const int nRow,
+                         const int* iCol,
+                         const int* iRow,
+                         const int m);
+
 RFLOAT logDataVSPrior(const Complex* dat,
                       const Complex* pri,
                       const RFLOAT* frequency,
@@ -1038,6 +1854,27 @@ RFLOAT logDataVSPrior(const Complex* dat,
                       const RFLOAT* sigRcp,
                       const int m);
 
+/**
+ * This function calculates the logarithm of the possibility that the image is
+ * from the projection, with the CTF evaluated on the fly from the terms given
+ * by CTFTerm().
+ *
+ * @param dat    image
+ * @param pri    projection
+ * @param dfTerm the defocus dependent term of CTF
+ * @param cTerm  the defocus independent term of CTF
+ * @param df     the scale of defocus
+ * @param sigRcp reciprocal of sigma of noise
+ * @param m      the number of pixels
+ */
+RFLOAT logDataVSPrior(const Complex* dat,
+                      const Complex* pri,
+                      const RFLOAT* dfTerm,
+                      const RFLOAT* cTerm,
+                      const RFLOAT df,
+                      const RFLOAT* sigRcp,
+                      const int m);
+
 /**
  * This function calculates the logarithm of the possibility that the image is
  * from the projection translation couple.
@@ -13,6 +13,7 @@
 
 #include <mpi.h>
 
+#include "Config.h"
 #include "Logging.h"
 #include "Precision.h"
 
@@ -101,6 +102,20 @@
         BLOG(INFO, "LOGGER_MEM") << msg << ", Physic Memory Usage : " << memUsageRM / MEGABYTE << "G"; \
     } while (0);
 
+/**
+ * This macro logs the statistics of the arena of Image / Volume buffers. The
+ * peak is the sum of the peaks of the threads, thus an upper bound.
+ */
+#define CHECK_ARENA_USAGE(msg) \
+    do \
+    { \
+        ArenaStat arena; \
+        arenaStat(arena); \
+        RFLOAT hitRate = (arena.hit + arena.miss == 0) ? 0 : (RFLOAT)arena.hit / (arena.hit + arena.miss); \
+        ALOG(INFO, "LOGGER_MEM") << msg << ", Arena Hit Rate : " << hitRate * 100 << "\%, Peak (Upper Bound) : " << arena.peakBytesBound / MEGABYTE << "M, In Use : " << arena.bytesInUse / MEGABYTE << "M, Cached : " << arena.bytesCached / MEGABYTE << "M"; \
+        BLOG(INFO, "LOGGER_MEM") << msg << ", Arena Hit Rate : " << hitRate * 100 << "\%, Peak (Upper Bound) : " << arena.peakBytesBound / MEGABYTE << "M, In Use : " << arena.bytesInUse / MEGABYTE << "M, Cached : " << arena.bytesCached / MEGABYTE << "M"; \
+    } while (0);
+
 class Parallel: private boost::noncopyable
 {
     protected:
@@ -122,6 +137,18 @@ class Parallel: private boost::noncopyable
 
         MPI_Comm _slav;
 
+        /**
+         * communicator of the processes of the hemisphere on the same node,
+         * which share memory, MPI_COMM_NULL unless PARALLEL_NODE_SHARED
+         */
+        MPI_Comm _node;
+
+        /**
+         * communicator of the leaders of the nodes of the hemisphere, i.e. rank
+         * 0 of each _node, MPI_COMM_NULL on the other processes
+         */
+        MPI_Comm _lead;
+
     public:
 
         /**
@@ -152,7 +179,9 @@ class Parallel: private boost::noncopyable
         void setMPIEnv(const int commSize,
                        const int commRank,
                        const MPI_Comm& hemi,
-                       const MPI_Comm& slav);
+                       const MPI_Comm& slav,
+                       const MPI_Comm& node = MPI_COMM_NULL,
+                       const MPI_Comm& lead = MPI_COMM_NULL);
 
         /**
          * This function returns whether the current process is the master
@@ -213,6 +242,14 @@ class Parallel: private boost::noncopyable
         MPI_Comm slav() const;
 
         void setSlav(const MPI_Comm& slav);
+
+        MPI_Comm node() const;
+
+        void setNode(const MPI_Comm& node);
+
+        MPI_Comm lead() const;
+
+        void setLead(const MPI_Comm& lead);
 };
 
 /**
@@ -290,4 +327,40 @@ void MPI_Allreduce_Large(void* buf,
                          MPI_Op op,
                          MPI_Comm comm);
 
+/**
+ * This function all-reduces as MPI_Allreduce_Large in two levels, reducing
+ * within each node to its leader first, then all-reducing among the leaders and
+ * broadcasting back within each node, thus only one copy per node crosses the
+ * network. It falls back to MPI_Allreduce_Large on comm when node is
+ * MPI_COMM_NULL.
+ *
+ * @param buf      the buffer area of all-reducing data
+ * @param count    the number of the data
+ * @param datatype the type of the data
+ * @param op       the operator of all-reducing
+ * @param comm     the communicator
+ * @param node     the processes of comm on the same node
+ * @param lead     the leaders of the nodes, rank 0 of node
+ */
+void MPI_Allreduce_Node(void* buf,
+                        size_t count,
+                        MPI_Datatype datatype,
+                        MPI_Op op,
+                        MPI_Comm comm,
+                        MPI_Comm node,
+                        MPI_Comm lead);
+
+/**
+ * This function allocates a buffer of size bytes on rank 0 of node, shared by
+ * all the processes of node, and returns its address in the current process.
+ * It is collective over node.
+ *
+ * @param win  the window of the buffer, freed by MPI_Win_free
+ * @param size the number of bytes
+ * @param node the processes on the same node
+ */
+void* MPI_Alloc_Shared(MPI_Win& win,
+                       size_t size,
+                       MPI_Comm node);
+
 #endif // PARALLEL_H
@@ -1132,6 +1132,24 @@ class Particle
          * This function will copy the content to another Particle object.
          */
         Particle copy() const;
+
+        /**
+         * This function appends the whole state of the particle filter, except
+         * the symmetry, to dst, e.g. for sending it to another process.
+         *
+         * @param dst the destination buffer
+         */
+        void pack(vector<double>& dst) const;
+
+        /**
+         * This function restores the particle filter packed by pack() and
+         * returns the position right after it.
+         *
+         * @param src the packed state
+         * @param sym the symmetry information
+         */
+        const double* unpack(const double* src,
+                             const Symmetry* sym);
     
     private:
 
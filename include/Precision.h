@@ -178,14 +178,19 @@ RFLOAT TSGSL_stats_sd (const RFLOAT data[], const size_t stride, const size_t n)
 RFLOAT TSGSL_stats_sd_m (const RFLOAT data[], const size_t stride, const size_t n, const RFLOAT mean);
 
 int TSFFTW_init_threads(void);
+void TSFFTW_make_planner_thread_safe(void);
 void TSFFTW_cleanup_threads(void);
 void TSFFTW_destroy_plan(TSFFTW_PLAN plan);
 void TSFFTW_execute(const TSFFTW_PLAN plan);
 void TSFFTW_execute_dft_r2c( const TSFFTW_PLAN p, RFLOAT *in, TSFFTW_COMPLEX *out);
 void TSFFTW_execute_dft_c2r( const TSFFTW_PLAN p, TSFFTW_COMPLEX *in, RFLOAT *out); 
+void TSFFTW_execute_dft( const TSFFTW_PLAN p, TSFFTW_COMPLEX *in, TSFFTW_COMPLEX *out);
 void *TSFFTW_malloc(size_t n);
 void TSFFTW_free(void *p);
 
+TSFFTW_PLAN TSFFTW_plan_dft_r2c_1d(int n, RFLOAT *in, TSFFTW_COMPLEX *out, unsigned flags);
+TSFFTW_PLAN TSFFTW_plan_dft_1d(int n, TSFFTW_COMPLEX *in, TSFFTW_COMPLEX *out, int sign, unsigned flags);
+TSFFTW_PLAN TSFFTW_plan_many_dft(int rank, const int *n, int howmany, TSFFTW_COMPLEX *in, const int *inembed, int istride, int idist, TSFFTW_COMPLEX *out, const int *onembed, int ostride, int odist, int sign, unsigned flags);
 TSFFTW_PLAN TSFFTW_plan_dft_r2c_2d(int n0, int n1, RFLOAT *in, TSFFTW_COMPLEX *out, unsigned flags);
 TSFFTW_PLAN TSFFTW_plan_dft_r2c_3d(int n0, int n1, int n2, RFLOAT *in, TSFFTW_COMPLEX *out, unsigned flags);
 
@@ -26,6 +26,15 @@
 
 #include "ImageFunctions.h"
 
+#include "Kernel.h"
+
+/**
+ * frequencies of the projectee higher than the padding factor times the max
+ * radius plus this margin are not calculated, the margin covers the neighbours
+ * taken by interpolation
+ */
+#define PROJECTOR_PAD_MARGIN 2
+
 class Projector
 {
     BOOST_MOVABLE_BUT_NOT_COPYABLE(Projector)
@@ -167,6 +176,63 @@ class Projector
          */
         void setProjectee(Volume src);
 
+        /**
+         * This function sets the projectee and the max radius of processing
+         * signal. Only the frequencies needed for projecting within the max
+         * radius are calculated, thus the projectee shall be set again before
+         * increasing the max radius.
+         *
+         * @param src       the image to be projected
+         * @param maxRadius the max radius
+         */
+        void setProjectee(Image src,
+                          const int maxRadius);
+
+        /**
+         * This function sets the projectee and the max radius of processing
+         * signal. Only the frequencies needed for projecting within the max
+         * radius are calculated, thus the projectee shall be set again before
+         * increasing the max radius.
+         *
+         * @param src       the volume to be projected
+         * @param maxRadius the max radius
+         */
+        void setProjectee(Volume src,
+                          const int maxRadius);
+
+        /**
+         * This function sets the projectee as above, except that the padded
+         * projectee is stored in a buffer owned by others, e.g. shared by the
+         * projectors of the processes on a node.
+         *
+         * @param src       the volume to be projected
+         * @param maxRadius the max radius
+         * @param data      the buffer of sizeFTPad(src.nColRL()) elements
+         */
+        void setProjectee(Volume src,
+                          const int maxRadius,
+                          Complex* data);
+
+        /**
+         * This function takes the padded projectee from a buffer, in which it
+         * is set by another projector of the same padding factor.
+         *
+         * @param data      the buffer of sizeFTPad(size) elements
+         * @param size      the size of the volume before padding
+         * @param maxRadius the max radius
+         */
+        void attachProjectee(Complex* data,
+                             const int size,
+                             const int maxRadius);
+
+        /**
+         * This function returns the number of elements of the padded projectee
+         * in Fourier space of a volume of a certain size.
+         *
+         * @param size the size of the volume before padding
+         */
+        size_t sizeFTPad(const int size) const;
+
         void project(Image& dst,
                      const dmat22& mat) const;
 
@@ -368,9 +434,20 @@ class Projector
     private:
 
         /**
-         * This function performs gridding correction on projectee.
+         * This function performs gridding correction on the projectee in real
+         * space before padding.
+         *
+         * @param img the projectee in real space
+         */
+        void gridCorrection(Image& img) const;
+
+        /**
+         * This function performs gridding correction on the projectee in real
+         * space before padding.
+         *
+         * @param vol the projectee in real space
          */
-        void gridCorrection();
+        void gridCorrection(Volume& vol) const;
 };
 
 #endif // PROJECTOR_H
@@ -432,6 +432,20 @@ class Reconstructor : public Parallel
                        const double oy,
                        const double oz);
 
+        /**
+         * insert the offset of a pose drawn count times, as count offsets of it
+         */
+        void insertDir(const dvec2& dir,
+                       const int count);
+
+        void insertDir(const dvec3& dir,
+                       const int count);
+
+        void insertDir(const double ox,
+                       const double oy,
+                       const double oz,
+                       const int count);
+
         void insert(const Image& src,
                     const Image& ctf,
                     const dmat22& rot,
@@ -0,0 +1,126 @@
+/*******************************************************************************
+ * Author:
+ * Dependecy:
+ * Test:
+ * Execution:
+ * Description:
+ * ****************************************************************************/
+
+#ifndef SLAB_POSTPROCESS_H
+#define SLAB_POSTPROCESS_H
+
+#include <string>
+
+#include "Macro.h"
+#include "Typedef.h"
+#include "Logging.h"
+#include "Precision.h"
+
+#include "ImageFile.h"
+#include "Image.h"
+#include "Volume.h"
+#include "Spectrum.h"
+#include "FFT.h"
+#include "Mask.h"
+#include "Filter.h"
+#include "SlabVolume.h"
+#include "Postprocess.h"
+
+/**
+ * thunder_postprocess works out of core on boxes larger than this, in core
+ * otherwise, unless a scratch directory is given
+ */
+#define POSTPROCESS_MAX_IN_CORE_SIZE 512
+
+/**
+ * Postprocess of boxes which do not fit in memory. The half maps, the mask and
+ * the intermediate maps are kept in files and processed slice by slice, see
+ * SlabVolume, thus the memory used does not grow with the box, while about as
+ * much scratch space as the box is taken. MRC files of modes other than 2 are
+ * converted into scratch files first.
+ *
+ * The results differ from those of Postprocess in that
+ * - Reference_A_Masked.mrc and Reference_B_Masked.mrc hold the masked half
+ *   maps, with the pixel size, instead of the unmasked ones,
+ * - the random phases are drawn by the engine of each thread, thus the FSC
+ *   beyond the threshold of random phase, and Reference_Sharp.mrc weighted by
+ *   it, differ by the random draws, up to a few percent of the peak.
+ */
+class SlabPostprocess
+{
+    private:
+
+        int _size;
+
+        RFLOAT _pixelSize;
+
+        /**
+         * the directory of the scratch files
+         */
+        std::string _scratch;
+
+        SlabVolume _mapA;
+
+        SlabVolume _mapB;
+
+        SlabVolume _mapAMasked;
+
+        SlabVolume _mapBMasked;
+
+        SlabVolume _mapI;
+
+        SlabVolume _mapARFMask;
+
+        SlabVolume _mapBRFMask;
+
+        SlabVolume _mask;
+
+        vec _FSCUnmask;
+
+        vec _FSCMask;
+
+        vec _FSCRFMask;
+
+        vec _FSC;
+        
+        int _res;
+
+    public:        
+
+        SlabPostprocess();
+
+        SlabPostprocess(const char mapAFilename[],
+                        const char mapBFilename[],
+                        const char maskFilename[],
+                        const RFLOAT pixelSize,
+                        const char scratch[] = ".");
+
+        void run();
+
+    private:
+
+        /**
+         * perform masking on reference A and reference B
+         */
+        void maskAB();
+
+        void maskABRF();
+
+        void randomPhaseAB(const int randomPhaseThres);
+
+        /**
+         * average reference A and reference B in Fourier space into a map
+         */
+        void mergeAB(SlabVolume& dst);
+
+        /**
+         * create a map in a scratch file, removed from the directory right away
+         */
+        void createScratch(SlabVolume& dst);
+
+        int maxR();
+
+        void saveFSC() const;
+};
+
+#endif // SLAB_POSTPROCESS_H
@@ -0,0 +1,131 @@
+/*******************************************************************************
+ * Author:
+ * Dependency:
+ * Test:
+ * Execution:
+ * Description: the sockets, NUMA nodes, cores and hardware threads available to
+ *              the process, read from sysfs, and the placement of the threads
+ *              and the memory on them
+ *
+ * Manual: The processes on a node with the same CPUs, i.e. all of them if the
+ *         launcher does not bind them, or those bound to the same socket by
+ *         e.g. mpirun --bind-to socket, share these CPUs in contiguous blocks
+ *         of cores, thus the cores of a process are on as few NUMA nodes as
+ *         possible. Each thread is bound to a core, one thread per core before
+ *         taking the second hardware thread of any core.
+ * ****************************************************************************/
+
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#include <sched.h>
+#include <unistd.h>
+
+#include <omp_compat.h>
+
+#include "Config.h"
+#include "Macro.h"
+#include "Logging.h"
+#include "Precision.h"
+
+/**
+ * the directory of the topology of the CPUs and the NUMA nodes in sysfs
+ */
+#define TOPOLOGY_SYSFS_CPU "/sys/devices/system/cpu"
+
+#define TOPOLOGY_SYSFS_NODE "/sys/devices/system/node"
+
+struct Topology
+{
+    /**
+     * the CPUs, i.e. hardware threads, the first hardware thread of each core
+     * ahead of the others, the cores ordered by NUMA node and socket
+     */
+    std::vector<int> cpu;
+
+    /**
+     * the core, NUMA node and socket of each CPU, cores and NUMA nodes are
+     * numbered from 0 in order
+     */
+    std::vector<int> core;
+
+    std::vector<int> node;
+
+    std::vector<int> socket;
+
+    int nCore;
+
+    int nNode;
+
+    int nSocket;
+
+    /**
+     * whether the process is restricted to part of the online CPUs, i.e. bound
+     * by the launcher or sharing the CPUs with other processes
+     */
+    bool bound;
+
+    /**
+     * bytes of memory available on the machine
+     */
+    size_t memAvailable;
+};
+
+/**
+ * This function detects the CPUs available to the process, i.e. in its
+ * affinity mask, and their topology.
+ *
+ * @param dst the topology
+ */
+void detectTopology(Topology& dst);
+
+/**
+ * This function hashes the CPUs of the topology, the same for the processes of
+ * the same CPUs, thus can be used to group them.
+ *
+ * @param topo the CPUs of the process
+ */
+int hashTopology(const Topology& topo);
+
+/**
+ * This function takes the share of the cores of the i-th out of n processes
+ * with the same CPUs, a contiguous block of cores.
+ *
+ * @param dst the CPUs of the process
+ * @param src the CPUs of the n processes
+ * @param i   the index of the process on the node
+ * @param n   the number of processes on the node
+ */
+void shareTopology(Topology& dst,
+                   const Topology& src,
+                   const int i,
+                   const int n);
+
+/**
+ * This function binds each thread of the OpenMP thread pool to a CPU of the
+ * topology, thread t to cpu[t % cpu.size()]. The master thread is kept on all
+ * the CPUs, since the threads created by it later, e.g. those of FFTW, inherit
+ * its affinity. It is meant for no more threads than CPUs of the topology.
+ *
+ * @param topo the CPUs of the process
+ */
+void bindThreads(const Topology& topo);
+
+/**
+ * This function allocates a buffer as TSFFTW_malloc does, and touches its pages
+ * by all the threads in static blocks, so that each page resides on the NUMA
+ * node of the thread which touches it first. Parallel loops of static schedule
+ * over the buffer then read mostly local memory, and loops in which every
+ * thread reads all of it spread their traffic over all the NUMA nodes.
+ *
+ * @param size the number of bytes
+ */
+void* mallocFirstTouch(const size_t size);
+
+#endif // TOPOLOGY_H
@@ -70,4 +70,46 @@ typedef Matrix<double, Dynamic, 2> dmat2;
 typedef Matrix<double, Dynamic, 3> dmat3;
 typedef Matrix<double, Dynamic, 4> dmat4;
 
+/**
+ * This function appends the size and then the elements, column by column, of a
+ * matrix to a buffer of double.
+ *
+ * @param dst the buffer
+ * @param src the matrix
+ */
+template <typename V, typename T>
+inline void packMatrix(V& dst,
+                       const T& src)
+{
+    dst.push_back(src.rows());
+    dst.push_back(src.cols());
+
+    for (int j = 0; j < src.cols(); j++)
+        for (int i = 0; i < src.rows(); i++)
+            dst.push_back((double)src(i, j));
+}
+
+/**
+ * This function restores a matrix packed by packMatrix() and returns the
+ * position right after it.
+ *
+ * @param dst the matrix
+ * @param src the buffer
+ */
+template <typename T>
+inline const double* unpackMatrix(T& dst,
+                                  const double* src)
+{
+    int nRow = (int)*src++;
+    int nCol = (int)*src++;
+
+    dst.resize(nRow, nCol);
+
+    for (int j = 0; j < nCol; j++)
+        for (int i = 0; i < nRow; i++)
+            dst(i, j) = (typename T::Scalar)(*src++);
+
+    return src;
+}
+
 #endif // TYPEDEF_H
@@ -143,3 +143,56 @@ void CTF(RFLOAT* dst,
         dst[i] = -w1 * TS_SIN(ki) + w2 * TS_COS(ki);
     }
 }
+
+void CTFTerm(RFLOAT* dfTerm,
+             RFLOAT* cTerm,
+             const RFLOAT pixelSize,
+             const RFLOAT voltage,
+             const RFLOAT defocusU,
+             const RFLOAT defocusV,
+             const RFLOAT theta,
+             const RFLOAT Cs,
+             const RFLOAT amplitudeContrast,
+             const RFLOAT phaseShift,
+             const int nCol,
+             const int nRow,
+             const int* iCol,
+             const int* iRow,
+             const int nPxl)
+{
+    RFLOAT lambda = 12.2643247 / sqrt(voltage * (1 + voltage * 0.978466e-6));
+
+    RFLOAT w1 = TS_SQRT(1 - TSGSL_pow_2(amplitudeContrast));
+    RFLOAT w2 = amplitudeContrast;
+
+    RFLOAT K1 = M_PI * lambda;
+    RFLOAT K2 = M_PI_2 * Cs * TSGSL_pow_3(lambda);
+
+    // -w1 * sin(ki) + w2 * cos(ki) = cos(ki + phi), as w1^2 + w2^2 = 1
+
+    RFLOAT phi = atan2(w1, w2);
+
+    for (int i = 0; i < nPxl; i++)
+    {
+        RFLOAT u = NORM(iCol[i] / (pixelSize * nCol),
+                        iRow[i] / (pixelSize * nRow));
+
+        RFLOAT angle = atan2(iRow[i], iCol[i]) - theta;
+        RFLOAT defocus = -(defocusU + defocusV
+                         + (defocusU - defocusV) * TS_COS(2 * angle)) / 2;
+
+        dfTerm[i] = K1 * defocus * TSGSL_pow_2(u);
+        cTerm[i] = K2 * TSGSL_pow_4(u) - phaseShift + phi;
+    }
+}
+
+void CTFFromTerm(RFLOAT* dst,
+                 const RFLOAT* dfTerm,
+                 const RFLOAT* cTerm,
+                 const RFLOAT df,
+                 const int nPxl)
+{
+    #pragma omp simd
+    for (int i = 0; i < nPxl; i++)
+        dst[i] = CTFFastCos(df * dfTerm[i] + cTerm[i]);
+}
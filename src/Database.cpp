@@ -146,6 +146,27 @@ void Database::shuffle()
     MPI_Barrier(MPI_COMM_WORLD);
 }
 
+void Database::setReg(const vector<int>& reg)
+{
+    _reg.resize(nParticle());
+
+    IF_MASTER
+    {
+        if (reg.size() != _reg.size())
+        {
+            REPORT_ERROR("INCONSISTENT NUMBER OF PARTICLES");
+
+            abort();
+        }
+
+        _reg = reg;
+    }
+
+    MPI_Bcast(&_reg[0], _reg.size(), MPI_INT, MASTER_ID, MPI_COMM_WORLD);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+}
+
 long Database::offset(const int i) const
 {
     return _offset[_reg[i]];
@@ -236,6 +257,36 @@ string Database::micrographPath(const int i) const
     return string(word);
 }
 
+void Database::source(string& path,
+                      string& micrographPath,
+                      RFLOAT& coordX,
+                      RFLOAT& coordY,
+                      const int i) const
+{
+    fseek(_db, _offset[_reg[i]], SEEK_SET);
+
+    char line[FILE_LINE_LENGTH];
+    char* word;
+
+    FGETS_ERROR_HANDLER(fgets(line, FILE_LINE_LENGTH - 1, _db));
+
+    word = strtok(line, " ");
+
+    for (int i = 0; i < THU_COORDINATE_Y; i++)
+    {
+        word = strtok(NULL, " ");
+
+        if (i + 1 == THU_PARTICLE_PATH)
+            path = string(word);
+        else if (i + 1 == THU_MICROGRAPH_PATH)
+            micrographPath = string(word);
+        else if (i + 1 == THU_COORDINATE_X)
+            coordX = atoi(word);
+    }
+
+    coordY = atoi(word);
+}
+
 void Database::ctf(RFLOAT& voltage,
                    RFLOAT& defocusU,
                    RFLOAT& defocusV,
@@ -10,8 +10,59 @@
 
 #include "FFT.h"
 
+#include <map>
+
 #include <omp_compat.h>
 
+/**
+ * the 1D plans of the padded Fourier transform, one pair for each length, as
+ * the padded size hardly changes within a run; a plan is never destroyed, as
+ * another thread may be executing it
+ */
+struct PadPlan
+{
+    TSFFTW_PLAN r2c;
+
+    TSFFTW_PLAN c2c;
+};
+
+static std::map<int, PadPlan> _padPlan;
+
+static PadPlan padCreatePlan(const int n)
+{
+    PadPlan plan;
+
+    #pragma omp critical (padCreatePlan)
+    {
+        std::map<int, PadPlan>::const_iterator it = _padPlan.find(n);
+
+        if (it != _padPlan.end())
+            plan = it->second;
+        else
+        {
+            RFLOAT* srcR = (RFLOAT*)TSFFTW_malloc(n * sizeof(RFLOAT));
+            TSFFTW_COMPLEX* srcC = (TSFFTW_COMPLEX*)TSFFTW_malloc(n * sizeof(Complex));
+            TSFFTW_COMPLEX* dstC = (TSFFTW_COMPLEX*)TSFFTW_malloc(n * sizeof(Complex));
+
+            plan.r2c = TSFFTW_plan_dft_r2c_1d(n, srcR, dstC, FFTW_MEASURE);
+            plan.c2c = TSFFTW_plan_dft_1d(n, srcC, dstC, FFTW_FORWARD, FFTW_MEASURE);
+
+            TSFFTW_free(srcR);
+            TSFFTW_free(srcC);
+            TSFFTW_free(dstC);
+
+            _padPlan[n] = plan;
+        }
+    }
+
+    return plan;
+}
+
+/**
+ * index of frequency or coordinate i in a line of length n
+ */
+#define PAD_WRAP(i, n) ((i) >= 0 ? (i) : (i) + (n))
+
 FFT::FFT() : _srcR(NULL),
              _srcC(NULL),
              _dstR(NULL),
@@ -530,3 +581,179 @@ void FFT::bwDestroyPlanMT()
         bwPlan = NULL;
     }
 }
+
+void FFT::fwPadMT(Image& dst,
+                  const Image& src,
+                  const int pf,
+                  const int r)
+{
+    int n = src.nColRL();
+    int p = pf * n;
+
+    // kx in [0, m], ky in [-m, m]
+
+    int m = GSL_MIN_INT(r, p / 2);
+
+    int w = m + 1;
+    int h = 2 * m + 1;
+
+    if ((dst.nColRL() != p) ||
+        (dst.nRowRL() != p) ||
+        dst.isEmptyFT())
+        dst.alloc(p, p, FT_SPACE);
+
+    #pragma omp parallel for
+    SET_0_FT(dst);
+
+    PadPlan plan = padCreatePlan(p);
+
+    Complex* t = (Complex*)TSFFTW_malloc((size_t)n * w * sizeof(Complex));
+
+    #pragma omp parallel
+    {
+        RFLOAT* lineR = (RFLOAT*)TSFFTW_malloc(p * sizeof(RFLOAT));
+        Complex* lineI = (Complex*)TSFFTW_malloc(p * sizeof(Complex));
+        Complex* lineO = (Complex*)TSFFTW_malloc(p * sizeof(Complex));
+
+        // along X, only the rows inside the source are non-zero
+
+        #pragma omp for
+        for (int y = 0; y < n; y++)
+        {
+            int j = y - n / 2;
+
+            memset(lineR, 0, p * sizeof(RFLOAT));
+
+            for (int i = -n / 2; i < n / 2; i++)
+                lineR[PAD_WRAP(i, p)] = src.getRL(i, j);
+
+            TSFFTW_execute_dft_r2c(plan.r2c, lineR, (TSFFTW_COMPLEX*)lineO);
+
+            memcpy(t + (size_t)y * w, lineO, w * sizeof(Complex));
+        }
+
+        // along Y
+
+        #pragma omp for
+        for (int x = 0; x < w; x++)
+        {
+            memset(lineI, 0, p * sizeof(Complex));
+
+            for (int y = 0; y < n; y++)
+                lineI[PAD_WRAP(y - n / 2, p)] = t[(size_t)y * w + x];
+
+            TSFFTW_execute_dft(plan.c2c, (TSFFTW_COMPLEX*)lineI, (TSFFTW_COMPLEX*)lineO);
+
+            for (int v = 0; v < h; v++)
+                dst[dst.iFTHalf(x, v - m)] = lineO[PAD_WRAP(v - m, p)];
+        }
+
+        TSFFTW_free(lineR);
+        TSFFTW_free(lineI);
+        TSFFTW_free(lineO);
+    }
+
+    TSFFTW_free(t);
+}
+
+void FFT::fwPadMT(Volume& dst,
+                  const Volume& src,
+                  const int pf,
+                  const int r)
+{
+    int n = src.nColRL();
+    int p = pf * n;
+
+    // kx in [0, m], ky and kz in [-m, m]
+
+    int m = GSL_MIN_INT(r, p / 2);
+
+    int w = m + 1;
+    int h = 2 * m + 1;
+
+    if ((dst.nColRL() != p) ||
+        (dst.nRowRL() != p) ||
+        (dst.nSlcRL() != p) ||
+        dst.isEmptyFT())
+        dst.alloc(p, p, p, FT_SPACE);
+
+    #pragma omp parallel for
+    SET_0_FT(dst);
+
+    PadPlan plan = padCreatePlan(p);
+
+    // t1 is indexed by [z][y][kx], t2 by [z][ky][kx]
+
+    Complex* t1 = (Complex*)TSFFTW_malloc((size_t)n * n * w * sizeof(Complex));
+    Complex* t2 = (Complex*)TSFFTW_malloc((size_t)n * h * w * sizeof(Complex));
+
+    #pragma omp parallel
+    {
+        RFLOAT* lineR = (RFLOAT*)TSFFTW_malloc(p * sizeof(RFLOAT));
+        Complex* lineI = (Complex*)TSFFTW_malloc(p * sizeof(Complex));
+        Complex* lineO = (Complex*)TSFFTW_malloc(p * sizeof(Complex));
+
+        // along X, only the rows inside the source are non-zero
+
+        #pragma omp for
+        for (int yz = 0; yz < n * n; yz++)
+        {
+            int j = yz % n - n / 2;
+            int k = yz / n - n / 2;
+
+            memset(lineR, 0, p * sizeof(RFLOAT));
+
+            for (int i = -n / 2; i < n / 2; i++)
+                lineR[PAD_WRAP(i, p)] = src.getRL(i, j, k);
+
+            TSFFTW_execute_dft_r2c(plan.r2c, lineR, (TSFFTW_COMPLEX*)lineO);
+
+            memcpy(t1 + (size_t)yz * w, lineO, w * sizeof(Complex));
+        }
+
+        // along Y, only the slices inside the source are non-zero
+
+        #pragma omp for
+        for (int xz = 0; xz < w * n; xz++)
+        {
+            int x = xz % w;
+            int z = xz / w;
+
+            memset(lineI, 0, p * sizeof(Complex));
+
+            for (int y = 0; y < n; y++)
+                lineI[PAD_WRAP(y - n / 2, p)] = t1[((size_t)z * n + y) * w + x];
+
+            TSFFTW_execute_dft(plan.c2c, (TSFFTW_COMPLEX*)lineI, (TSFFTW_COMPLEX*)lineO);
+
+            for (int v = 0; v < h; v++)
+                t2[((size_t)z * h + v) * w + x] = lineO[PAD_WRAP(v - m, p)];
+        }
+
+        // along Z
+
+        #pragma omp for
+        for (int xy = 0; xy < w * h; xy++)
+        {
+            int x = xy % w;
+            int v = xy / w;
+
+            memset(lineI, 0, p * sizeof(Complex));
+
+            for (int z = 0; z < n; z++)
+                lineI[PAD_WRAP(z - n / 2, p)] = t2[((size_t)z * h + v) * w + x];
+
+            TSFFTW_execute_dft(plan.c2c, (TSFFTW_COMPLEX*)lineI, (TSFFTW_COMPLEX*)lineO);
+
+            for (int u = 0; u < h; u++)
+                dst[dst.iFTHalf(x, v - m, u - m)] = lineO[PAD_WRAP(u - m, p)];
+        }
+
+        TSFFTW_free(lineR);
+        TSFFTW_free(lineI);
+        TSFFTW_free(lineO);
+    }
+
+    TSFFTW_free(t1);
+    TSFFTW_free(t2);
+}
@@ -155,3 +155,91 @@ void fscWeightingFilter(Volume& dst,
             dst.setFT(COMPLEX(0, 0), i, j, k);
     }
 }
+
+static RFLOAT filterWeight(const FilterStage& stage,
+                           const RFLOAT f,
+                           const int nCol)
+{
+    switch (stage.type)
+    {
+        case FILTER_LOW_PASS:
+            if (f < stage.thres)
+                return 1;
+            else if (f > stage.thres + stage.ew)
+                return 0;
+            else
+                return cos((f - stage.thres) * M_PI / stage.ew) / 2 + 0.5;
+
+        case FILTER_HIGH_PASS:
+            if (f > stage.thres)
+                return 1;
+            else if (f < stage.thres - stage.ew)
+                return 0;
+            else
+                return cos((stage.thres - f) * M_PI / stage.ew) / 2 + 0.5;
+
+        case FILTER_B_FACTOR:
+            return exp(-0.5 * stage.bFactor * f * f);
+
+        case FILTER_FSC_WEIGHTING:
+        {
+            int idx = AROUND(f * nCol);
+
+            if (idx < stage.fsc.size())
+                return sqrt(TSGSL_MAX_RFLOAT(0, 2 * stage.fsc(idx) / (1 + stage.fsc(idx))));
+            else
+                return 0;
+        }
+    }
+
+    return 1;
+}
+
+void fusedFilter(Volume& dst,
+                 const Volume& src,
+                 const vector<FilterStage>& stage)
+{
+    #pragma omp parallel for schedule(dynamic)
+    VOLUME_FOR_EACH_PIXEL_FT(src)
+    {
+        RFLOAT f = NORM_3(RFLOAT(i) / src.nColRL(),
+                          RFLOAT(j) / src.nRowRL(),
+                          RFLOAT(k) / src.nSlcRL());
+
+        RFLOAT w = 1;
+
+        for (size_t l = 0; (l < stage.size()) && (w != 0); l++)
+            w *= filterWeight(stage[l], f, src.nColRL());
+
+        dst.setFT(src.getFT(i, j, k) * w, i, j, k);
+    }
+}
+
+void fusedFilter(SlabVolume& vol,
+                 const vector<FilterStage>& stage)
+{
+    #pragma omp parallel for schedule(dynamic)
+    for (int k = 0; k < vol.nSlcRL(); k++)
+    {
+        Complex* slc = vol.slcFT(k);
+
+        RFLOAT fk = RFLOAT(SLAB_FREQ(k, vol.nSlcRL())) / vol.nSlcRL();
+
+        for (int j = 0; j < vol.nRowRL(); j++)
+        {
+            RFLOAT fj = RFLOAT(SLAB_FREQ(j, vol.nRowRL())) / vol.nRowRL();
+
+            for (int i = 0; i < vol.nColFT(); i++)
+            {
+                RFLOAT f = NORM_3(RFLOAT(i) / vol.nColRL(), fj, fk);
+
+                RFLOAT w = 1;
+
+                for (size_t l = 0; (l < stage.size()) && (w != 0); l++)
+                    w *= filterWeight(stage[l], f, vol.nColRL());
+
+                slc[j * vol.nColFT() + i] = slc[j * vol.nColFT() + i] * w;
+            }
+        }
+    }
+}
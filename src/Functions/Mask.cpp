@@ -506,6 +506,64 @@ void softMask(Volume& dst,
     ***/
 }
 
+void softMask(SlabVolume& vol,
+              const RFLOAT r,
+              const RFLOAT ew,
+              const RFLOAT bg)
+{
+    #pragma omp parallel for schedule(dynamic)
+    for (int k = 0; k < vol.nSlcRL(); k++)
+    {
+        float* slc = vol.slcRL(k);
+
+        for (int j = 0; j < vol.nRowRL(); j++)
+            for (int i = 0; i < vol.nColRL(); i++)
+            {
+                // the centre of the file is the origin
+
+                RFLOAT u = NORM_3(i - vol.nColRL() / 2,
+                                  j - vol.nRowRL() / 2,
+                                  k - vol.nSlcRL() / 2);
+
+                float& v = slc[j * vol.nColRL() + i];
+
+                if (u > r + ew)
+                    v = bg;
+                else if (u >= r)
+                {
+                    RFLOAT w = 0.5 - 0.5 * cos((u - r) / ew * M_PI); // portion of background
+                    v = bg * w + v * (1 - w);
+                }
+            }
+    }
+}
+
+void softMask(SlabVolume& vol,
+              const SlabVolume& alpha,
+              const RFLOAT bg)
+{
+    if ((alpha.nColRL() != vol.nColRL()) ||
+        (alpha.nRowRL() != vol.nRowRL()) ||
+        (alpha.nSlcRL() != vol.nSlcRL()))
+    {
+        REPORT_ERROR("MASK OF A DIFFERENT SIZE");
+        abort();
+    }
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int k = 0; k < vol.nSlcRL(); k++)
+    {
+        float* slc = vol.slcRL(k);
+        const float* a = alpha.slcRL(k);
+
+        for (size_t i = 0; i < vol.slcSizeRL(); i++)
+        {
+            RFLOAT w = 1 - a[i]; // portion of background
+            slc[i] = bg * w + slc[i] * (1 - w);
+        }
+    }
+}
+
 void regionBgSoftMask(Image& dst,
                       const Image& src,
                       const RFLOAT r,
@@ -213,6 +213,56 @@ void powerSpectrum(vec& dst,
         dst(i) /= counter(i);
 }
 
+void powerSpectrum(vec& dst,
+                   const SlabVolume& src,
+                   const int r)
+{
+    dvec sum = dvec::Zero(r);
+    dvec counter = dvec::Zero(r);
+
+    #pragma omp parallel
+    {
+        dvec s = dvec::Zero(r);
+        dvec c = dvec::Zero(r);
+
+        #pragma omp for schedule(dynamic)
+        for (int k = 0; k < src.nSlcRL(); k++)
+        {
+            const Complex* slc = src.slcFT(k);
+
+            int fk = SLAB_FREQ(k, src.nSlcRL());
+
+            for (int j = 0; j < src.nRowRL(); j++)
+            {
+                int fj = SLAB_FREQ(j, src.nRowRL());
+
+                for (int i = 0; i < src.nColFT(); i++)
+                    if (QUAD_3(i, fj, fk) < TSGSL_pow_2(r))
+                    {
+                        int u = AROUND(NORM_3(i, fj, fk));
+
+                        if (u < r)
+                        {
+                            s(u) += ABS2(slc[j * src.nColFT() + i]);
+                            c(u) += 1;
+                        }
+                    }
+            }
+        }
+
+        #pragma omp critical (powerSpectrum)
+        {
+            sum += s;
+            counter += c;
+        }
+    }
+
+    dst.setZero();
+
+    for (int i = 0; i < r; i++)
+        dst(i) = sum(i) / counter(i);
+}
+
 void FRC(vec& dst,
          const Image& A,
          const Image& B)
@@ -321,6 +371,69 @@ void FSC(vec& dst,
     }
 }
 
+void FSC(vec& dst,
+         const SlabVolume& A,
+         const SlabVolume& B)
+{
+    int n = dst.size();
+
+    dvec vecS = dvec::Zero(n);
+    dvec vecA = dvec::Zero(n);
+    dvec vecB = dvec::Zero(n);
+
+    #pragma omp parallel
+    {
+        dvec s = dvec::Zero(n);
+        dvec a = dvec::Zero(n);
+        dvec b = dvec::Zero(n);
+
+        #pragma omp for schedule(dynamic)
+        for (int k = 0; k < A.nSlcRL(); k++)
+        {
+            const Complex* slcA = A.slcFT(k);
+            const Complex* slcB = B.slcFT(k);
+
+            int fk = SLAB_FREQ(k, A.nSlcRL());
+
+            for (int j = 0; j < A.nRowRL(); j++)
+            {
+                int fj = SLAB_FREQ(j, A.nRowRL());
+
+                for (int i = 0; i < A.nColFT(); i++)
+                {
+                    int u = AROUND(NORM_3(i, fj, fk));
+
+                    if (u < n)
+                    {
+                        const Complex& x = slcA[j * A.nColFT() + i];
+                        const Complex& y = slcB[j * A.nColFT() + i];
+
+                        s(u) += REAL(x * CONJUGATE(y));
+                        a(u) += ABS2(x);
+                        b(u) += ABS2(y);
+                    }
+                }
+            }
+        }
+
+        #pragma omp critical (FSC)
+        {
+            vecS += s;
+            vecA += a;
+            vecB += b;
+        }
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        double AB = sqrt(vecA(i) * vecB(i));
+        if (AB == 0)
+            dst(i) = 0;
+        else
+            dst(i) = vecS(i) / AB;
+    }
+}
+
 int resP(const vec& fsc,
          const RFLOAT thres,
          const int pf,
@@ -369,6 +482,43 @@ void randomPhase(Volume& dst,
     }
 }
 
+void randomPhase(SlabVolume& dst,
+                 const SlabVolume& src,
+                 const int r)
+{
+    #pragma omp parallel
+    {
+        gsl_rng* engine = get_random_engine();
+
+        #pragma omp for schedule(dynamic)
+        for (int k = 0; k < src.nSlcRL(); k++)
+        {
+            Complex* slcDst = dst.slcFT(k);
+            const Complex* slcSrc = src.slcFT(k);
+
+            int fk = SLAB_FREQ(k, src.nSlcRL());
+
+            for (int j = 0; j < src.nRowRL(); j++)
+            {
+                int fj = SLAB_FREQ(j, src.nRowRL());
+
+                for (int i = 0; i < src.nColFT(); i++)
+                {
+                    size_t idx = j * src.nColFT() + i;
+
+                    int u = AROUND(NORM_3(i, fj, fk));
+
+                    if (u > r)
+                        slcDst[idx] = slcSrc[idx]
+                                    * COMPLEX_POLAR(TSGSL_ran_flat(engine, 0, 2 * M_PI));
+                    else
+                        slcDst[idx] = slcSrc[idx];
+                }
+            }
+        }
+    }
+}
+
 void sharpen(Volume& dst,
              const Volume& src,
              const RFLOAT thres,
@@ -433,3 +583,73 @@ void bFactorEst(RFLOAT& bFactor,
 
     bFactor = 2 * c1;
 }
+
+void bFactorEst(RFLOAT& bFactor,
+                const SlabVolume& vol,
+                const int rU,
+                const int rL)
+{
+    dvec sum = dvec::Zero(rU - rL);
+    dvec counter = dvec::Zero(rU - rL);
+
+    #pragma omp parallel
+    {
+        dvec s = dvec::Zero(rU - rL);
+        dvec c = dvec::Zero(rU - rL);
+
+        #pragma omp for schedule(dynamic)
+        for (int k = 0; k < vol.nSlcRL(); k++)
+        {
+            const Complex* slc = vol.slcFT(k);
+
+            int fk = SLAB_FREQ(k, vol.nSlcRL());
+
+            for (int j = 0; j < vol.nRowRL(); j++)
+            {
+                int fj = SLAB_FREQ(j, vol.nRowRL());
+
+                for (int i = 0; i < vol.nColFT(); i++)
+                {
+                    int u = AROUND(NORM_3(i, fj, fk));
+
+                    if ((u < rU) && (u >= rL))
+                    {
+                        s(u - rL) += ABS(slc[j * vol.nColFT() + i]);
+                        c(u - rL) += 1;
+                    }
+                }
+            }
+        }
+
+        #pragma omp critical (bFactorEst)
+        {
+            sum += s;
+            counter += c;
+        }
+    }
+
+    vec I(rU - rL);
+    vec C(rU - rL);
+
+    for (int i = 0; i < rU - rL; i++)
+    {
+        I[i] = log(sum(i) / counter(i));
+        C[i] = TSGSL_pow_2((RFLOAT)(i + rL) / vol.nColRL());
+    }
+
+    RFLOAT c0, c1, cov00, cov01, cov11, sumsq;
+
+    TSGSL_fit_linear(C.data(),
+                   1,
+                   I.data(),
+                   1,
+                   rU - rL, 
+                   &c0,
+                   &c1,
+                   &cov00,
+                   &cov01,
+                   &cov11,
+                   &sumsq);
+
+    bFactor = 2 * c1;
+}
@@ -30,6 +30,39 @@ double pdfACG(const dvec4& x,
     return pdfACG(x, sig);
 }
 
+/**
+ * This function fills dst with n standard Gaussian numbers by the ziggurat
+ * method, which takes no transcendental function in the common case.
+ */
+static void gaussian(double* dst,
+                     const size_t n,
+                     gsl_rng* engine)
+{
+    for (size_t i = 0; i < n; i++)
+        dst[i] = gsl_ran_gaussian_ziggurat(engine, 1);
+}
+
+/**
+ * This function samples n quaternions, dst.row(i) = L * g_i / |L * g_i|, where
+ * g_i is a standard Gaussian 4-vector. The samples are kept column by column,
+ * thus transformed and normalised all at once.
+ */
+static void sampleACGL(dmat4& dst,
+                       const dmat44& L,
+                       const int n)
+{
+    dmat4 g(n, 4);
+
+    gaussian(g.data(), 4 * (size_t)n, get_random_engine());
+
+    dst.topRows(n).noalias() = g * L.transpose();
+
+    dvec norm = dst.topRows(n).rowwise().norm();
+
+    for (int j = 0; j < 4; j++)
+        dst.col(j).head(n).array() /= norm.array();
+}
+
 void sampleACG(dmat4& dst,
                const dmat44& src,
                const int n)
@@ -39,20 +72,36 @@ void sampleACG(dmat4& dst,
     LLT<dmat44> llt(src);
     dmat44 L = llt.matrixL();
 
-    gsl_rng* engine = get_random_engine();
+    sampleACGL(dst, L, n);
+}
 
-    for (int i = 0; i < n; i++)
-    {
-        // sample from a standard Gaussian distribution
-        dvec4 v;
-        for (int j = 0; j < 4; j++)
-            v(j) = gsl_ran_gaussian(engine, 1);
+void perturbACG(dmat4& dst,
+                const dmat44& src,
+                const dvec4& mean)
+{
+    LLT<dmat44> llt(src);
+    dmat44 L = llt.matrixL();
+
+    // mean * d * mean^-1 is linear in d, and it keeps the norm, thus it is
+    // merged into L before normalising
+
+    dmat44 rot;
 
-        v = L * v;
-        v /= v.norm();
+    dvec4 quat;
 
-        dst.row(i) = v.transpose();
+    for (int i = 0; i < 4; i++)
+    {
+        quaternion_mul(quat, mean, dvec4::Unit(i));
+        quaternion_mul(quat, quat, quaternion_conj(mean));
+
+        rot.col(i) = quat;
     }
+
+    dmat4 d(dst.rows(), 4);
+
+    sampleACGL(d, rot * L, dst.rows());
+
+    quaternion_mul(dst, d, dst);
 }
 
 void sampleACG(dmat4& dst,
@@ -84,44 +133,90 @@ void sampleACG(dmat4& dst,
     sampleACG(dst, src, n);
 }
 
+/**
+ * This function performs one step of the fixed-point iteration of inferring the
+ * parameter matrix of ACG. A is factorised once, and the quadratic forms of all
+ * the samples are evaluated column by column, thus vectorised over samples. It
+ * returns false when A is not positive definite.
+ *
+ * @param dst the parameter matrix after this step
+ * @param y   scratch of the size of src
+ * @param w   scratch of the number of samples
+ * @param A   the parameter matrix before this step
+ * @param src the data
+ */
+static bool stepACG(dmat44& dst,
+                    dmat4& y,
+                    dvec& w,
+                    const dmat44& A,
+                    const dmat4& src)
+{
+    LLT<dmat44> llt(A);
+
+    if (llt.info() != Success) return false;
+
+    // w(i) = 1 / (x_i^T * A^-1 * x_i) = 1 / |L^-1 * x_i|^2
+
+    dmat44 inv = llt.matrixL().solve(dmat44::Identity());
+
+    y.noalias() = src * inv.transpose();
+
+    w = y.rowwise().squaredNorm().cwiseInverse();
+
+    y = src.array().colwise() * w.array();
+
+    dst.noalias() = src.transpose() * y;
+
+    dst *= 4.0 / w.sum();
+
+    return true;
+}
+
+static double distACG(const dmat44& A,
+                      const dmat44& B)
+{
+    return (abs((A - B).array())).sum();
+}
+
 void inferACG(dmat44& dst,
               const dmat4& src)
 {
-    dmat44 A;
-    dmat44 B = dmat44::Identity();
+    inferACG(dst, src, dmat44::Identity());
+}
 
-    do
-    {
-        A = B;
+void inferACG(dmat44& dst,
+              const dmat4& src,
+              const dmat44& init)
+{
+    dmat4 y(src.rows(), 4);
+    dvec w(src.rows());
 
-        B = dmat44::Zero();
-        double nf = 0;
+    dmat44 A, B;
 
-        for (int i = 0; i < src.rows(); i++)
-        {
-            // get the tensor product of the i-th quaternion and itself
-            dmat44 tensor;
-            for (int j = 0; j < 4; j++)
-                for (int k = 0; k < 4; k++)
-                    tensor(j, k) = src(i, j) * src(i, k);
+    if (!stepACG(A, y, w, init, src))
+        stepACG(A, y, w, dmat44::Identity(), src);
 
-            // get the factor
-            double u = src.row(i) * A.inverse() * src.row(i).transpose();
+    // a NaN stops the iteration as well, and is caught below
 
-            B += tensor / u;
+    int iter = 0;
 
-            nf += 1.0 / u;
-        }
+    while (stepACG(B, y, w, A, src))
+    {
+        bool converged = !(distACG(A, B) > ACG_INFER_THRES);
 
-        B *= 4.0 / nf;
+        A = B;
 
-        /***
-        // make it self-adjoint
-        for (int i = 1; i < 4; i++)
-            for (int j = 0; j < i; j++)
-                B(i, j) = B(j, i);
-        ***/
-    } while ((abs((A - B).array())).sum() > 1e-3);
+        if (converged) break;
+
+        if (++iter == ACG_INFER_MAX_ITER)
+        {
+            CLOG(WARNING, "LOGGER_SYS") << "INFERENCE OF ACG NOT CONVERGED AFTER "
+                                        << ACG_INFER_MAX_ITER
+                                        << " ITERATIONS";
+
+            break;
+        }
+    }
 
     dst = A;
 
@@ -179,9 +274,18 @@ void inferACG(double& k1,
               double& k2,
               double& k3,
               const dmat4& src)
+{
+    inferACG(k1, k2, k3, src, dmat44::Identity());
+}
+
+void inferACG(double& k1,
+              double& k2,
+              double& k3,
+              const dmat4& src,
+              const dmat44& init)
 {
     dmat44 A;
-    inferACG(A, src);
+    inferACG(A, src, init);
 
     k1 = A(1, 1) / A(0, 0);
     k2 = A(2, 2) / A(0, 0);
@@ -217,9 +321,16 @@ void inferACG(double& k1,
 
 void inferACG(dvec4& mean,
               const dmat4& src)
+{
+    inferACG(mean, src, dmat44::Identity());
+}
+
+void inferACG(dvec4& mean,
+              const dmat4& src,
+              const dmat44& init)
 {
     dmat44 A;
-    inferACG(A, src);
+    inferACG(A, src, init);
 
     SelfAdjointEigenSolver<dmat44> eigenSolver(A);
 
@@ -325,6 +436,16 @@ void sampleVMS(dmat4& dst,
     dst.leftCols<2>() = dst2D;
 }
 
+void perturbVMS(dmat4& dst,
+                const double k)
+{
+    dmat4 d(dst.rows(), 4);
+
+    sampleVMS(d, dvec4(1, 0, 0, 0), k, dst.rows());
+
+    quaternion_mul(dst, dst, d);
+}
+
 void inferVMS(dvec2& mu,
               double& k,
               const dmat2& src)
@@ -25,6 +25,38 @@ void quaternion_mul(dvec4& dst,
     dst[3] = z;
 }
 
+void quaternion_mul(dmat4& dst,
+                    const dmat4& a,
+                    const dmat4& b)
+{
+    dvec w = a.col(0).array() * b.col(0).array()
+           - a.col(1).array() * b.col(1).array()
+           - a.col(2).array() * b.col(2).array()
+           - a.col(3).array() * b.col(3).array();
+
+    dvec x = a.col(0).array() * b.col(1).array()
+           + a.col(1).array() * b.col(0).array()
+           + a.col(2).array() * b.col(3).array()
+           - a.col(3).array() * b.col(2).array();
+
+    dvec y = a.col(0).array() * b.col(2).array()
+           - a.col(1).array() * b.col(3).array()
+           + a.col(2).array() * b.col(0).array()
+           + a.col(3).array() * b.col(1).array();
+
+    dvec z = a.col(0).array() * b.col(3).array()
+           + a.col(1).array() * b.col(2).array()
+           - a.col(2).array() * b.col(1).array()
+           + a.col(3).array() * b.col(0).array();
+
+    dst.resize(a.rows(), 4);
+
+    dst.col(0) = w;
+    dst.col(1) = x;
+    dst.col(2) = y;
+    dst.col(3) = z;
+}
+
 dvec4 quaternion_conj(const dvec4& quat)
 {
     dvec4 conj;
@@ -306,32 +306,117 @@ bool asymmetry(const Symmetry& sym)
         return false;
 }
 
+void symmetryOrbit(dmat4& dst,
+                   const Symmetry& sym,
+                   const dvec4* anchor)
+{
+    int n = sym.nSymmetryElement();
+
+    dst.resize(n, 4);
+
+    dvec4 p;
+
+    for (int i = 0; i < n; i++)
+    {
+        if (anchor == NULL)
+            p = sym.quat(i);
+        else
+            quaternion_mul(p, sym.quat(i), *anchor);
+
+        dst.row(i) = p.transpose();
+    }
+}
+
 void symmetryCounterpart(dvec4& dst,
                          const Symmetry& sym,
                          const dvec4* anchor)
 {
-    if (anchor == NULL) anchor = &ANCHOR_POINT_2;
+    const dvec4& a = (anchor == NULL) ? ANCHOR_POINT_2 : *anchor;
 
-    dvec4 q = dst;
+    // |<quat(i)^-1 * dst, anchor>| = |<dst, quat(i) * anchor>|, thus only the
+    // winner takes a quaternion product
 
-    RFLOAT s = fabs(dst.dot(*anchor));
+    RFLOAT s = fabs(dst.dot(a));
+
+    int best = -1;
 
     dvec4 p;
 
     for (int i = 0; i < sym.nSymmetryElement(); i++)
     {
-        quaternion_mul(p, quaternion_conj(sym.quat(i)), dst);
+        if (anchor == NULL)
+            p = sym.quat(i);
+        else
+            quaternion_mul(p, sym.quat(i), a);
 
-        RFLOAT t = fabs(p.dot(*anchor));
+        RFLOAT t = fabs(dst.dot(p));
 
         if (t > s)
         {
             s = t;
-            q = p;
+            best = i;
         }
     }
 
-    dst = q;
+    if (best != -1)
+        quaternion_mul(dst, quaternion_conj(sym.quat(best)), dst);
+}
+
+void symmetryCounterpart(dmat4& dst,
+                         const Symmetry& sym,
+                         const dvec4* anchor)
+{
+    dmat4 orbit;
+
+    symmetryOrbit(orbit, sym, anchor);
+
+    int n = dst.rows();
+
+    dvec s = (dst * ((anchor == NULL) ? ANCHOR_POINT_2 : *anchor)).cwiseAbs();
+
+    // running maximum over the symmetry elements, the inner loop runs down the
+    // columns of dst, thus contiguous and free of branches
+
+    const double* w = &dst(0, 0);
+    const double* x = &dst(0, 1);
+    const double* y = &dst(0, 2);
+    const double* z = &dst(0, 3);
+
+    vector<int> best(n, -1);
+
+    for (int i = 0; i < orbit.rows(); i++)
+    {
+        double o0 = orbit(i, 0);
+        double o1 = orbit(i, 1);
+        double o2 = orbit(i, 2);
+        double o3 = orbit(i, 3);
+
+        for (int j = 0; j < n; j++)
+        {
+            double t = fabs(w[j] * o0 + x[j] * o1 + y[j] * o2 + z[j] * o3);
+
+            bool b = t > s(j);
+
+            s(j) = b ? t : s(j);
+            best[j] = b ? i : best[j];
+        }
+    }
+
+    // the conjugate of the winning symmetry element of each row, identity if
+    // the row is already the nearest
+
+    dmat4 conj(n, 4);
+
+    dvec4 q;
+
+    for (int j = 0; j < n; j++)
+    {
+        q = (best[j] == -1) ? dvec4(1, 0, 0, 0) : quaternion_conj(sym.quat(best[j]));
+
+        conj.row(j) = q.transpose();
+    }
+
+    quaternion_mul(dst, conj, dst);
 }
 
 void symmetryRotation(vector<dmat33>& sr,
@@ -346,6 +431,8 @@ void symmetryRotation(vector<dmat33>& sr,
 
     if (asymmetry(*sym)) return;
 
+    sr.reserve(1 + sym->nSymmetryElement());
+
     dmat33 L, R;
 
     for (int i = 0; i < sym->nSymmetryElement(); i++)
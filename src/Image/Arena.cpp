@@ -0,0 +1,375 @@
+/*******************************************************************************
+ * Author:
+ * Dependency:
+ * Test:
+ * Execution:
+ * Description:
+ *
+ * Manual:
+ * ****************************************************************************/
+
+#include "Arena.h"
+
+#include "Logging.h"
+
+#define ARENA_MAGIC 0x5448554e41524e41UL
+
+/**
+ * the size class of a directly allocated (not pooled) block
+ */
+#define ARENA_DIRECT -1
+
+/**
+ * Every block starts with a header of one alignment unit, which records the
+ * size class of the block, so that arenaFree() needs no size from the caller.
+ */
+struct ArenaHeader
+{
+    size_t magic;
+
+    size_t size;
+
+    int sizeClass;
+};
+
+/**
+ * The cache of a thread. Only the owning thread touches it in arenaMalloc() and
+ * arenaFree(), the lock is taken there uncontended and only guards against
+ * arenaReset() and arenaResetStat() from another thread, e.g. the main thread
+ * ending an ArenaScope while a background writer still frees its volumes.
+ * Aligned to ARENA_ALIGNMENT, thus the caches of two threads never share a
+ * cache line.
+ */
+struct ArenaCache
+{
+    volatile int lock;
+
+    void* freeList[ARENA_N_SIZE_CLASS];
+
+    size_t nCached[ARENA_N_SIZE_CLASS];
+
+    size_t bytesCached;
+
+    size_t hit;
+
+    size_t miss;
+
+    /**
+     * bytes allocated minus bytes freed by this thread, negative when it frees
+     * more blocks of other threads than it allocates
+     */
+    long inUse;
+
+    /**
+     * peak of inUse since the last arenaResetStat()
+     */
+    long peak;
+
+    ArenaCache* next;
+} __attribute__((aligned(ARENA_ALIGNMENT)));
+
+static __thread ArenaCache* _arenaCache = NULL;
+
+static ArenaCache* _arenaRegistry = NULL;
+
+/**
+ * the counters of the caches released by arenaRelease(), kept so that the
+ * statistics still balance the blocks they allocated or freed
+ */
+static ArenaCache _arenaRetired;
+
+static inline size_t arenaClassSize(const int sizeClass)
+{
+    if (sizeClass == 0) return ARENA_MIN_BLOCK;
+
+    int e = ARENA_MIN_BLOCK_LOG2 + (sizeClass - 1) / ARENA_N_CLASS_PER_OCTAVE;
+    int q = 1 + (sizeClass - 1) % ARENA_N_CLASS_PER_OCTAVE;
+
+    return (1UL << e) + q * ((1UL << e) / ARENA_N_CLASS_PER_OCTAVE);
+}
+
+static inline int arenaSizeClass(const size_t size)
+{
+    if (size <= ARENA_MIN_BLOCK) return 0;
+
+    if (size > (1UL << ARENA_MAX_BLOCK_LOG2)) return ARENA_DIRECT;
+
+    // 2^e < size <= 2^(e + 1)
+
+    int e = 63 - __builtin_clzl(size - 1);
+
+    size_t step = (1UL << e) / ARENA_N_CLASS_PER_OCTAVE;
+
+    int q = (size - (1UL << e) + step - 1) / step;
+
+    return 1 + (e - ARENA_MIN_BLOCK_LOG2) * ARENA_N_CLASS_PER_OCTAVE + (q - 1);
+}
+
+static ArenaCache* arenaCache()
+{
+    if (_arenaCache != NULL) return _arenaCache;
+
+    ArenaCache* cache = NULL;
+
+    if (posix_memalign((void**)&cache, ARENA_ALIGNMENT, sizeof(ArenaCache)) != 0)
+    {
+        REPORT_ERROR("FAIL TO ALLOCATE SPACE");
+
+        abort();
+    }
+
+    memset(cache, 0, sizeof(ArenaCache));
+
+    // only taken once per thread
+
+    #pragma omp critical (arenaRegistry)
+    {
+        cache->next = _arenaRegistry;
+        _arenaRegistry = cache;
+    }
+
+    _arenaCache = cache;
+
+    return cache;
+}
+
+static inline void arenaLock(ArenaCache* cache)
+{
+    while (__sync_lock_test_and_set(&cache->lock, 1))
+        while (cache->lock);
+}
+
+static inline void arenaUnlock(ArenaCache* cache)
+{
+    __sync_lock_release(&cache->lock);
+}
+
+static inline void* arenaSystemMalloc(const size_t size)
+{
+    void* block = NULL;
+
+    if (posix_memalign(&block, ARENA_ALIGNMENT, ARENA_ALIGNMENT + size) != 0)
+        return NULL;
+
+    return block;
+}
+
+void* arenaMalloc(const size_t size)
+{
+    int sizeClass = arenaSizeClass(size);
+
+    size_t blockSize = (sizeClass == ARENA_DIRECT) ? size : arenaClassSize(sizeClass);
+
+    ArenaCache* cache = arenaCache();
+
+    ArenaHeader* header = NULL;
+
+    arenaLock(cache);
+
+    if ((sizeClass != ARENA_DIRECT) && (cache->freeList[sizeClass] != NULL))
+    {
+        void* ptr = cache->freeList[sizeClass];
+
+        cache->freeList[sizeClass] = *(void**)ptr;
+        cache->nCached[sizeClass] -= 1;
+        cache->bytesCached -= blockSize;
+
+        cache->hit += 1;
+
+        header = (ArenaHeader*)((char*)ptr - ARENA_ALIGNMENT);
+    }
+    else
+    {
+        header = (ArenaHeader*)arenaSystemMalloc(blockSize);
+
+        if (header == NULL)
+        {
+            arenaUnlock(cache);
+
+            return NULL;
+        }
+
+        header->magic = ARENA_MAGIC;
+        header->size = blockSize;
+        header->sizeClass = sizeClass;
+
+        cache->miss += 1;
+    }
+
+    cache->inUse += blockSize;
+
+    if (cache->inUse > cache->peak) cache->peak = cache->inUse;
+
+    arenaUnlock(cache);
+
+    return (char*)header + ARENA_ALIGNMENT;
+}
+
+void arenaFree(void* ptr)
+{
+    if (ptr == NULL) return;
+
+    ArenaHeader* header = (ArenaHeader*)((char*)ptr - ARENA_ALIGNMENT);
+
+    if (header->magic != ARENA_MAGIC)
+    {
+        REPORT_ERROR("FREEING A BUFFER WHICH IS NOT FROM THE ARENA");
+
+        abort();
+    }
+
+    ArenaCache* cache = arenaCache();
+
+    arenaLock(cache);
+
+    cache->inUse -= header->size;
+
+    if ((header->sizeClass == ARENA_DIRECT) ||
+        (cache->bytesCached + header->size > ARENA_MAX_CACHED_BYTES_PER_THREAD))
+    {
+        arenaUnlock(cache);
+
+        free(header);
+
+        return;
+    }
+
+    *(void**)ptr = cache->freeList[header->sizeClass];
+
+    cache->freeList[header->sizeClass] = ptr;
+    cache->nCached[header->sizeClass] += 1;
+    cache->bytesCached += header->size;
+
+    arenaUnlock(cache);
+}
+
+/**
+ * This function empties the free lists of a cache, with its lock taken.
+ */
+static void arenaDrain(ArenaCache* cache)
+{
+    for (int i = 0; i < ARENA_N_SIZE_CLASS; i++)
+    {
+        void* ptr = cache->freeList[i];
+
+        while (ptr != NULL)
+        {
+            void* next = *(void**)ptr;
+
+            free((char*)ptr - ARENA_ALIGNMENT);
+
+            ptr = next;
+        }
+
+        cache->freeList[i] = NULL;
+        cache->nCached[i] = 0;
+    }
+
+    cache->bytesCached = 0;
+}
+
+void arenaReset()
+{
+    #pragma omp critical (arenaRegistry)
+    for (ArenaCache* cache = _arenaRegistry; cache != NULL; cache = cache->next)
+    {
+        arenaLock(cache);
+
+        arenaDrain(cache);
+
+        arenaUnlock(cache);
+    }
+}
+
+void arenaRelease()
+{
+    ArenaCache* cache = _arenaCache;
+
+    if (cache == NULL) return;
+
+    #pragma omp critical (arenaRegistry)
+    {
+        ArenaCache** p = &_arenaRegistry;
+
+        while (*p != cache) p = &(*p)->next;
+
+        *p = cache->next;
+
+        _arenaRetired.hit += cache->hit;
+        _arenaRetired.miss += cache->miss;
+        _arenaRetired.inUse += cache->inUse;
+        _arenaRetired.peak += cache->peak;
+    }
+
+    // no other thread reaches the cache once it is out of the registry
+
+    arenaDrain(cache);
+
+    free(cache);
+
+    _arenaCache = NULL;
+}
+
+void arenaStat(ArenaStat& dst)
+{
+    dst = ArenaStat();
+
+    long inUse = 0;
+    long peak = 0;
+
+    // the threads reach their peaks at different moments, the sum of them is
+    // an upper bound of the peak of the process
+
+    #pragma omp critical (arenaRegistry)
+    {
+        dst.hit = _arenaRetired.hit;
+        dst.miss = _arenaRetired.miss;
+
+        inUse = _arenaRetired.inUse;
+        peak = _arenaRetired.peak;
+
+        for (ArenaCache* cache = _arenaRegistry; cache != NULL; cache = cache->next)
+        {
+            dst.hit += cache->hit;
+            dst.miss += cache->miss;
+            dst.bytesCached += cache->bytesCached;
+
+            inUse += cache->inUse;
+            peak += cache->peak;
+        }
+    }
+
+    dst.bytesInUse = (inUse > 0) ? inUse : 0;
+    dst.peakBytesBound = (peak > 0) ? peak : 0;
+}
+
+void arenaResetStat()
+{
+    #pragma omp critical (arenaRegistry)
+    {
+        _arenaRetired.hit = 0;
+        _arenaRetired.miss = 0;
+        _arenaRetired.peak = _arenaRetired.inUse;
+
+        for (ArenaCache* cache = _arenaRegistry; cache != NULL; cache = cache->next)
+        {
+            arenaLock(cache);
+
+            cache->hit = 0;
+            cache->miss = 0;
+            cache->peak = cache->inUse;
+
+            arenaUnlock(cache);
+        }
+    }
+}
+
+ArenaScope::ArenaScope()
+{
+    arenaResetStat();
+}
+
+ArenaScope::~ArenaScope()
+{
+    arenaReset();
+}
@@ -67,36 +67,30 @@ void Image::alloc(const int nCol,
     {
         clearRL();
 
-        _sizeRL = nCol * nRow;
-        _sizeFT = (nCol / 2 + 1) * nRow;
+        _sizeRL = (size_t)nCol * nRow;
+        _sizeFT = (size_t)(nCol / 2 + 1) * nRow;
 
 #ifdef CXX11_PTR
         _dataRL.reset(new RFLOAT[_sizeRL]);
 #endif
 
 #ifdef FFTW_PTR
-#ifdef FFTW_PTR_THREAD_SAFETY
-        #pragma omp critical  (line81)
-#endif
-        _dataRL = (RFLOAT*)TSFFTW_malloc(_sizeRL * sizeof(RFLOAT));
+        _dataRL = (RFLOAT*)IMAGE_BASE_MALLOC(_sizeRL * sizeof(RFLOAT));
 #endif
     }
     else if (space == FT_SPACE)
     {
         clearFT();
 
-        _sizeRL = nCol * nRow;
-        _sizeFT = (nCol / 2 + 1) * nRow;
+        _sizeRL = (size_t)nCol * nRow;
+        _sizeFT = (size_t)(nCol / 2 + 1) * nRow;
 
 #ifdef CXX11_PTR
         _dataFT.reset(new Complex[_sizeFT]);
 #endif
 
 #ifdef FFTW_PTR
-#ifdef FFTW_PTR_THREAD_SAFETY
-        #pragma omp critical  (line99)
-#endif
-        _dataFT = (Complex*)TSFFTW_malloc(_sizeFT * sizeof(Complex));
+        _dataFT = (Complex*)IMAGE_BASE_MALLOC(_sizeFT * sizeof(Complex));
 #endif
     }
 
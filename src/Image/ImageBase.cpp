@@ -10,7 +10,7 @@
 
 #include "ImageBase.h"
 
-ImageBase::ImageBase() : _sizeRL(0), _sizeFT(0)
+ImageBase::ImageBase() : _sizeRL(0), _sizeFT(0), _attachedFT(false)
 {
 #ifdef FFTW_PTR
     _dataRL = NULL;
@@ -39,19 +39,13 @@ ImageBase::~ImageBase()
 #ifdef FFTW_PTR
     if (_dataRL != NULL)
     {
-#ifdef FFTW_PTR_THREAD_SAFETY
-        #pragma omp critical  (line45)
-#endif
-        TSFFTW_free(_dataRL);
+        IMAGE_BASE_FREE(_dataRL);
         _dataRL = NULL;
     }
 
-    if (_dataFT != NULL)
+    if ((_dataFT != NULL) && !_attachedFT)
     {
-#ifdef FFTW_PTR_THREAD_SAFETY
-        #pragma omp critical  (line54)
-#endif
-        TSFFTW_free(_dataFT);
+        IMAGE_BASE_FREE(_dataFT);
         _dataFT = NULL;
     }
 #endif
@@ -71,6 +65,8 @@ void ImageBase::swap(ImageBase& that)
 
     std::swap(_sizeRL, that._sizeRL);
     std::swap(_sizeFT, that._sizeFT);
+
+    std::swap(_attachedFT, that._attachedFT);
 }
 
 bool ImageBase::isEmptyRL() const
@@ -87,6 +83,8 @@ size_t ImageBase::sizeRL() const { return _sizeRL; }
 
 size_t ImageBase::sizeFT() const { return _sizeFT; }
 
+bool ImageBase::isAttachedFT() const { return _attachedFT; }
+
 void ImageBase::clear()
 {
     clearRL();
@@ -102,10 +100,7 @@ void ImageBase::clearRL()
 #ifdef FFTW_PTR
     if (_dataRL != NULL)
     {
-#ifdef FFTW_PTR_THREAD_SAFETY
-        #pragma omp critical (line108)
-#endif
-        TSFFTW_free(_dataRL);
+        IMAGE_BASE_FREE(_dataRL);
 
         _dataRL = NULL;
     }
@@ -121,14 +116,16 @@ void ImageBase::clearFT()
 #ifdef FFTW_PTR
     if (_dataFT != NULL)
     {
-#ifdef FFTW_PTR_THREAD_SAFETY
-        #pragma omp critical (line127)
-#endif
-        TSFFTW_free(_dataFT);
+        if (!_attachedFT)
+        {
+            IMAGE_BASE_FREE(_dataFT);
+        }
 
         _dataFT = NULL;
     }
 #endif
+
+    _attachedFT = false;
 }
 
 void ImageBase::copyBase(ImageBase& other) const
@@ -144,10 +141,7 @@ void ImageBase::copyBase(ImageBase& other) const
 #endif
 
 #ifdef FFTW_PTR
-#ifdef FFTW_PTR_THREAD_SAFETY
-        #pragma omp critical  (line150)
-#endif
-        other._dataRL = (RFLOAT*)TSFFTW_malloc(_sizeRL * sizeof(RFLOAT));
+        other._dataRL = (RFLOAT*)IMAGE_BASE_MALLOC(_sizeRL * sizeof(RFLOAT));
 
         memcpy(other._dataRL, _dataRL, _sizeRL * sizeof(RFLOAT));
 #endif
@@ -165,6 +159,8 @@ void ImageBase::copyBase(ImageBase& other) const
 
     other._sizeFT = _sizeFT;
 
+    other._attachedFT = false;
+
     if (_dataFT)
     {
 #ifdef CXX11_PTR
@@ -174,10 +170,7 @@ void ImageBase::copyBase(ImageBase& other) const
 #endif
 
 #ifdef FFTW_PTR
-#ifdef FFTW_PTR_THREAD_SAFETY
-        #pragma omp critical  (line180)
-#endif
-        other._dataFT = (Complex*)TSFFTW_malloc(_sizeFT * sizeof(Complex));
+        other._dataFT = (Complex*)IMAGE_BASE_MALLOC(_sizeFT * sizeof(Complex));
         memcpy(other._dataFT, _dataFT, _sizeFT * sizeof(Complex));
 #endif
     }
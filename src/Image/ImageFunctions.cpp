@@ -10,6 +10,8 @@
 
 #include "ImageFunctions.h"
 
+#include "Kernel.h"
+
 vec2 centroid(const Image& img)
 {
     vec2 c = vec2::Zero();
@@ -207,14 +209,7 @@ void translate(Complex* dst,
                const int* iRow,
                const int nPxl)
 {
-    RFLOAT rCol = nTransCol / nCol;
-    RFLOAT rRow = nTransRow / nRow;
-
-    for (int i = 0; i < nPxl; i++)
-    {
-        RFLOAT phase = M_2X_PI * (iCol[i] * rCol + iRow[i] * rRow);
-        dst[i] = COMPLEX_POLAR(-phase);
-    }
+    kernel().translate(dst, nTransCol, nTransRow, nCol, nRow, iCol, iRow, nPxl);
 }
 
 void translateMT(Complex* dst,
@@ -0,0 +1,459 @@
+/*******************************************************************************
+ * Author:
+ * Dependency:
+ * Test:
+ * Execution:
+ * Description:
+ *
+ * Manual:
+ * ****************************************************************************/
+
+#include "SlabVolume.h"
+
+SlabVolume::SlabVolume() : _nCol(0),
+                           _nRow(0),
+                           _nSlc(0),
+                           _nColFT(0),
+                           _fdRL(-1),
+                           _mapRL(NULL),
+                           _mapSizeRL(0),
+                           _dataRL(NULL),
+                           _fdFT(-1),
+                           _dataFT(NULL),
+                           _mapSizeFT(0),
+                           _bufferSize(SLAB_BUFFER_SIZE) {}
+
+SlabVolume::~SlabVolume()
+{
+    closeFT();
+    closeMRC();
+}
+
+/**
+ * This function converts the data of an MRC file of mode 0 or 1, i.e. of type
+ * T, into floats, slice by slice, from the descriptor src into dst past the
+ * header.
+ */
+template <typename T>
+static bool convertSlices(const int dst,
+                          const int src,
+                          const MRCHeader& header)
+{
+    size_t slcSize = (size_t)header.nx * header.ny;
+
+    std::vector<T> in(slcSize);
+    std::vector<float> out(slcSize);
+
+    for (int k = 0; k < header.nz; k++)
+    {
+        off_t offset = k * slcSize;
+
+        if (pread(src,
+                  &in[0],
+                  slcSize * sizeof(T),
+                  1024 + header.nsymbt + offset * sizeof(T)) != (ssize_t)(slcSize * sizeof(T)))
+            return false;
+
+        for (size_t i = 0; i < slcSize; i++)
+            out[i] = in[i];
+
+        if (pwrite(dst,
+                   &out[0],
+                   slcSize * sizeof(float),
+                   1024 + offset * sizeof(float)) != (ssize_t)(slcSize * sizeof(float)))
+            return false;
+    }
+
+    return true;
+}
+
+void SlabVolume::openMRC(const char file[],
+                         const bool write,
+                         const char scratch[])
+{
+    closeMRC();
+
+    _fdRL = open(file, write ? O_RDWR : O_RDONLY);
+
+    if (_fdRL == -1)
+    {
+        REPORT_ERROR("FAIL TO OPEN MRC FILE");
+        abort();
+    }
+
+    MRCHeader header;
+
+    if (pread(_fdRL, &header, 1024, 0) != 1024)
+    {
+        REPORT_ERROR("FAIL TO READ IN MRC HEADER FILE.");
+        abort();
+    }
+
+    if (header.mode != 2)
+    {
+        // other modes, as read by ImageFile, are converted into a scratch file
+        // of mode 2, which is mapped in place of the MRC file
+
+        if (write || ((header.mode != 0) && (header.mode != 1)))
+        {
+            REPORT_ERROR("ONLY MRC FILE OF MODE 2 CAN BE MAPPED");
+            abort();
+        }
+
+        char path[FILE_NAME_LENGTH];
+
+        snprintf(path, FILE_NAME_LENGTH, "%s/.thunder_slab_XXXXXX", scratch);
+
+        int fd = mkstemp(path);
+
+        if (fd == -1)
+        {
+            REPORT_ERROR("FAIL TO CREATE SCRATCH FILE");
+            abort();
+        }
+
+        unlink(path);
+
+        bool done = (header.mode == 0)
+                  ? convertSlices<char>(fd, _fdRL, header)
+                  : convertSlices<short>(fd, _fdRL, header);
+
+        header.mode = 2;
+        header.nsymbt = 0;
+
+        if (!done || (pwrite(fd, &header, 1024, 0) != 1024))
+        {
+            REPORT_ERROR("FAIL TO CONVERT MRC FILE INTO MODE 2");
+            abort();
+        }
+
+        close(_fdRL);
+
+        _fdRL = fd;
+    }
+
+    _nCol = header.nx;
+    _nRow = header.ny;
+    _nSlc = header.nz;
+
+    _nColFT = _nCol / 2 + 1;
+
+    size_t offset = 1024 + header.nsymbt;
+
+    _mapSizeRL = offset + (size_t)_nCol * _nRow * _nSlc * sizeof(float);
+
+    struct stat st;
+
+    if ((fstat(_fdRL, &st) != 0) || ((size_t)st.st_size < _mapSizeRL))
+    {
+        REPORT_ERROR("MRC FILE IS TRUNCATED");
+        abort();
+    }
+
+    _mapRL = (char*)mmap(NULL,
+                         _mapSizeRL,
+                         write ? (PROT_READ | PROT_WRITE) : PROT_READ,
+                         MAP_SHARED,
+                         _fdRL,
+                         0);
+
+    if (_mapRL == MAP_FAILED)
+    {
+        _mapRL = NULL;
+
+        REPORT_ERROR("FAIL TO MAP MRC FILE");
+        abort();
+    }
+
+    _dataRL = (float*)(_mapRL + offset);
+}
+
+void SlabVolume::createMRC(const char file[],
+                           const int nCol,
+                           const int nRow,
+                           const int nSlc,
+                           const RFLOAT pixelSize)
+{
+    closeMRC();
+
+    int fd = open(file, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if (fd == -1)
+    {
+        REPORT_ERROR("FAIL TO CREATE MRC FILE");
+        abort();
+    }
+
+    MRCHeader header;
+
+    memset(&header, 0, sizeof(MRCHeader));
+
+    header.mode = 2;
+
+    header.nx = nCol;
+    header.ny = nRow;
+    header.nz = nSlc;
+
+    header.mx = nCol;
+    header.my = nRow;
+    header.mz = nSlc;
+
+    header.cella[0] = nCol * pixelSize;
+    header.cella[1] = nRow * pixelSize;
+    header.cella[2] = nSlc * pixelSize;
+
+    header.cellb[0] = 90;
+    header.cellb[1] = 90;
+    header.cellb[2] = 90;
+
+    header.mapc = 1;
+    header.mapr = 2;
+    header.maps = 3;
+
+    header.ispg = 1;
+
+    // the data is a hole of the file, read as 0
+
+    if ((pwrite(fd, &header, 1024, 0) != 1024) ||
+        (ftruncate(fd, 1024 + (off_t)nCol * nRow * nSlc * sizeof(float)) != 0))
+    {
+        REPORT_ERROR("FAIL TO WRITE OUT MRC FILE");
+        abort();
+    }
+
+    close(fd);
+
+    openMRC(file, true);
+}
+
+void SlabVolume::openFT(const char dir[])
+{
+    closeFT();
+
+    if (_nCol == 0)
+    {
+        REPORT_ERROR("NO MRC FILE MAPPED");
+        abort();
+    }
+
+    char path[FILE_NAME_LENGTH];
+
+    snprintf(path, FILE_NAME_LENGTH, "%s/.thunder_slab_XXXXXX", dir);
+
+    _fdFT = mkstemp(path);
+
+    if (_fdFT == -1)
+    {
+        REPORT_ERROR("FAIL TO CREATE SCRATCH FILE");
+        abort();
+    }
+
+    // removed from the directory right away, the space is freed on closing
+
+    unlink(path);
+
+    _mapSizeFT = slcSizeFT() * _nSlc * sizeof(Complex);
+
+    if (ftruncate(_fdFT, _mapSizeFT) != 0)
+    {
+        REPORT_ERROR("FAIL TO ALLOCATE SCRATCH FILE");
+        abort();
+    }
+
+    _dataFT = (Complex*)mmap(NULL,
+                             _mapSizeFT,
+                             PROT_READ | PROT_WRITE,
+                             MAP_SHARED,
+                             _fdFT,
+                             0);
+
+    if (_dataFT == MAP_FAILED)
+    {
+        _dataFT = NULL;
+
+        REPORT_ERROR("FAIL TO MAP SCRATCH FILE");
+        abort();
+    }
+}
+
+void SlabVolume::closeMRC()
+{
+    if (_mapRL != NULL) munmap(_mapRL, _mapSizeRL);
+
+    if (_fdRL != -1) close(_fdRL);
+
+    _mapRL = NULL;
+    _dataRL = NULL;
+    _fdRL = -1;
+}
+
+void SlabVolume::closeFT()
+{
+    if (_dataFT != NULL) munmap(_dataFT, _mapSizeFT);
+
+    if (_fdFT != -1) close(_fdFT);
+
+    _dataFT = NULL;
+    _fdFT = -1;
+}
+
+void SlabVolume::fw()
+{
+    RFLOAT* srcR = (RFLOAT*)TSFFTW_malloc(slcSizeRL() * sizeof(RFLOAT));
+    TSFFTW_COMPLEX* dstC = (TSFFTW_COMPLEX*)TSFFTW_malloc(slcSizeFT() * sizeof(Complex));
+
+    TSFFTW_PLAN plan = TSFFTW_plan_dft_r2c_2d(_nRow,
+                                              _nCol,
+                                              srcR,
+                                              dstC,
+                                              FFTW_ESTIMATE);
+
+    TSFFTW_free(srcR);
+    TSFFTW_free(dstC);
+
+    #pragma omp parallel
+    {
+        RFLOAT* r = (RFLOAT*)TSFFTW_malloc(slcSizeRL() * sizeof(RFLOAT));
+        TSFFTW_COMPLEX* c = (TSFFTW_COMPLEX*)TSFFTW_malloc(slcSizeFT() * sizeof(Complex));
+
+        #pragma omp for schedule(dynamic)
+        for (int k = 0; k < _nSlc; k++)
+        {
+            // the origin moves from the centre of the file to the corner, as
+            // ImageFile::readVolume does
+
+            const float* src = slcRL((k + _nSlc / 2) % _nSlc);
+
+            for (int j = 0; j < _nRow; j++)
+            {
+                const float* row = src + (size_t)((j + _nRow / 2) % _nRow) * _nCol;
+
+                for (int i = 0; i < _nCol; i++)
+                    r[j * _nCol + i] = row[(i + _nCol / 2) % _nCol];
+            }
+
+            TSFFTW_execute_dft_r2c(plan, r, c);
+
+            memcpy(slcFT(k), c, slcSizeFT() * sizeof(Complex));
+        }
+
+        TSFFTW_free(r);
+        TSFFTW_free(c);
+    }
+
+    TSFFTW_destroy_plan(plan);
+
+    transformZ(FFTW_FORWARD);
+}
+
+void SlabVolume::bw()
+{
+    transformZ(FFTW_BACKWARD);
+
+    RFLOAT* srcR = (RFLOAT*)TSFFTW_malloc(slcSizeRL() * sizeof(RFLOAT));
+    TSFFTW_COMPLEX* srcC = (TSFFTW_COMPLEX*)TSFFTW_malloc(slcSizeFT() * sizeof(Complex));
+
+    TSFFTW_PLAN plan = TSFFTW_plan_dft_c2r_2d(_nRow,
+                                              _nCol,
+                                              srcC,
+                                              srcR,
+                                              FFTW_ESTIMATE);
+
+    TSFFTW_free(srcR);
+    TSFFTW_free(srcC);
+
+    RFLOAT scale = 1.0 / ((double)_nCol * _nRow * _nSlc);
+
+    #pragma omp parallel
+    {
+        RFLOAT* r = (RFLOAT*)TSFFTW_malloc(slcSizeRL() * sizeof(RFLOAT));
+        TSFFTW_COMPLEX* c = (TSFFTW_COMPLEX*)TSFFTW_malloc(slcSizeFT() * sizeof(Complex));
+
+        #pragma omp for schedule(dynamic)
+        for (int k = 0; k < _nSlc; k++)
+        {
+            memcpy(c, slcFT(k), slcSizeFT() * sizeof(Complex));
+
+            TSFFTW_execute_dft_c2r(plan, c, r);
+
+            float* dst = slcRL((k + _nSlc / 2) % _nSlc);
+
+            for (int j = 0; j < _nRow; j++)
+            {
+                float* row = dst + (size_t)((j + _nRow / 2) % _nRow) * _nCol;
+
+                for (int i = 0; i < _nCol; i++)
+                    row[(i + _nCol / 2) % _nCol] = r[j * _nCol + i] * scale;
+            }
+        }
+
+        TSFFTW_free(r);
+        TSFFTW_free(c);
+    }
+
+    TSFFTW_destroy_plan(plan);
+}
+
+void SlabVolume::transformZ(const int sign)
+{
+    // a block of nRowBlock rows of every slice, stored slice by slice, thus
+    // the lines along Z are interleaved with a stride of the block
+
+    size_t rowSize = (size_t)_nColFT * _nSlc * sizeof(Complex);
+
+    int nRowBlock = GSL_MAX_INT(1, GSL_MIN_INT(_nRow, _bufferSize / rowSize));
+
+    TSFFTW_COMPLEX* buf = (TSFFTW_COMPLEX*)TSFFTW_malloc((size_t)nRowBlock * _nColFT * _nSlc * sizeof(Complex));
+
+    TSFFTW_PLAN plan = NULL;
+
+    int nLinePlan = 0;
+
+    for (int j0 = 0; j0 < _nRow; j0 += nRowBlock)
+    {
+        int nLine = GSL_MIN_INT(nRowBlock, _nRow - j0) * _nColFT;
+
+        if (nLine != nLinePlan)
+        {
+            if (plan) TSFFTW_destroy_plan(plan);
+
+            TSFFTW_plan_with_nthreads(omp_get_max_threads());
+
+            plan = TSFFTW_plan_many_dft(1,
+                                        &_nSlc,
+                                        nLine,
+                                        buf,
+                                        NULL,
+                                        nLine,
+                                        1,
+                                        buf,
+                                        NULL,
+                                        nLine,
+                                        1,
+                                        sign,
+                                        FFTW_ESTIMATE);
+
+            TSFFTW_plan_with_nthreads(1);
+
+            nLinePlan = nLine;
+        }
+
+        #pragma omp parallel for
+        for (int k = 0; k < _nSlc; k++)
+            memcpy((Complex*)buf + (size_t)k * nLine,
+                   slcFT(k) + (size_t)j0 * _nColFT,
+                   nLine * sizeof(Complex));
+
+        TSFFTW_execute(plan);
+
+        #pragma omp parallel for
+        for (int k = 0; k < _nSlc; k++)
+            memcpy(slcFT(k) + (size_t)j0 * _nColFT,
+                   (Complex*)buf + (size_t)k * nLine,
+                   nLine * sizeof(Complex));
+    }
+
+    if (plan) TSFFTW_destroy_plan(plan);
+
+    TSFFTW_free(buf);
+}
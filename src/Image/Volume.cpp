@@ -72,18 +72,15 @@ void Volume::alloc(const int nCol,
     {
         clearRL();
 
-        _sizeRL = nCol * nRow * nSlc;
-        _sizeFT = (nCol / 2 + 1) * nRow * nSlc;
+        _sizeRL = (size_t)nCol * nRow * nSlc;
+        _sizeFT = (size_t)(nCol / 2 + 1) * nRow * nSlc;
 
 #ifdef CXX11_PTR
         _dataRL.reset(new RFLOAT[_sizeRL]);
 #endif
 
 #ifdef FFTW_PTR
-#ifdef FFTW_PTR_THREAD_SAFETY
-        #pragma omp critical  (line86)
-#endif
-        _dataRL = (RFLOAT*)TSFFTW_malloc(_sizeRL * sizeof(RFLOAT));
+        _dataRL = (RFLOAT*)IMAGE_BASE_MALLOC(_sizeRL * sizeof(RFLOAT));
 
         if (_dataRL == NULL)
         {
@@ -97,18 +94,15 @@ void Volume::alloc(const int nCol,
     {
         clearFT();
 
-        _sizeRL = nCol * nRow * nSlc;
-        _sizeFT = (nCol / 2 + 1) * nRow * nSlc;
+        _sizeRL = (size_t)nCol * nRow * nSlc;
+        _sizeFT = (size_t)(nCol / 2 + 1) * nRow * nSlc;
 
 #ifdef CXX11_PTR
         _dataFT.reset(new Complex[_sizeFT]);
 #endif
 
 #ifdef FFTW_PTR
-#ifdef FFTW_PTR_THREAD_SAFETY
-        #pragma omp critical  (line111)
-#endif
-        _dataFT = (Complex*)TSFFTW_malloc(_sizeFT * sizeof(Complex));
+        _dataFT = (Complex*)IMAGE_BASE_MALLOC(_sizeFT * sizeof(Complex));
 
         if (_dataFT == NULL)
         {
@@ -122,6 +116,35 @@ void Volume::alloc(const int nCol,
     initBox();
 }
 
+void Volume::attachFT(Complex* data,
+                      const int nCol,
+                      const int nRow,
+                      const int nSlc)
+{
+#ifdef CXX11_PTR
+    REPORT_ERROR("ATTACHING SPACE IS NOT SUPPORTED BY CXX11_PTR");
+
+    abort();
+#endif
+
+    clearFT();
+
+    _nCol = nCol;
+    _nRow = nRow;
+    _nSlc = nSlc;
+
+    _sizeRL = (size_t)nCol * nRow * nSlc;
+    _sizeFT = (size_t)(nCol / 2 + 1) * nRow * nSlc;
+
+#ifdef FFTW_PTR
+    _dataFT = data;
+#endif
+
+    _attachedFT = true;
+
+    initBox();
+}
+
 RFLOAT Volume::getRL(const int iCol,
                      const int iRow,
                      const int iSlc) const
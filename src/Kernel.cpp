@@ -0,0 +1,1194 @@
+/*******************************************************************************
+ * Author:
+ * Dependency:
+ * Test:
+ * Execution:
+ * Description:
+ *
+ * Manual:
+ * ****************************************************************************/
+
+#include "Kernel.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KERNEL_MULTIVERSION
+#endif
+
+/**
+ * The bodies of the kernels are written once and inlined into each variant,
+ * which is then vectorised for the instruction set of the variant.
+ */
+#define KERNEL_INLINE static inline __attribute__((always_inline))
+
+#define KERNEL_TARGET_AVX2 __attribute__((target("avx2,fma")))
+
+#define KERNEL_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma")))
+
+KERNEL_INLINE RFLOAT* kernelLogDataVSPrior_m_n(const Complex* dat,
+                                               const Complex* pri,
+                                               const RFLOAT* ctf,
+                                               const RFLOAT* sigRcp,
+                                               const int n,
+                                               const int m,
+                                               RFLOAT* result)
+{
+    for (int i = 0; i < m; i++)
+    {
+        const Complex* d = dat + (size_t)i * n;
+        const RFLOAT* c = ctf + (size_t)i * n;
+        const RFLOAT* s = sigRcp + (size_t)i * n;
+
+        RFLOAT priReal = pri[i].dat[0];
+        RFLOAT priImag = pri[i].dat[1];
+
+        #pragma omp simd
+        for (int j = 0; j < n; j++)
+        {
+            RFLOAT re = d[j].dat[0] - c[j] * priReal;
+            RFLOAT im = d[j].dat[1] - c[j] * priImag;
+
+            result[j] += (re * re + im * im) * s[j];
+        }
+    }
+
+    return result;
+}
+
+KERNEL_INLINE RFLOAT* kernelLogDataVSPrior_m_n_BF16(const ComplexBF16* dat,
+                                                    const Complex* pri,
+                                                    const bf16* ctf,
+                                                    const bf16* sigRcp,
+                                                    const int n,
+                                                    const int m,
+                                                    RFLOAT* result)
+{
+    for (int i = 0; i < m; i++)
+    {
+        size_t base = (size_t)i * n;
+
+        #pragma omp simd
+        for (int j = 0; j < n; j++)
+        {
+            size_t idx = base + j;
+
+            RFLOAT c = RFLOAT_BF16(ctf[idx]);
+
+            RFLOAT re = RFLOAT_BF16(dat[idx].dat[0]) - c * pri[i].dat[0];
+            RFLOAT im = RFLOAT_BF16(dat[idx].dat[1]) - c * pri[i].dat[1];
+
+            result[j] += (re * re + im * im) * RFLOAT_BF16(sigRcp[idx]);
+        }
+    }
+
+    return result;
+}
+
+KERNEL_INLINE RFLOAT kernelWiden(const RFLOAT x)
+{
+    return x;
+}
+
+KERNEL_INLINE RFLOAT kernelWiden(const bf16 x)
+{
+    return RFLOAT_BF16(x);
+}
+
+template <typename C>
+KERNEL_INLINE RFLOAT* kernelLogDataVSPrior_m_n_seg(const C* dat,
+                                                   const Complex* pri,
+                                                   const RFLOAT* ctf,
+                                                   const RFLOAT* sigRcp,
+                                                   const int n,
+                                                   const int m,
+                                                   const int nCTF,
+                                                   const int nSig,
+                                                   const int nSeg,
+                                                   const int* seg,
+                                                   const int* segCTF,
+                                                   const int* segSig,
+                                                   RFLOAT* result)
+{
+    for (int i = 0; i < m; i++)
+    {
+        const C* datI = dat + (size_t)i * n;
+
+        for (int s = 0; s < nSeg; s++)
+        {
+            // CTF and sigma are constant within a segment
+
+            RFLOAT c = ctf[(size_t)i * nCTF + segCTF[s]];
+
+            RFLOAT priReal = c * pri[i].dat[0];
+            RFLOAT priImag = c * pri[i].dat[1];
+
+            RFLOAT w = sigRcp[(size_t)i * nSig + segSig[s]];
+
+            #pragma omp simd
+            for (int j = seg[s]; j < seg[s + 1]; j++)
+            {
+                RFLOAT re = kernelWiden(datI[j].dat[0]) - priReal;
+                RFLOAT im = kernelWiden(datI[j].dat[1]) - priImag;
+
+                result[j] += (re * re + im * im) * w;
+            }
+        }
+    }
+
+    return result;
+}
+
+template <typename C>
+KERNEL_INLINE RFLOAT* kernelLogDataVSPrior_m_n_idx(const C* dat,
+                                                   const Complex* pri,
+                                                   const RFLOAT* ctf,
+                                                   const RFLOAT* sigRcp,
+                                                   const int n,
+                                                   const int m,
+                                                   const int nCTF,
+                                                   const int nSig,
+                                                   const int* colCTF,
+                                                   const int* colSig,
+                                                   const int nIdx,
+                                                   const int* idx,
+                                                   RFLOAT* result)
+{
+    for (int i = 0; i < m; i++)
+    {
+        const C* datI = dat + (size_t)i * n;
+
+        const RFLOAT* ctfI = ctf + (size_t)i * nCTF;
+        const RFLOAT* sigI = sigRcp + (size_t)i * nSig;
+
+        RFLOAT priReal = pri[i].dat[0];
+        RFLOAT priImag = pri[i].dat[1];
+
+        #pragma omp simd
+        for (int k = 0; k < nIdx; k++)
+        {
+            int j = idx[k];
+
+            RFLOAT c = ctfI[colCTF[j]];
+
+            RFLOAT re = kernelWiden(datI[j].dat[0]) - c * priReal;
+            RFLOAT im = kernelWiden(datI[j].dat[1]) - c * priImag;
+
+            result[k] += (re * re + im * im) * sigI[colSig[j]];
+        }
+    }
+
+    return result;
+}
+
+KERNEL_INLINE RFLOAT kernelLogDataVSPrior_m(const Complex* dat,
+                                            const Complex* pri,
+                                            const RFLOAT* ctf,
+                                            const RFLOAT* sigRcp,
+                                            const int m)
+{
+    RFLOAT result = 0;
+
+    #pragma omp simd reduction(+:result)
+    for (int i = 0; i < m; i++)
+    {
+        RFLOAT re = dat[i].dat[0] - ctf[i] * pri[i].dat[0];
+        RFLOAT im = dat[i].dat[1] - ctf[i] * pri[i].dat[1];
+
+        result += (re * re + im * im) * sigRcp[i];
+    }
+
+    return result;
+}
+
+/**
+ * sin(x) and cos(x) by the same reduction and polynomials as CTFFastCos, so
+ * that the loop calling it can be vectorised
+ */
+KERNEL_INLINE void kernelSinCos(RFLOAT& s,
+                                RFLOAT& c,
+                                const double x)
+{
+    double q = floor(x * M_2_PI + 0.5);
+    double r = x - q * M_PI_2;
+
+    double r2 = r * r;
+
+    double cr = 1 + r2 * (-1.0 / 2 + r2 * (1.0 / 24 + r2 * (-1.0 / 720 + r2 * (1.0 / 40320))));
+    double sr = r * (1 + r2 * (-1.0 / 6 + r2 * (1.0 / 120 + r2 * (-1.0 / 5040 + r2 * (1.0 / 362880)))));
+
+    // (cos(x), sin(x)) = (cr, sr), (-sr, cr), (-cr, -sr), (sr, -cr) in quadrant
+    // 0, 1, 2, 3
+
+    int iq = (int)q & 3;
+
+    double vc = (iq & 1) ? sr : cr;
+    double vs = (iq & 1) ? cr : sr;
+
+    c = (RFLOAT)(((iq + 1) & 2) ? -vc : vc);
+    s = (RFLOAT)((iq & 2) ? -vs : vs);
+}
+
+KERNEL_INLINE void kernelTranslate(Complex* dst,
+                                   const RFLOAT nTransCol,
+                                   const RFLOAT nTransRow,
+                                   const int nCol,
+                                   const int nRow,
+                                   const int* iCol,
+                                   const int* iRow,
+                                   const int nPxl)
+{
+    RFLOAT rCol = nTransCol / nCol;
+    RFLOAT rRow = nTransRow / nRow;
+
+    #pragma omp simd
+    for (int i = 0; i < nPxl; i++)
+    {
+        RFLOAT phase = M_2X_PI * (iCol[i] * rCol + iRow[i] * rRow);
+
+        RFLOAT s, c;
+
+        kernelSinCos(s, c, phase);
+
+        dst[i].dat[0] = c;
+        dst[i].dat[1] = -s;
+    }
+}
+
+KERNEL_INLINE void kernelProject3D(Complex* dst,
+                                   const Complex* src,
+                                   const int nColFT,
+                                   const int nRow,
+                                   const int nSlc,
+                                   const double* mat,
+                                   const int pf,
+                                   const int* iCol,
+                                   const int* iRow,
+                                   const int nPxl)
+{
+    size_t nSlab = (size_t)nColFT * nRow;
+
+    #pragma omp simd
+    for (int i = 0; i < nPxl; i++)
+    {
+        double a = iCol[i] * pf;
+        double b = iRow[i] * pf;
+
+        RFLOAT x = mat[0] * a + mat[3] * b;
+        RFLOAT y = mat[1] * a + mat[4] * b;
+        RFLOAT z = mat[2] * a + mat[5] * b;
+
+        // the same as Volume::getByInterpolationFT with LINEAR_INTERP
+
+        bool conj = (x < 0);
+
+        if (conj)
+        {
+            x = -x;
+            y = -y;
+            z = -z;
+        }
+
+        int x0 = floor(x);
+        int y0 = floor(y);
+        int z0 = floor(z);
+
+        RFLOAT xd = x - x0;
+        RFLOAT yd = y - y0;
+        RFLOAT zd = z - z0;
+
+        // the negative frequencies are wrapped around corner by corner, as a
+        // cell may straddle the origin
+
+        size_t r0 = (y0 >= 0 ? y0 : y0 + nRow) * (size_t)nColFT;
+        size_t r1 = (y0 + 1 >= 0 ? y0 + 1 : y0 + 1 + nRow) * (size_t)nColFT;
+
+        size_t s0 = (z0 >= 0 ? z0 : z0 + nSlc) * nSlab;
+        size_t s1 = (z0 + 1 >= 0 ? z0 + 1 : z0 + 1 + nSlc) * nSlab;
+
+        RFLOAT w000 = (1 - xd) * (1 - yd) * (1 - zd);
+        RFLOAT w001 = xd * (1 - yd) * (1 - zd);
+        RFLOAT w010 = (1 - xd) * yd * (1 - zd);
+        RFLOAT w011 = xd * yd * (1 - zd);
+        RFLOAT w100 = (1 - xd) * (1 - yd) * zd;
+        RFLOAT w101 = xd * (1 - yd) * zd;
+        RFLOAT w110 = (1 - xd) * yd * zd;
+        RFLOAT w111 = xd * yd * zd;
+
+        const Complex* p00 = src + s0 + r0 + x0;
+        const Complex* p01 = src + s0 + r1 + x0;
+        const Complex* p10 = src + s1 + r0 + x0;
+        const Complex* p11 = src + s1 + r1 + x0;
+
+        RFLOAT re = p00[0].dat[0] * w000
+                  + p00[1].dat[0] * w001
+                  + p01[0].dat[0] * w010
+                  + p01[1].dat[0] * w011
+                  + p10[0].dat[0] * w100
+                  + p10[1].dat[0] * w101
+                  + p11[0].dat[0] * w110
+                  + p11[1].dat[0] * w111;
+
+        RFLOAT im = p00[0].dat[1] * w000
+                  + p00[1].dat[1] * w001
+                  + p01[0].dat[1] * w010
+                  + p01[1].dat[1] * w011
+                  + p10[0].dat[1] * w100
+                  + p10[1].dat[1] * w101
+                  + p11[0].dat[1] * w110
+                  + p11[1].dat[1] * w111;
+
+        dst[i].dat[0] = re;
+        dst[i].dat[1] = conj ? -im : im;
+    }
+}
+
+KERNEL_INLINE void kernelProject2D(Complex* dst,
+                                   const Complex* src,
+                                   const int nColFT,
+                                   const int nRow,
+                                   const double* mat,
+                                   const int pf,
+                                   const int* iCol,
+                                   const int* iRow,
+                                   const int nPxl)
+{
+    #pragma omp simd
+    for (int i = 0; i < nPxl; i++)
+    {
+        double a = iCol[i] * pf;
+        double b = iRow[i] * pf;
+
+        RFLOAT x = mat[0] * a + mat[2] * b;
+        RFLOAT y = mat[1] * a + mat[3] * b;
+
+        // the same as Image::getByInterpolationFT with LINEAR_INTERP
+
+        bool conj = (x < 0);
+
+        if (conj)
+        {
+            x = -x;
+            y = -y;
+        }
+
+        int x0 = floor(x);
+        int y0 = floor(y);
+
+        RFLOAT xd = x - x0;
+        RFLOAT yd = y - y0;
+
+        size_t r0 = (y0 >= 0 ? y0 : y0 + nRow) * (size_t)nColFT;
+        size_t r1 = (y0 + 1 >= 0 ? y0 + 1 : y0 + 1 + nRow) * (size_t)nColFT;
+
+        RFLOAT w00 = (1 - xd) * (1 - yd);
+        RFLOAT w01 = xd * (1 - yd);
+        RFLOAT w10 = (1 - xd) * yd;
+        RFLOAT w11 = xd * yd;
+
+        const Complex* p0 = src + r0 + x0;
+        const Complex* p1 = src + r1 + x0;
+
+        RFLOAT re = p0[0].dat[0] * w00
+                  + p0[1].dat[0] * w01
+                  + p1[0].dat[0] * w10
+                  + p1[1].dat[0] * w11;
+
+        RFLOAT im = p0[0].dat[1] * w00
+                  + p0[1].dat[1] * w01
+                  + p1[0].dat[1] * w10
+                  + p1[1].dat[1] * w11;
+
+        dst[i].dat[0] = re;
+        dst[i].dat[1] = conj ? -im : im;
+    }
+}
+
+/* ******************************* SCALAR ********************************** */
+
+static RFLOAT* logDataVSPrior_m_n_scalar(const Complex* dat,
+                                         const Complex* pri,
+                                         const RFLOAT* ctf,
+                                         const RFLOAT* sigRcp,
+                                         const int n,
+                                         const int m,
+                                         RFLOAT* result)
+{
+    return kernelLogDataVSPrior_m_n(dat, pri, ctf, sigRcp, n, m, result);
+}
+
+static RFLOAT* logDataVSPrior_m_n_BF16_scalar(const ComplexBF16* dat,
+                                              const Complex* pri,
+                                              const bf16* ctf,
+                                              const bf16* sigRcp,
+                                              const int n,
+                                              const int m,
+                                              RFLOAT* result)
+{
+    return kernelLogDataVSPrior_m_n_BF16(dat, pri, ctf, sigRcp, n, m, result);
+}
+
+static RFLOAT* logDataVSPrior_m_n_seg_scalar(const Complex* dat,
+                                              const Complex* pri,
+                                              const RFLOAT* ctf,
+                                              const RFLOAT* sigRcp,
+                                              const int n,
+                                              const int m,
+                                              const int nCTF,
+                                              const int nSig,
+                                              const int nSeg,
+                                              const int* seg,
+                                              const int* segCTF,
+                                              const int* segSig,
+                                              RFLOAT* result)
+{
+    return kernelLogDataVSPrior_m_n_seg(dat, pri, ctf, sigRcp, n, m, nCTF, nSig, nSeg, seg, segCTF, segSig, result);
+}
+
+static RFLOAT* logDataVSPrior_m_n_seg_BF16_scalar(const ComplexBF16* dat,
+                                                   const Complex* pri,
+                                                   const RFLOAT* ctf,
+                                                   const RFLOAT* sigRcp,
+                                                   const int n,
+                                                   const int m,
+                                                   const int nCTF,
+                                                   const int nSig,
+                                                   const int nSeg,
+                                                   const int* seg,
+                                                   const int* segCTF,
+                                                   const int* segSig,
+                                                   RFLOAT* result)
+{
+    return kernelLogDataVSPrior_m_n_seg(dat, pri, ctf, sigRcp, n, m, nCTF, nSig, nSeg, seg, segCTF, segSig, result);
+}
+
+static RFLOAT* logDataVSPrior_m_n_idx_scalar(const Complex* dat,
+                                             const Complex* pri,
+                                             const RFLOAT* ctf,
+                                             const RFLOAT* sigRcp,
+                                             const int n,
+                                             const int m,
+                                             const int nCTF,
+                                             const int nSig,
+                                             const int* colCTF,
+                                             const int* colSig,
+                                             const int nIdx,
+                                             const int* idx,
+                                             RFLOAT* result)
+{
+    return kernelLogDataVSPrior_m_n_idx(dat, pri, ctf, sigRcp, n, m, nCTF, nSig, colCTF, colSig, nIdx, idx, result);
+}
+
+static RFLOAT* logDataVSPrior_m_n_idx_BF16_scalar(const ComplexBF16* dat,
+                                                  const Complex* pri,
+                                                  const RFLOAT* ctf,
+                                                  const RFLOAT* sigRcp,
+                                                  const int n,
+                                                  const int m,
+                                                  const int nCTF,
+                                                  const int nSig,
+                                                  const int* colCTF,
+                                                  const int* colSig,
+                                                  const int nIdx,
+                                                  const int* idx,
+                                                  RFLOAT* result)
+{
+    return kernelLogDataVSPrior_m_n_idx(dat, pri, ctf, sigRcp, n, m, nCTF, nSig, colCTF, colSig, nIdx, idx, result);
+}
+
+static RFLOAT logDataVSPrior_m_scalar(const Complex* dat,
+                                      const Complex* pri,
+                                      const RFLOAT* ctf,
+                                      const RFLOAT* sigRcp,
+                                      const int m)
+{
+    return kernelLogDataVSPrior_m(dat, pri, ctf, sigRcp, m);
+}
+
+/**
+ * the scalar path keeps the math library sin / cos
+ */
+static void translate_scalar(Complex* dst,
+                             const RFLOAT nTransCol,
+                             const RFLOAT nTransRow,
+                             const int nCol,
+                             const int nRow,
+                             const int* iCol,
+                             const int* iRow,
+                             const int nPxl)
+{
+    RFLOAT rCol = nTransCol / nCol;
+    RFLOAT rRow = nTransRow / nRow;
+
+    for (int i = 0; i < nPxl; i++)
+    {
+        RFLOAT phase = M_2X_PI * (iCol[i] * rCol + iRow[i] * rRow);
+        dst[i] = COMPLEX_POLAR(-phase);
+    }
+}
+
+static void project3D_scalar(Complex* dst,
+                             const Complex* src,
+                             const int nColFT,
+                             const int nRow,
+                             const int nSlc,
+                             const double* mat,
+                             const int pf,
+                             const int* iCol,
+                             const int* iRow,
+                             const int nPxl)
+{
+    kernelProject3D(dst, src, nColFT, nRow, nSlc, mat, pf, iCol, iRow, nPxl);
+}
+
+static void project2D_scalar(Complex* dst,
+                             const Complex* src,
+                             const int nColFT,
+                             const int nRow,
+                             const double* mat,
+                             const int pf,
+                             const int* iCol,
+                             const int* iRow,
+                             const int nPxl)
+{
+    kernelProject2D(dst, src, nColFT, nRow, mat, pf, iCol, iRow, nPxl);
+}
+
+#ifdef KERNEL_MULTIVERSION
+
+/* ******************************** AVX2 *********************************** */
+
+KERNEL_TARGET_AVX2
+static RFLOAT* logDataVSPrior_m_n_avx2(const Complex* dat,
+                                       const Complex* pri,
+                                       const RFLOAT* ctf,
+                                       const RFLOAT* sigRcp,
+                                       const int n,
+                                       const int m,
+                                       RFLOAT* result)
+{
+    return kernelLogDataVSPrior_m_n(dat, pri, ctf, sigRcp, n, m, result);
+}
+
+#ifdef SINGLE_PRECISION
+
+/**
+ * widen 8 bfloat16 to single precision, the lanes hold the elements in the
+ * order of 0, 1, 4, 5, 2, 3, 6, 7, matching the order of the real and
+ * imaginary parts deinterleaved by _mm256_shuffle_ps
+ */
+KERNEL_TARGET_AVX2
+static inline __m256 widenBF16SIMD256(const bf16* src)
+{
+    __m128i zero = _mm_setzero_si128();
+
+    __m128i v = _mm_loadu_si128((const __m128i*)src);
+
+    __m128i lo = _mm_unpacklo_epi16(zero, v);
+    __m128i hi = _mm_unpackhi_epi16(zero, v);
+
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_castsi128_ps(_mm_unpacklo_epi64(lo, hi))),
+                                _mm_castsi128_ps(_mm_unpackhi_epi64(lo, hi)),
+                                1);
+}
+
+/**
+ * widen 4 complex numbers in bfloat16 to re0, im0, re1, im1, re2, im2, re3, im3
+ */
+KERNEL_TARGET_AVX2
+static inline __m256 widenComplexBF16SIMD256(const ComplexBF16* src)
+{
+    __m128i zero = _mm_setzero_si128();
+
+    __m128i v = _mm_loadu_si128((const __m128i*)src);
+
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_castsi128_ps(_mm_unpacklo_epi16(zero, v))),
+                                _mm_castsi128_ps(_mm_unpackhi_epi16(zero, v)),
+                                1);
+}
+
+KERNEL_TARGET_AVX2
+static RFLOAT* logDataVSPrior_m_n_BF16_avx2(const ComplexBF16* dat,
+                                            const Complex* pri,
+                                            const bf16* ctf,
+                                            const bf16* sigRcp,
+                                            const int n,
+                                            const int m,
+                                            RFLOAT* result)
+{
+    static const int lane[8] = {0, 1, 4, 5, 2, 3, 6, 7};
+
+    float tmp[8] __attribute__((aligned(64)));
+
+    for (int i = 0; i < m; i++)
+    {
+        __m256 priReal = _mm256_set1_ps(pri[i].dat[0]);
+        __m256 priImag = _mm256_set1_ps(pri[i].dat[1]);
+
+        size_t base = (size_t)i * n;
+
+        int j = 0;
+
+        for (; j <= (n - 8); j += 8)
+        {
+            size_t idx = base + j;
+
+            __m256 v0 = widenComplexBF16SIMD256(dat + idx);
+            __m256 v1 = widenComplexBF16SIMD256(dat + idx + 4);
+
+            __m256 datReal = _mm256_shuffle_ps(v0, v1, _MM_SHUFFLE(2, 0, 2, 0));
+            __m256 datImag = _mm256_shuffle_ps(v0, v1, _MM_SHUFFLE(3, 1, 3, 1));
+
+            __m256 c = widenBF16SIMD256(ctf + idx);
+            __m256 w = widenBF16SIMD256(sigRcp + idx);
+
+            __m256 re = _mm256_fnmadd_ps(c, priReal, datReal);
+            __m256 im = _mm256_fnmadd_ps(c, priImag, datImag);
+
+            __m256 r = _mm256_mul_ps(_mm256_fmadd_ps(re, re, _mm256_mul_ps(im, im)), w);
+
+            _mm256_store_ps(tmp, r);
+
+            for (int k = 0; k < 8; k++)
+                result[j + lane[k]] += tmp[k];
+        }
+
+        for (; j < n; j++)
+        {
+            size_t idx = base + j;
+
+            RFLOAT c = RFLOAT_BF16(ctf[idx]);
+
+            RFLOAT re = RFLOAT_BF16(dat[idx].dat[0]) - c * pri[i].dat[0];
+            RFLOAT im = RFLOAT_BF16(dat[idx].dat[1]) - c * pri[i].dat[1];
+
+            result[j] += (re * re + im * im) * RFLOAT_BF16(sigRcp[idx]);
+        }
+    }
+
+    return result;
+}
+
+#else
+
+KERNEL_TARGET_AVX2
+static RFLOAT* logDataVSPrior_m_n_BF16_avx2(const ComplexBF16* dat,
+                                            const Complex* pri,
+                                            const bf16* ctf,
+                                            const bf16* sigRcp,
+                                            const int n,
+                                            const int m,
+                                            RFLOAT* result)
+{
+    return kernelLogDataVSPrior_m_n_BF16(dat, pri, ctf, sigRcp, n, m, result);
+}
+
+#endif
+
+KERNEL_TARGET_AVX2
+static RFLOAT* logDataVSPrior_m_n_seg_avx2(const Complex* dat,
+                                            const Complex* pri,
+                                            const RFLOAT* ctf,
+                                            const RFLOAT* sigRcp,
+                                            const int n,
+                                            const int m,
+                                            const int nCTF,
+                                            const int nSig,
+                                            const int nSeg,
+                                            const int* seg,
+                                            const int* segCTF,
+                                            const int* segSig,
+                                            RFLOAT* result)
+{
+    return kernelLogDataVSPrior_m_n_seg(dat, pri, ctf, sigRcp, n, m, nCTF, nSig, nSeg, seg, segCTF, segSig, result);
+}
+
+KERNEL_TARGET_AVX2
+static RFLOAT* logDataVSPrior_m_n_seg_BF16_avx2(const ComplexBF16* dat,
+                                                 const Complex* pri,
+                                                 const RFLOAT* ctf,
+                                                 const RFLOAT* sigRcp,
+                                                 const int n,
+                                                 const int m,
+                                                 const int nCTF,
+                                                 const int nSig,
+                                                 const int nSeg,
+                                                 const int* seg,
+                                                 const int* segCTF,
+                                                 const int* segSig,
+                                                 RFLOAT* result)
+{
+    return kernelLogDataVSPrior_m_n_seg(dat, pri, ctf, sigRcp, n, m, nCTF, nSig, nSeg, seg, segCTF, segSig, result);
+}
+
+KERNEL_TARGET_AVX2
+static RFLOAT* logDataVSPrior_m_n_idx_avx2(const Complex* dat,
+                                           const Complex* pri,
+                                           const RFLOAT* ctf,
+                                           const RFLOAT* sigRcp,
+                                           const int n,
+                                           const int m,
+                                           const int nCTF,
+                                           const int nSig,
+                                           const int* colCTF,
+                                           const int* colSig,
+                                           const int nIdx,
+                                           const int* idx,
+                                           RFLOAT* result)
+{
+    return kernelLogDataVSPrior_m_n_idx(dat, pri, ctf, sigRcp, n, m, nCTF, nSig, colCTF, colSig, nIdx, idx, result);
+}
+
+KERNEL_TARGET_AVX2
+static RFLOAT* logDataVSPrior_m_n_idx_BF16_avx2(const ComplexBF16* dat,
+                                                const Complex* pri,
+                                                const RFLOAT* ctf,
+                                                const RFLOAT* sigRcp,
+                                                const int n,
+                                                const int m,
+                                                const int nCTF,
+                                                const int nSig,
+                                                const int* colCTF,
+                                                const int* colSig,
+                                                const int nIdx,
+                                                const int* idx,
+                                                RFLOAT* result)
+{
+    return kernelLogDataVSPrior_m_n_idx(dat, pri, ctf, sigRcp, n, m, nCTF, nSig, colCTF, colSig, nIdx, idx, result);
+}
+
+KERNEL_TARGET_AVX2
+static RFLOAT logDataVSPrior_m_avx2(const Complex* dat,
+                                    const Complex* pri,
+                                    const RFLOAT* ctf,
+                                    const RFLOAT* sigRcp,
+                                    const int m)
+{
+    return kernelLogDataVSPrior_m(dat, pri, ctf, sigRcp, m);
+}
+
+KERNEL_TARGET_AVX2
+static void translate_avx2(Complex* dst,
+                           const RFLOAT nTransCol,
+                           const RFLOAT nTransRow,
+                           const int nCol,
+                           const int nRow,
+                           const int* iCol,
+                           const int* iRow,
+                           const int nPxl)
+{
+    kernelTranslate(dst, nTransCol, nTransRow, nCol, nRow, iCol, iRow, nPxl);
+}
+
+KERNEL_TARGET_AVX2
+static void project3D_avx2(Complex* dst,
+                           const Complex* src,
+                           const int nColFT,
+                           const int nRow,
+                           const int nSlc,
+                           const double* mat,
+                           const int pf,
+                           const int* iCol,
+                           const int* iRow,
+                           const int nPxl)
+{
+    kernelProject3D(dst, src, nColFT, nRow, nSlc, mat, pf, iCol, iRow, nPxl);
+}
+
+KERNEL_TARGET_AVX2
+static void project2D_avx2(Complex* dst,
+                           const Complex* src,
+                           const int nColFT,
+                           const int nRow,
+                           const double* mat,
+                           const int pf,
+                           const int* iCol,
+                           const int* iRow,
+                           const int nPxl)
+{
+    kernelProject2D(dst, src, nColFT, nRow, mat, pf, iCol, iRow, nPxl);
+}
+
+/* ******************************* AVX512 ********************************** */
+
+KERNEL_TARGET_AVX512
+static RFLOAT* logDataVSPrior_m_n_avx512(const Complex* dat,
+                                         const Complex* pri,
+                                         const RFLOAT* ctf,
+                                         const RFLOAT* sigRcp,
+                                         const int n,
+                                         const int m,
+                                         RFLOAT* result)
+{
+    return kernelLogDataVSPrior_m_n(dat, pri, ctf, sigRcp, n, m, result);
+}
+
+#ifdef SINGLE_PRECISION
+
+/**
+ * widen 16 bfloat16 to single precision
+ */
+KERNEL_TARGET_AVX512
+static inline __m512 widenBF16SIMD512(const bf16* src)
+{
+    return _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i*)src)), 16));
+}
+
+KERNEL_TARGET_AVX512
+static RFLOAT* logDataVSPrior_m_n_BF16_avx512(const ComplexBF16* dat,
+                                              const Complex* pri,
+                                              const bf16* ctf,
+                                              const bf16* sigRcp,
+                                              const int n,
+                                              const int m,
+                                              RFLOAT* result)
+{
+    const __m512i iReal = _mm512_set_epi32(30, 28, 26, 24, 22, 20, 18, 16, 14, 12, 10, 8, 6, 4, 2, 0);
+    const __m512i iImag = _mm512_set_epi32(31, 29, 27, 25, 23, 21, 19, 17, 15, 13, 11, 9, 7, 5, 3, 1);
+
+    for (int i = 0; i < m; i++)
+    {
+        __m512 priReal = _mm512_set1_ps(pri[i].dat[0]);
+        __m512 priImag = _mm512_set1_ps(pri[i].dat[1]);
+
+        size_t base = (size_t)i * n;
+
+        int j = 0;
+
+        for (; j <= (n - 16); j += 16)
+        {
+            size_t idx = base + j;
+
+            // re0, im0, ..., re7, im7 and re8, im8, ..., re15, im15
+
+            __m512 v0 = widenBF16SIMD512(dat[idx].dat);
+            __m512 v1 = widenBF16SIMD512(dat[idx + 8].dat);
+
+            __m512 datReal = _mm512_permutex2var_ps(v0, iReal, v1);
+            __m512 datImag = _mm512_permutex2var_ps(v0, iImag, v1);
+
+            __m512 c = widenBF16SIMD512(ctf + idx);
+            __m512 w = widenBF16SIMD512(sigRcp + idx);
+
+            __m512 re = _mm512_fnmadd_ps(c, priReal, datReal);
+            __m512 im = _mm512_fnmadd_ps(c, priImag, datImag);
+
+            __m512 r = _mm512_mul_ps(_mm512_fmadd_ps(re, re, _mm512_mul_ps(im, im)), w);
+
+            _mm512_storeu_ps(result + j, _mm512_add_ps(_mm512_loadu_ps(result + j), r));
+        }
+
+        for (; j < n; j++)
+        {
+            size_t idx = base + j;
+
+            RFLOAT c = RFLOAT_BF16(ctf[idx]);
+
+            RFLOAT re = RFLOAT_BF16(dat[idx].dat[0]) - c * pri[i].dat[0];
+            RFLOAT im = RFLOAT_BF16(dat[idx].dat[1]) - c * pri[i].dat[1];
+
+            result[j] += (re * re + im * im) * RFLOAT_BF16(sigRcp[idx]);
+        }
+    }
+
+    return result;
+}
+
+#else
+
+KERNEL_TARGET_AVX512
+static RFLOAT* logDataVSPrior_m_n_BF16_avx512(const ComplexBF16* dat,
+                                              const Complex* pri,
+                                              const bf16* ctf,
+                                              const bf16* sigRcp,
+                                              const int n,
+                                              const int m,
+                                              RFLOAT* result)
+{
+    return kernelLogDataVSPrior_m_n_BF16(dat, pri, ctf, sigRcp, n, m, result);
+}
+
+#endif
+
+KERNEL_TARGET_AVX512
+static RFLOAT* logDataVSPrior_m_n_seg_avx512(const Complex* dat,
+                                              const Complex* pri,
+                                              const RFLOAT* ctf,
+                                              const RFLOAT* sigRcp,
+                                              const int n,
+                                              const int m,
+                                              const int nCTF,
+                                              const int nSig,
+                                              const int nSeg,
+                                              const int* seg,
+                                              const int* segCTF,
+                                              const int* segSig,
+                                              RFLOAT* result)
+{
+    return kernelLogDataVSPrior_m_n_seg(dat, pri, ctf, sigRcp, n, m, nCTF, nSig, nSeg, seg, segCTF, segSig, result);
+}
+
+KERNEL_TARGET_AVX512
+static RFLOAT* logDataVSPrior_m_n_seg_BF16_avx512(const ComplexBF16* dat,
+                                                   const Complex* pri,
+                                                   const RFLOAT* ctf,
+                                                   const RFLOAT* sigRcp,
+                                                   const int n,
+                                                   const int m,
+                                                   const int nCTF,
+                                                   const int nSig,
+                                                   const int nSeg,
+                                                   const int* seg,
+                                                   const int* segCTF,
+                                                   const int* segSig,
+                                                   RFLOAT* result)
+{
+    return kernelLogDataVSPrior_m_n_seg(dat, pri, ctf, sigRcp, n, m, nCTF, nSig, nSeg, seg, segCTF, segSig, result);
+}
+
+KERNEL_TARGET_AVX512
+static RFLOAT* logDataVSPrior_m_n_idx_avx512(const Complex* dat,
+                                             const Complex* pri,
+                                             const RFLOAT* ctf,
+                                             const RFLOAT* sigRcp,
+                                             const int n,
+                                             const int m,
+                                             const int nCTF,
+                                             const int nSig,
+                                             const int* colCTF,
+                                             const int* colSig,
+                                             const int nIdx,
+                                             const int* idx,
+                                             RFLOAT* result)
+{
+    return kernelLogDataVSPrior_m_n_idx(dat, pri, ctf, sigRcp, n, m, nCTF, nSig, colCTF, colSig, nIdx, idx, result);
+}
+
+KERNEL_TARGET_AVX512
+static RFLOAT* logDataVSPrior_m_n_idx_BF16_avx512(const ComplexBF16* dat,
+                                                  const Complex* pri,
+                                                  const RFLOAT* ctf,
+                                                  const RFLOAT* sigRcp,
+                                                  const int n,
+                                                  const int m,
+                                                  const int nCTF,
+                                                  const int nSig,
+                                                  const int* colCTF,
+                                                  const int* colSig,
+                                                  const int nIdx,
+                                                  const int* idx,
+                                                  RFLOAT* result)
+{
+    return kernelLogDataVSPrior_m_n_idx(dat, pri, ctf, sigRcp, n, m, nCTF, nSig, colCTF, colSig, nIdx, idx, result);
+}
+
+KERNEL_TARGET_AVX512
+static RFLOAT logDataVSPrior_m_avx512(const Complex* dat,
+                                      const Complex* pri,
+                                      const RFLOAT* ctf,
+                                      const RFLOAT* sigRcp,
+                                      const int m)
+{
+    return kernelLogDataVSPrior_m(dat, pri, ctf, sigRcp, m);
+}
+
+KERNEL_TARGET_AVX512
+static void translate_avx512(Complex* dst,
+                             const RFLOAT nTransCol,
+                             const RFLOAT nTransRow,
+                             const int nCol,
+                             const int nRow,
+                             const int* iCol,
+                             const int* iRow,
+                             const int nPxl)
+{
+    kernelTranslate(dst, nTransCol, nTransRow, nCol, nRow, iCol, iRow, nPxl);
+}
+
+KERNEL_TARGET_AVX512
+static void project3D_avx512(Complex* dst,
+                             const Complex* src,
+                             const int nColFT,
+                             const int nRow,
+                             const int nSlc,
+                             const double* mat,
+                             const int pf,
+                             const int* iCol,
+                             const int* iRow,
+                             const int nPxl)
+{
+    kernelProject3D(dst, src, nColFT, nRow, nSlc, mat, pf, iCol, iRow, nPxl);
+}
+
+KERNEL_TARGET_AVX512
+static void project2D_avx512(Complex* dst,
+                             const Complex* src,
+                             const int nColFT,
+                             const int nRow,
+                             const double* mat,
+                             const int pf,
+                             const int* iCol,
+                             const int* iRow,
+                             const int nPxl)
+{
+    kernelProject2D(dst, src, nColFT, nRow, mat, pf, iCol, iRow, nPxl);
+}
+
+#endif // KERNEL_MULTIVERSION
+
+static const KernelTable _kernelTable[KERNEL_N_PATH] =
+{
+    {
+        "scalar",
+        logDataVSPrior_m_n_scalar,
+        logDataVSPrior_m_n_BF16_scalar,
+        logDataVSPrior_m_n_seg_scalar,
+        logDataVSPrior_m_n_seg_BF16_scalar,
+        logDataVSPrior_m_n_idx_scalar,
+        logDataVSPrior_m_n_idx_BF16_scalar,
+        logDataVSPrior_m_scalar,
+        translate_scalar,
+        project3D_scalar,
+        project2D_scalar
+    },
+#ifdef KERNEL_MULTIVERSION
+    {
+        "avx2",
+        logDataVSPrior_m_n_avx2,
+        logDataVSPrior_m_n_BF16_avx2,
+        logDataVSPrior_m_n_seg_avx2,
+        logDataVSPrior_m_n_seg_BF16_avx2,
+        logDataVSPrior_m_n_idx_avx2,
+        logDataVSPrior_m_n_idx_BF16_avx2,
+        logDataVSPrior_m_avx2,
+        translate_avx2,
+        project3D_avx2,
+        project2D_avx2
+    },
+    {
+        "avx512",
+        logDataVSPrior_m_n_avx512,
+        logDataVSPrior_m_n_BF16_avx512,
+        logDataVSPrior_m_n_seg_avx512,
+        logDataVSPrior_m_n_seg_BF16_avx512,
+        logDataVSPrior_m_n_idx_avx512,
+        logDataVSPrior_m_n_idx_BF16_avx512,
+        logDataVSPrior_m_avx512,
+        translate_avx512,
+        project3D_avx512,
+        project2D_avx512
+    }
+#else
+    {
+        "avx2",
+        NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL
+    },
+    {
+        "avx512",
+        NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL
+    }
+#endif
+};
+
+/**
+ * the selected kernels, published with release and read with acquire, so that
+ * a thread seeing the pointer also sees the selection done before it
+ */
+static const KernelTable* _kernel = NULL;
+
+bool kernelSupported(const int path)
+{
+    switch (path)
+    {
+        case KERNEL_SCALAR:
+            return true;
+
+#ifdef KERNEL_MULTIVERSION
+        case KERNEL_AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+
+        case KERNEL_AVX512:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx512f") && kernelSupported(KERNEL_AVX2);
+#endif
+
+        default:
+            return false;
+    }
+}
+
+void kernelInit()
+{
+    #pragma omp critical (kernelInit)
+    if (_kernel == NULL)
+    {
+        int path = KERNEL_SCALAR;
+
+        for (int i = KERNEL_N_PATH - 1; i >= 0; i--)
+            if (kernelSupported(i))
+            {
+                path = i;
+                break;
+            }
+
+        const char* env = getenv(KERNEL_ENV);
+
+        if (env != NULL)
+        {
+            int request = -1;
+
+            for (int i = 0; i < KERNEL_N_PATH; i++)
+                if (strcmp(env, _kernelTable[i].name) == 0)
+                    request = i;
+
+            if (request == -1)
+            {
+                CLOG(WARNING, "LOGGER_SYS") << KERNEL_ENV << " = " << env
+                                            << " Is Not a Kernel Path, Using "
+                                            << _kernelTable[path].name;
+            }
+            else if (!kernelSupported(request))
+            {
+                CLOG(WARNING, "LOGGER_SYS") << "Kernel Path " << env
+                                            << " Is Not Supported by This CPU, Using "
+                                            << _kernelTable[path].name;
+            }
+            else
+                path = request;
+        }
+
+        CLOG(INFO, "LOGGER_SYS") << "Kernel Path : "
+                                 << _kernelTable[path].name
+                                 << ((env == NULL) ? " (CPUID)" : " (" KERNEL_ENV ")");
+
+        __atomic_store_n(&_kernel, &_kernelTable[path], __ATOMIC_RELEASE);
+    }
+}
+
+const KernelTable& kernel()
+{
+    const KernelTable* k = __atomic_load_n(&_kernel, __ATOMIC_ACQUIRE);
+
+    if (k == NULL)
+    {
+        kernelInit();
+
+        k = __atomic_load_n(&_kernel, __ATOMIC_ACQUIRE);
+    }
+
+    return *k;
+}
+
+const KernelTable& kernel(const int path)
+{
+    if (!kernelSupported(path))
+    {
+        REPORT_ERROR("KERNEL PATH NOT SUPPORTED");
+
+        abort();
+    }
+
+    return _kernelTable[path];
+}
@@ -129,7 +129,7 @@ void Model::initProjReco()
     BLOG(INFO, "LOGGER_INIT") << "Setting Up MPI Environment of Reconstructors";
 
     FOR_EACH_CLASS
-        _reco[l]->setMPIEnv(_commSize, _commRank, _hemi, _slav);
+        _reco[l]->setMPIEnv(_commSize, _commRank, _hemi, _slav, _node, _lead);
 
 #ifdef VERBOSE_LEVEL_1
     MPI_Barrier(_hemi);
@@ -955,12 +955,6 @@ RFLOAT Model::resolutionA(const RFLOAT thres) const
     return resP2A(resolutionP(thres), _size, _pixelSize);
 }
 
-void Model::setProjMaxRadius(const int maxRadius)
-{
-    FOR_EACH_CLASS
-        _proj[l].setMaxRadius(maxRadius);
-}
-
 void Model::refreshProj()
 {
     FOR_EACH_CLASS
@@ -979,18 +973,52 @@ void Model::refreshProj()
             Image tmp(_size, _size, FT_SPACE);
             SLC_EXTRACT_FT(tmp, _ref[l], 0);
 
-            _proj[l].setProjectee(tmp.copyImage());
+            _proj[l].setProjectee(boost::move(tmp), _r);
         }
         else if (_mode == MODE_3D)
         {
             _proj[l].setMode(MODE_3D);
 
-            _proj[l].setProjectee(_ref[l].copyVolume());
+            if (_node != MPI_COMM_NULL)
+            {
+                // one padded projectee per node, set by its leader and read by
+                // all the processes on it
+
+                if (_projWin.empty())
+                {
+                    _projWin.resize(_k);
+                    _projShared.resize(_k);
+
+                    for (int c = 0; c < _k; c++)
+                        _projShared[c] = (Complex*)MPI_Alloc_Shared(_projWin[c],
+                                                                    _proj[l].sizeFTPad(_size) * sizeof(Complex),
+                                                                    _node);
+                }
+
+                int nodeRank;
+                MPI_Comm_rank(_node, &nodeRank);
+
+                // no process is projecting while the projectee is overwritten
+
+                MPI_Win_fence(0, _projWin[l]);
+
+                if (nodeRank == 0)
+                    _proj[l].setProjectee(_ref[l].copyVolume(), _r, _projShared[l]);
+
+                MPI_Win_fence(0, _projWin[l]);
+
+                if (nodeRank != 0)
+                    _proj[l].attachProjectee(_projShared[l], _size, _r);
+            }
+            else
+            {
+                // the copy is taken by the inverse Fourier transform
+
+                _proj[l].setProjectee(_ref[l].copyVolume(), _r);
+            }
         }
         else
             REPORT_ERROR("INEXISTENT MODE");
-
-        _proj[l].setMaxRadius(_r);
     }
 }
 
@@ -1524,6 +1552,18 @@ void Model::clear()
 
     _proj.clear();
     _reco.clear();
+
+    // the windows are freed by MPI_Finalize if it is done
+
+    int finalized;
+    MPI_Finalized(&finalized);
+
+    if (!finalized)
+        for (size_t l = 0; l < _projWin.size(); l++)
+            MPI_Win_free(&_projWin[l]);
+
+    _projWin.clear();
+    _projShared.clear();
 }
 
 #ifdef MODEL_DETERMINE_INCREASE_R_R_CHANGE
@@ -1762,3 +1802,91 @@ void Model::avgHemi()
         }
     }
 }
+
+void Model::pack(vector<double>& dst) const
+{
+    packMatrix(dst, _FSC);
+    packMatrix(dst, _SNR);
+    packMatrix(dst, _tau);
+    packMatrix(dst, _sig);
+
+    dst.push_back(_r);
+    dst.push_back(_rInit);
+    dst.push_back(_rU);
+    dst.push_back(_rPrev);
+    dst.push_back(_rUPrev);
+    dst.push_back(_rT);
+    dst.push_back(_res);
+    dst.push_back(_resT);
+    dst.push_back(_rGlobal);
+
+    dst.push_back(_rVari);
+    dst.push_back(_tVariS0);
+    dst.push_back(_tVariS1);
+    dst.push_back(_tVariS0Prev);
+    dst.push_back(_tVariS1Prev);
+    dst.push_back(_stdRVari);
+    dst.push_back(_stdTVariS0);
+    dst.push_back(_stdTVariS1);
+
+    dst.push_back(_fscArea);
+    dst.push_back(_fscAreaPrev);
+
+    dst.push_back(_rChange);
+    dst.push_back(_rChangePrev);
+    dst.push_back(_stdRChange);
+    dst.push_back(_stdRChangePrev);
+
+    dst.push_back(_nRChangeNoDecrease);
+    dst.push_back(_nTopResNoImprove);
+
+    dst.push_back(_searchType);
+    dst.push_back(_searchTypePrev);
+
+    dst.push_back(_increaseR);
+}
+
+const double* Model::unpack(const double* src)
+{
+    src = unpackMatrix(_FSC, src);
+    src = unpackMatrix(_SNR, src);
+    src = unpackMatrix(_tau, src);
+    src = unpackMatrix(_sig, src);
+
+    _r = (int)*src++;
+    _rInit = (int)*src++;
+    _rU = (int)*src++;
+    _rPrev = (int)*src++;
+    _rUPrev = (int)*src++;
+    _rT = (int)*src++;
+    _res = (int)*src++;
+    _resT = (int)*src++;
+    _rGlobal = (int)*src++;
+
+    _rVari = *src++;
+    _tVariS0 = *src++;
+    _tVariS1 = *src++;
+    _tVariS0Prev = *src++;
+    _tVariS1Prev = *src++;
+    _stdRVari = *src++;
+    _stdTVariS0 = *src++;
+    _stdTVariS1 = *src++;
+
+    _fscArea = *src++;
+    _fscAreaPrev = *src++;
+
+    _rChange = *src++;
+    _rChangePrev = *src++;
+    _stdRChange = *src++;
+    _stdRChangePrev = *src++;
+
+    _nRChangeNoDecrease = (int)*src++;
+    _nTopResNoImprove = (int)*src++;
+
+    _searchType = (int)*src++;
+    _searchTypePrev = (int)*src++;
+
+    _increaseR = (*src++ != 0);
+
+    return src;
+}
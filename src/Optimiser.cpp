@@ -9,19 +9,6 @@
 
 #include "Optimiser.h"
 
-#ifdef ENABLE_SIMD_512
- RFLOAT* logDataVSPrior_m_n_huabin_SIMD512(Complex* dat, const Complex* pri, const RFLOAT* ctf, const RFLOAT* sigRcp, const int n, const int m, RFLOAT *SIMDResult);
- RFLOAT logDataVSPrior_m_huabin_SIMD512(Complex* dat, const Complex* pri, const RFLOAT* ctf, const RFLOAT* sigRcp, const int m);
-#else
-#ifdef ENABLE_SIMD_256
- RFLOAT* logDataVSPrior_m_n_huabin_SIMD256(Complex* dat, const Complex* pri, const RFLOAT* ctf, const RFLOAT* sigRcp, const int n, const int m, RFLOAT *SIMDResult);
- RFLOAT logDataVSPrior_m_huabin_SIMD256(Complex* dat, const Complex* pri, const RFLOAT* ctf, const RFLOAT* sigRcp, const int m);
-#else
-   RFLOAT logDataVSPrior_m_huabin(const Complex* dat, const Complex* pri, const RFLOAT* ctf, const RFLOAT* sigRcp, const int m);
-   RFLOAT*  logDataVSPrior_m_n_huabin(const Complex* dat, const Complex* pri, const RFLOAT* ctf, const RFLOAT* sigRcp, const int n, const int m, RFLOAT *result);
-#endif
-#endif
-
 void compareDVPVariable(vec& dvpHuabin, vec& dvpOrig, int processRank, int threadID, int n ,int m)
 {
     fprintf(stderr, "n = %d, m = %d\n", n, m);
@@ -125,6 +112,11 @@ void Optimiser::setPara(const OptimiserPara& para)
     _para = para;
 }
 
+double Optimiser::stageTime(const int stage) const
+{
+    return _stageTime[stage];
+}
+
 void Optimiser::init()
 {
 
@@ -148,8 +140,10 @@ void Optimiser::init()
         abort();
     }
 
+    kernelInit();
+
     MLOG(INFO, "LOGGER_INIT") << "Setting MPI Environment of _model";
-    _model.setMPIEnv(_commSize, _commRank, _hemi, _slav);
+    _model.setMPIEnv(_commSize, _commRank, _hemi, _slav, _node, _lead);
 
     MLOG(INFO, "LOGGER_INIT") << "Setting up Symmetry";
     _sym.init(_para.sym);
@@ -370,6 +364,15 @@ void Optimiser::init()
 #endif
     }
 
+    if (_para.resume)
+    {
+        MLOG(INFO, "LOGGER_INIT") << "Restoring Optimiser from Checkpoint";
+
+        loadCheckpoint();
+
+        return;
+    }
+
     NT_MASTER
     {
         ALOG(INFO, "LOGGER_INIT") << "Initialising IDs of 2D Images";
@@ -406,8 +409,12 @@ void Optimiser::init()
         ALOG(INFO, "LOGGER_INIT") << "Initialising 2D Images";
         BLOG(INFO, "LOGGER_INIT") << "Initialising 2D Images";
 
+        switchStage(OPTIMISER_STAGE_INIT_IMG);
+
         initImg();
 
+        switchStage(OPTIMISER_STAGE_NONE);
+
 #ifdef OPTIMISER_LOG_MEM_USAGE
         CHECK_MEMORY_USAGE("After Initialising 2D Images");
 #endif
@@ -432,6 +439,12 @@ void Optimiser::init()
         CHECK_MEMORY_USAGE("After Initialsing CTFs");
 #endif
 
+#ifdef OPTIMISER_IMG_CACHE
+        if (_cache == NULL) saveImgCache();
+
+        closeImgCache();
+#endif
+
 #ifdef VERBOSE_LEVEL_1
         MPI_Barrier(_hemi);
 
@@ -650,6 +663,64 @@ struct SpWeightComparator
     }
 };
 
+/**
+ * This function interpolates bilinearly the log-likelihood of a translation
+ * from the correlation map of logDataVSPriorTrans, of the 4 pixels idx around
+ * it weighted by w.
+ */
+static inline RFLOAT transLookup(const RFLOAT* map,
+                                 const int* idx,
+                                 const RFLOAT* w)
+{
+    return w[0] * map[idx[0]]
+         + w[1] * map[idx[1]]
+         + w[2] * map[idx[2]]
+         + w[3] * map[idx[3]];
+}
+
+/**
+ * This function accumulates the weight of image l at class t, rotation m and
+ * translation n of the global search, of log-likelihood dvp. The weights are
+ * kept relative to the highest log-likelihood so far, the baseline, thus
+ * rescaled when it rises.
+ */
+static void accumulateGlobalWeight(mat& wC,
+                                   vector<mat>& wR,
+                                   vector<mat>& wT,
+                                   RFLOAT& baseLine,
+                                   const Particle& par,
+                                   const int l,
+                                   const int t,
+                                   const int m,
+                                   const int n,
+                                   const RFLOAT dvp)
+{
+    if (TSGSL_isnan(baseLine))
+        baseLine = dvp;
+    else if (dvp > baseLine)
+    {
+        RFLOAT nf = exp(baseLine - dvp);
+
+        wC.row(l) *= nf;
+
+        for (size_t td = 0; td < wR.size(); td++)
+        {
+            wR[td].row(l) *= nf;
+            wT[td].row(l) *= nf;
+        }
+
+        baseLine = dvp;
+    }
+
+    RFLOAT w = exp(dvp - baseLine);
+
+    wC(l, t) += w * (par.wR(m) * par.wT(n));
+
+    wR[t](l, m) += w * par.wT(n);
+
+    wT[t](l, n) += w * par.wR(m);
+}
+
 void Optimiser::expectation()
 {
     IF_MASTER return;
@@ -720,37 +791,100 @@ void Optimiser::expectation()
         ALOG(INFO, "LOGGER_ROUND") << "Minimum Standard Deviation of Translation in Scanning Phase: "
                                    << scanMinStdT;
 
+#ifdef OPTIMISER_GLOBAL_TRANS_FFT
+        // the log-likelihood of all the translations is given by an inverse
+        // Fourier transform per image and rotation, instead of scoring nT phase
+        // images, which requires the full CTF and sigma rows
+
+        bool transFFT = (_datP != NULL)
+                     && (_ctfP != NULL)
+                     && ((double)nT * _nPxl
+                       > GLOBAL_TRANS_FFT_COST
+                       * TSGSL_pow_2(_para.size)
+                       * log2(TSGSL_pow_2(_para.size)));
+#else
+        bool transFFT = false;
+#endif
+
         Particle par = _par[0].copy();
 
         par.reset(_para.k, nR, nT, 1);
 
+        dmat22 rot2D;
+        dmat33 rot3D;
+        dvec2 t;
+
+        if (transFFT)
+        {
+            ALOG(INFO, "LOGGER_ROUND") << "Scoring "
+                                       << nT
+                                       << " Translations by Cross-correlation";
+            BLOG(INFO, "LOGGER_ROUND") << "Scoring "
+                                       << nT
+                                       << " Translations by Cross-correlation";
+        }
+
         FOR_EACH_2D_IMAGE
         {
             // the previous top class, translation, rotation remain
             par.copy(_par[l]);
         }
 
-        dmat22 rot2D;
-        dmat33 rot3D;
-        dvec2 t;
-
         // generate "translations"
 
-        Complex* traP = (Complex*)TSFFTW_malloc(nT * _nPxl * sizeof(Complex));
+        Complex* traP = NULL;
+
+        // the indices in the correlation map of the 4 pixels around each
+        // translation and their weights of bilinear interpolation, so that the
+        // translations keep their sub-pixel samples and are scored apart
 
-        #pragma omp parallel for schedule(dynamic) private(t)
-        for (size_t m = 0; m < (size_t)nT; m++)
+        vector<int> traIdx;
+        vector<RFLOAT> traW;
+
+        if (transFFT)
         {
-            par.t(t, m);
+            traIdx.resize(4 * nT);
+            traW.resize(4 * nT);
 
-            translate(traP + m * _nPxl,
-                      t(0),
-                      t(1),
-                      _para.size,
-                      _para.size,
-                      _iCol,
-                      _iRow,
-                      _nPxl);
+            for (int n = 0; n < nT; n++)
+            {
+                par.t(t, n);
+
+                int x0 = (int)floor(t(0));
+                int y0 = (int)floor(t(1));
+
+                RFLOAT fx = t(0) - x0;
+                RFLOAT fy = t(1) - y0;
+
+                for (int j = 0; j < 2; j++)
+                    for (int i = 0; i < 2; i++)
+                    {
+                        int x = ((x0 + i) % _para.size + _para.size) % _para.size;
+                        int y = ((y0 + j) % _para.size + _para.size) % _para.size;
+
+                        traIdx[4 * n + 2 * j + i] = y * _para.size + x;
+                        traW[4 * n + 2 * j + i] = (i ? fx : 1 - fx) * (j ? fy : 1 - fy);
+                    }
+            }
+        }
+        else
+        {
+            traP = (Complex*)TSFFTW_malloc(nT * _nPxl * sizeof(Complex));
+
+            #pragma omp parallel for schedule(dynamic) private(t)
+            for (size_t m = 0; m < (size_t)nT; m++)
+            {
+                par.t(t, m);
+
+                translate(traP + m * _nPxl,
+                          t(0),
+                          t(1),
+                          _para.size,
+                          _para.size,
+                          _iCol,
+                          _iRow,
+                          _nPxl);
+            }
         }
 
         mat wC = mat::Zero(_ID.size(), _para.k);
@@ -783,6 +917,215 @@ void Optimiser::expectation()
         Complex* poolPriRotP = (Complex*)TSFFTW_malloc(_nPxl * omp_get_max_threads() * sizeof(Complex));
         Complex* poolPriAllP = (Complex*)TSFFTW_malloc(_nPxl * omp_get_max_threads() * sizeof(Complex));
 
+        // correlation map and its Fourier transform of each thread
+
+        RFLOAT* poolMap = NULL;
+        Complex* poolMapFT = NULL;
+
+        TSFFTW_PLAN planMap = NULL;
+
+        size_t mapSize = (size_t)_para.size * _para.size;
+        size_t mapSizeFT = (size_t)_para.size * (_para.size / 2 + 1);
+
+        if (transFFT)
+        {
+            poolMap = (RFLOAT*)TSFFTW_malloc(mapSize * omp_get_max_threads() * sizeof(RFLOAT));
+            poolMapFT = (Complex*)TSFFTW_malloc(mapSizeFT * omp_get_max_threads() * sizeof(Complex));
+
+            planMap = TSFFTW_plan_dft_c2r_2d(_para.size,
+                                             _para.size,
+                                             (TSFFTW_COMPLEX*)poolMapFT,
+                                             poolMap,
+                                             FFTW_ESTIMATE);
+        }
+
+        size_t nImg = _ID.size();
+
+        // image, row of CTF and row of sigma of each column of pixel major data
+
+        vector<int> colImg(nImg);
+        vector<int> colCTF(nImg);
+        vector<int> colSig(nImg);
+
+        FOR_EACH_2D_IMAGE
+        {
+            colImg[_jImgP[l]] = l;
+            colCTF[_jImgP[l]] = _iCTFP[l];
+            colSig[_jImgP[l]] = _iSigP[l];
+        }
+
+        // the pixels within the coarse radius are the first nPxlC ones
+
+        int nPxlC = nPxlBelow(_r * GLOBAL_PRUNE_R_FACTOR);
+
+#ifdef OPTIMISER_GLOBAL_PRUNE
+        // the pruned scoring does not support compact rows of CTF and sigma
+
+        bool prune = (_ctfPC == NULL)
+                  && (nPxlC > 0)
+                  && (nPxlC <= _nPxl * GLOBAL_PRUNE_MAX_PXL_FRACTION);
+#else
+        bool prune = false;
+#endif
+
+        // coarse log-likelihood of image l at class t and rotation m, the best
+        // one among the translations, stored at (t * nR + m) * nImg + l
+
+        RFLOAT* scoreC = NULL;
+
+        // rotations of image l of coarse log-likelihood below thresC[l] are
+        // pruned
+
+        RFLOAT* thresC = NULL;
+
+        int* poolIdx = NULL;
+
+        if (prune)
+        {
+            ALOG(INFO, "LOGGER_ROUND") << "Coarse Scoring of Global Search on "
+                                       << nPxlC
+                                       << " out of "
+                                       << _nPxl
+                                       << " Pixels";
+            BLOG(INFO, "LOGGER_ROUND") << "Coarse Scoring of Global Search on "
+                                       << nPxlC
+                                       << " out of "
+                                       << _nPxl
+                                       << " Pixels";
+
+            scoreC = (RFLOAT*)TSFFTW_malloc((size_t)_para.k * nR * nImg * sizeof(RFLOAT));
+
+            for (size_t t = 0; t < (size_t)_para.k; t++)
+            {
+                #pragma omp parallel for schedule(dynamic) private(rot2D, rot3D)
+                for (size_t m = 0; m < (size_t)nR; m++)
+                {
+                    Complex* priRotP = poolPriRotP + _nPxl * omp_get_thread_num();
+
+                    Complex* priAllP = poolPriAllP + _nPxl * omp_get_thread_num();
+
+                    RFLOAT* SIMDResult = poolSIMDResult + omp_get_thread_num() * nImg;
+
+                    RFLOAT* score = scoreC + (t * nR + m) * nImg;
+
+                    if (_para.mode == MODE_2D)
+                    {
+                        par.rot(rot2D, m);
+
+                        _model.proj(t).project(priRotP, rot2D, _iCol, _iRow, nPxlC);
+                    }
+                    else if (_para.mode == MODE_3D)
+                    {
+                        par.rot(rot3D, m);
+
+                        _model.proj(t).project(priRotP, rot3D, _iCol, _iRow, nPxlC);
+                    }
+                    else
+                    {
+                        REPORT_ERROR("INEXISTENT MODE");
+
+                        abort();
+                    }
+
+                    if (transFFT)
+                    {
+                        RFLOAT* map = poolMap + mapSize * omp_get_thread_num();
+                        Complex* mapFT = poolMapFT + mapSizeFT * omp_get_thread_num();
+
+                        FOR_EACH_2D_IMAGE
+                        {
+                            int j = _jImgP[l];
+
+                            logDataVSPriorTrans(map,
+                                                mapFT,
+                                                planMap,
+                                                _datP + j,
+                                                priRotP,
+                                                _ctfP + colCTF[j],
+                                                _sigRcpP + colSig[j],
+                                                nImg,
+                                                _nCTFP,
+                                                _nSigP,
+                                                _para.size,
+                                                _para.size,
+                                                _iCol,
+                                                _iRow,
+                                                nPxlC);
+
+                            score[l] = transLookup(map, &traIdx[0], &traW[0]);
+
+                            for (int n = 1; n < nT; n++)
+                                score[l] = GSL_MAX(score[l],
+                                                   transLookup(map,
+                                                               &traIdx[4 * n],
+                                                               &traW[4 * n]));
+                        }
+                    }
+                    else
+                    {
+                        for (size_t n = 0; n < (size_t)nT; n++)
+                        {
+                            for (int i = 0; i < nPxlC; i++)
+                                priAllP[i] = traP[_nPxl * n + i] * priRotP[i];
+
+                            memset(SIMDResult, '\0', nImg * sizeof(RFLOAT));
+
+                            RFLOAT* dvp = logDataVSPriorP(SIMDResult, priAllP, nPxlC);
+
+                            FOR_EACH_2D_IMAGE
+                            {
+                                RFLOAT dvpL = dvp[_jImgP[l]];
+
+                                if ((n == 0) || (dvpL > score[l])) score[l] = dvpL;
+                            }
+                        }
+                    }
+                }
+            }
+
+            size_t nPose = (size_t)_para.k * nR;
+
+            size_t nKeep = GSL_MAX(1, (size_t)ceil(nPose * GLOBAL_PRUNE_KEEP));
+
+            thresC = new RFLOAT[nImg];
+
+            RFLOAT* poolScore = (RFLOAT*)TSFFTW_malloc(nPose * omp_get_max_threads() * sizeof(RFLOAT));
+
+            size_t nSurvive = 0;
+
+            #pragma omp parallel for reduction(+:nSurvive)
+            FOR_EACH_2D_IMAGE
+            {
+                RFLOAT* score = poolScore + nPose * omp_get_thread_num();
+
+                for (size_t p = 0; p < nPose; p++)
+                    score[p] = scoreC[p * nImg + l];
+
+                // the nKeep best poses are always kept
+
+                std::nth_element(score,
+                                 score + nKeep - 1,
+                                 score + nPose,
+                                 std::greater<RFLOAT>());
+
+                RFLOAT best = *std::max_element(score, score + nKeep);
+
+                thresC[l] = GSL_MIN(best - GLOBAL_PRUNE_MARGIN, score[nKeep - 1]);
+
+                for (size_t p = 0; p < nPose; p++)
+                    if (scoreC[p * nImg + l] >= thresC[l]) nSurvive += 1;
+            }
+
+            TSFFTW_free(poolScore);
+
+            ALOG(INFO, "LOGGER_ROUND") << 100.0 * nSurvive / (nPose * nImg)
+                                       << "\% of Poses Kept for Scoring at Full Resolution";
+            BLOG(INFO, "LOGGER_ROUND") << 100.0 * nSurvive / (nPose * nImg)
+                                       << "\% of Poses Kept for Scoring at Full Resolution";
+
+            poolIdx = new int[nImg * omp_get_max_threads()];
+        }
+
         for (size_t t = 0; t < (size_t)_para.k; t++)
         {
             #pragma omp parallel for schedule(dynamic) private(rot2D, rot3D)
@@ -796,131 +1139,149 @@ void Optimiser::expectation()
                 //Add by huabin
                 RFLOAT* SIMDResult = poolSIMDResult + omp_get_thread_num() * _ID.size();
 
-                // perform projection
+                // columns to be scored, all of them unless pruned
 
-                if (_para.mode == MODE_2D)
-                {
-                    par.rot(rot2D, m);
+                int nIdx = (int)nImg;
 
-                    _model.proj(t).project(priRotP, rot2D, _iCol, _iRow, _nPxl);
-                }
-                else if (_para.mode == MODE_3D)
-                {
-                    par.rot(rot3D, m);
+                int* idx = NULL;
 
-                    _model.proj(t).project(priRotP, rot3D, _iCol, _iRow, _nPxl);
-                }
-                else
+                if (prune)
                 {
-                    REPORT_ERROR("INEXISTENT MODE");
+                    idx = poolIdx + nImg * omp_get_thread_num();
 
-                    abort();
+                    const RFLOAT* score = scoreC + (t * nR + m) * nImg;
+
+                    nIdx = 0;
+
+                    for (size_t j = 0; j < nImg; j++)
+                        if (score[colImg[j]] >= thresC[colImg[j]])
+                            idx[nIdx++] = j;
                 }
 
-                for (size_t n = 0; n < (size_t)nT; n++)
+                if (nIdx > 0)
                 {
-                    for (int i = 0; i < _nPxl; i++)
-                        priAllP[i] = traP[_nPxl * n + i] * priRotP[i];
-
-                    // higher logDataVSPrior, higher probability
-
-                    //Add by huabin
-                    memset(SIMDResult, '\0', _ID.size() * sizeof(RFLOAT));
-
-#ifdef ENABLE_SIMD_512
-            RFLOAT* dvp = logDataVSPrior_m_n_huabin_SIMD512(_datP,
-                                             priAllP,
-                                             _ctfP,
-                                             _sigRcpP,
-                                             (int)_ID.size(),
-                                             _nPxl,
-                                             SIMDResult);
-#else
-#ifdef ENABLE_SIMD_256
-            RFLOAT* dvp = logDataVSPrior_m_n_huabin_SIMD256(_datP,
-                                             priAllP,
-                                             _ctfP,
-                                             _sigRcpP,
-                                             (int)_ID.size(),
-                                             _nPxl,
-                                             SIMDResult);
-#else
-            RFLOAT* dvp = logDataVSPrior_m_n_huabin(_datP,
-                                             priAllP,
-                                             _ctfP,
-                                             _sigRcpP,
-                                             (int)_ID.size(),
-                                             _nPxl,
-                                             SIMDResult);
-#endif
-#endif
+                    // perform projection
 
-#ifndef NAN_NO_CHECK
+                    if (_para.mode == MODE_2D)
+                    {
+                        par.rot(rot2D, m);
 
-           SEGMENT_NAN_CHECK(dvp, _ID.size());
+                        _model.proj(t).project(priRotP, rot2D, _iCol, _iRow, _nPxl);
+                    }
+                    else if (_para.mode == MODE_3D)
+                    {
+                        par.rot(rot3D, m);
 
-#endif
+                        _model.proj(t).project(priRotP, rot3D, _iCol, _iRow, _nPxl);
+                    }
+                    else
+                    {
+                        REPORT_ERROR("INEXISTENT MODE");
 
-                    FOR_EACH_2D_IMAGE
+                        abort();
+                    }
+
+                    if (transFFT)
                     {
-                        omp_set_lock(&mtx[l]);
+                        RFLOAT* map = poolMap + mapSize * omp_get_thread_num();
+                        Complex* mapFT = poolMapFT + mapSizeFT * omp_get_thread_num();
 
-                        if (TSGSL_isnan(baseLine[l]))
-                            baseLine[l] = dvp[l];
-                        else
+                        for (int k = 0; k < nIdx; k++)
                         {
-                            if (dvp[l] > baseLine[l])
-                            {
-                                RFLOAT offset = dvp[l] - baseLine[l];
+                            int j = (idx == NULL) ? k : idx[k];
+
+                            logDataVSPriorTrans(map,
+                                                mapFT,
+                                                planMap,
+                                                _datP + j,
+                                                priRotP,
+                                                _ctfP + colCTF[j],
+                                                _sigRcpP + colSig[j],
+                                                nImg,
+                                                _nCTFP,
+                                                _nSigP,
+                                                _para.size,
+                                                _para.size,
+                                                _iCol,
+                                                _iRow,
+                                                _nPxl);
 
-                                RFLOAT nf = exp(-offset);
+#ifndef NAN_NO_CHECK
 
-                                wC.row(l) *= nf;
+               SEGMENT_NAN_CHECK(map, mapSize);
 
-                                for (int td = 0; td < _para.k; td++)
-                                {
-                                    wR[td].row(l) *= nf;
-                                    wT[td].row(l) *= nf;
-                                }
+#endif
 
-                                /***
-                                RFLOAT nf = exp(offset);
+                            int l = colImg[j];
 
-                                if (TSGSL_isinf(nf))
-                                {
-                                    wC.row(l) = vec::Zero(_para.k).transpose();
-                                    wR.row(l) = vec::Zero(nR).transpose();
-                                    wT.row(l) = vec::Zero(nT).transpose();
-                                }
-                                else
-                                {
-                                    wC.row(l) /= nf;
-                                    wR.row(l) /= nf;
-                                    wT.row(l) /= nf;
-                                }
-                                ***/
+                            omp_set_lock(&mtx[l]);
 
-                                baseLine[l] += offset;
-                            }
+                            for (int n = 0; n < nT; n++)
+                                accumulateGlobalWeight(wC,
+                                                       wR,
+                                                       wT,
+                                                       baseLine[l],
+                                                       _par[l],
+                                                       l,
+                                                       t,
+                                                       m,
+                                                       n,
+                                                       transLookup(map,
+                                                                   &traIdx[4 * n],
+                                                                   &traW[4 * n]));
+
+                            omp_unset_lock(&mtx[l]);
                         }
+                    }
+                    else
+                    {
+                        for (size_t n = 0; n < (size_t)nT; n++)
+                        {
+                            for (int i = 0; i < _nPxl; i++)
+                                priAllP[i] = traP[_nPxl * n + i] * priRotP[i];
+
+                            // higher logDataVSPrior, higher probability
 
-                        RFLOAT w = exp(dvp[l] - baseLine[l]);
+                            //Add by huabin
+                            memset(SIMDResult, '\0', nIdx * sizeof(RFLOAT));
 
-                        /***
-                        wC(l, t) += w;
+                            RFLOAT* dvp = (idx == NULL)
+                                        ? logDataVSPriorP(SIMDResult, priAllP, _nPxl)
+                                        : logDataVSPriorP(SIMDResult,
+                                                          priAllP,
+                                                          nIdx,
+                                                          idx,
+                                                          &colCTF[0],
+                                                          &colSig[0]);
 
-                        wR(l, m) += w;
+#ifndef NAN_NO_CHECK
+
+               SEGMENT_NAN_CHECK(dvp, nIdx);
+
+#endif
 
-                        wT(l, n) += w;
-                        ***/
+                            for (int k = 0; k < nIdx; k++)
+                            {
+                                // dvp[k] is of column k, or column idx[k] when pruned
 
-                        wC(l, t) += w * (_par[l].wR(m) * _par[l].wT(n));
+                                int l = colImg[(idx == NULL) ? k : idx[k]];
 
-                        wR[t](l, m) += w * _par[l].wT(n);
+                                omp_set_lock(&mtx[l]);
 
-                        wT[t](l, n) += w * _par[l].wR(m);
+                                accumulateGlobalWeight(wC,
+                                                       wR,
+                                                       wT,
+                                                       baseLine[l],
+                                                       _par[l],
+                                                       l,
+                                                       t,
+                                                       m,
+                                                       n,
+                                                       dvp[k]);
 
-                        omp_unset_lock(&mtx[l]);
+                                omp_unset_lock(&mtx[l]);
+                            }
+                        }
                     }
                 }
 
@@ -947,6 +1308,22 @@ void Optimiser::expectation()
         TSFFTW_free(poolPriRotP);
         TSFFTW_free(poolPriAllP);
 
+        if (transFFT)
+        {
+            TSFFTW_destroy_plan(planMap);
+
+            TSFFTW_free(poolMap);
+            TSFFTW_free(poolMapFT);
+        }
+
+        if (prune)
+        {
+            TSFFTW_free(scoreC);
+
+            delete[] thresC;
+            delete[] poolIdx;
+        }
+
         delete[] mtx;
         delete[] baseLine;
         
@@ -1178,6 +1555,33 @@ void Optimiser::expectation()
     _nI = 0;
 
     nPer = 0;
+
+#ifdef OPTIMISER_SELECTIVE_SEARCH
+    bool selective = (_searchType == SEARCH_TYPE_LOCAL);
+#else
+    bool selective = false;
+#endif
+
+    if ((!selective) || (_track.size() != _ID.size()))
+    {
+        _track.resize(_ID.size());
+
+        FOR_EACH_2D_IMAGE
+            _track[l].nStable = -1;
+    }
+
+    // the top pose of a stable image remains valid only at the same resolution
+
+    bool skip = selective && (_r == _rTrack);
+
+    _rTrack = _r;
+
+    long nFull = 0;
+    long nReduced = 0;
+    long nSkip = 0;
+
+    if (_cost.size() != _ID.size())
+        _cost.resize(_ID.size(), 0);
     
     Complex* poolPriRotP = (Complex*)TSFFTW_malloc(_nPxl * omp_get_max_threads() * sizeof(Complex));
     Complex* poolPriAllP = (Complex*)TSFFTW_malloc(_nPxl * omp_get_max_threads() * sizeof(Complex));
@@ -1189,9 +1593,39 @@ void Optimiser::expectation()
     if (_searchType == SEARCH_TYPE_CTF)
         poolCtfP = (RFLOAT*)TSFFTW_malloc(_para.mLD * _nPxl * omp_get_max_threads() * sizeof(RFLOAT));
 
-    #pragma omp parallel for schedule(dynamic)
+    #pragma omp parallel for schedule(dynamic) reduction(+:nFull, nReduced, nSkip)
     FOR_EACH_2D_IMAGE
     {
+        int budget = selective ? searchBudget(l, skip) : SEARCH_BUDGET_FULL;
+
+        double start = omp_get_wtime();
+
+        if (budget == SEARCH_BUDGET_SKIP)
+        {
+            // the particle filter of the previous iteration remains, and the
+            // image is examined again by the reduced schedule next time, the
+            // cost of its last search is kept for balancing the load
+
+            nSkip += 1;
+
+            _nP[l] = 0;
+
+            _track[l].nStable = SELECTIVE_N_ITER_REDUCE;
+
+            #pragma omp atomic
+            _nI += 1;
+
+            continue;
+        }
+
+        if (budget == SEARCH_BUDGET_REDUCED)
+            nReduced += 1;
+        else
+            nFull += 1;
+
+        int nPhase = (budget == SEARCH_BUDGET_REDUCED)
+                   ? N_PHASE_REDUCED_SEARCH
+                   : MAX_N_PHASE_PER_ITER;
 
         Complex* priRotP = poolPriRotP + _nPxl * omp_get_thread_num();
         Complex* priAllP = poolPriAllP + _nPxl * omp_get_thread_num();
@@ -1210,7 +1644,7 @@ void Optimiser::expectation()
         double tVariS1 = 5 * _para.transS;
         double dVari = 5 * _para.ctfRefineS;
 #endif
-        for (int phase = (_searchType == SEARCH_TYPE_GLOBAL) ? 1 : 0; phase < MAX_N_PHASE_PER_ITER; phase++)
+        for (int phase = (_searchType == SEARCH_TYPE_GLOBAL) ? 1 : 0; phase < nPhase; phase++)
         {
 #ifdef OPTIMISER_GLOBAL_PERTURB_LARGE
             if (phase == (_searchType == SEARCH_TYPE_GLOBAL) ? 1 : 0)
@@ -1282,22 +1716,11 @@ void Optimiser::expectation()
                     {
                         _par[l].d(d, iD);
 
-                        for (int i = 0; i < _nPxl; i++)
-                        {
-                            RFLOAT ki = _K1[l]
-                                      * _defocusP[l * _nPxl + i]
-                                      * d
-                                      * TSGSL_pow_2(_frequency[i])
-                                      + _K2[l]
-                                      * TSGSL_pow_4(_frequency[i])
-                                      - _ctfAttr[l].phaseShift;
-
-                            //ctfP[_nPxl * iD + i] = -w1 * TS_SIN(ki) + w2 * TS_COS(ki);
-                            ctfP[_nPxl * iD + i] = -TS_SQRT(1 - TSGSL_pow_2(_ctfAttr[l].amplitudeContrast))
-                                                 * TS_SIN(ki)
-                                                 + _ctfAttr[l].amplitudeContrast
-                                                 * TS_COS(ki);
-                        }
+                        CTFFromTerm(ctfP + _nPxl * iD,
+                                    _ctfTermDf + (size_t)_iCTFTerm[l] * _nPxl,
+                                    _ctfTermC + (size_t)_iCTFTerm[l] * _nPxl,
+                                    d,
+                                    _nPxl);
                     }
                 }
 
@@ -1352,61 +1775,23 @@ void Optimiser::expectation()
 
                             RFLOAT w;
 
-#ifdef ENABLE_SIMD_512
                             if (_searchType != SEARCH_TYPE_CTF)
                             {
-                                w = logDataVSPrior_m_huabin_SIMD512(_datP + l * _nPxl,
-                                                   priAllP,
-                                                   _ctfP + l * _nPxl,
-                                                   _sigRcpP + l * _nPxl,
-                                                   _nPxl);
+                                w = kernel().logDataVSPrior_m(_datP + l * _nPxl,
+                                                              priAllP,
+                                                              _ctfP + _iCTFP[l] * _nPxl,
+                                                              _sigRcpP + _iSigP[l] * _nPxl,
+                                                              _nPxl);
                             }
                             else
                             {
-                                w = logDataVSPrior_m_huabin_SIMD512(_datP + l * _nPxl,
-                                                   priAllP,
-                                                   ctfP + iD * _nPxl,
-                                                   _sigRcpP + l * _nPxl,
-                                                   _nPxl);
+                                w = kernel().logDataVSPrior_m(_datP + l * _nPxl,
+                                                              priAllP,
+                                                              ctfP + iD * _nPxl,
+                                                              _sigRcpP + _iSigP[l] * _nPxl,
+                                                              _nPxl);
                             }
-#else
-#ifdef ENABLE_SIMD_256
-                            if (_searchType != SEARCH_TYPE_CTF)
-                            {
-                                w = logDataVSPrior_m_huabin_SIMD256(_datP + l * _nPxl,
-                                                   priAllP,
-                                                   _ctfP + l * _nPxl,
-                                                   _sigRcpP + l * _nPxl,
-                                                   _nPxl);
-                            }
-                            else
-                            {
-                                w = logDataVSPrior_m_huabin_SIMD256(_datP + l * _nPxl,
-                                                   priAllP,
-                                                   ctfP + iD * _nPxl,
-                                                   _sigRcpP + l * _nPxl,
-                                                   _nPxl);
-                            }
-#else
-                            if (_searchType != SEARCH_TYPE_CTF)
-                            {
-                                w = logDataVSPrior_m_huabin(_datP + l * _nPxl,
-                                                   priAllP,
-                                                   _ctfP + l * _nPxl,
-                                                   _sigRcpP + l * _nPxl,
-                                                   _nPxl);
-                            }
-                            else
-                            {
-                                w = logDataVSPrior_m_huabin(_datP + l * _nPxl,
-                                                   priAllP,
-                                                   ctfP + iD * _nPxl,
-                                                   _sigRcpP + l * _nPxl,
-                                                   _nPxl);
-                            }
-#endif
-#endif
-                            
+
                             baseLine = TSGSL_isnan(baseLine) ? w : baseLine;
 
                             if (w > baseLine)
@@ -1642,6 +2027,21 @@ void Optimiser::expectation()
             }
         }
 
+        if (budget == SEARCH_BUDGET_REDUCED)
+        {
+            _nP[l] = nPhase;
+
+            #pragma omp atomic
+            _nF += nPhase;
+
+            #pragma omp atomic
+            _nI += 1;
+        }
+
+        if (selective) refreshTrack(l);
+
+        _cost[l] = omp_get_wtime() - start;
+
         #pragma omp critical  (line1495)
         if (_nI > (int)(_ID.size() / 10))
         {
@@ -1694,6 +2094,28 @@ void Optimiser::expectation()
     if (_searchType == SEARCH_TYPE_CTF)
         TSFFTW_free(poolCtfP);
 
+    if (selective)
+    {
+        MPI_Allreduce(MPI_IN_PLACE, &nFull, 1, MPI_LONG, MPI_SUM, _hemi);
+        MPI_Allreduce(MPI_IN_PLACE, &nReduced, 1, MPI_LONG, MPI_SUM, _hemi);
+        MPI_Allreduce(MPI_IN_PLACE, &nSkip, 1, MPI_LONG, MPI_SUM, _hemi);
+
+        ALOG(INFO, "LOGGER_ROUND") << "Local Search : "
+                                   << nFull
+                                   << " Full, "
+                                   << nReduced
+                                   << " Reduced, "
+                                   << nSkip
+                                   << " Skipped";
+        BLOG(INFO, "LOGGER_ROUND") << "Local Search : "
+                                   << nFull
+                                   << " Full, "
+                                   << nReduced
+                                   << " Reduced, "
+                                   << nSkip
+                                   << " Skipped";
+    }
+
     ALOG(INFO, "LOGGER_ROUND") << "Freeing Space for Pre-calcuation in Expectation";
     BLOG(INFO, "LOGGER_ROUND") << "Freeing Space for Pre-calcuation in Expectation";
 
@@ -3618,10 +4040,15 @@ void Optimiser::run()
 #endif
 
     MLOG(INFO, "LOGGER_ROUND") << "Entering Iteration";
-    for (_iter = 0; _iter < _para.iterMax; _iter++)
+    for (; _iter < _para.iterMax; _iter++)
     {
         MLOG(INFO, "LOGGER_ROUND") << "Round " << _iter;
 
+        // scratch buffers of Image / Volume cached during this round are
+        // returned at the end of it
+
+        ArenaScope arenaScope;
+
         if (_searchType == SEARCH_TYPE_GLOBAL)
         {
             MLOG(INFO, "LOGGER_ROUND") << "Search Type ( Round "
@@ -3653,6 +4080,21 @@ void Optimiser::run()
 
         MPI_Barrier(MPI_COMM_WORLD);
 
+#ifdef OPTIMISER_MASTER_SAVE_MAP
+        // the master process is otherwise idle until the end of expectation
+
+        flushMapQueue();
+#endif
+
+#ifdef OPTIMISER_BALANCE_LOAD
+        if (_iter != 0)
+        {
+            MLOG(INFO, "LOGGER_ROUND") << "Balancing Load among Processes";
+
+            balanceLoad();
+        }
+#endif
+
         if ((_iter == 0) || (!_para.skipE))
         {
 #ifdef OPTIMISER_LOG_MEM_USAGE
@@ -3663,6 +4105,10 @@ void Optimiser::run()
 
             MLOG(INFO, "LOGGER_ROUND") << "Performing Expectation";
 
+            switchStage((_searchType == SEARCH_TYPE_GLOBAL)
+                      ? OPTIMISER_STAGE_GLOBAL
+                      : OPTIMISER_STAGE_LOCAL);
+
 #ifdef GPU_VERSION
             //float time_use = 0;
             //struct timeval start;
@@ -3703,6 +4149,8 @@ void Optimiser::run()
 
             MPI_Barrier(MPI_COMM_WORLD);
 
+            switchStage(OPTIMISER_STAGE_NONE);
+
             MLOG(INFO, "LOGGER_ROUND") << "All Processes Finishing Expectation";
 
 #ifdef OPTIMISER_LOG_MEM_USAGE
@@ -3744,8 +4192,12 @@ void Optimiser::run()
         {
             MLOG(INFO, "LOGGER_ROUND") << "Saving Database";
  
+            switchStage(OPTIMISER_STAGE_SAVE);
+
             saveDatabase();
 
+            switchStage(OPTIMISER_STAGE_NONE);
+
 #ifdef VERBOSE_LEVEL_1
             MPI_Barrier(MPI_COMM_WORLD);
 
@@ -3910,12 +4362,20 @@ void Optimiser::run()
         MPI_Barrier(MPI_COMM_WORLD);
         MLOG(INFO, "LOGGER_ROUND") << "Maximization Performed";
 
+#ifdef OPTIMISER_LOG_MEM_USAGE
+        CHECK_ARENA_USAGE("After Maximization");
+#endif
+
         MLOG(INFO, "LOGGER_ROUND") << "Calculating SNR(s)";
         _model.refreshSNR();
 
 #ifdef OPTIMISER_SAVE_FSC
         MLOG(INFO, "LOGGER_ROUND") << "Saving FSC(s)";
+        switchStage(OPTIMISER_STAGE_SAVE);
+
         saveFSC();
+
+        switchStage(OPTIMISER_STAGE_NONE);
 #endif
 
         MLOG(INFO, "LOGGER_ROUND") << "Saving Class Information";
@@ -4096,8 +4556,26 @@ void Optimiser::run()
 
             _model.resetReco(_para.thresReportFSC);
         }
+
+#ifdef OPTIMISER_CHECKPOINT
+        MLOG(INFO, "LOGGER_ROUND") << "Saving Checkpoint";
+
+        switchStage(OPTIMISER_STAGE_SAVE);
+
+        saveCheckpoint();
+
+        switchStage(OPTIMISER_STAGE_NONE);
+#endif
     }
 
+#ifdef OPTIMISER_CHECKPOINT
+    joinCheckpoint();
+#endif
+
+#ifdef OPTIMISER_MASTER_SAVE_MAP
+    flushMapQueue();
+#endif
+
     MLOG(INFO, "LOGGER_ROUND") << "Preparing to Reconstruct Reference(s) at Nyquist";
 
     MLOG(INFO, "LOGGER_ROUND") << "Resetting to Nyquist Limit";
@@ -4153,6 +4631,8 @@ void Optimiser::run()
     MLOG(INFO, "LOGGER_ROUND") << "Final Reference(s) Reconstructed";
 #endif
 
+    switchStage(OPTIMISER_STAGE_SAVE);
+
     MLOG(INFO, "LOGGER_ROUND") << "Saving Final FSC(s)";
 
     saveFSC(true);
@@ -4161,6 +4641,8 @@ void Optimiser::run()
 
     saveDatabase(true);
 
+    switchStage(OPTIMISER_STAGE_NONE);
+
     if (_para.subtract)
     {
         if (strcmp(_para.regionCentre, "") != 0)
@@ -4306,6 +4788,17 @@ void Optimiser::clear()
     _ctf.clear();
 }
 
+void Optimiser::switchStage(const int stage)
+{
+    double now = MPI_Wtime();
+
+    if (_stage != OPTIMISER_STAGE_NONE)
+        _stageTime[_stage] += now - _stageStart;
+
+    _stage = stage;
+    _stageStart = now;
+}
+
 void Optimiser::bCastNPar()
 {
     _nPar = _db.nParticle();
@@ -4543,6 +5036,18 @@ void Optimiser::initID()
 
 void Optimiser::initImg()
 {
+#ifdef OPTIMISER_IMG_CACHE
+    if (openImgCache())
+    {
+        ALOG(INFO, "LOGGER_INIT") << "Taking Preprocessed Images from Cache " << _cachePath;
+        BLOG(INFO, "LOGGER_INIT") << "Taking Preprocessed Images from Cache " << _cachePath;
+
+        loadImgCache();
+
+        return;
+    }
+#endif
+
     ALOG(INFO, "LOGGER_INIT") << "Reading Images from Disk";
     BLOG(INFO, "LOGGER_INIT") << "Reading Images from Disk";
 
@@ -4751,6 +5256,10 @@ void Optimiser::statImg()
     
     _stdStdN = 0;
 
+#ifdef OPTIMISER_IMG_CACHE
+    _imgStat.resize(IMG_CACHE_N_STAT * _ID.size());
+#endif
+
     int nPer = 0;
     int nImg = 0;
 
@@ -4772,42 +5281,41 @@ void Optimiser::statImg()
         }
 
 #ifdef OPTIMISER_INIT_IMG_NORMALISE_OUT_MASK_REGION
-        #pragma omp atomic
-        _mean += regionMean(_img[l],
-                            _para.maskRadius / _para.pixelSize,
-                            0);
+        RFLOAT mean = regionMean(_img[l],
+                                 _para.maskRadius / _para.pixelSize,
+                                 0);
+
+        RFLOAT stdN = bgStddev(0,
+                               _img[l],
+                               _para.maskRadius / _para.pixelSize);
 #else
-        #pragma omp atomic
-        _mean += regionMean(_img[l],
-                            _para.size / 2,
-                            0);
+        RFLOAT mean = regionMean(_img[l],
+                                 _para.size / 2,
+                                 0);
+
+        RFLOAT stdN = bgStddev(0,
+                               _img[l],
+                               _para.size / 2);
 #endif
 
-#ifdef OPTIMISER_INIT_IMG_NORMALISE_OUT_MASK_REGION
-        #pragma omp atomic
-        _stdN += bgStddev(0,
-                          _img[l],
-                          _para.maskRadius / _para.pixelSize);
-#else
+        RFLOAT stdD = stddev(0, _img[l]);
+
         #pragma omp atomic
-        _stdN += bgStddev(0,
-                          _img[l],
-                          _para.size / 2);
-#endif
+        _mean += mean;
 
         #pragma omp atomic
-        _stdD += stddev(0, _img[l]);
+        _stdN += stdN;
 
-#ifdef OPTIMISER_INIT_IMG_NORMALISE_OUT_MASK_REGION
         #pragma omp atomic
-        _stdStdN += gsl_pow_2(bgStddev(0,
-                                       _img[l],
-                                       _para.maskRadius / _para.pixelSize));
-#else
+        _stdD += stdD;
+
         #pragma omp atomic
-        _stdStdN += gsl_pow_2(bgStddev(0,
-                                       _img[l],
-                                       _para.size / 2));
+        _stdStdN += gsl_pow_2(stdN);
+
+#ifdef OPTIMISER_IMG_CACHE
+        _imgStat[IMG_CACHE_N_STAT * l] = mean;
+        _imgStat[IMG_CACHE_N_STAT * l + 1] = stdN;
+        _imgStat[IMG_CACHE_N_STAT * l + 2] = stdD;
 #endif
     }
 
@@ -4815,6 +5323,11 @@ void Optimiser::statImg()
     ILOG(INFO, "LOGGER_ROUND") << "Performing Statistics on Images Accomplished";
 #endif
 
+    allReduceStatImg();
+}
+
+void Optimiser::allReduceStatImg()
+{
     MPI_Barrier(_hemi);
 
     MPI_Allreduce(MPI_IN_PLACE, &_mean, 1, TS_MPI_DOUBLE, MPI_SUM, _hemi);
@@ -4942,6 +5455,12 @@ void Optimiser::normaliseImg()
     _stdN *= scale;
     _stdD *= scale;
     _stdS *= scale;
+
+#ifdef OPTIMISER_IMG_CACHE
+    if (_imgStat.size() == IMG_CACHE_N_STAT * _ID.size())
+        FOR_EACH_2D_IMAGE
+            _imgStat[IMG_CACHE_N_STAT * l + 3] = scale;
+#endif
 }
 
 void Optimiser::fwImg()
@@ -4989,6 +5508,25 @@ void Optimiser::initCTF()
     }
 
 #ifndef OPTIMISER_CTF_ON_THE_FLY
+#ifdef OPTIMISER_IMG_CACHE
+    if (_cache != NULL)
+    {
+        size_t stride = imgCacheStride();
+
+        #pragma omp parallel for
+        FOR_EACH_2D_IMAGE
+        {
+            const char* rec = _cache + IMG_CACHE_HEAD + _db.reg()[_ID[l]] * stride;
+
+            memcpy(&_ctf[l][0],
+                   rec + IMG_CACHE_N_STAT * sizeof(double) + 2 * _ctf[l].sizeFT() * sizeof(Complex),
+                   _ctf[l].sizeFT() * sizeof(Complex));
+        }
+
+        return;
+    }
+#endif
+
     #pragma omp parallel for
     FOR_EACH_2D_IMAGE
     {
@@ -5010,1574 +5548,3112 @@ void Optimiser::initCTF()
 #endif
 }
 
-void Optimiser::correctScale(const bool init,
-                             const bool coord,
-                             const bool group)
-{
-    ALOG(INFO, "LOGGER_SYS") << "Refreshing Scale";
-    BLOG(INFO, "LOGGER_SYS") << "Refreshing Scale";
-
-    refreshScale(coord, group);
+#define FNV_OFFSET 0xcbf29ce484222325UL
 
-    IF_MASTER return;
+#define FNV_PRIME 0x100000001b3UL
 
-    ALOG(INFO, "LOGGER_SYS") << "Correcting Scale";
-    BLOG(INFO, "LOGGER_SYS") << "Correcting Scale";
+static size_t fnv1a(size_t h,
+                    const void* src,
+                    const size_t n)
+{
+    const unsigned char* p = (const unsigned char*)src;
 
-    if (init)
+    for (size_t i = 0; i < n; i++)
     {
-        for (int l = 0; l < _para.k; l++)
-        {
-            #pragma omp parallel for
-            SCALE_FT(_model.ref(l), _scale(_groupID[0] - 1));
-        }
+        h ^= p[i];
+        h *= FNV_PRIME;
     }
-    else
-    {
-        #pragma omp parallel for
-        FOR_EACH_2D_IMAGE
-        {
-            FOR_EACH_PIXEL_FT(_img[l])
-            {
-                _img[l][i] /= _scale(_groupID[l] - 1);
-                _imgOri[l][i] /= _scale(_groupID[l] - 1);
-            }
-        }
 
-        #pragma omp parallel for
-        for (int i = 0; i < _nGroup; i++)
-        {
-            _sig.row(i) /= TSGSL_pow_2(_scale(i));
-        }
-    }
+    return h;
 }
 
-void Optimiser::initSigma()
+struct ImgCacheHead
 {
-    IF_MASTER return;
+    size_t magic;
 
-    ALOG(INFO, "LOGGER_INIT") << "Calculating Average Image";
-    BLOG(INFO, "LOGGER_INIT") << "Calculating Average Image";
+    size_t key;
 
-#ifdef OPTIMISER_SIGMA_MASK
-    Image avg = _img[0].copyImage();
-#else
-    Image avg = _imgOri[0].copyImage();
-#endif
+    size_t nParticle;
 
-    for (size_t l = 1; l < _ID.size(); l++)
-    {
-        #pragma omp parallel for
-#ifdef OPTIMISER_SIGMA_MASK
-        ADD_FT(avg, _img[l]);
+    size_t stride;
+};
+
+size_t Optimiser::imgCacheStride() const
+{
+    size_t sizeFT = (size_t)(_para.size / 2 + 1) * _para.size;
+
+#ifdef OPTIMISER_CTF_ON_THE_FLY
+    size_t nFT = 2;
 #else
-        ADD_FT(avg, _imgOri[l]);
+    size_t nFT = 3;
 #endif
-    }
 
-    MPI_Barrier(_hemi);
+    return IMG_CACHE_N_STAT * sizeof(double) + nFT * sizeFT * sizeof(Complex);
+}
 
-    MPI_Allreduce(MPI_IN_PLACE,
-                  &avg[0],
-                  avg.sizeFT(),
-                  TS_MPI_DOUBLE_COMPLEX,
-                  MPI_SUM,
-                  _hemi);
+bool Optimiser::openImgCache()
+{
+    _cachePath[0] = '\0';
 
-    MPI_Barrier(_hemi);
+    const char* dir = getenv(IMG_CACHE_ENV);
 
-    #pragma omp parallel for
-    SCALE_FT(avg, 1.0 / _N);
+    int enabled = (dir != NULL);
 
-    ALOG(INFO, "LOGGER_INIT") << "Calculating Average Power Spectrum";
-    BLOG(INFO, "LOGGER_INIT") << "Calculating Average Power Spectrum";
+#ifdef OPTIMISER_MASK_IMG
+    // the background of masking is random noise unless it is zero
 
-    vec avgPs = vec::Zero(maxR());
+    if (!_para.zeroMask) enabled = 0;
+#endif
 
-    #pragma omp parallel for
-    FOR_EACH_2D_IMAGE
-    {
-        vec ps(maxR());
+    MPI_Allreduce(MPI_IN_PLACE, &enabled, 1, MPI_INT, MPI_LAND, _slav);
 
-        // powerSpectrum(ps, _imgOri[l], maxR());
+    if (!enabled) return false;
 
-#ifdef OPTIMISER_SIGMA_MASK
-        powerSpectrum(ps, _img[l], maxR());
-#else
-        powerSpectrum(ps, _imgOri[l], maxR());
-#endif
+    int rank;
 
-        #pragma omp critical  (line2742)
-        avgPs += ps;
-    }
+    MPI_Comm_rank(_slav, &rank);
 
-    MPI_Barrier(_hemi);
+    size_t key = FNV_OFFSET;
 
-    MPI_Allreduce(MPI_IN_PLACE,
-                  avgPs.data(),
-                  maxR(),
-                  TS_MPI_DOUBLE,
-                  MPI_SUM,
-                  _hemi);
-    
-    MPI_Barrier(_hemi);
+    if (rank == 0)
+    {
+        FILE* file = fopen(_para.db, "rb");
 
+        if (file == NULL)
+        {
+            REPORT_ERROR("FAIL TO OPEN DATABASE");
 
-    avgPs /= _N;
+            abort();
+        }
 
-    ALOG(INFO, "LOGGER_INIT") << "Calculating Expectation for Initializing Sigma";
-    BLOG(INFO, "LOGGER_INIT") << "Calculating Expectation for Initializing Sigma";
+        vector<char> buf(MEGABYTE);
 
-    vec psAvg(maxR());
-    for (int i = 0; i < maxR(); i++)
-    {
-        psAvg(i) = ringAverage(i,
-                               avg,
-                               function<RFLOAT(const Complex)>(&gsl_real_imag_sum));
-        psAvg(i) = TSGSL_pow_2(psAvg(i));
-    }
+        size_t n;
 
-    // avgPs -> average power spectrum
-    // psAvg -> expectation of pixels
-    ALOG(INFO, "LOGGER_INIT") << "Substract avgPs and psAvg for _sig";
-    BLOG(INFO, "LOGGER_INIT") << "Substract avgPs and psAvg for _sig";
+        while ((n = fread(&buf[0], 1, buf.size(), file)) > 0)
+            key = fnv1a(key, &buf[0], n);
 
-    _sig.leftCols(_sig.cols() - 1).rowwise() = (avgPs - psAvg).transpose() / 2;
+        fclose(file);
+    }
 
-    ALOG(INFO, "LOGGER_INIT") << "Calculating Reciprocal of Sigma";
-    BLOG(INFO, "LOGGER_INIT") << "Calculating Reciprocal of Sigma";
+    MPI_Bcast(&key, 1, MPI_UNSIGNED_LONG, 0, _slav);
 
-    for (int i = 0; i < _nGroup; i++)
-        for (int j = 0; j < maxR(); j++)
-            _sigRcp(i, j) = -0.5 / _sig(i, j);
-}
+    int opt = 0;
 
-void Optimiser::initParticles()
-{
-    IF_MASTER return;
+#ifdef OPTIMISER_MASK_IMG
+    opt |= 1;
+#endif
 
-    _par.clear();
-    _par.resize(_ID.size());
+#ifdef OPTIMISER_INIT_IMG_NORMALISE_OUT_MASK_REGION
+    opt |= 2;
+#endif
 
-    #pragma omp parallel for
-    FOR_EACH_2D_IMAGE
-    {
-#ifdef VERBOSE_LEVEL_3
-        ALOG(INFO, "LOGGER_SYS") << "Initialising Particle Filter for Image " << _ID[l];
-        BLOG(INFO, "LOGGER_SYS") << "Initialising Particle Filter for Image " << _ID[l];
+#ifdef OPTIMISER_CTF_ON_THE_FLY
+    opt |= 4;
 #endif
-        _par[l].init(_para.mode,
-                     _para.transS,
-                     TRANS_Q,
-                     &_sym);
-    }
-}
 
-void Optimiser::avgStdR(RFLOAT& stdR)
-{
-    IF_MASTER return;
+    int zeroMask = _para.zeroMask;
 
-    /***
-    stdR = 0;
+    RFLOAT ew = EDGE_WIDTH_RL;
 
-    FOR_EACH_2D_IMAGE
-        stdR += _db.stdR(_ID[l]);
+    size_t sizeRFLOAT = sizeof(RFLOAT);
 
-    MPI_Allreduce(MPI_IN_PLACE,
-                 &stdR,
-                 1,
-                 TS_MPI_DOUBLE,
-                 MPI_SUM,
-                 _hemi);
+    key = fnv1a(key, &_para.size, sizeof(_para.size));
+    key = fnv1a(key, &_para.pixelSize, sizeof(_para.pixelSize));
+    key = fnv1a(key, &_para.maskRadius, sizeof(_para.maskRadius));
+    key = fnv1a(key, &zeroMask, sizeof(zeroMask));
+    key = fnv1a(key, &ew, sizeof(ew));
+    key = fnv1a(key, &opt, sizeof(opt));
+    key = fnv1a(key, &sizeRFLOAT, sizeof(sizeRFLOAT));
+    key = fnv1a(key, _para.parPrefix, strlen(_para.parPrefix));
 
-    stdR /= _N;
-    ***/
-}
+    _cacheKey = key;
 
-void Optimiser::avgStdT(RFLOAT& stdT)
-{
-    IF_MASTER return;
+    snprintf(_cachePath, sizeof(_cachePath), "%s/THUNDER_%016lx.cache", dir, key);
 
-    /***
-    stdT = 0;
+    size_t stride = imgCacheStride();
 
-    FOR_EACH_2D_IMAGE
+    size_t size = IMG_CACHE_HEAD + (size_t)_nPar * stride;
+
+    int hit = 0;
+
+    int fd = open(_cachePath, O_RDONLY);
+
+    if (fd >= 0)
     {
-        stdT += _db.stdTX(_ID[l]);
-        stdT += _db.stdTY(_ID[l]);
+        struct stat st;
+
+        if ((fstat(fd, &st) == 0) && ((size_t)st.st_size == size))
+        {
+            void* ptr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+
+            if (ptr != MAP_FAILED)
+            {
+                const ImgCacheHead* head = (const ImgCacheHead*)ptr;
+
+                if ((head->magic == IMG_CACHE_MAGIC) &&
+                    (head->key == key) &&
+                    (head->nParticle == (size_t)_nPar) &&
+                    (head->stride == stride))
+                {
+                    _cache = (char*)ptr;
+                    _cacheSize = size;
+
+                    hit = 1;
+                }
+                else
+                    munmap(ptr, size);
+            }
+        }
+
+        close(fd);
     }
 
-    MPI_Allreduce(MPI_IN_PLACE,
-                  &stdT,
-                  1,
-                  TS_MPI_DOUBLE,
-                  MPI_SUM,
-                  _hemi);
+    MPI_Allreduce(MPI_IN_PLACE, &hit, 1, MPI_INT, MPI_LAND, _slav);
 
-    stdT /= _N;
-    stdT /= 2;
-    ***/
+    if (!hit)
+    {
+        closeImgCache();
+
+        ALOG(INFO, "LOGGER_INIT") << "Preprocessed Images will be Cached in " << _cachePath;
+        BLOG(INFO, "LOGGER_INIT") << "Preprocessed Images will be Cached in " << _cachePath;
+    }
+
+    return hit;
 }
 
-void Optimiser::loadParticles()
+void Optimiser::loadImgCache()
 {
-    IF_MASTER return;
-
-    /***
-    RFLOAT stdR, stdT;
+    size_t stride = imgCacheStride();
 
-    avgStdR(stdR);
-    avgStdT(stdT);
+    _img.clear();
+    _img.resize(_ID.size());
 
-    ALOG(INFO, "LOGGER_SYS") << "Average Standard Deviation of Rotation: " << stdR;
-    BLOG(INFO, "LOGGER_SYS") << "Average Standard Deviation of Rotation: " << stdR;
+    _imgOri.clear();
+    _imgOri.resize(_ID.size());
 
-    ALOG(INFO, "LOGGER_SYS") << "Average Standard Deviation of Translation: " << stdT;
-    BLOG(INFO, "LOGGER_SYS") << "Average Standard Deviation of Translation: " << stdT;
-    ***/
+#ifdef OPTIMISER_RECENTRE_IMAGE_EACH_ITERATION
+    _offset = vector<dvec2>(_img.size(), dvec2(0, 0));
+#endif
 
-    // size_t cls;
-    dvec4 quat;
-    dvec2 tran;
-    double d;
+    _mean = 0;
 
-    double k1, k2, k3, stdTX, stdTY, stdD, score;
+    _stdN = 0;
+    _stdD = 0;
+    _stdS = 0;
 
-    //#pragma omp parallel for private(cls, quat, stdR, tran, d)
+    _stdStdN = 0;
 
-    #pragma omp parallel for private(quat, tran, d, k1, k2, k3, stdTX, stdTY, stdD)
     FOR_EACH_2D_IMAGE
     {
-        #pragma omp critical  (line2883)
-        {
-            // cls = _db.cls(_ID[l]);
-            quat = _db.quat(_ID[l]);
-            //stdR = _db.stdR(_ID[l]);
-            tran = _db.tran(_ID[l]);
-            d = _db.d(_ID[l]);
+        const double* stat = (const double*)(_cache + IMG_CACHE_HEAD + _db.reg()[_ID[l]] * stride);
 
-            k1 = _db.k1(_ID[l]);
-            k2 = _db.k2(_ID[l]);
-            k3 = _db.k3(_ID[l]);
-
-            stdTX = _db.stdTX(_ID[l]);
-            stdTY = _db.stdTY(_ID[l]);
-            stdD = _db.stdD(_ID[l]);
+        _mean += stat[0];
 
-            score = _db.score(_ID[l]);
-        }
+        _stdN += stat[1];
+        _stdD += stat[2];
 
-        _par[l].load(_para.mLR,
-                     _para.mLT,
-                     1,
-                     quat,
-                     k1,
-                     k2,
-                     k3,
-                     tran,
-                     stdTX,
-                     stdTY,
-                     d,
-                     stdD,
-                     score);
+        _stdStdN += gsl_pow_2(stat[1]);
     }
 
-    /***
-    for (int l = 0; l < 10; l++)
-    {
-        ALOG(INFO, "LOGGER_SYS") << "Compress of "
-                                 << l
-                                 << " : "
-                                 << _par[l].compress();
-    }
-    ***/
-}
+    allReduceStatImg();
 
-void Optimiser::refreshRotationChange()
-{
-    /***
-    RFLOAT mean = 0;
-    RFLOAT std = 0;
+    displayStatImg();
 
-    int num = 0;
+    RFLOAT scale = 1.0 / _stdN;
 
-    NT_MASTER
+    #pragma omp parallel for
+    FOR_EACH_2D_IMAGE
     {
-        FOR_EACH_2D_IMAGE
-        {
-            RFLOAT diffR = _par[l].diffTopR();
+        const char* rec = _cache + IMG_CACHE_HEAD + _db.reg()[_ID[l]] * stride;
 
-            if (_par[l].diffTopC())
-            {
-                mean += diffR;
-                std += TSGSL_pow_2(diffR);
-                num += 1;
-            }
+        // the records are normalised by the hemisphere they were written in
+
+        RFLOAT factor = scale / ((const double*)rec)[3];
+
+        _imgOri[l].alloc(_para.size, _para.size, FT_SPACE);
+        _img[l].alloc(_para.size, _para.size, FT_SPACE);
+
+        const Complex* ori = (const Complex*)(rec + IMG_CACHE_N_STAT * sizeof(double));
+        const Complex* img = ori + _img[l].sizeFT();
+
+        memcpy(&_imgOri[l][0], ori, _imgOri[l].sizeFT() * sizeof(Complex));
+        memcpy(&_img[l][0], img, _img[l].sizeFT() * sizeof(Complex));
+
+        if (factor != 1)
+        {
+            SCALE_FT(_imgOri[l], factor);
+            SCALE_FT(_img[l], factor);
         }
     }
 
-    MPI_Allreduce(MPI_IN_PLACE,
-                  &mean,
-                  1,
-                  TS_MPI_DOUBLE,
-                  MPI_SUM,
-                  MPI_COMM_WORLD);
+    _stdN *= scale;
+    _stdD *= scale;
+    _stdS *= scale;
 
-    MPI_Allreduce(MPI_IN_PLACE,
-                  &std,
-                  1,
-                  TS_MPI_DOUBLE,
-                  MPI_SUM,
-                  MPI_COMM_WORLD);
+    displayStatImg();
+}
 
-    MPI_Allreduce(MPI_IN_PLACE,
-                  &num,
-                  1,
-                  MPI_INT,
-                  MPI_SUM,
-                  MPI_COMM_WORLD);
+void Optimiser::saveImgCache()
+{
+    if (_cachePath[0] == '\0') return;
 
-    mean /= num;
+    char filename[FILE_NAME_LENGTH + 8];
 
-    std = sqrt(std / num - TSGSL_pow_2(mean));
-    ***/
+    sprintf(filename, "%s.tmp", _cachePath);
 
-    vec rc = vec::Zero(_nPar);
+    MPI_File file;
 
-    NT_MASTER
+    if (MPI_File_open(_slav,
+                      filename,
+                      MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                      MPI_INFO_NULL,
+                      &file) != MPI_SUCCESS)
     {
-        FOR_EACH_2D_IMAGE
-        {
-            RFLOAT diff = _par[l].diffTopR();
-
-            rc(_ID[l]) = diff;
+        CLOG(WARNING, "LOGGER_SYS") << "Fail to Create Cache of Images " << filename;
 
-            /***
-            if (_par[l].diffTopC())
-                rc(_ID[l]) = _par[l].diffTopR();
-            else
-                rc(_ID[l]) = 1;
-            ***/
-        }
+        return;
     }
 
-    MPI_Allreduce(MPI_IN_PLACE,
-                  rc.data(),
-                  rc.size(),
-                  TS_MPI_DOUBLE,
-                  MPI_SUM,
-                  MPI_COMM_WORLD); 
-/***
-    int nNoZero = 0;
-    for (int i = 0; i < _nPar; i++)
-        if (rc(i) != 0)
-            nNoZero += 1;
-    ***/
-
-    //vec rcNoZero = vec::Zero(nNoZero);
+    size_t stride = imgCacheStride();
 
-    //TSGSL_sort_largest(rcNoZero.data(), nNoZero, rc.data(), 1, _nPar);
-    //TSGSL_sort_largest(rc.data(), nNoZero, rc.data(), 1, _nPar);
+    vector<char> rec(stride);
 
-    //RFLOAT mean = TSGSL_stats_mean(rc.data(), 1, _nPar);
-    //RFLOAT std = TSGSL_stats_sd_m(rc.data(), 1, _nPar, mean);
+    MPI_Status status;
 
-    RFLOAT mean, std;
-    TSGSL_sort(rc.data(), 1, _nPar);
+    // every process takes part in each collective write, those out of images
+    // writing nothing
 
-    stat_MAS(mean, std, rc, _nPar);
+    int nImg = _ID.size();
 
-    _model.setRChange(mean);
-    _model.setStdRChange(std);
-}
+    int nWrite = nImg;
 
-void Optimiser::refreshClassDistr()
-{
-    _cDistr = vec::Zero(_para.k);
+    MPI_Allreduce(MPI_IN_PLACE, &nWrite, 1, MPI_INT, MPI_MAX, _slav);
 
-    NT_MASTER
+    for (int l = 0; l < nWrite; l++)
     {
-        size_t cls;
-
-        #pragma omp parallel for private(cls)
-        FOR_EACH_2D_IMAGE
+        if (l >= nImg)
         {
-            for (int k = 0; k < _para.k; k++)
-            {
-                _par[l].rand(cls); 
+            MPI_File_write_at_all(file, 0, &rec[0], 0, MPI_BYTE, &status);
 
-                #pragma omp atomic
-                _cDistr(cls) += 1;
-            }
+            continue;
         }
-    }
 
-    MPI_Barrier(MPI_COMM_WORLD);
+        char* ptr = &rec[0];
 
-    MPI_Allreduce(MPI_IN_PLACE,
-                  _cDistr.data(),
-                  _cDistr.size(),
-                  TS_MPI_DOUBLE,
-                  MPI_SUM,
-                  MPI_COMM_WORLD);
+        memcpy(ptr, &_imgStat[IMG_CACHE_N_STAT * l], IMG_CACHE_N_STAT * sizeof(double));
+        ptr += IMG_CACHE_N_STAT * sizeof(double);
 
-    //_cDistr.array() /= (_nPar * _para.k);
-    _cDistr.array() /= _cDistr.sum();
-}
+        memcpy(ptr, &_imgOri[l][0], _imgOri[l].sizeFT() * sizeof(Complex));
+        ptr += _imgOri[l].sizeFT() * sizeof(Complex);
 
-void Optimiser::determineBalanceClass(umat2& dst,
-                                      const RFLOAT thres)
-{
-    int num = 0;
+        memcpy(ptr, &_img[l][0], _img[l].sizeFT() * sizeof(Complex));
 
-    for (int t = 0; t < _para.k; t++)
-        if (_cDistr(t) < thres / _para.k)
-            num++;
+#ifndef OPTIMISER_CTF_ON_THE_FLY
+        ptr += _img[l].sizeFT() * sizeof(Complex);
 
-#ifdef VERBOSE_LEVEL_1
-    MLOG(INFO, "LOGGER_SYS") << num << " Classes Empty and Needing Resigning";
+        memcpy(ptr, &_ctf[l][0], _ctf[l].sizeFT() * sizeof(Complex));
 #endif
 
-    dst = umat2::Zero(num, 2);
+        MPI_File_write_at_all(file,
+                              IMG_CACHE_HEAD + (MPI_Offset)_db.reg()[_ID[l]] * stride,
+                              &rec[0],
+                              stride,
+                              MPI_BYTE,
+                              &status);
+    }
 
-    IF_MASTER
-    {
-        dvec cum = dvec::Zero(_para.k);
+    MPI_File_sync(file);
 
-        for (int t = 0; t < _para.k; t++)
-        {
-            if (_cDistr(t) < thres / _para.k)
-                cum(t) = 0;
-            else
-                cum(t) = _cDistr(t) - (thres / _para.k);
-        }
+    MPI_Barrier(_slav);
 
-        cum.array() /= cum.sum();
+    int rank;
 
-        cum = d_cumsum(cum);
+    MPI_Comm_rank(_slav, &rank);
 
-#ifdef VERBOSE_LEVEL_1
-        MLOG(INFO, "LOGGER_SYS") << "Summation of Percentage Calculated";
-#endif
-
-        gsl_rng* engine = get_random_engine();
+    // the header goes last, after every record is on disk, written by the
+    // first process
 
-        int i = 0;
+    vector<char> buf(IMG_CACHE_HEAD, 0);
 
-        for (int t = 0; t < _para.k; t++)
-        {
-            if (_cDistr(t) < thres / _para.k)
-            {
-                RFLOAT indice = TSGSL_ran_flat(engine, 0, 1);
+    ImgCacheHead* head = (ImgCacheHead*)&buf[0];
 
-                int j = 0;
-                while (cum(j) < indice) j++;
+    head->magic = IMG_CACHE_MAGIC;
+    head->nParticle = _nPar;
+    head->stride = stride;
 
-                MLOG(INFO, "LOGGER_SYS") << "Class " << t << " is Empty ( Round "
-                                         << _iter
-                                         << " ), Resigned it with Class "
-                                         << j;
+    head->key = _cacheKey;
 
-                dst(i, 0) = t;
-                dst(i, 1) = j;
+    MPI_File_write_at_all(file,
+                          0,
+                          &buf[0],
+                          (rank == 0) ? IMG_CACHE_HEAD : 0,
+                          MPI_BYTE,
+                          &status);
 
-                i++;
-            }
-        }
-    }
+    MPI_File_close(&file);
 
-    MPI_Bcast(dst.data(),
-              dst.size(),
-              MPI_LONG,
-              MASTER_ID,
-              MPI_COMM_WORLD);
+    if ((rank == 0) && (rename(filename, _cachePath) != 0))
+        CLOG(WARNING, "LOGGER_SYS") << "Fail to Rename Cache of Images " << filename;
 }
 
-void Optimiser::balanceClass(const umat2& bm)
+void Optimiser::closeImgCache()
 {
-    for (int i = 0; i < bm.rows(); i++)
-    {
-        NT_MASTER _model.ref(bm(i, 0)) = _model.ref(bm(i, 1)).copyVolume();
-    }
+    if (_cache != NULL) munmap(_cache, _cacheSize);
+
+    _cache = NULL;
+    _cacheSize = 0;
+
+    _imgStat.clear();
 }
 
-/***
-void Optimiser::balanceClass(const RFLOAT thres,
-                             const bool refreshDistr)
+void Optimiser::correctScale(const bool init,
+                             const bool coord,
+                             const bool group)
 {
-    int cls;
-    RFLOAT num = _cDistr.maxCoeff(&cls);
+    ALOG(INFO, "LOGGER_SYS") << "Refreshing Scale";
+    BLOG(INFO, "LOGGER_SYS") << "Refreshing Scale";
 
-    for (int t = 0; t < _para.k; t++)
-        if (_cDistr(t) < thres / _para.k)
-        {
-            MLOG(INFO, "LOGGER_SYS") << "Class " << t << " is Empty ( Round "
-                                     << _iter
-                                     << " ), Resigned it with Class "
-                                     << cls;
+    refreshScale(coord, group);
 
-            NT_MASTER _model.ref(t) = _model.ref(cls).copyVolume();
+    IF_MASTER return;
 
-            if (refreshDistr) _cDistr(t) = num;
+    ALOG(INFO, "LOGGER_SYS") << "Correcting Scale";
+    BLOG(INFO, "LOGGER_SYS") << "Correcting Scale";
+
+    if (init)
+    {
+        for (int l = 0; l < _para.k; l++)
+        {
+            #pragma omp parallel for
+            SCALE_FT(_model.ref(l), _scale(_groupID[0] - 1));
+        }
+    }
+    else
+    {
+        #pragma omp parallel for
+        FOR_EACH_2D_IMAGE
+        {
+            FOR_EACH_PIXEL_FT(_img[l])
+            {
+                _img[l][i] /= _scale(_groupID[l] - 1);
+                _imgOri[l][i] /= _scale(_groupID[l] - 1);
+            }
         }
 
-    if (refreshDistr) _cDistr.array() /= _cDistr.sum();
+        #pragma omp parallel for
+        for (int i = 0; i < _nGroup; i++)
+        {
+            _sig.row(i) /= TSGSL_pow_2(_scale(i));
+        }
+    }
 }
-***/
 
-void Optimiser::refreshVariance()
+void Optimiser::initSigma()
 {
-    vec rv = vec::Zero(_nPar);
-    vec t0v = vec::Zero(_nPar);
-    vec t1v = vec::Zero(_nPar);
-
-#ifdef OPTIMISER_REFRESH_VARIANCE_BEST_CLASS
+    IF_MASTER return;
 
-    int bestClass = _model.bestClass(_para.thresCutoffFSC, false);
+    ALOG(INFO, "LOGGER_INIT") << "Calculating Average Image";
+    BLOG(INFO, "LOGGER_INIT") << "Calculating Average Image";
 
-#ifdef VERBOSE_LEVEL_1
-    MLOG(INFO, "LOGGER_SYS") << "Best Class is " << bestClass;
-#endif
-    
+#ifdef OPTIMISER_SIGMA_MASK
+    Image avg = _img[0].copyImage();
+#else
+    Image avg = _imgOri[0].copyImage();
 #endif
 
-    NT_MASTER
+    for (size_t l = 1; l < _ID.size(); l++)
     {
-        double rVari, tVariS0, tVariS1, dVari;
-
-        #pragma omp parallel for private(rVari, tVariS0, tVariS1, dVari)
-        FOR_EACH_2D_IMAGE
-        {
-#ifdef OPTIMISER_REFRESH_VARIANCE_BEST_CLASS
-            size_t cls;
-            _par[l].rand(cls);
-
-            if (cls == (size_t)bestClass)
-            {
-                _par[l].vari(rVari,
-                             tVariS0,
-                             tVariS1,
-                             dVari);
-            }
-            else
-            {
-                rVari = GSL_NAN;
-                tVariS0 = GSL_NAN;
-                tVariS1 = GSL_NAN;
-                dVari = GSL_NAN;
-            }
+        #pragma omp parallel for
+#ifdef OPTIMISER_SIGMA_MASK
+        ADD_FT(avg, _img[l]);
 #else
-            _par[l].vari(rVari,
-                         tVariS0,
-                         tVariS1,
-                         dVari);
+        ADD_FT(avg, _imgOri[l]);
 #endif
-
-            rv(_ID[l]) = rVari;
-            t0v(_ID[l]) = tVariS0;
-            t1v(_ID[l]) = tVariS1;
-        }
     }
 
-    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Barrier(_hemi);
 
     MPI_Allreduce(MPI_IN_PLACE,
-                  rv.data(),
-                  rv.size(),
-                  TS_MPI_DOUBLE,
+                  &avg[0],
+                  avg.sizeFT(),
+                  TS_MPI_DOUBLE_COMPLEX,
                   MPI_SUM,
-                  MPI_COMM_WORLD); 
+                  _hemi);
 
-    MPI_Allreduce(MPI_IN_PLACE,
-                  t0v.data(),
-                  t0v.size(),
-                  TS_MPI_DOUBLE,
-                  MPI_SUM,
-                  MPI_COMM_WORLD); 
+    MPI_Barrier(_hemi);
 
-    MPI_Allreduce(MPI_IN_PLACE,
-                  t1v.data(),
-                  t1v.size(),
-                  TS_MPI_DOUBLE,
-                  MPI_SUM,
-                  MPI_COMM_WORLD); 
+    #pragma omp parallel for
+    SCALE_FT(avg, 1.0 / _N);
 
-    MPI_Barrier(MPI_COMM_WORLD);
+    ALOG(INFO, "LOGGER_INIT") << "Calculating Average Power Spectrum";
+    BLOG(INFO, "LOGGER_INIT") << "Calculating Average Power Spectrum";
 
-#ifdef OPTIMISER_REFRESH_VARIANCE_BEST_CLASS
-    int num = 0;
-    for (int i = 0; i < _nPar; i++)
-        if (!TSGSL_isnan(rv(i))) num++;
+    vec avgPs = vec::Zero(maxR());
 
-#ifdef VERBOSE_LEVEL_1
-    MLOG(INFO, "LOGGER_SYS") << num << " Particles Belonging to Best Class";
-#endif
+    #pragma omp parallel for
+    FOR_EACH_2D_IMAGE
+    {
+        vec ps(maxR());
 
-    vec rvt = vec::Zero(num);
-    vec t0vt = vec::Zero(num);
-    vec t1vt = vec::Zero(num);
+        // powerSpectrum(ps, _imgOri[l], maxR());
 
-    int j = 0;
-    for (int i = 0; i < _nPar; i++)
-    {
-        if (!TSGSL_isnan(rv(i)))
-        {
-            rvt(j) = rv(i);
-            t0vt(j) = t0v(i);
-            t1vt(j) = t1v(i);
-            
-            j++;
-        }
+#ifdef OPTIMISER_SIGMA_MASK
+        powerSpectrum(ps, _img[l], maxR());
+#else
+        powerSpectrum(ps, _imgOri[l], maxR());
+#endif
+
+        #pragma omp critical  (line2742)
+        avgPs += ps;
     }
 
-    rv = rvt;
-    t0v = t0vt;
-    t1v = t1vt;
-#endif
+    MPI_Barrier(_hemi);
 
-    ALOG(INFO, "LOGGER_SYS") << "Maximum Rotation Variance: " << rv.maxCoeff();
-    BLOG(INFO, "LOGGER_SYS") << "Maximum Rotation Variance: " << rv.maxCoeff();
+    MPI_Allreduce(MPI_IN_PLACE,
+                  avgPs.data(),
+                  maxR(),
+                  TS_MPI_DOUBLE,
+                  MPI_SUM,
+                  _hemi);
+    
+    MPI_Barrier(_hemi);
 
-    RFLOAT mean, std;
 
-    stat_MAS(mean, std, rv, rv.size());
+    avgPs /= _N;
 
-    _model.setRVari(mean);
-    _model.setStdRVari(std);
+    ALOG(INFO, "LOGGER_INIT") << "Calculating Expectation for Initializing Sigma";
+    BLOG(INFO, "LOGGER_INIT") << "Calculating Expectation for Initializing Sigma";
 
-    stat_MAS(mean, std, t0v, t0v.size());
+    vec psAvg(maxR());
+    for (int i = 0; i < maxR(); i++)
+    {
+        psAvg(i) = ringAverage(i,
+                               avg,
+                               function<RFLOAT(const Complex)>(&gsl_real_imag_sum));
+        psAvg(i) = TSGSL_pow_2(psAvg(i));
+    }
 
-    _model.setTVariS0(mean);
-    _model.setStdTVariS0(std);
+    // avgPs -> average power spectrum
+    // psAvg -> expectation of pixels
+    ALOG(INFO, "LOGGER_INIT") << "Substract avgPs and psAvg for _sig";
+    BLOG(INFO, "LOGGER_INIT") << "Substract avgPs and psAvg for _sig";
 
-    stat_MAS(mean, std, t1v, t1v.size());
+    _sig.leftCols(_sig.cols() - 1).rowwise() = (avgPs - psAvg).transpose() / 2;
 
-    _model.setTVariS1(mean);
-    _model.setStdTVariS1(std);
+    ALOG(INFO, "LOGGER_INIT") << "Calculating Reciprocal of Sigma";
+    BLOG(INFO, "LOGGER_INIT") << "Calculating Reciprocal of Sigma";
+
+    for (int i = 0; i < _nGroup; i++)
+        for (int j = 0; j < maxR(); j++)
+            _sigRcp(i, j) = -0.5 / _sig(i, j);
 }
 
-void Optimiser::refreshScale(const bool coord,
-                             const bool group)
+void Optimiser::initParticles()
 {
-    if (_iter != 0)
-        _rS = _model.resolutionP(_para.thresSclCorFSC, false);
+    IF_MASTER return;
+
+    _par.clear();
+    _par.resize(_ID.size());
+
+    #pragma omp parallel for
+    FOR_EACH_2D_IMAGE
+    {
+#ifdef VERBOSE_LEVEL_3
+        ALOG(INFO, "LOGGER_SYS") << "Initialising Particle Filter for Image " << _ID[l];
+        BLOG(INFO, "LOGGER_SYS") << "Initialising Particle Filter for Image " << _ID[l];
+#endif
+        _par[l].init(_para.mode,
+                     _para.transS,
+                     TRANS_Q,
+                     &_sym);
+    }
+}
+
+void Optimiser::avgStdR(RFLOAT& stdR)
+{
+    IF_MASTER return;
+
+    /***
+    stdR = 0;
+
+    FOR_EACH_2D_IMAGE
+        stdR += _db.stdR(_ID[l]);
+
+    MPI_Allreduce(MPI_IN_PLACE,
+                 &stdR,
+                 1,
+                 TS_MPI_DOUBLE,
+                 MPI_SUM,
+                 _hemi);
+
+    stdR /= _N;
+    ***/
+}
+
+void Optimiser::avgStdT(RFLOAT& stdT)
+{
+    IF_MASTER return;
+
+    /***
+    stdT = 0;
+
+    FOR_EACH_2D_IMAGE
+    {
+        stdT += _db.stdTX(_ID[l]);
+        stdT += _db.stdTY(_ID[l]);
+    }
+
+    MPI_Allreduce(MPI_IN_PLACE,
+                  &stdT,
+                  1,
+                  TS_MPI_DOUBLE,
+                  MPI_SUM,
+                  _hemi);
+
+    stdT /= _N;
+    stdT /= 2;
+    ***/
+}
+
+void Optimiser::loadParticles()
+{
+    IF_MASTER return;
+
+    /***
+    RFLOAT stdR, stdT;
+
+    avgStdR(stdR);
+    avgStdT(stdT);
+
+    ALOG(INFO, "LOGGER_SYS") << "Average Standard Deviation of Rotation: " << stdR;
+    BLOG(INFO, "LOGGER_SYS") << "Average Standard Deviation of Rotation: " << stdR;
+
+    ALOG(INFO, "LOGGER_SYS") << "Average Standard Deviation of Translation: " << stdT;
+    BLOG(INFO, "LOGGER_SYS") << "Average Standard Deviation of Translation: " << stdT;
+    ***/
+
+    // size_t cls;
+    dvec4 quat;
+    dvec2 tran;
+    double d;
+
+    double k1, k2, k3, stdTX, stdTY, stdD, score;
+
+    //#pragma omp parallel for private(cls, quat, stdR, tran, d)
+
+    #pragma omp parallel for private(quat, tran, d, k1, k2, k3, stdTX, stdTY, stdD)
+    FOR_EACH_2D_IMAGE
+    {
+        #pragma omp critical  (line2883)
+        {
+            // cls = _db.cls(_ID[l]);
+            quat = _db.quat(_ID[l]);
+            //stdR = _db.stdR(_ID[l]);
+            tran = _db.tran(_ID[l]);
+            d = _db.d(_ID[l]);
+
+            k1 = _db.k1(_ID[l]);
+            k2 = _db.k2(_ID[l]);
+            k3 = _db.k3(_ID[l]);
+
+            stdTX = _db.stdTX(_ID[l]);
+            stdTY = _db.stdTY(_ID[l]);
+            stdD = _db.stdD(_ID[l]);
+
+            score = _db.score(_ID[l]);
+        }
+
+        _par[l].load(_para.mLR,
+                     _para.mLT,
+                     1,
+                     quat,
+                     k1,
+                     k2,
+                     k3,
+                     tran,
+                     stdTX,
+                     stdTY,
+                     d,
+                     stdD,
+                     score);
+    }
+
+    /***
+    for (int l = 0; l < 10; l++)
+    {
+        ALOG(INFO, "LOGGER_SYS") << "Compress of "
+                                 << l
+                                 << " : "
+                                 << _par[l].compress();
+    }
+    ***/
+}
+
+void Optimiser::refreshRotationChange()
+{
+    /***
+    RFLOAT mean = 0;
+    RFLOAT std = 0;
+
+    int num = 0;
+
+    NT_MASTER
+    {
+        FOR_EACH_2D_IMAGE
+        {
+            RFLOAT diffR = _par[l].diffTopR();
+
+            if (_par[l].diffTopC())
+            {
+                mean += diffR;
+                std += TSGSL_pow_2(diffR);
+                num += 1;
+            }
+        }
+    }
+
+    MPI_Allreduce(MPI_IN_PLACE,
+                  &mean,
+                  1,
+                  TS_MPI_DOUBLE,
+                  MPI_SUM,
+                  MPI_COMM_WORLD);
+
+    MPI_Allreduce(MPI_IN_PLACE,
+                  &std,
+                  1,
+                  TS_MPI_DOUBLE,
+                  MPI_SUM,
+                  MPI_COMM_WORLD);
+
+    MPI_Allreduce(MPI_IN_PLACE,
+                  &num,
+                  1,
+                  MPI_INT,
+                  MPI_SUM,
+                  MPI_COMM_WORLD);
+
+    mean /= num;
+
+    std = sqrt(std / num - TSGSL_pow_2(mean));
+    ***/
+
+    vec rc = vec::Zero(_nPar);
+
+    NT_MASTER
+    {
+        FOR_EACH_2D_IMAGE
+        {
+            RFLOAT diff = _par[l].diffTopR();
+
+            rc(_ID[l]) = diff;
+
+            /***
+            if (_par[l].diffTopC())
+                rc(_ID[l]) = _par[l].diffTopR();
+            else
+                rc(_ID[l]) = 1;
+            ***/
+        }
+    }
+
+    MPI_Allreduce(MPI_IN_PLACE,
+                  rc.data(),
+                  rc.size(),
+                  TS_MPI_DOUBLE,
+                  MPI_SUM,
+                  MPI_COMM_WORLD); 
+/***
+    int nNoZero = 0;
+    for (int i = 0; i < _nPar; i++)
+        if (rc(i) != 0)
+            nNoZero += 1;
+    ***/
+
+    //vec rcNoZero = vec::Zero(nNoZero);
+
+    //TSGSL_sort_largest(rcNoZero.data(), nNoZero, rc.data(), 1, _nPar);
+    //TSGSL_sort_largest(rc.data(), nNoZero, rc.data(), 1, _nPar);
+
+    //RFLOAT mean = TSGSL_stats_mean(rc.data(), 1, _nPar);
+    //RFLOAT std = TSGSL_stats_sd_m(rc.data(), 1, _nPar, mean);
+
+    RFLOAT mean, std;
+    TSGSL_sort(rc.data(), 1, _nPar);
+
+    stat_MAS(mean, std, rc, _nPar);
+
+    _model.setRChange(mean);
+    _model.setStdRChange(std);
+}
+
+void Optimiser::refreshClassDistr()
+{
+    _cDistr = vec::Zero(_para.k);
+
+    NT_MASTER
+    {
+        size_t cls;
+
+        #pragma omp parallel for private(cls)
+        FOR_EACH_2D_IMAGE
+        {
+            for (int k = 0; k < _para.k; k++)
+            {
+                _par[l].rand(cls); 
+
+                #pragma omp atomic
+                _cDistr(cls) += 1;
+            }
+        }
+    }
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    MPI_Allreduce(MPI_IN_PLACE,
+                  _cDistr.data(),
+                  _cDistr.size(),
+                  TS_MPI_DOUBLE,
+                  MPI_SUM,
+                  MPI_COMM_WORLD);
+
+    //_cDistr.array() /= (_nPar * _para.k);
+    _cDistr.array() /= _cDistr.sum();
+}
+
+void Optimiser::determineBalanceClass(umat2& dst,
+                                      const RFLOAT thres)
+{
+    int num = 0;
+
+    for (int t = 0; t < _para.k; t++)
+        if (_cDistr(t) < thres / _para.k)
+            num++;
+
+#ifdef VERBOSE_LEVEL_1
+    MLOG(INFO, "LOGGER_SYS") << num << " Classes Empty and Needing Resigning";
+#endif
+
+    dst = umat2::Zero(num, 2);
+
+    IF_MASTER
+    {
+        dvec cum = dvec::Zero(_para.k);
+
+        for (int t = 0; t < _para.k; t++)
+        {
+            if (_cDistr(t) < thres / _para.k)
+                cum(t) = 0;
+            else
+                cum(t) = _cDistr(t) - (thres / _para.k);
+        }
+
+        cum.array() /= cum.sum();
+
+        cum = d_cumsum(cum);
+
+#ifdef VERBOSE_LEVEL_1
+        MLOG(INFO, "LOGGER_SYS") << "Summation of Percentage Calculated";
+#endif
+
+        gsl_rng* engine = get_random_engine();
+
+        int i = 0;
+
+        for (int t = 0; t < _para.k; t++)
+        {
+            if (_cDistr(t) < thres / _para.k)
+            {
+                RFLOAT indice = TSGSL_ran_flat(engine, 0, 1);
+
+                int j = 0;
+                while (cum(j) < indice) j++;
+
+                MLOG(INFO, "LOGGER_SYS") << "Class " << t << " is Empty ( Round "
+                                         << _iter
+                                         << " ), Resigned it with Class "
+                                         << j;
+
+                dst(i, 0) = t;
+                dst(i, 1) = j;
+
+                i++;
+            }
+        }
+    }
+
+    MPI_Bcast(dst.data(),
+              dst.size(),
+              MPI_LONG,
+              MASTER_ID,
+              MPI_COMM_WORLD);
+}
+
+void Optimiser::balanceClass(const umat2& bm)
+{
+    for (int i = 0; i < bm.rows(); i++)
+    {
+        NT_MASTER _model.ref(bm(i, 0)) = _model.ref(bm(i, 1)).copyVolume();
+    }
+}
+
+/***
+void Optimiser::balanceClass(const RFLOAT thres,
+                             const bool refreshDistr)
+{
+    int cls;
+    RFLOAT num = _cDistr.maxCoeff(&cls);
+
+    for (int t = 0; t < _para.k; t++)
+        if (_cDistr(t) < thres / _para.k)
+        {
+            MLOG(INFO, "LOGGER_SYS") << "Class " << t << " is Empty ( Round "
+                                     << _iter
+                                     << " ), Resigned it with Class "
+                                     << cls;
+
+            NT_MASTER _model.ref(t) = _model.ref(cls).copyVolume();
+
+            if (refreshDistr) _cDistr(t) = num;
+        }
+
+    if (refreshDistr) _cDistr.array() /= _cDistr.sum();
+}
+***/
+
+void Optimiser::refreshVariance()
+{
+    vec rv = vec::Zero(_nPar);
+    vec t0v = vec::Zero(_nPar);
+    vec t1v = vec::Zero(_nPar);
+
+#ifdef OPTIMISER_REFRESH_VARIANCE_BEST_CLASS
+
+    int bestClass = _model.bestClass(_para.thresCutoffFSC, false);
+
+#ifdef VERBOSE_LEVEL_1
+    MLOG(INFO, "LOGGER_SYS") << "Best Class is " << bestClass;
+#endif
+    
+#endif
+
+    NT_MASTER
+    {
+        double rVari, tVariS0, tVariS1, dVari;
+
+        #pragma omp parallel for private(rVari, tVariS0, tVariS1, dVari)
+        FOR_EACH_2D_IMAGE
+        {
+#ifdef OPTIMISER_REFRESH_VARIANCE_BEST_CLASS
+            size_t cls;
+            _par[l].rand(cls);
+
+            if (cls == (size_t)bestClass)
+            {
+                _par[l].vari(rVari,
+                             tVariS0,
+                             tVariS1,
+                             dVari);
+            }
+            else
+            {
+                rVari = GSL_NAN;
+                tVariS0 = GSL_NAN;
+                tVariS1 = GSL_NAN;
+                dVari = GSL_NAN;
+            }
+#else
+            _par[l].vari(rVari,
+                         tVariS0,
+                         tVariS1,
+                         dVari);
+#endif
+
+            rv(_ID[l]) = rVari;
+            t0v(_ID[l]) = tVariS0;
+            t1v(_ID[l]) = tVariS1;
+        }
+    }
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    MPI_Allreduce(MPI_IN_PLACE,
+                  rv.data(),
+                  rv.size(),
+                  TS_MPI_DOUBLE,
+                  MPI_SUM,
+                  MPI_COMM_WORLD); 
+
+    MPI_Allreduce(MPI_IN_PLACE,
+                  t0v.data(),
+                  t0v.size(),
+                  TS_MPI_DOUBLE,
+                  MPI_SUM,
+                  MPI_COMM_WORLD); 
+
+    MPI_Allreduce(MPI_IN_PLACE,
+                  t1v.data(),
+                  t1v.size(),
+                  TS_MPI_DOUBLE,
+                  MPI_SUM,
+                  MPI_COMM_WORLD); 
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+#ifdef OPTIMISER_REFRESH_VARIANCE_BEST_CLASS
+    int num = 0;
+    for (int i = 0; i < _nPar; i++)
+        if (!TSGSL_isnan(rv(i))) num++;
+
+#ifdef VERBOSE_LEVEL_1
+    MLOG(INFO, "LOGGER_SYS") << num << " Particles Belonging to Best Class";
+#endif
+
+    vec rvt = vec::Zero(num);
+    vec t0vt = vec::Zero(num);
+    vec t1vt = vec::Zero(num);
+
+    int j = 0;
+    for (int i = 0; i < _nPar; i++)
+    {
+        if (!TSGSL_isnan(rv(i)))
+        {
+            rvt(j) = rv(i);
+            t0vt(j) = t0v(i);
+            t1vt(j) = t1v(i);
+            
+            j++;
+        }
+    }
+
+    rv = rvt;
+    t0v = t0vt;
+    t1v = t1vt;
+#endif
+
+    ALOG(INFO, "LOGGER_SYS") << "Maximum Rotation Variance: " << rv.maxCoeff();
+    BLOG(INFO, "LOGGER_SYS") << "Maximum Rotation Variance: " << rv.maxCoeff();
+
+    RFLOAT mean, std;
+
+    stat_MAS(mean, std, rv, rv.size());
+
+    _model.setRVari(mean);
+    _model.setStdRVari(std);
+
+    stat_MAS(mean, std, t0v, t0v.size());
+
+    _model.setTVariS0(mean);
+    _model.setStdTVariS0(std);
+
+    stat_MAS(mean, std, t1v, t1v.size());
+
+    _model.setTVariS1(mean);
+    _model.setStdTVariS1(std);
+}
+
+void Optimiser::refreshScale(const bool coord,
+                             const bool group)
+{
+    if (_iter != 0)
+        _rS = _model.resolutionP(_para.thresSclCorFSC, false);
 
     if (_rS > _r)
     {
-        MLOG(WARNING, "LOGGER_SYS") << "_rS is Larger than _r, Set _rS to _r";
-        _rS = _r;
+        MLOG(WARNING, "LOGGER_SYS") << "_rS is Larger than _r, Set _rS to _r";
+        _rS = _r;
+    }
+
+#ifdef OPTIMISER_REFRESH_SCALE_ZERO_FREQ_NO_COORD
+    if (!coord) _rS = 1;
+#endif
+
+    MLOG(INFO, "LOGGER_SYS") << "Upper Boundary Frequency for Scale Correction: "
+                             << _rS;
+
+    mat mXA = mat::Zero(_nGroup, _rS);
+    mat mAA = mat::Zero(_nGroup, _rS);
+
+    vec sXA = vec::Zero(_rS);
+    vec sAA = vec::Zero(_rS);
+
+    NT_MASTER
+    {
+        Image img(size(), size(), FT_SPACE);
+
+        size_t cls;
+        dmat22 rot2D;
+        dmat33 rot3D;
+        dvec2 tran;
+        double d;
+
+        FOR_EACH_2D_IMAGE
+        {
+#ifdef VERBOSE_LEVEL_3
+            ALOG(INFO, "LOGGER_SYS") << "Projecting from the Initial Reference from a Random Rotation for Image " << _ID[l];
+            BLOG(INFO, "LOGGER_SYS") << "Projecting from the Initial Reference from a Random Rotation for Image " << _ID[l];
+#endif
+
+            if (!coord)
+            {
+                if (_para.mode == MODE_2D)
+                {
+                    randRotate2D(rot2D);
+#ifdef VERBOSE_LEVEL_3
+                ALOG(INFO, "LOGGER_SYS") << "The Random Rotation Matrix is " << rot2D;
+                BLOG(INFO, "LOGGER_SYS") << "The Random Rotation Matrix is " << rot2D;
+#endif
+                }
+                else if (_para.mode == MODE_3D)
+                {
+                    randRotate3D(rot3D);
+#ifdef VERBOSE_LEVEL_3
+                ALOG(INFO, "LOGGER_SYS") << "The Random Rotation Matrix is " << rot3D;
+                BLOG(INFO, "LOGGER_SYS") << "The Random Rotation Matrix is " << rot3D;
+#endif
+                }
+                else
+                    REPORT_ERROR("INEXISTENT MODE");
+
+                if (_para.mode == MODE_2D)
+                {
+                    _model.proj(0).projectMT(img, rot2D);
+                }
+                else if (_para.mode == MODE_3D)
+                {
+                    _model.proj(0).projectMT(img, rot3D);
+                }
+                else
+                    REPORT_ERROR("INEXISTENT MODE");
+            }
+            else
+            {
+                if (_para.mode == MODE_2D)
+                {
+                    _par[l].rank1st(cls, rot2D, tran, d);
+                }
+                else if (_para.mode == MODE_3D)
+                {
+                    _par[l].rank1st(cls, rot3D, tran, d);
+                }
+                else
+                    REPORT_ERROR("INEXISTENT MODE");
+
+                if (_para.mode == MODE_2D)
+                {
+#ifdef OPTIMISER_RECENTRE_IMAGE_EACH_ITERATION
+#ifdef OPTIMISER_SCALE_MASK
+                    _model.proj(cls).projectMT(img, rot2D, tran);
+#else
+                    _model.proj(cls).projectMT(img, rot2D, tran - _offset[l]);
+#endif
+#else
+                    _model.proj(cls).projectMT(img, rot2D, tran);
+#endif
+                }
+                else if (_para.mode == MODE_3D)
+                {
+#ifdef OPTIMISER_RECENTRE_IMAGE_EACH_ITERATION
+#ifdef OPTIMISER_SCALE_MASK
+                    _model.proj(cls).projectMT(img, rot3D, tran);
+#else
+                    _model.proj(cls).projectMT(img, rot3D, tran - _offset[l]);
+#endif
+#else
+                    _model.proj(cls).projectMT(img, rot3D, tran);
+#endif
+                }
+                else
+                {
+                    REPORT_ERROR("INEXISTENT MODE");
+
+                    abort();
+                }
+            }
+
+#ifdef VERBOSE_LEVEL_3
+            ALOG(INFO, "LOGGER_SYS") << "Calculating Intensity Scale for Image " << l;
+            BLOG(INFO, "LOGGER_SYS") << "Calculating Intensity Scale for Image " << l;
+#endif
+
+#ifdef OPTIMISER_REFRESH_SCALE_ZERO_FREQ_NO_COORD
+            RFLOAT rL = coord ? _rL : 0;
+#else
+            RFLOAT rL = _rL;
+#endif
+
+#ifdef OPTIMISER_CTF_ON_THE_FLY
+            Image ctf(_para.size, _para.size, FT_SPACE);
+            CTF(ctf,
+                _para.pixelSize, 
+                _ctfAttr[l].voltage,
+                _ctfAttr[l].defocusU,
+                _ctfAttr[l].defocusV,
+                _ctfAttr[l].defocusTheta,
+                _ctfAttr[l].Cs,
+                _ctfAttr[l].amplitudeContrast,
+                _ctfAttr[l].phaseShift,
+                CEIL(_rS) + 1);
+#ifdef OPTIMISER_SCALE_MASK
+            scaleDataVSPrior(sXA,
+                             sAA,
+                             _img[l],
+                             img,
+                             ctf,
+                             _rS,
+                             rL);
+#else
+            scaleDataVSPrior(sXA,
+                             sAA,
+                             _imgOri[l],
+                             img,
+                             ctf,
+                             _rS,
+                             rL);
+#endif
+#else
+#ifdef OPTIMISER_SCALE_MASK
+            scaleDataVSPrior(sXA,
+                             sAA,
+                             _img[l],
+                             img,
+                             _ctf[l],
+                             _rS,
+                             rL);
+#else
+            scaleDataVSPrior(sXA,
+                             sAA,
+                             _imgOri[l],
+                             img,
+                             _ctf[l],
+                             _rS,
+                             rL);
+#endif
+#endif
+
+#ifdef VERBOSE_LEVEL_3
+            ALOG(INFO, "LOGGER_SYS") << "Accumulating Intensity Scale Information from Image " << l;
+            BLOG(INFO, "LOGGER_SYS") << "Accumulating Intensity Scale Information from Image " << l;
+#endif
+
+            if (group)
+            {
+                mXA.row(_groupID[l] - 1) += sXA.transpose();
+                mAA.row(_groupID[l] - 1) += sAA.transpose();
+            }
+            else
+            {
+                mXA.row(0) += sXA.transpose();
+                mAA.row(0) += sAA.transpose();
+            }
+        }
+    }
+
+#ifdef VERBOSE_LEVEL_1
+    ILOG(INFO, "LOGGER_SYS") << "Intensity Scale Information Calculated";
+#endif
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    MLOG(INFO, "LOGGER_ROUND") << "Accumulating Intensity Scale Information from All Processes";
+
+    MPI_Allreduce(MPI_IN_PLACE,
+                  mXA.data(),
+                  mXA.size(),
+                  TS_MPI_DOUBLE,
+                  MPI_SUM,
+                  MPI_COMM_WORLD);
+
+    MPI_Allreduce(MPI_IN_PLACE,
+                  mAA.data(),
+                  mAA.size(),
+                  TS_MPI_DOUBLE,
+                  MPI_SUM,
+                  MPI_COMM_WORLD);
+    if (group)
+    {
+        for (int i = 0; i < _nGroup; i++)
+        {
+#ifdef OPTIMISER_REFRESH_SCALE_SPECTRUM
+            RFLOAT sum = 0;
+            int count = 0;
+
+            for (int r = (int)rL; r < _rS; r++)
+            {
+                sum += mXA(i, r) / mAA(i, r);
+                count += 1;
+            }
+
+            _scale(i) = sum / count;
+#else
+            _scale(i) = mXA.row(i).sum() / mAA.row(i).sum();
+#endif
+        }
+    }
+    else
+    {
+#ifdef OPTIMISER_REFRESH_SCALE_SPECTRUM
+        RFLOAT sum = 0;
+        int count = 0;
+
+        for (int r = (int)rL; r < _rS; r++)
+        {
+            sum += mXA(0, r) / mAA(0, r);
+            count += 1;
+        }
+        
+        for (int i = 0; i < _nGroup; i++)
+            _scale(i) = sum / count;
+#else
+        for (int i = 0; i < _nGroup; i++)
+            _scale(i) = mXA.row(0).sum() / mAA.row(0).sum();
+#endif
+    }
+
+    RFLOAT medianScale = median(_scale, _scale.size());
+
+    MLOG(INFO, "LOGGER_ROUND") << "Median Intensity Scale: " << medianScale;
+
+    MLOG(INFO, "LOGGER_ROUND") << "Removing Extreme Values from Intensity Scale";
+
+    for (int i = 0; i < _nGroup; i++)
+    {
+        if (fabs(_scale(i)) > fabs(medianScale * 5))
+            _scale(i) = medianScale * 5;
+        else if (fabs(_scale(i)) < fabs(medianScale / 5))
+            _scale(i) = medianScale / 5;
+    }
+
+    RFLOAT meanScale = _scale.mean();
+    
+    MLOG(INFO, "LOGGER_ROUND") << "Average Intensity Scale: " << meanScale;
+
+    if (meanScale < 0)
+    {
+        REPORT_ERROR("AVERAGE INTENSITY SCALE SHOULD NOT BE SMALLER THAN ZERO");
+        abort();
+    }
+
+    /***
+    if (medianScale * meanScale < 0)
+        CLOG(FATAL, "LOGGER_SYS") << "Median and Mean of Intensity Scale Should Have the Same Sign";
+    ***/
+
+    MLOG(INFO, "LOGGER_ROUND") << "Standard Deviation of Intensity Scale: "
+                               << TSGSL_stats_sd(_scale.data(), 1, _scale.size());
+
+    /***
+    if (!init)
+    {
+        MLOG(INFO, "LOGGER_ROUND") << "Making Average Intensity Scale be 1";
+
+        for (int i = 0; i < _nGroup; i++)
+            _scale(i) /= fabs(meanScale);
+    }
+    ***/
+
+    IF_MASTER
+    {
+#ifdef VERBOSE_LEVEL_2
+        for (int i = 0; i < _nGroup; i++)
+            MLOG(INFO, "LOGGER_ROUND") << "Scale of Group " << i << " is " << _scale(i);
+#endif
+    }
+}
+
+#ifdef OPTIMISER_RECENTRE_IMAGE_EACH_ITERATION
+void Optimiser::reCentreImg()
+{
+    IF_MASTER return;
+
+    dvec2 tran;
+
+    #pragma omp parallel for private(tran)
+    FOR_EACH_2D_IMAGE
+    {
+        _par[l].rank1st(tran);
+
+        _offset[l](0) -= tran(0);
+        _offset[l](1) -= tran(1);
+
+        translate(_img[l],
+                  _imgOri[l],
+                  _offset[l](0),
+                  _offset[l](1));
+
+        _par[l].setT(_par[l].t().rowwise() - tran.transpose());
+
+        _par[l].setTopT(_par[l].topT() - tran);
+        _par[l].setTopTPrev(_par[l].topTPrev() - tran);
+    }
+}
+#endif
+
+void Optimiser::reMaskImg()
+{
+    IF_MASTER return;
+
+#ifdef OPTIMISER_MASK_IMG
+    if (_para.zeroMask)
+    {
+        //if (_commRank == HEMI_B_LEAD)
+        //{
+        //    int imgNum = _ID.size();
+        //    printf("maskR:%lf, pixelS:%lf, idim:%d, imgNum:%d\n",_para.maskRadius,
+        //                                                         _para.pixelSize,
+        //                                                         _para.size,
+        //                                                         imgNum);
+        //    FILE* p;
+        //    for (int i = 0; i < imgNum; i++)
+        //    {
+        //        std::stringstream ss;
+        //        ss<<i; 
+        //        std::string sC = ss.str();
+        //        std::string addT;
+        //        addT.append("image");
+        //        addT.append(sC);
+        //        addT.append(".dat");
+
+        //        p = fopen(addT.c_str(), "wb");
+        //        fwrite(&(_img[i][0]), sizeof(Complex), _img[i].sizeFT(), p);
+        //        fclose (p);
+        //    }
+        //    printf("write done!\n");
+        //}
+
+        Image mask(_para.size, _para.size, RL_SPACE);
+
+        softMask(mask,
+                 _para.maskRadius / _para.pixelSize,
+                 EDGE_WIDTH_RL);
+
+        FOR_EACH_2D_IMAGE
+        {
+            _fftImg.bwExecutePlanMT(_img[l]);
+
+            #pragma omp parallel for
+            MUL_RL(_img[l], mask);
+
+            _fftImg.fwExecutePlanMT(_img[l]);
+
+            _img[l].clearRL();
+        }
+    }
+    else
+    {
+        //TODO Make the background a noise with PowerSpectrum of sigma2
+    }
+#endif
+}
+
+#ifdef GPU_VERSION
+
+void Optimiser::reMaskImgG()
+{
+    IF_MASTER return;
+
+#ifdef OPTIMISER_MASK_IMG
+    if (_para.zeroMask)
+    {
+        //if (_commRank == HEMI_B_LEAD)
+        //{
+        //    int imgNum = 1200;
+        //    printf("maskR:%lf, pixelS:%lf, idim:%d, imgNum:%d\n",_para.maskRadius,
+        //                                                         _para.pixelSize,
+        //                                                         _para.size,
+        //                                                         imgNum);
+        //    FILE* p;
+        //    for (int i = 0; i < imgNum; i++)
+        //    {
+        //        std::stringstream ss;
+        //        ss<<i; 
+        //        std::string sC = ss.str();
+        //        std::string addT;
+        //        addT.append("image");
+        //        addT.append(sC);
+        //        addT.append(".dat");
+
+        //        p = fopen(addT.c_str(), "wb");
+        //        fwrite(&(_img[i][0]), sizeof(Complex), _img[i].sizeFT(), p);
+        //        fclose (p);
+        //    }
+        //    printf("write done!\n");
+        //}
+
+        ReMask(_img,
+               _para.maskRadius,
+               _para.pixelSize,
+               EDGE_WIDTH_RL,
+               _para.size,
+               (int)_ID.size());
+    }
+    else
+    {
+        //TODO Make the background a noise with PowerSpectrum of sigma2
+    }
+#endif
+}
+
+#endif // GPU_VERSION
+
+void Optimiser::normCorrection()
+{
+    RFLOAT rNorm = TSGSL_MIN_RFLOAT(_r, _model.resolutionP(0.75, false));
+
+    vec norm = vec::Zero(_nPar);
+
+    size_t cls;
+
+    dmat22 rot2D;
+    dmat33 rot3D;
+
+    dvec2 tran;
+
+    double d;
+
+    NT_MASTER
+    {
+        #pragma omp parallel for private(cls, rot2D, rot3D, tran, d)
+        FOR_EACH_2D_IMAGE
+        {
+            Image img(size(), size(), FT_SPACE);
+
+            SET_0_FT(img);
+
+            //for (int m = 0; m < _para.mReco; m++)
+            for (int m = 0; m < 1; m++)
+            {
+                if (_para.mode == MODE_2D)
+                {
+                    //_par[l].rand(cls, rot2D, tran, d);
+                    _par[l].rank1st(cls, rot2D, tran, d);
+
+#ifdef OPTIMISER_RECENTRE_IMAGE_EACH_ITERATION
+#ifdef OPTIMISER_NORM_MASK
+                    _model.proj(cls).project(img, rot2D, tran);
+#else
+                    _model.proj(cls).project(img, rot2D, tran - _offset[l]);
+#endif
+#else
+                    _model.proj(cls).project(img, rot2D, tran);
+#endif
+                }
+                else if (_para.mode == MODE_3D)
+                {
+                    //_par[l].rand(cls, rot3D, tran, d);
+                    _par[l].rank1st(cls, rot3D, tran, d);
+
+#ifdef OPTIMISER_RECENTRE_IMAGE_EACH_ITERATION
+#ifdef OPTIMISER_NORM_MASK
+                    _model.proj(cls).project(img, rot3D, tran);
+#else
+                    _model.proj(cls).project(img, rot3D, tran - _offset[l]);
+#endif
+#else
+                    _model.proj(cls).project(img, rot3D, tran);
+#endif
+                }
+
+                if (_searchType != SEARCH_TYPE_CTF)
+                {
+#ifdef OPTIMISER_CTF_ON_THE_FLY
+                    Image ctf(_para.size, _para.size, FT_SPACE);
+                    CTF(ctf,
+                        _para.pixelSize, 
+                        _ctfAttr[l].voltage,
+                        _ctfAttr[l].defocusU,
+                        _ctfAttr[l].defocusV,
+                        _ctfAttr[l].defocusTheta,
+                        _ctfAttr[l].Cs,
+                        _ctfAttr[l].amplitudeContrast,
+                        _ctfAttr[l].phaseShift,
+                        CEIL(rNorm) + 1);
+
+                    FOR_EACH_PIXEL_FT(img)
+                        img[i] *= REAL(ctf[i]);
+#else
+                    FOR_EACH_PIXEL_FT(img)
+                        img[i] *= REAL(_ctf[l][i]);
+#endif
+                }
+                else
+                {
+                    Image ctf(_para.size, _para.size, FT_SPACE);
+                    CTF(ctf,
+                        _para.pixelSize, 
+                        _ctfAttr[l].voltage,
+                        _ctfAttr[l].defocusU * d,
+                        _ctfAttr[l].defocusV * d,
+                        _ctfAttr[l].defocusTheta,
+                        _ctfAttr[l].Cs,
+                        _ctfAttr[l].amplitudeContrast,
+                        _ctfAttr[l].phaseShift);
+
+                    FOR_EACH_PIXEL_FT(img)
+                        img[i] *= REAL(ctf[i]);
+                }
+
+#ifdef OPTIMISER_ADJUST_2D_IMAGE_NOISE_ZERO_MEAN
+                _img[l][0] = img[0];
+                _imgOri[l][0] = img[0];
+#endif
+
+                NEG_FT(img);
+
+#ifdef OPTIMISER_NORM_MASK
+                ADD_FT(img, _img[l]);
+#else
+                ADD_FT(img, _imgOri[l]);
+#endif
+
+                IMAGE_FOR_EACH_PIXEL_FT(img)
+                {
+                    if ((QUAD(i, j) >= TSGSL_pow_2(_rL)) &&
+                        (QUAD(i, j) < TSGSL_pow_2(rNorm)))
+                        norm(_ID[l]) += ABS2(img.getFTHalf(i, j));
+                }
+            }
+        }
+    }
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    MPI_Allreduce(MPI_IN_PLACE,
+                  norm.data(),
+                  norm.size(),
+                  TS_MPI_DOUBLE,
+                  MPI_SUM,
+                  MPI_COMM_WORLD); 
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    MLOG(INFO, "LOGGER_SYS") << "Max of Norm of Noise : "
+                             << TSGSL_stats_max(norm.data(), 1, norm.size());
+
+    MLOG(INFO, "LOGGER_SYS") << "Min of Norm of Noise : "
+                             << TSGSL_stats_min(norm.data(), 1, norm.size());
+
+    RFLOAT m = median(norm, norm.size());
+
+    MLOG(INFO, "LOGGER_SYS") << "Mean of Norm of Noise : "
+                             << m;
+
+    NT_MASTER
+    {
+        #pragma omp parallel for
+        FOR_EACH_2D_IMAGE
+        {
+            FOR_EACH_PIXEL_FT(_img[l])
+            {
+                _img[l][i] *= sqrt(m / norm(_ID[l]));
+                _imgOri[l][i] *= sqrt(m / norm(_ID[l]));
+            }
+        }
+    }
+}
+
+void Optimiser::allReduceSigma(const bool group)
+/***
+void Optimiser::allReduceSigma(const bool mask,
+                               const bool group)
+***/
+{
+    IF_MASTER return;
+
+#ifdef OPTIMISER_SIGMA_WHOLE_FREQUENCY
+    int rSig = maxR();
+#else
+    int rSig = _r;
+#endif
+
+    ALOG(INFO, "LOGGER_ROUND") << "Clearing Up Sigma";
+    BLOG(INFO, "LOGGER_ROUND") << "Clearing Up Sigma";
+
+    // set re-calculating part to zero
+    _sig.leftCols(rSig).setZero();
+    _sig.rightCols(1).setZero();
+
+    // mat sigM = _sig; // masked sigma
+    // mat sigN = _sig; // no-masked sigma
+
+    mat sigM = mat::Zero(_sig.rows(), _sig.cols()); // masked sigma
+    mat sigN = mat::Zero(_sig.rows(), _sig.cols()); // no-masked sigma
+
+    _svd.leftCols(rSig).setZero();
+    _svd.rightCols(1).setZero();
+
+    ALOG(INFO, "LOGGER_ROUND") << "Recalculating Sigma";
+    BLOG(INFO, "LOGGER_ROUND") << "Recalculating Sigma";
+
+    size_t cls;
+
+    dmat22 rot2D;
+    dmat33 rot3D;
+
+    dvec2 tran;
+
+    double d;
+
+    omp_lock_t* mtx = new omp_lock_t[_nGroup];
+
+    #pragma omp parallel for
+    for (int l = 0; l < _nGroup; l++)
+        omp_init_lock(&mtx[l]);
+
+    #pragma omp parallel for private(cls, rot2D, rot3D, tran, d) schedule(dynamic)
+    FOR_EACH_2D_IMAGE
+    {
+#ifdef OPTIMISER_SIGMA_RANK1ST
+        for (int m = 0; m < 1; m++)
+#else
+        for (int m = 0; m < _para.mReco; m++)
+#endif
+        {
+#ifdef OPTIMIDSER_SIGMA_GRADING
+            RFLOAT w;
+
+            if (_para.parGra) 
+                w = _par[l].compressR();
+            else
+                w = 1;
+#else
+            RFLOAT w = 1;
+#endif
+
+            Image imgM(size(), size(), FT_SPACE);
+            Image imgN(size(), size(), FT_SPACE);
+
+            SET_0_FT(imgM);
+            SET_0_FT(imgN);
+
+            vec vSigM(rSig);
+            vec vSigN(rSig);
+
+            vec sSVD(rSig);
+            vec dSVD(rSig);
+
+            if (_para.mode == MODE_2D)
+            {
+#ifdef OPTIMISER_SIGMA_RANK1ST
+                _par[l].rank1st(cls, rot2D, tran, d);
+#else
+                _par[l].rand(cls, rot2D, tran, d);
+#endif
+
+#ifdef OPTIMISER_RECENTRE_IMAGE_EACH_ITERATION
+                 _model.proj(cls).project(imgM, rot2D, tran);
+                 _model.proj(cls).project(imgN, rot2D, tran - _offset[l]);
+#else
+                 _model.proj(cls).project(imgM, rot2D, tran);
+                 _model.proj(cls).project(imgN, rot2D, tran);
+#endif
+            }
+            else if (_para.mode == MODE_3D)
+            {
+#ifdef OPTIMISER_SIGMA_RANK1ST
+                _par[l].rank1st(cls, rot3D, tran, d);
+#else
+                _par[l].rand(cls, rot3D, tran, d);
+#endif
+
+#ifdef OPTIMISER_RECENTRE_IMAGE_EACH_ITERATION
+                _model.proj(cls).project(imgM, rot3D, tran);
+                _model.proj(cls).project(imgN, rot3D, tran - _offset[l]);
+#else
+                _model.proj(cls).project(imgM, rot3D, tran);
+                _model.proj(cls).project(imgN, rot3D, tran);
+#endif
+            }
+
+            if (_searchType != SEARCH_TYPE_CTF)
+            {
+#ifdef OPTIMISER_CTF_ON_THE_FLY
+                Image ctf(_para.size, _para.size, FT_SPACE);
+                CTF(ctf,
+                    _para.pixelSize, 
+                    _ctfAttr[l].voltage,
+                    _ctfAttr[l].defocusU,
+                    _ctfAttr[l].defocusV,
+                    _ctfAttr[l].defocusTheta,
+                    _ctfAttr[l].Cs,
+                    _ctfAttr[l].amplitudeContrast,
+                    _ctfAttr[l].phaseShift,
+                    CEIL(rSig) + 1);
+
+                FOR_EACH_PIXEL_FT(imgM)
+                    imgM[i] *= REAL(ctf[i]);
+                FOR_EACH_PIXEL_FT(imgN)
+                    imgN[i] *= REAL(ctf[i]);
+#else
+                FOR_EACH_PIXEL_FT(imgM)
+                    imgM[i] *= REAL(_ctf[l][i]);
+                FOR_EACH_PIXEL_FT(imgN)
+                    imgN[i] *= REAL(_ctf[l][i]);
+#endif
+            }
+            else
+            {
+                Image ctf(_para.size, _para.size, FT_SPACE);
+                CTF(ctf,
+                    _para.pixelSize, 
+                    _ctfAttr[l].voltage,
+                    _ctfAttr[l].defocusU * d,
+                    _ctfAttr[l].defocusV * d,
+                    _ctfAttr[l].defocusTheta,
+                    _ctfAttr[l].Cs,
+                    _ctfAttr[l].amplitudeContrast,
+                    _ctfAttr[l].phaseShift);
+
+                FOR_EACH_PIXEL_FT(imgM)
+                    imgM[i] *= REAL(ctf[i]);
+                FOR_EACH_PIXEL_FT(imgN)
+                    imgN[i] *= REAL(ctf[i]);
+            }
+
+            powerSpectrum(sSVD, imgM, rSig);
+            powerSpectrum(dSVD, _img[l], rSig);
+
+            NEG_FT(imgM);
+            NEG_FT(imgN);
+
+            ADD_FT(imgM, _img[l]);
+            ADD_FT(imgN, _imgOri[l]);
+
+            powerSpectrum(vSigM, imgM, rSig);
+            powerSpectrum(vSigN, imgN, rSig);
+
+            if (group)
+            {
+                omp_set_lock(&mtx[_groupID[l] - 1]);
+
+                sigM.row(_groupID[l] - 1).head(rSig) += w * vSigM.transpose() / 2;
+                sigM(_groupID[l] - 1, sigM.cols() - 1) += w;
+
+                sigN.row(_groupID[l] - 1).head(rSig) += w * vSigN.transpose() / 2;
+                sigN(_groupID[l] - 1, sigN.cols() - 1) += w;
+
+                for (int i = 0; i < rSig; i++)
+                    _svd(_groupID[l] - 1, i) += w * sqrt(sSVD(i) / dSVD(i));
+                _svd(_groupID[l] - 1, _svd.cols() - 1) += w;
+
+                omp_unset_lock(&mtx[_groupID[l] - 1]);
+            }
+            else
+            {
+                omp_set_lock(&mtx[0]);
+
+                sigM.row(0).head(rSig) += w * vSigM.transpose() / 2;
+                sigM(0, sigM.cols() - 1) += w;
+
+                sigN.row(0).head(rSig) += w * vSigN.transpose() / 2;
+                sigN(0, sigN.cols() - 1) += w;
+
+                for (int i = 0; i < rSig; i++)
+                    _svd(0, i) += w * sqrt(sSVD(i) / dSVD(i));
+                _svd(0, _svd.cols() - 1) += w;
+
+                omp_unset_lock(&mtx[0]);
+            }
+        }
+    }
+
+    delete[] mtx;
+
+    MPI_Barrier(_hemi);
+
+    ALOG(INFO, "LOGGER_ROUND") << "Averaging Sigma of Images Belonging to the Same Group";
+    BLOG(INFO, "LOGGER_ROUND") << "Averaging Sigma of Images Belonging to the Same Group";
+
+    MPI_Allreduce(MPI_IN_PLACE,
+                  sigM.data(),
+                  rSig * _nGroup,
+                  TS_MPI_DOUBLE,
+                  MPI_SUM,
+                  _hemi);
+
+    MPI_Allreduce(MPI_IN_PLACE,
+                  sigM.col(sigM.cols() - 1).data(),
+                  _nGroup,
+                  TS_MPI_DOUBLE,
+                  MPI_SUM,
+                  _hemi);
+
+    MPI_Allreduce(MPI_IN_PLACE,
+                  sigN.data(),
+                  rSig * _nGroup,
+                  TS_MPI_DOUBLE,
+                  MPI_SUM,
+                  _hemi);
+
+    MPI_Allreduce(MPI_IN_PLACE,
+                  sigN.col(sigN.cols() - 1).data(),
+                  _nGroup,
+                  TS_MPI_DOUBLE,
+                  MPI_SUM,
+                  _hemi);
+
+    MPI_Allreduce(MPI_IN_PLACE,
+                  _svd.data(),
+                  rSig * _nGroup,
+                  TS_MPI_DOUBLE,
+                  MPI_SUM,
+                  _hemi);
+
+    MPI_Allreduce(MPI_IN_PLACE,
+                  _svd.col(_svd.cols() - 1).data(),
+                  _nGroup,
+                  TS_MPI_DOUBLE,
+                  MPI_SUM,
+                  _hemi);
+
+    MPI_Barrier(_hemi);
+
+    if (group)
+    {
+        #pragma omp parallel for
+        for (int i = 0; i < _sig.rows(); i++)
+        {
+            sigM.row(i).head(rSig) /= sigM(i, sigM.cols() - 1);
+            sigN.row(i).head(rSig) /= sigN(i, sigN.cols() - 1);
+            _svd.row(i).head(rSig) /= _svd(i, _svd.cols() - 1);
+        }
+    }
+    else
+    {
+        sigM.row(0).head(rSig) /= sigM(0, sigM.cols() - 1);
+        sigN.row(0).head(rSig) /= sigN(0, sigN.cols() - 1);
+        _svd.row(0).head(rSig) /= _svd(0, _svd.cols() - 1);
+
+        #pragma omp parallel for
+        for (int i = 1; i < _sig.rows(); i++)
+        {
+            sigM.row(i).head(rSig) = sigM.row(0).head(rSig);
+            sigN.row(i).head(rSig) = sigN.row(0).head(rSig);
+            _svd.row(i).head(rSig) = _svd.row(0).head(rSig);
+        }
+    }
+
+    #pragma omp parallel for
+    for (int i = rSig; i < _sig.cols() - 1; i++)
+    {
+        sigM.col(i) = sigM.col(rSig - 1);
+        sigN.col(i) = sigN.col(rSig - 1);
+        _svd.col(i) = _svd.col(rSig - 1);
+    }
+
+    RFLOAT alpha = sqrt(M_PI * gsl_pow_2(_para.maskRadius / (_para.size * _para.pixelSize)));
+    
+    // ALOG(INFO, "LOGGER_SYS") << "alpha = " << alpha;
+
+    #pragma omp parallel for
+    for (int i = 0; i < _nGroup; i++)
+        for (int j = 0; j < _sig.cols() - 1; j++)
+        {
+            RFLOAT ratio = GSL_MIN_DBL(1, _svd(i, j));
+
+#ifdef OPTIMISER_SIGMA_MASK
+            _sig(i, j) = sigM(i, j);
+#else
+            _sig(i, j) = ratio * sigM(i, j) + (1 - ratio) * alpha * sigN(i, j);
+#endif
+            // _sig(i, j) = (ratio * gsl_pow_2(alpha) + (1 - ratio) * alpha) * sigN(i, j);
+        }
+
+    /***
+    if (!mask)
+    {
+#ifdef OPTIMISER_SIGMA_CORE
+        RFLOAT ratio = M_PI * gsl_pow_2(_para.maskRadius / _para.pixelSize) / gsl_pow_2(_para.size);
+
+        _sig.array() *= gsl_pow_2(ratio);
+#endif
+    }
+    ***/
+
+    #pragma omp parallel for
+    for (int i = 0; i < _nGroup; i++)
+        for (int j = 0; j < rSig; j++)
+            _sigRcp(i, j) = -0.5 / _sig(i, j);
+}
+
+/**
+ * order of the poses to be inserted, by translation, defocus factor, class and
+ * then rotation
+ */
+struct RecoPoseLess
+{
+    bool operator()(const RecoPose& a, const RecoPose& b) const
+    {
+        if (a.tran[0] != b.tran[0]) return a.tran[0] < b.tran[0];
+        if (a.tran[1] != b.tran[1]) return a.tran[1] < b.tran[1];
+        if (a.d != b.d) return a.d < b.d;
+        if (a.cls != b.cls) return a.cls < b.cls;
+
+        for (int i = 0; i < 4; i++)
+            if (a.quat[i] != b.quat[i]) return a.quat[i] < b.quat[i];
+
+        return false;
+    }
+};
+
+int Optimiser::planInsert(vector<RecoPose>& dst,
+                          const int l,
+                          const RFLOAT w) const
+{
+    vector<RecoPose> draw(_para.mReco);
+
+    for (int m = 0; m < _para.mReco; m++)
+    {
+        size_t cls;
+        dvec4 quat;
+        dvec2 tran;
+        double d;
+
+        _par[l].rand(cls, quat, tran, d);
+
+        draw[m].cls = cls;
+
+        for (int i = 0; i < 4; i++) draw[m].quat[i] = quat(i);
+
+        draw[m].tran[0] = tran(0);
+        draw[m].tran[1] = tran(1);
+
+        draw[m].d = d;
+
+        draw[m].w = w;
+
+        draw[m].count = 1;
+    }
+
+    std::sort(draw.begin(), draw.end(), RecoPoseLess());
+
+    // cosine of the largest angle between the rotations merged, the angle
+    // between two quaternions in 3D being twice of that between the vectors
+
+    double cosTol = (_para.mode == MODE_2D)
+                  ? cos(RECO_MERGE_ROT_TOL * M_PI / 180)
+                  : cos(RECO_MERGE_ROT_TOL * M_PI / 360);
+
+    dst.clear();
+
+    // the first pose of the run sharing class, translation and defocus factor
+    // with the current draw
+
+    int run = 0;
+
+    for (int m = 0; m < _para.mReco; m++)
+    {
+        const RecoPose& p = draw[m];
+
+        if ((m == 0) ||
+            (p.tran[0] != dst.back().tran[0]) ||
+            (p.tran[1] != dst.back().tran[1]) ||
+            (p.d != dst.back().d) ||
+            (p.cls != dst.back().cls))
+            run = dst.size();
+
+        int merge = -1;
+
+        for (int i = run; i < (int)dst.size(); i++)
+        {
+            if (memcmp(dst[i].quat, p.quat, sizeof(p.quat)) == 0)
+            {
+                merge = i;
+                break;
+            }
+
+            if (RECO_MERGE_ROT_TOL > 0)
+            {
+                double dot = (_para.mode == MODE_2D)
+                           ? dst[i].quat[0] * p.quat[0] + dst[i].quat[1] * p.quat[1]
+                           : fabs(dst[i].quat[0] * p.quat[0]
+                                + dst[i].quat[1] * p.quat[1]
+                                + dst[i].quat[2] * p.quat[2]
+                                + dst[i].quat[3] * p.quat[3]);
+
+                if (dot >= cosTol)
+                {
+                    merge = i;
+                    break;
+                }
+            }
+        }
+
+        if (merge == -1)
+            dst.push_back(p);
+        else
+        {
+            dst[merge].w += p.w;
+            dst[merge].count += p.count;
+        }
+    }
+
+    return dst.size();
+}
+
+int Optimiser::searchBudget(const int l,
+                            const bool skip) const
+{
+    int nStable = _track[l].nStable;
+
+    if (skip && (nStable >= SELECTIVE_N_ITER_SKIP))
+        return SEARCH_BUDGET_SKIP;
+    else if (nStable >= SELECTIVE_N_ITER_REDUCE)
+        return SEARCH_BUDGET_REDUCED;
+    else
+        return SEARCH_BUDGET_FULL;
+}
+
+void Optimiser::refreshTrack(const int l)
+{
+    size_t cls;
+    dvec4 quat;
+    dvec2 tran;
+    double d;
+
+    _par[l].rank1st(cls, quat, tran, d);
+
+    ParticleTrack& track = _track[l];
+
+    if (track.nStable >= 0)
+    {
+        double dot = fabs(quat(0) * track.quat[0]
+                        + quat(1) * track.quat[1]
+                        + quat(2) * track.quat[2]
+                        + quat(3) * track.quat[3]);
+
+        // the quaternion of a 2D rotation holds the cosine and sine of the
+        // angle, and that of a 3D one those of the half angle
+
+        double diffR = (_para.mode == MODE_2D)
+                     ? acos(GSL_MIN(dot, 1.0))
+                     : 2 * acos(GSL_MIN(dot, 1.0));
+
+        double diffT = sqrt(TSGSL_pow_2(tran(0) - track.tran[0])
+                          + TSGSL_pow_2(tran(1) - track.tran[1]));
+
+        if ((cls == track.cls) &&
+            (diffR < SELECTIVE_ROT_TOL * M_PI / 180) &&
+            (diffT < SELECTIVE_TRANS_TOL))
+            track.nStable += 1;
+        else
+            track.nStable = 0;
+    }
+    else
+        track.nStable = 0;
+
+    track.cls = cls;
+
+    for (int i = 0; i < 4; i++)
+        track.quat[i] = quat(i);
+
+    track.tran[0] = tran(0);
+    track.tran[1] = tran(1);
+}
+
+#define BALANCE_LOAD_TAG_N 100
+
+#define BALANCE_LOAD_TAG_IMG 101
+
+static inline void packBytes(vector<char>& dst,
+                             const void* src,
+                             const size_t n)
+{
+    dst.insert(dst.end(), (const char*)src, (const char*)src + n);
+}
+
+static inline const char* unpackBytes(void* dst,
+                                      const char* src,
+                                      const size_t n)
+{
+    memcpy(dst, src, n);
+
+    return src + n;
+}
+
+static void packImage(vector<char>& dst,
+                      const Image& src)
+{
+    int dim[4] = {src.nColRL(),
+                  src.nRowRL(),
+                  !src.isEmptyRL(),
+                  !src.isEmptyFT()};
+
+    packBytes(dst, dim, sizeof(dim));
+
+    if (dim[2]) packBytes(dst, src.dataRL(), src.sizeRL() * sizeof(RFLOAT));
+    if (dim[3]) packBytes(dst, src.dataFT(), src.sizeFT() * sizeof(Complex));
+}
+
+static const char* unpackImage(Image& dst,
+                               const char* src)
+{
+    int dim[4];
+
+    src = unpackBytes(dim, src, sizeof(dim));
+
+    dst = Image();
+
+    if (dim[2])
+    {
+        dst.alloc(dim[0], dim[1], RL_SPACE);
+
+        src = unpackBytes(&dst(0), src, dst.sizeRL() * sizeof(RFLOAT));
     }
 
-#ifdef OPTIMISER_REFRESH_SCALE_ZERO_FREQ_NO_COORD
-    if (!coord) _rS = 1;
-#endif
+    if (dim[3])
+    {
+        dst.alloc(dim[0], dim[1], FT_SPACE);
 
-    MLOG(INFO, "LOGGER_SYS") << "Upper Boundary Frequency for Scale Correction: "
-                             << _rS;
+        src = unpackBytes(&dst[0], src, dst.sizeFT() * sizeof(Complex));
+    }
 
-    mat mXA = mat::Zero(_nGroup, _rS);
-    mat mAA = mat::Zero(_nGroup, _rS);
+    return src;
+}
 
-    vec sXA = vec::Zero(_rS);
-    vec sAA = vec::Zero(_rS);
+/**
+ * This function drops the moved entries of a vector, keeping the order of the
+ * others.
+ */
+template <typename T>
+static void keepUnmoved(vector<T>& v,
+                        const vector<char>& moved)
+{
+    size_t k = 0;
 
-    NT_MASTER
+    for (size_t l = 0; l < v.size(); l++)
     {
-        Image img(size(), size(), FT_SPACE);
+        if (moved[l]) continue;
 
-        size_t cls;
-        dmat22 rot2D;
-        dmat33 rot3D;
-        dvec2 tran;
-        double d;
+        if (k != l) v[k] = boost::move(v[l]);
 
-        FOR_EACH_2D_IMAGE
-        {
-#ifdef VERBOSE_LEVEL_3
-            ALOG(INFO, "LOGGER_SYS") << "Projecting from the Initial Reference from a Random Rotation for Image " << _ID[l];
-            BLOG(INFO, "LOGGER_SYS") << "Projecting from the Initial Reference from a Random Rotation for Image " << _ID[l];
-#endif
+        k++;
+    }
 
-            if (!coord)
-            {
-                if (_para.mode == MODE_2D)
-                {
-                    randRotate2D(rot2D);
-#ifdef VERBOSE_LEVEL_3
-                ALOG(INFO, "LOGGER_SYS") << "The Random Rotation Matrix is " << rot2D;
-                BLOG(INFO, "LOGGER_SYS") << "The Random Rotation Matrix is " << rot2D;
-#endif
-                }
-                else if (_para.mode == MODE_3D)
-                {
-                    randRotate3D(rot3D);
-#ifdef VERBOSE_LEVEL_3
-                ALOG(INFO, "LOGGER_SYS") << "The Random Rotation Matrix is " << rot3D;
-                BLOG(INFO, "LOGGER_SYS") << "The Random Rotation Matrix is " << rot3D;
-#endif
-                }
-                else
-                    REPORT_ERROR("INEXISTENT MODE");
+    v.resize(k);
+}
 
-                if (_para.mode == MODE_2D)
-                {
-                    _model.proj(0).projectMT(img, rot2D);
-                }
-                else if (_para.mode == MODE_3D)
-                {
-                    _model.proj(0).projectMT(img, rot3D);
-                }
-                else
-                    REPORT_ERROR("INEXISTENT MODE");
-            }
-            else
-            {
-                if (_para.mode == MODE_2D)
-                {
-                    _par[l].rank1st(cls, rot2D, tran, d);
-                }
-                else if (_para.mode == MODE_3D)
-                {
-                    _par[l].rank1st(cls, rot3D, tran, d);
-                }
-                else
-                    REPORT_ERROR("INEXISTENT MODE");
+void Optimiser::packImg(vector<char>& dst,
+                        const int l,
+                        const bool ctf) const
+{
+    packBytes(dst, &_ID[l], sizeof(int));
+    packBytes(dst, &_groupID[l], sizeof(int));
+    packBytes(dst, &_ctfAttr[l], sizeof(CTFAttr));
+    packBytes(dst, &_nP[l], sizeof(int));
+    packBytes(dst, &_track[l], sizeof(ParticleTrack));
+    packBytes(dst, &_cost[l], sizeof(double));
 
-                if (_para.mode == MODE_2D)
-                {
 #ifdef OPTIMISER_RECENTRE_IMAGE_EACH_ITERATION
-#ifdef OPTIMISER_SCALE_MASK
-                    _model.proj(cls).projectMT(img, rot2D, tran);
-#else
-                    _model.proj(cls).projectMT(img, rot2D, tran - _offset[l]);
+    double offset[2] = {_offset[l](0), _offset[l](1)};
+
+    packBytes(dst, offset, sizeof(offset));
 #endif
-#else
-                    _model.proj(cls).projectMT(img, rot2D, tran);
+
+    packImage(dst, _img[l]);
+    packImage(dst, _imgOri[l]);
+
+#ifndef OPTIMISER_CTF_ON_THE_FLY
+    if (ctf) packImage(dst, _ctf[l]);
 #endif
-                }
-                else if (_para.mode == MODE_3D)
-                {
+
+    vector<double> par;
+
+    _par[l].pack(par);
+
+    size_t nPar = par.size();
+
+    packBytes(dst, &nPar, sizeof(size_t));
+    packBytes(dst, &par[0], nPar * sizeof(double));
+}
+
+const char* Optimiser::unpackImg(const char* src,
+                                 const bool ctf)
+{
+    int id, groupID, nP;
+    CTFAttr ctfAttr;
+    ParticleTrack track;
+    double c;
+
+    src = unpackBytes(&id, src, sizeof(int));
+    src = unpackBytes(&groupID, src, sizeof(int));
+    src = unpackBytes(&ctfAttr, src, sizeof(CTFAttr));
+    src = unpackBytes(&nP, src, sizeof(int));
+    src = unpackBytes(&track, src, sizeof(ParticleTrack));
+    src = unpackBytes(&c, src, sizeof(double));
+
+    _ID.push_back(id);
+    _groupID.push_back(groupID);
+    _ctfAttr.push_back(ctfAttr);
+    _nP.push_back(nP);
+    _track.push_back(track);
+    _cost.push_back(c);
+
 #ifdef OPTIMISER_RECENTRE_IMAGE_EACH_ITERATION
-#ifdef OPTIMISER_SCALE_MASK
-                    _model.proj(cls).projectMT(img, rot3D, tran);
-#else
-                    _model.proj(cls).projectMT(img, rot3D, tran - _offset[l]);
-#endif
-#else
-                    _model.proj(cls).projectMT(img, rot3D, tran);
-#endif
-                }
-                else
-                {
-                    REPORT_ERROR("INEXISTENT MODE");
+    double offset[2];
 
-                    abort();
-                }
-            }
+    src = unpackBytes(offset, src, sizeof(offset));
 
-#ifdef VERBOSE_LEVEL_3
-            ALOG(INFO, "LOGGER_SYS") << "Calculating Intensity Scale for Image " << l;
-            BLOG(INFO, "LOGGER_SYS") << "Calculating Intensity Scale for Image " << l;
+    _offset.push_back(dvec2(offset[0], offset[1]));
 #endif
 
-#ifdef OPTIMISER_REFRESH_SCALE_ZERO_FREQ_NO_COORD
-            RFLOAT rL = coord ? _rL : 0;
-#else
-            RFLOAT rL = _rL;
-#endif
+    _img.push_back(Image());
+    src = unpackImage(_img.back(), src);
 
-#ifdef OPTIMISER_CTF_ON_THE_FLY
-            Image ctf(_para.size, _para.size, FT_SPACE);
-            CTF(ctf,
-                _para.pixelSize, 
-                _ctfAttr[l].voltage,
-                _ctfAttr[l].defocusU,
-                _ctfAttr[l].defocusV,
-                _ctfAttr[l].defocusTheta,
-                _ctfAttr[l].Cs,
-                _ctfAttr[l].amplitudeContrast,
-                _ctfAttr[l].phaseShift,
-                CEIL(_rS) + 1);
-#ifdef OPTIMISER_SCALE_MASK
-            scaleDataVSPrior(sXA,
-                             sAA,
-                             _img[l],
-                             img,
-                             ctf,
-                             _rS,
-                             rL);
-#else
-            scaleDataVSPrior(sXA,
-                             sAA,
-                             _imgOri[l],
-                             img,
-                             ctf,
-                             _rS,
-                             rL);
-#endif
-#else
-#ifdef OPTIMISER_SCALE_MASK
-            scaleDataVSPrior(sXA,
-                             sAA,
-                             _img[l],
-                             img,
-                             _ctf[l],
-                             _rS,
-                             rL);
-#else
-            scaleDataVSPrior(sXA,
-                             sAA,
-                             _imgOri[l],
-                             img,
-                             _ctf[l],
-                             _rS,
-                             rL);
-#endif
-#endif
+    _imgOri.push_back(Image());
+    src = unpackImage(_imgOri.back(), src);
 
-#ifdef VERBOSE_LEVEL_3
-            ALOG(INFO, "LOGGER_SYS") << "Accumulating Intensity Scale Information from Image " << l;
-            BLOG(INFO, "LOGGER_SYS") << "Accumulating Intensity Scale Information from Image " << l;
+#ifndef OPTIMISER_CTF_ON_THE_FLY
+    if (ctf)
+    {
+        _ctf.push_back(Image());
+        src = unpackImage(_ctf.back(), src);
+    }
 #endif
 
-            if (group)
-            {
-                mXA.row(_groupID[l] - 1) += sXA.transpose();
-                mAA.row(_groupID[l] - 1) += sAA.transpose();
-            }
-            else
-            {
-                mXA.row(0) += sXA.transpose();
-                mAA.row(0) += sAA.transpose();
-            }
-        }
-    }
+    size_t nPar;
 
-#ifdef VERBOSE_LEVEL_1
-    ILOG(INFO, "LOGGER_SYS") << "Intensity Scale Information Calculated";
-#endif
+    src = unpackBytes(&nPar, src, sizeof(size_t));
 
-    MPI_Barrier(MPI_COMM_WORLD);
+    vector<double> par(nPar);
 
-    MLOG(INFO, "LOGGER_ROUND") << "Accumulating Intensity Scale Information from All Processes";
+    src = unpackBytes(&par[0], src, nPar * sizeof(double));
 
-    MPI_Allreduce(MPI_IN_PLACE,
-                  mXA.data(),
-                  mXA.size(),
-                  TS_MPI_DOUBLE,
-                  MPI_SUM,
-                  MPI_COMM_WORLD);
+    _par.push_back(Particle());
+    _par.back().unpack(&par[0], &_sym);
 
-    MPI_Allreduce(MPI_IN_PLACE,
-                  mAA.data(),
-                  mAA.size(),
-                  TS_MPI_DOUBLE,
-                  MPI_SUM,
-                  MPI_COMM_WORLD);
-    if (group)
-    {
-        for (int i = 0; i < _nGroup; i++)
-        {
-#ifdef OPTIMISER_REFRESH_SCALE_SPECTRUM
-            RFLOAT sum = 0;
-            int count = 0;
+    return src;
+}
 
-            for (int r = (int)rL; r < _rS; r++)
-            {
-                sum += mXA(i, r) / mAA(i, r);
-                count += 1;
-            }
+void Optimiser::balanceLoad()
+{
+    IF_MASTER return;
 
-            _scale(i) = sum / count;
-#else
-            _scale(i) = mXA.row(i).sum() / mAA.row(i).sum();
-#endif
-        }
-    }
-    else
-    {
-#ifdef OPTIMISER_REFRESH_SCALE_SPECTRUM
-        RFLOAT sum = 0;
-        int count = 0;
+    size_t nImg = _ID.size();
 
-        for (int r = (int)rL; r < _rS; r++)
-        {
-            sum += mXA(0, r) / mAA(0, r);
-            count += 1;
-        }
-        
-        for (int i = 0; i < _nGroup; i++)
-            _scale(i) = sum / count;
-#else
-        for (int i = 0; i < _nGroup; i++)
-            _scale(i) = mXA.row(0).sum() / mAA.row(0).sum();
-#endif
-    }
+    // the cost is only measured by the expectation on CPU
 
-    RFLOAT medianScale = median(_scale, _scale.size());
+    int valid = (_cost.size() == nImg);
+
+    MPI_Allreduce(MPI_IN_PLACE, &valid, 1, MPI_INT, MPI_LAND, _hemi);
+
+    if (!valid) return;
 
-    MLOG(INFO, "LOGGER_ROUND") << "Median Intensity Scale: " << medianScale;
+    int nRank, rank;
 
-    MLOG(INFO, "LOGGER_ROUND") << "Removing Extreme Values from Intensity Scale";
+    MPI_Comm_size(_hemi, &nRank);
+    MPI_Comm_rank(_hemi, &rank);
 
-    for (int i = 0; i < _nGroup; i++)
-    {
-        if (fabs(_scale(i)) > fabs(medianScale * 5))
-            _scale(i) = medianScale * 5;
-        else if (fabs(_scale(i)) < fabs(medianScale / 5))
-            _scale(i) = medianScale / 5;
-    }
+    double cost = 0;
 
-    RFLOAT meanScale = _scale.mean();
-    
-    MLOG(INFO, "LOGGER_ROUND") << "Average Intensity Scale: " << meanScale;
+    FOR_EACH_2D_IMAGE
+        cost += _cost[l];
 
-    if (meanScale < 0)
-    {
-        REPORT_ERROR("AVERAGE INTENSITY SCALE SHOULD NOT BE SMALLER THAN ZERO");
-        abort();
-    }
+    vector<double> costRank(nRank);
 
-    /***
-    if (medianScale * meanScale < 0)
-        CLOG(FATAL, "LOGGER_SYS") << "Median and Mean of Intensity Scale Should Have the Same Sign";
-    ***/
+    MPI_Allgather(&cost, 1, MPI_DOUBLE, &costRank[0], 1, MPI_DOUBLE, _hemi);
 
-    MLOG(INFO, "LOGGER_ROUND") << "Standard Deviation of Intensity Scale: "
-                               << TSGSL_stats_sd(_scale.data(), 1, _scale.size());
+    double mean = 0;
+    double max = 0;
 
-    /***
-    if (!init)
+    for (int r = 0; r < nRank; r++)
     {
-        MLOG(INFO, "LOGGER_ROUND") << "Making Average Intensity Scale be 1";
-
-        for (int i = 0; i < _nGroup; i++)
-            _scale(i) /= fabs(meanScale);
+        mean += costRank[r] / nRank;
+        max = GSL_MAX(max, costRank[r]);
     }
-    ***/
 
-    IF_MASTER
+    if ((mean <= 0) || (max <= mean * BALANCE_LOAD_THRES))
     {
-#ifdef VERBOSE_LEVEL_2
-        for (int i = 0; i < _nGroup; i++)
-            MLOG(INFO, "LOGGER_ROUND") << "Scale of Group " << i << " is " << _scale(i);
-#endif
+        ALOG(INFO, "LOGGER_ROUND") << "Load Balanced, Busiest Process Taking "
+                                   << max / mean
+                                   << " of Average";
+        BLOG(INFO, "LOGGER_ROUND") << "Load Balanced, Busiest Process Taking "
+                                   << max / mean
+                                   << " of Average";
+
+        return;
     }
-}
 
-#ifdef OPTIMISER_RECENTRE_IMAGE_EACH_ITERATION
-void Optimiser::reCentreImg()
-{
-    IF_MASTER return;
+    // cost to be moved from process i to process j, planned identically on
+    // every process by matching the surpluses with the deficits in order
 
-    dvec2 tran;
+    vector<double> surplus(nRank);
 
-    #pragma omp parallel for private(tran)
-    FOR_EACH_2D_IMAGE
+    for (int r = 0; r < nRank; r++)
+        surplus[r] = costRank[r] - mean;
+
+    vector<double> amount(nRank * nRank, 0);
+
+    for (int i = 0, j = 0; ; )
     {
-        _par[l].rank1st(tran);
+        while ((i < nRank) && (surplus[i] <= 0)) i++;
+        while ((j < nRank) && (surplus[j] >= 0)) j++;
 
-        _offset[l](0) -= tran(0);
-        _offset[l](1) -= tran(1);
+        if ((i == nRank) || (j == nRank)) break;
 
-        translate(_img[l],
-                  _imgOri[l],
-                  _offset[l](0),
-                  _offset[l](1));
+        double t = GSL_MIN(surplus[i], -surplus[j]);
 
-        _par[l].setT(_par[l].t().rowwise() - tran.transpose());
+        amount[i * nRank + j] = t;
 
-        _par[l].setTopT(_par[l].topT() - tran);
-        _par[l].setTopTPrev(_par[l].topTPrev() - tran);
+        surplus[i] -= t;
+        surplus[j] += t;
     }
-}
-#endif
 
-void Optimiser::reMaskImg()
-{
-    IF_MASTER return;
+    // images are given away from the end of the list, as long as the cost sent
+    // to a process does not exceed the planned one by more than half an image,
+    // and at least one image is kept
 
-#ifdef OPTIMISER_MASK_IMG
-    if (_para.zeroMask)
+    if (_track.size() != nImg)
     {
-        //if (_commRank == HEMI_B_LEAD)
-        //{
-        //    int imgNum = _ID.size();
-        //    printf("maskR:%lf, pixelS:%lf, idim:%d, imgNum:%d\n",_para.maskRadius,
-        //                                                         _para.pixelSize,
-        //                                                         _para.size,
-        //                                                         imgNum);
-        //    FILE* p;
-        //    for (int i = 0; i < imgNum; i++)
-        //    {
-        //        std::stringstream ss;
-        //        ss<<i; 
-        //        std::string sC = ss.str();
-        //        std::string addT;
-        //        addT.append("image");
-        //        addT.append(sC);
-        //        addT.append(".dat");
+        _track.resize(nImg);
 
-        //        p = fopen(addT.c_str(), "wb");
-        //        fwrite(&(_img[i][0]), sizeof(Complex), _img[i].sizeFT(), p);
-        //        fclose (p);
-        //    }
-        //    printf("write done!\n");
-        //}
+        FOR_EACH_2D_IMAGE
+            _track[l].nStable = -1;
+    }
 
-        Image mask(_para.size, _para.size, RL_SPACE);
+    _nP.resize(nImg, 0);
 
-        softMask(mask,
-                 _para.maskRadius / _para.pixelSize,
-                 EDGE_WIDTH_RL);
+    vector<char> moved(nImg, 0);
 
-        FOR_EACH_2D_IMAGE
+    vector<vector<char> > buf;
+
+    vector<MPI_Request> req;
+
+    vector<int> nSend(nRank, 0);
+
+    int last = nImg - 1;
+
+    for (int j = 0; j < nRank; j++)
+    {
+        double target = amount[rank * nRank + j];
+
+        if (target <= 0) continue;
+
+        double sent = 0;
+
+        while ((last > 0) && (sent + _cost[last] / 2 <= target))
         {
-            _fftImg.bwExecutePlanMT(_img[l]);
+            moved[last] = 1;
 
-            #pragma omp parallel for
-            MUL_RL(_img[l], mask);
+            sent += _cost[last];
 
-            _fftImg.fwExecutePlanMT(_img[l]);
+            buf.push_back(vector<char>());
 
-            _img[l].clearRL();
+            packImg(buf.back(), last, true);
+
+            nSend[j] += 1;
+
+            last -= 1;
         }
     }
-    else
-    {
-        //TODO Make the background a noise with PowerSpectrum of sigma2
-    }
-#endif
-}
 
-#ifdef GPU_VERSION
+    // buffers stay in place until all the sends complete
 
-void Optimiser::reMaskImgG()
-{
-    IF_MASTER return;
+    req.resize(nRank + buf.size());
 
-#ifdef OPTIMISER_MASK_IMG
-    if (_para.zeroMask)
+    int nReq = 0;
+
+    for (int j = 0, k = 0; j < nRank; j++)
     {
-        //if (_commRank == HEMI_B_LEAD)
-        //{
-        //    int imgNum = 1200;
-        //    printf("maskR:%lf, pixelS:%lf, idim:%d, imgNum:%d\n",_para.maskRadius,
-        //                                                         _para.pixelSize,
-        //                                                         _para.size,
-        //                                                         imgNum);
-        //    FILE* p;
-        //    for (int i = 0; i < imgNum; i++)
-        //    {
-        //        std::stringstream ss;
-        //        ss<<i; 
-        //        std::string sC = ss.str();
-        //        std::string addT;
-        //        addT.append("image");
-        //        addT.append(sC);
-        //        addT.append(".dat");
+        if (amount[rank * nRank + j] <= 0) continue;
 
-        //        p = fopen(addT.c_str(), "wb");
-        //        fwrite(&(_img[i][0]), sizeof(Complex), _img[i].sizeFT(), p);
-        //        fclose (p);
-        //    }
-        //    printf("write done!\n");
-        //}
+        MPI_Isend(&nSend[j], 1, MPI_INT, j, BALANCE_LOAD_TAG_N, _hemi, &req[nReq++]);
 
-        ReMask(_img,
-               _para.maskRadius,
-               _para.pixelSize,
-               EDGE_WIDTH_RL,
-               _para.size,
-               (int)_ID.size());
-    }
-    else
-    {
-        //TODO Make the background a noise with PowerSpectrum of sigma2
+        for (int n = 0; n < nSend[j]; n++, k++)
+            MPI_Isend(&buf[k][0],
+                      buf[k].size(),
+                      MPI_BYTE,
+                      j,
+                      BALANCE_LOAD_TAG_IMG,
+                      _hemi,
+                      &req[nReq++]);
     }
+
+    keepUnmoved(_ID, moved);
+    keepUnmoved(_groupID, moved);
+    keepUnmoved(_ctfAttr, moved);
+    keepUnmoved(_nP, moved);
+    keepUnmoved(_track, moved);
+    keepUnmoved(_cost, moved);
+
+#ifdef OPTIMISER_RECENTRE_IMAGE_EACH_ITERATION
+    keepUnmoved(_offset, moved);
 #endif
-}
 
-#endif // GPU_VERSION
+    keepUnmoved(_img, moved);
+    keepUnmoved(_imgOri, moved);
 
-void Optimiser::normCorrection()
-{
-    RFLOAT rNorm = TSGSL_MIN_RFLOAT(_r, _model.resolutionP(0.75, false));
+#ifndef OPTIMISER_CTF_ON_THE_FLY
+    keepUnmoved(_ctf, moved);
+#endif
 
-    vec norm = vec::Zero(_nPar);
+    keepUnmoved(_par, moved);
 
-    size_t cls;
+    vector<char> src;
 
-    dmat22 rot2D;
-    dmat33 rot3D;
+    for (int i = 0; i < nRank; i++)
+    {
+        if (amount[i * nRank + rank] <= 0) continue;
 
-    dvec2 tran;
+        int nRecv;
 
-    double d;
+        MPI_Recv(&nRecv, 1, MPI_INT, i, BALANCE_LOAD_TAG_N, _hemi, MPI_STATUS_IGNORE);
 
-    NT_MASTER
-    {
-        #pragma omp parallel for private(cls, rot2D, rot3D, tran, d)
-        FOR_EACH_2D_IMAGE
+        for (int n = 0; n < nRecv; n++)
         {
-            Image img(size(), size(), FT_SPACE);
+            MPI_Status status;
 
-            SET_0_FT(img);
+            MPI_Probe(i, BALANCE_LOAD_TAG_IMG, _hemi, &status);
 
-            //for (int m = 0; m < _para.mReco; m++)
-            for (int m = 0; m < 1; m++)
-            {
-                if (_para.mode == MODE_2D)
-                {
-                    //_par[l].rand(cls, rot2D, tran, d);
-                    _par[l].rank1st(cls, rot2D, tran, d);
+            int size;
 
-#ifdef OPTIMISER_RECENTRE_IMAGE_EACH_ITERATION
-#ifdef OPTIMISER_NORM_MASK
-                    _model.proj(cls).project(img, rot2D, tran);
-#else
-                    _model.proj(cls).project(img, rot2D, tran - _offset[l]);
-#endif
-#else
-                    _model.proj(cls).project(img, rot2D, tran);
-#endif
-                }
-                else if (_para.mode == MODE_3D)
-                {
-                    //_par[l].rand(cls, rot3D, tran, d);
-                    _par[l].rank1st(cls, rot3D, tran, d);
+            MPI_Get_count(&status, MPI_BYTE, &size);
 
-#ifdef OPTIMISER_RECENTRE_IMAGE_EACH_ITERATION
-#ifdef OPTIMISER_NORM_MASK
-                    _model.proj(cls).project(img, rot3D, tran);
-#else
-                    _model.proj(cls).project(img, rot3D, tran - _offset[l]);
-#endif
-#else
-                    _model.proj(cls).project(img, rot3D, tran);
-#endif
-                }
+            src.resize(size);
 
-                if (_searchType != SEARCH_TYPE_CTF)
-                {
-#ifdef OPTIMISER_CTF_ON_THE_FLY
-                    Image ctf(_para.size, _para.size, FT_SPACE);
-                    CTF(ctf,
-                        _para.pixelSize, 
-                        _ctfAttr[l].voltage,
-                        _ctfAttr[l].defocusU,
-                        _ctfAttr[l].defocusV,
-                        _ctfAttr[l].defocusTheta,
-                        _ctfAttr[l].Cs,
-                        _ctfAttr[l].amplitudeContrast,
-                        _ctfAttr[l].phaseShift,
-                        CEIL(rNorm) + 1);
+            MPI_Recv(&src[0], size, MPI_BYTE, i, BALANCE_LOAD_TAG_IMG, _hemi, MPI_STATUS_IGNORE);
 
-                    FOR_EACH_PIXEL_FT(img)
-                        img[i] *= REAL(ctf[i]);
-#else
-                    FOR_EACH_PIXEL_FT(img)
-                        img[i] *= REAL(_ctf[l][i]);
-#endif
-                }
-                else
-                {
-                    Image ctf(_para.size, _para.size, FT_SPACE);
-                    CTF(ctf,
-                        _para.pixelSize, 
-                        _ctfAttr[l].voltage,
-                        _ctfAttr[l].defocusU * d,
-                        _ctfAttr[l].defocusV * d,
-                        _ctfAttr[l].defocusTheta,
-                        _ctfAttr[l].Cs,
-                        _ctfAttr[l].amplitudeContrast,
-                        _ctfAttr[l].phaseShift);
+            unpackImg(&src[0], true);
+        }
+
+        if (nRecv != 0) _ckpt.stackStale = true;
+    }
+
+    if (last + 1 != (int)nImg) _ckpt.stackStale = true;
+
+    MPI_Waitall(nReq, &req[0], MPI_STATUSES_IGNORE);
+
+    long nMoved = nImg - (last + 1);
+
+    MPI_Allreduce(MPI_IN_PLACE, &nMoved, 1, MPI_LONG, MPI_SUM, _hemi);
+
+    ALOG(INFO, "LOGGER_ROUND") << "Busiest Process Taking "
+                               << max / mean
+                               << " of Average, "
+                               << nMoved
+                               << " Images Moved";
+    BLOG(INFO, "LOGGER_ROUND") << "Busiest Process Taking "
+                               << max / mean
+                               << " of Average, "
+                               << nMoved
+                               << " Images Moved";
+}
+
+static bool writeAside(const char* dst,
+                       const vector<char>& buf)
+{
+    // written aside and renamed, so that a preempted write never leaves a
+    // truncated checkpoint behind
+
+    char filename[FILE_NAME_LENGTH + 4];
+
+    snprintf(filename, sizeof(filename), "%s.tmp", dst);
 
-                    FOR_EACH_PIXEL_FT(img)
-                        img[i] *= REAL(ctf[i]);
-                }
+    FILE* file = fopen(filename, "wb");
 
-#ifdef OPTIMISER_ADJUST_2D_IMAGE_NOISE_ZERO_MEAN
-                _img[l][0] = img[0];
-                _imgOri[l][0] = img[0];
-#endif
+    bool done = (file != NULL);
 
-                NEG_FT(img);
+    if (done)
+        done = (fwrite(&buf[0], 1, buf.size(), file) == buf.size());
 
-#ifdef OPTIMISER_NORM_MASK
-                ADD_FT(img, _img[l]);
-#else
-                ADD_FT(img, _imgOri[l]);
-#endif
+    if (file != NULL)
+        done = (fclose(file) == 0) && done;
 
-                IMAGE_FOR_EACH_PIXEL_FT(img)
-                {
-                    if ((QUAD(i, j) >= TSGSL_pow_2(_rL)) &&
-                        (QUAD(i, j) < TSGSL_pow_2(rNorm)))
-                        norm(_ID[l]) += ABS2(img.getFTHalf(i, j));
-                }
-            }
-        }
+    if (done)
+        done = (rename(filename, dst) == 0);
+
+    if (!done)
+        CLOG(WARNING, "LOGGER_SYS") << "FAIL TO WRITE CHECKPOINT " << dst;
+
+    return done;
+}
+
+static void* writeCheckpoint(void* arg)
+{
+    CheckpointWriter* ckpt = (CheckpointWriter*)arg;
+
+    bool done = true;
+
+    if (!ckpt->stack.empty())
+    {
+        done = writeAside(ckpt->stackFilename, ckpt->stack);
+
+        ckpt->stackDone = done;
+
+        vector<char>().swap(ckpt->stack);
     }
 
-    MPI_Barrier(MPI_COMM_WORLD);
+    // a checkpoint is never left behind without the images it refers to
 
-    MPI_Allreduce(MPI_IN_PLACE,
-                  norm.data(),
-                  norm.size(),
-                  TS_MPI_DOUBLE,
-                  MPI_SUM,
-                  MPI_COMM_WORLD); 
+    if (done) writeAside(ckpt->filename, ckpt->buf);
+
+    vector<char>().swap(ckpt->buf);
+
+    return NULL;
+}
+
+void Optimiser::saveCheckpoint()
+{
+    // the older slot is only reused when every process has completed the
+    // newer one
+
+    joinCheckpoint();
 
     MPI_Barrier(MPI_COMM_WORLD);
 
-    MLOG(INFO, "LOGGER_SYS") << "Max of Norm of Noise : "
-                             << TSGSL_stats_max(norm.data(), 1, norm.size());
+    if (!_ckpt.stackDone)
+    {
+        // the generation failed to be written is written again
 
-    MLOG(INFO, "LOGGER_SYS") << "Min of Norm of Noise : "
-                             << TSGSL_stats_min(norm.data(), 1, norm.size());
+        _ckpt.stackGen -= 1;
+        _ckpt.stackStale = true;
+        _ckpt.stackDone = true;
+    }
 
-    RFLOAT m = median(norm, norm.size());
+    snprintf(_ckpt.filename,
+             FILE_NAME_LENGTH,
+             "%sCheckpoint_Slot_%d_Rank_%06d.bin",
+             _para.dstPrefix,
+             (_iter + 1) % CHECKPOINT_N_SLOT,
+             _commRank);
 
-    MLOG(INFO, "LOGGER_SYS") << "Mean of Norm of Noise : "
-                             << m;
+    size_t nImg = _ID.size();
 
-    NT_MASTER
+    // the original images never change during iterations, they are written
+    // again only when they are moved among the processes, to the file of the
+    // generation not referred to by the newer slot which every process has
+    // completed
+
+    if (_ckpt.stackStale)
     {
-        #pragma omp parallel for
+        _ckpt.stackGen += 1;
+
+        snprintf(_ckpt.stackFilename,
+                 FILE_NAME_LENGTH,
+                 "%sCheckpoint_Stack_%d_Rank_%06d.bin",
+                 _para.dstPrefix,
+                 _ckpt.stackGen % CHECKPOINT_N_SLOT,
+                 _commRank);
+
+        vector<char>& stack = _ckpt.stack;
+
+        stack.clear();
+
+        int head[2] = {CHECKPOINT_MAGIC, _ckpt.stackGen};
+
+        packBytes(stack, head, sizeof(head));
+        packBytes(stack, &nImg, sizeof(size_t));
+
         FOR_EACH_2D_IMAGE
         {
-            FOR_EACH_PIXEL_FT(_img[l])
-            {
-                _img[l][i] *= sqrt(m / norm(_ID[l]));
-                _imgOri[l][i] *= sqrt(m / norm(_ID[l]));
-            }
+            packBytes(stack, &_ID[l], sizeof(int));
+            packBytes(stack, &_groupID[l], sizeof(int));
+            packBytes(stack, &_ctfAttr[l], sizeof(CTFAttr));
+
+            packImage(stack, _imgOri[l]);
         }
+
+        _ckpt.stackStale = false;
     }
-}
 
-void Optimiser::allReduceSigma(const bool group)
-/***
-void Optimiser::allReduceSigma(const bool mask,
-                               const bool group)
-***/
-{
-    IF_MASTER return;
+    vector<char>& dst = _ckpt.buf;
 
-#ifdef OPTIMISER_SIGMA_WHOLE_FREQUENCY
-    int rSig = maxR();
-#else
-    int rSig = _r;
-#endif
+    dst.clear();
 
-    ALOG(INFO, "LOGGER_ROUND") << "Clearing Up Sigma";
-    BLOG(INFO, "LOGGER_ROUND") << "Clearing Up Sigma";
+    int head[CHECKPOINT_N_HEAD] = {CHECKPOINT_MAGIC,
+                                   _commSize,
+                                   _para.mode,
+                                   _para.k,
+                                   _para.size,
+                                   _iter + 1,
+                                   _ckpt.stackGen};
 
-    // set re-calculating part to zero
-    _sig.leftCols(rSig).setZero();
-    _sig.rightCols(1).setZero();
+    packBytes(dst, head, sizeof(head));
 
-    // mat sigM = _sig; // masked sigma
-    // mat sigN = _sig; // no-masked sigma
+    vector<double> state;
 
-    mat sigM = mat::Zero(_sig.rows(), _sig.cols()); // masked sigma
-    mat sigN = mat::Zero(_sig.rows(), _sig.cols()); // no-masked sigma
+    state.push_back(_r);
+    state.push_back(_rL);
+    state.push_back(_rS);
+    state.push_back(_searchType);
+    state.push_back(_resCutoff);
+    state.push_back(_resReport);
+    state.push_back(_genMask);
+    state.push_back(_rTrack);
 
-    _svd.leftCols(rSig).setZero();
-    _svd.rightCols(1).setZero();
+    state.push_back(_mean);
+    state.push_back(_stdN);
+    state.push_back(_stdD);
+    state.push_back(_stdS);
+    state.push_back(_stdStdN);
 
-    ALOG(INFO, "LOGGER_ROUND") << "Recalculating Sigma";
-    BLOG(INFO, "LOGGER_ROUND") << "Recalculating Sigma";
+    packMatrix(state, _sig);
+    packMatrix(state, _sigRcp);
+    packMatrix(state, _svd);
+    packMatrix(state, _scale);
+    packMatrix(state, _cDistr);
 
-    size_t cls;
+    _model.pack(state);
 
-    dmat22 rot2D;
-    dmat33 rot3D;
+    size_t n = state.size();
 
-    dvec2 tran;
+    packBytes(dst, &n, sizeof(size_t));
+    packBytes(dst, &state[0], n * sizeof(double));
 
-    double d;
+    // the order of particles, by the master
 
-    omp_lock_t* mtx = new omp_lock_t[_nGroup];
+    n = (_commRank == MASTER_ID) ? _db.reg().size() : 0;
 
-    #pragma omp parallel for
-    for (int l = 0; l < _nGroup; l++)
-        omp_init_lock(&mtx[l]);
+    packBytes(dst, &n, sizeof(size_t));
+
+    if (n != 0) packBytes(dst, &_db.reg()[0], n * sizeof(int));
+
+    // the images and the CTFs are re-generated on resuming, from the image
+    // stack and the attributes respectively
+
+    if (_track.size() != nImg)
+    {
+        _track.resize(nImg);
+
+        FOR_EACH_2D_IMAGE
+            _track[l].nStable = -1;
+    }
+
+    _nP.resize(nImg, 0);
+    _cost.resize(nImg, 0);
+
+    packBytes(dst, &nImg, sizeof(size_t));
 
-    #pragma omp parallel for private(cls, rot2D, rot3D, tran, d) schedule(dynamic)
     FOR_EACH_2D_IMAGE
     {
-#ifdef OPTIMISER_SIGMA_RANK1ST
-        for (int m = 0; m < 1; m++)
-#else
-        for (int m = 0; m < _para.mReco; m++)
+        packBytes(dst, &_ID[l], sizeof(int));
+        packBytes(dst, &_nP[l], sizeof(int));
+        packBytes(dst, &_track[l], sizeof(ParticleTrack));
+        packBytes(dst, &_cost[l], sizeof(double));
+
+#ifdef OPTIMISER_RECENTRE_IMAGE_EACH_ITERATION
+        double offset[2] = {_offset[l](0), _offset[l](1)};
+
+        packBytes(dst, offset, sizeof(offset));
 #endif
+
+        vector<double> par;
+
+        _par[l].pack(par);
+
+        size_t nPar = par.size();
+
+        packBytes(dst, &nPar, sizeof(size_t));
+        packBytes(dst, &par[0], nPar * sizeof(double));
+    }
+
+    // the references, by the leads of the hemispheres
+
+    n = ((_commRank == HEMI_A_LEAD) || (_commRank == HEMI_B_LEAD)) ? _para.k : 0;
+
+    packBytes(dst, &n, sizeof(size_t));
+
+    for (size_t t = 0; t < n; t++)
+    {
+        size_t sizeFT = _model.ref(t).sizeFT();
+
+        packBytes(dst, &sizeFT, sizeof(size_t));
+        packBytes(dst, &_model.ref(t)[0], sizeFT * sizeof(Complex));
+    }
+
+    _ckpt.pending = (pthread_create(&_ckpt.thread, NULL, writeCheckpoint, &_ckpt) == 0);
+
+    if (!_ckpt.pending) writeCheckpoint(&_ckpt);
+}
+
+void Optimiser::joinCheckpoint()
+{
+    if (!_ckpt.pending) return;
+
+    pthread_join(_ckpt.thread, NULL);
+
+    _ckpt.pending = false;
+}
+
+void Optimiser::loadCheckpoint()
+{
+    // the latest iteration of which every process has a complete checkpoint
+
+    char filename[CHECKPOINT_N_SLOT][FILE_NAME_LENGTH];
+
+    int iter[CHECKPOINT_N_SLOT];
+
+    int stackGen[CHECKPOINT_N_SLOT];
+
+    int latest = -1;
+
+    for (int s = 0; s < CHECKPOINT_N_SLOT; s++)
+    {
+        snprintf(filename[s],
+                 FILE_NAME_LENGTH,
+                 "%sCheckpoint_Slot_%d_Rank_%06d.bin",
+                 _para.dstPrefix,
+                 s,
+                 _commRank);
+
+        iter[s] = -1;
+
+        FILE* file = fopen(filename[s], "rb");
+
+        if (file == NULL) continue;
+
+        int head[CHECKPOINT_N_HEAD];
+
+        if ((fread(head, sizeof(head), 1, file) == 1) &&
+            (head[0] == CHECKPOINT_MAGIC) &&
+            (head[1] == _commSize) &&
+            (head[2] == _para.mode) &&
+            (head[3] == _para.k) &&
+            (head[4] == _para.size))
         {
-#ifdef OPTIMIDSER_SIGMA_GRADING
-            RFLOAT w;
+            iter[s] = head[5];
+            stackGen[s] = head[6];
+        }
 
-            if (_para.parGra) 
-                w = _par[l].compressR();
-            else
-                w = 1;
-#else
-            RFLOAT w = 1;
-#endif
+        fclose(file);
 
-            Image imgM(size(), size(), FT_SPACE);
-            Image imgN(size(), size(), FT_SPACE);
+        latest = GSL_MAX_INT(latest, iter[s]);
+    }
 
-            SET_0_FT(imgM);
-            SET_0_FT(imgN);
+    MPI_Allreduce(MPI_IN_PLACE, &latest, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
 
-            vec vSigM(rSig);
-            vec vSigN(rSig);
+    int slot = -1;
 
-            vec sSVD(rSig);
-            vec dSVD(rSig);
+    for (int s = 0; s < CHECKPOINT_N_SLOT; s++)
+        if ((latest >= 0) && (iter[s] == latest)) slot = s;
 
-            if (_para.mode == MODE_2D)
-            {
-#ifdef OPTIMISER_SIGMA_RANK1ST
-                _par[l].rank1st(cls, rot2D, tran, d);
-#else
-                _par[l].rand(cls, rot2D, tran, d);
-#endif
+    int valid = (slot != -1);
 
-#ifdef OPTIMISER_RECENTRE_IMAGE_EACH_ITERATION
-                 _model.proj(cls).project(imgM, rot2D, tran);
-                 _model.proj(cls).project(imgN, rot2D, tran - _offset[l]);
-#else
-                 _model.proj(cls).project(imgM, rot2D, tran);
-                 _model.proj(cls).project(imgN, rot2D, tran);
-#endif
-            }
-            else if (_para.mode == MODE_3D)
-            {
-#ifdef OPTIMISER_SIGMA_RANK1ST
-                _par[l].rank1st(cls, rot3D, tran, d);
-#else
-                _par[l].rand(cls, rot3D, tran, d);
-#endif
+    MPI_Allreduce(MPI_IN_PLACE, &valid, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
 
-#ifdef OPTIMISER_RECENTRE_IMAGE_EACH_ITERATION
-                _model.proj(cls).project(imgM, rot3D, tran);
-                _model.proj(cls).project(imgN, rot3D, tran - _offset[l]);
-#else
-                _model.proj(cls).project(imgM, rot3D, tran);
-                _model.proj(cls).project(imgN, rot3D, tran);
-#endif
-            }
+    if (!valid)
+    {
+        REPORT_ERROR("NO CHECKPOINT COMPLETED BY ALL PROCESSES");
 
-            if (_searchType != SEARCH_TYPE_CTF)
-            {
-#ifdef OPTIMISER_CTF_ON_THE_FLY
-                Image ctf(_para.size, _para.size, FT_SPACE);
-                CTF(ctf,
-                    _para.pixelSize, 
-                    _ctfAttr[l].voltage,
-                    _ctfAttr[l].defocusU,
-                    _ctfAttr[l].defocusV,
-                    _ctfAttr[l].defocusTheta,
-                    _ctfAttr[l].Cs,
-                    _ctfAttr[l].amplitudeContrast,
-                    _ctfAttr[l].phaseShift,
-                    CEIL(rSig) + 1);
+        abort();
+    }
 
-                FOR_EACH_PIXEL_FT(imgM)
-                    imgM[i] *= REAL(ctf[i]);
-                FOR_EACH_PIXEL_FT(imgN)
-                    imgN[i] *= REAL(ctf[i]);
-#else
-                FOR_EACH_PIXEL_FT(imgM)
-                    imgM[i] *= REAL(_ctf[l][i]);
-                FOR_EACH_PIXEL_FT(imgN)
-                    imgN[i] *= REAL(_ctf[l][i]);
-#endif
-            }
-            else
-            {
-                Image ctf(_para.size, _para.size, FT_SPACE);
-                CTF(ctf,
-                    _para.pixelSize, 
-                    _ctfAttr[l].voltage,
-                    _ctfAttr[l].defocusU * d,
-                    _ctfAttr[l].defocusV * d,
-                    _ctfAttr[l].defocusTheta,
-                    _ctfAttr[l].Cs,
-                    _ctfAttr[l].amplitudeContrast,
-                    _ctfAttr[l].phaseShift);
+    MLOG(INFO, "LOGGER_INIT") << "Resuming from Round " << latest;
+
+    FILE* file = fopen(filename[slot], "rb");
+
+    fseek(file, 0, SEEK_END);
+
+    vector<char> buf(ftell(file));
+
+    rewind(file);
+
+    if (fread(&buf[0], 1, buf.size(), file) != buf.size())
+    {
+        REPORT_ERROR("FAIL TO READ CHECKPOINT");
+
+        abort();
+    }
+
+    fclose(file);
+
+    const char* p = &buf[0] + CHECKPOINT_N_HEAD * sizeof(int);
 
-                FOR_EACH_PIXEL_FT(imgM)
-                    imgM[i] *= REAL(ctf[i]);
-                FOR_EACH_PIXEL_FT(imgN)
-                    imgN[i] *= REAL(ctf[i]);
-            }
+    size_t n;
 
-            powerSpectrum(sSVD, imgM, rSig);
-            powerSpectrum(dSVD, _img[l], rSig);
+    p = unpackBytes(&n, p, sizeof(size_t));
 
-            NEG_FT(imgM);
-            NEG_FT(imgN);
+    vector<double> state(n);
 
-            ADD_FT(imgM, _img[l]);
-            ADD_FT(imgN, _imgOri[l]);
+    p = unpackBytes(&state[0], p, n * sizeof(double));
 
-            powerSpectrum(vSigM, imgM, rSig);
-            powerSpectrum(vSigN, imgN, rSig);
+    MLOG(INFO, "LOGGER_INIT") << "Restoring the Order of Particles";
 
-            if (group)
-            {
-                omp_set_lock(&mtx[_groupID[l] - 1]);
+    p = unpackBytes(&n, p, sizeof(size_t));
 
-                sigM.row(_groupID[l] - 1).head(rSig) += w * vSigM.transpose() / 2;
-                sigM(_groupID[l] - 1, sigM.cols() - 1) += w;
+    vector<int> reg(n);
 
-                sigN.row(_groupID[l] - 1).head(rSig) += w * vSigN.transpose() / 2;
-                sigN(_groupID[l] - 1, sigN.cols() - 1) += w;
+    if (n != 0) p = unpackBytes(&reg[0], p, n * sizeof(int));
 
-                for (int i = 0; i < rSig; i++)
-                    _svd(_groupID[l] - 1, i) += w * sqrt(sSVD(i) / dSVD(i));
-                _svd(_groupID[l] - 1, _svd.cols() - 1) += w;
+    _db.setReg(reg);
 
-                omp_unset_lock(&mtx[_groupID[l] - 1]);
-            }
-            else
-            {
-                omp_set_lock(&mtx[0]);
+    ALOG(INFO, "LOGGER_INIT") << "Restoring 2D Images and Particle Filters";
+    BLOG(INFO, "LOGGER_INIT") << "Restoring 2D Images and Particle Filters";
 
-                sigM.row(0).head(rSig) += w * vSigM.transpose() / 2;
-                sigM(0, sigM.cols() - 1) += w;
+    // the images are in the same order in the image stack as in the
+    // checkpoint, as they are only re-ordered by balancing the load, after
+    // which a new generation of the image stack is written
 
-                sigN.row(0).head(rSig) += w * vSigN.transpose() / 2;
-                sigN(0, sigN.cols() - 1) += w;
+    char stackFilename[FILE_NAME_LENGTH];
 
-                for (int i = 0; i < rSig; i++)
-                    _svd(0, i) += w * sqrt(sSVD(i) / dSVD(i));
-                _svd(0, _svd.cols() - 1) += w;
+    snprintf(stackFilename,
+             FILE_NAME_LENGTH,
+             "%sCheckpoint_Stack_%d_Rank_%06d.bin",
+             _para.dstPrefix,
+             stackGen[slot] % CHECKPOINT_N_SLOT,
+             _commRank);
 
-                omp_unset_lock(&mtx[0]);
-            }
-        }
+    file = fopen(stackFilename, "rb");
+
+    if (file == NULL)
+    {
+        REPORT_ERROR("FAIL TO READ IMAGE STACK OF CHECKPOINT");
+
+        abort();
     }
 
-    delete[] mtx;
+    fseek(file, 0, SEEK_END);
 
-    MPI_Barrier(_hemi);
+    vector<char> stack(ftell(file));
 
-    ALOG(INFO, "LOGGER_ROUND") << "Averaging Sigma of Images Belonging to the Same Group";
-    BLOG(INFO, "LOGGER_ROUND") << "Averaging Sigma of Images Belonging to the Same Group";
+    rewind(file);
 
-    MPI_Allreduce(MPI_IN_PLACE,
-                  sigM.data(),
-                  rSig * _nGroup,
-                  TS_MPI_DOUBLE,
-                  MPI_SUM,
-                  _hemi);
+    if (fread(&stack[0], 1, stack.size(), file) != stack.size())
+    {
+        REPORT_ERROR("FAIL TO READ IMAGE STACK OF CHECKPOINT");
 
-    MPI_Allreduce(MPI_IN_PLACE,
-                  sigM.col(sigM.cols() - 1).data(),
-                  _nGroup,
-                  TS_MPI_DOUBLE,
-                  MPI_SUM,
-                  _hemi);
+        abort();
+    }
 
-    MPI_Allreduce(MPI_IN_PLACE,
-                  sigN.data(),
-                  rSig * _nGroup,
-                  TS_MPI_DOUBLE,
-                  MPI_SUM,
-                  _hemi);
+    fclose(file);
 
-    MPI_Allreduce(MPI_IN_PLACE,
-                  sigN.col(sigN.cols() - 1).data(),
-                  _nGroup,
-                  TS_MPI_DOUBLE,
-                  MPI_SUM,
-                  _hemi);
+    const char* r = &stack[0];
 
-    MPI_Allreduce(MPI_IN_PLACE,
-                  _svd.data(),
-                  rSig * _nGroup,
-                  TS_MPI_DOUBLE,
-                  MPI_SUM,
-                  _hemi);
+    int head[2];
 
-    MPI_Allreduce(MPI_IN_PLACE,
-                  _svd.col(_svd.cols() - 1).data(),
-                  _nGroup,
-                  TS_MPI_DOUBLE,
-                  MPI_SUM,
-                  _hemi);
+    r = unpackBytes(head, r, sizeof(head));
 
-    MPI_Barrier(_hemi);
+    if ((head[0] != CHECKPOINT_MAGIC) || (head[1] != stackGen[slot]))
+    {
+        REPORT_ERROR("INCONSISTENT IMAGE STACK OF CHECKPOINT");
 
-    if (group)
+        abort();
+    }
+
+    size_t nImg;
+
+    r = unpackBytes(&nImg, r, sizeof(size_t));
+
+    for (size_t l = 0; l < nImg; l++)
     {
-        #pragma omp parallel for
-        for (int i = 0; i < _sig.rows(); i++)
-        {
-            sigM.row(i).head(rSig) /= sigM(i, sigM.cols() - 1);
-            sigN.row(i).head(rSig) /= sigN(i, sigN.cols() - 1);
-            _svd.row(i).head(rSig) /= _svd(i, _svd.cols() - 1);
-        }
+        int id, groupID;
+        CTFAttr ctfAttr;
+
+        r = unpackBytes(&id, r, sizeof(int));
+        r = unpackBytes(&groupID, r, sizeof(int));
+        r = unpackBytes(&ctfAttr, r, sizeof(CTFAttr));
+
+        _ID.push_back(id);
+        _groupID.push_back(groupID);
+        _ctfAttr.push_back(ctfAttr);
+
+        _imgOri.push_back(Image());
+        r = unpackImage(_imgOri.back(), r);
     }
-    else
+
+    vector<char>().swap(stack);
+
+    p = unpackBytes(&nImg, p, sizeof(size_t));
+
+    if (nImg != _ID.size())
     {
-        sigM.row(0).head(rSig) /= sigM(0, sigM.cols() - 1);
-        sigN.row(0).head(rSig) /= sigN(0, sigN.cols() - 1);
-        _svd.row(0).head(rSig) /= _svd(0, _svd.cols() - 1);
+        REPORT_ERROR("INCONSISTENT IMAGE STACK OF CHECKPOINT");
 
-        #pragma omp parallel for
-        for (int i = 1; i < _sig.rows(); i++)
+        abort();
+    }
+
+    for (size_t l = 0; l < nImg; l++)
+    {
+        int id, nP;
+        ParticleTrack track;
+        double c;
+
+        p = unpackBytes(&id, p, sizeof(int));
+        p = unpackBytes(&nP, p, sizeof(int));
+        p = unpackBytes(&track, p, sizeof(ParticleTrack));
+        p = unpackBytes(&c, p, sizeof(double));
+
+        if (id != _ID[l])
         {
-            sigM.row(i).head(rSig) = sigM.row(0).head(rSig);
-            sigN.row(i).head(rSig) = sigN.row(0).head(rSig);
-            _svd.row(i).head(rSig) = _svd.row(0).head(rSig);
+            REPORT_ERROR("INCONSISTENT IMAGE STACK OF CHECKPOINT");
+
+            abort();
         }
+
+        _nP.push_back(nP);
+        _track.push_back(track);
+        _cost.push_back(c);
+
+#ifdef OPTIMISER_RECENTRE_IMAGE_EACH_ITERATION
+        double offset[2];
+
+        p = unpackBytes(offset, p, sizeof(offset));
+
+        _offset.push_back(dvec2(offset[0], offset[1]));
+#endif
+
+        size_t nPar;
+
+        p = unpackBytes(&nPar, p, sizeof(size_t));
+
+        vector<double> par(nPar);
+
+        p = unpackBytes(&par[0], p, nPar * sizeof(double));
+
+        _par.push_back(Particle());
+        _par.back().unpack(&par[0], &_sym);
     }
 
-    #pragma omp parallel for
-    for (int i = rSig; i < _sig.cols() - 1; i++)
+    // the image stack of this generation is already on disk
+
+    _ckpt.stackGen = stackGen[slot];
+    _ckpt.stackStale = false;
+
+    NT_MASTER
     {
-        sigM.col(i) = sigM.col(rSig - 1);
-        sigN.col(i) = sigN.col(rSig - 1);
-        _svd.col(i) = _svd.col(rSig - 1);
+        allReduceN();
+
+        ALOG(INFO, "LOGGER_INIT") << "Number of Images in Hemisphere A: " << _N;
+        BLOG(INFO, "LOGGER_INIT") << "Number of Images in Hemisphere B: " << _N;
+
+        ALOG(INFO, "LOGGER_INIT") << "Generating CTFs";
+        BLOG(INFO, "LOGGER_INIT") << "Generating CTFs";
+
+        initCTF();
     }
 
-    RFLOAT alpha = sqrt(M_PI * gsl_pow_2(_para.maskRadius / (_para.size * _para.pixelSize)));
-    
-    // ALOG(INFO, "LOGGER_SYS") << "alpha = " << alpha;
+    MLOG(INFO, "LOGGER_INIT") << "Broadacasting Information of Groups";
 
-    #pragma omp parallel for
-    for (int i = 0; i < _nGroup; i++)
-        for (int j = 0; j < _sig.cols() - 1; j++)
+    bcastGroupInfo();
+
+    const double* q = &state[0];
+
+    _r = (int)*q++;
+    _rL = *q++;
+    _rS = (int)*q++;
+    _searchType = (int)*q++;
+    _resCutoff = *q++;
+    _resReport = *q++;
+    _genMask = (*q++ != 0);
+    _rTrack = (int)*q++;
+
+    _mean = *q++;
+    _stdN = *q++;
+    _stdD = *q++;
+    _stdS = *q++;
+    _stdStdN = *q++;
+
+    q = unpackMatrix(_sig, q);
+    q = unpackMatrix(_sigRcp, q);
+    q = unpackMatrix(_svd, q);
+    q = unpackMatrix(_scale, q);
+    q = unpackMatrix(_cDistr, q);
+
+    _model.unpack(q);
+
+    _iter = latest;
+
+    NT_MASTER
+    {
+        ALOG(INFO, "LOGGER_INIT") << "Re-Generating 2D Images";
+        BLOG(INFO, "LOGGER_INIT") << "Re-Generating 2D Images";
+
+        reloadImg();
+    }
+
+    NT_MASTER
+    {
+        ALOG(INFO, "LOGGER_INIT") << "Restoring References";
+        BLOG(INFO, "LOGGER_INIT") << "Restoring References";
+
+        p = unpackBytes(&n, p, sizeof(size_t));
+
+        for (size_t t = 0; t < n; t++)
         {
-            RFLOAT ratio = GSL_MIN_DBL(1, _svd(i, j));
+            size_t sizeFT;
 
-#ifdef OPTIMISER_SIGMA_MASK
-            _sig(i, j) = sigM(i, j);
-#else
-            _sig(i, j) = ratio * sigM(i, j) + (1 - ratio) * alpha * sigN(i, j);
-#endif
-            // _sig(i, j) = (ratio * gsl_pow_2(alpha) + (1 - ratio) * alpha) * sigN(i, j);
+            p = unpackBytes(&sizeFT, p, sizeof(size_t));
+
+            if (sizeFT != _model.ref(t).sizeFT())
+            {
+                REPORT_ERROR("INCONSISTENT SIZE OF REFERENCE IN CHECKPOINT");
+
+                abort();
+            }
+
+            p = unpackBytes(&_model.ref(t)[0], p, sizeFT * sizeof(Complex));
         }
 
-    /***
-    if (!mask)
-    {
-#ifdef OPTIMISER_SIGMA_CORE
-        RFLOAT ratio = M_PI * gsl_pow_2(_para.maskRadius / _para.pixelSize) / gsl_pow_2(_para.size);
+        for (int t = 0; t < _para.k; t++)
+            MPI_Bcast_Large(&_model.ref(t)[0],
+                            _model.ref(t).sizeFT(),
+                            TS_MPI_DOUBLE_COMPLEX,
+                            0,
+                            _hemi);
 
-        _sig.array() *= gsl_pow_2(ratio);
-#endif
+        ALOG(INFO, "LOGGER_INIT") << "Setting Up Projectors and Reconstructors of _model";
+        BLOG(INFO, "LOGGER_INIT") << "Setting Up Projectors and Reconstructors of _model";
+
+        _model.initProjReco();
+
+        _model.resetReco(_para.thresReportFSC);
     }
-    ***/
 
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    MLOG(INFO, "LOGGER_INIT") << "Checkpoint of Round " << latest << " Restored";
+}
+
+void Optimiser::reloadImg()
+{
+    IF_MASTER return;
+
+    _img.clear();
+
+    FOR_EACH_2D_IMAGE
+        _img.push_back(_imgOri[l].copyImage());
+
+#ifdef OPTIMISER_RECENTRE_IMAGE_EACH_ITERATION
     #pragma omp parallel for
-    for (int i = 0; i < _nGroup; i++)
-        for (int j = 0; j < rSig; j++)
-            _sigRcp(i, j) = -0.5 / _sig(i, j);
+    FOR_EACH_2D_IMAGE
+        translate(_img[l],
+                  _imgOri[l],
+                  _offset[l](0),
+                  _offset[l](1));
+#endif
+
+#ifdef OPTIMISER_MASK_IMG
+    if ((!_para.zeroMask) && (_searchType == SEARCH_TYPE_GLOBAL))
+    {
+        // the background is filled with noise as in maskImg(), only before
+        // the images are re-centred
+
+        FOR_EACH_2D_IMAGE
+        {
+            _fftImg.bwExecutePlanMT(_img[l]);
+
+            softMask(_img[l],
+                     _img[l],
+                     _para.maskRadius / _para.pixelSize,
+                     EDGE_WIDTH_RL,
+                     0,
+                     _stdN);
+
+            _fftImg.fwExecutePlanMT(_img[l]);
+
+            _img[l].clearRL();
+        }
+    }
+    else
+    {
+#ifdef GPU_VERSION
+        reMaskImgG();
+#else
+        reMaskImg();
+#endif
+    }
+#endif
 }
 
 void Optimiser::reconstructRef(const bool fscFlag,
@@ -6588,6 +8664,8 @@ void Optimiser::reconstructRef(const bool fscFlag,
 {
     FFT fft;
 
+    switchStage(OPTIMISER_STAGE_INSERT);
+
     ALOG(INFO, "LOGGER_ROUND") << "Allocating Space for Pre-calcuation in Reconstruction";
     BLOG(INFO, "LOGGER_ROUND") << "Allocating Space for Pre-calcuation in Reconstruction";
     
@@ -6907,7 +8985,13 @@ void Optimiser::reconstructRef(const bool fscFlag,
 #else
         Complex* poolTransImgP = (Complex*)TSFFTW_malloc(_nPxl * omp_get_max_threads() * sizeof(Complex));
 
-        #pragma omp parallel for
+        RFLOAT* poolCTFP = cSearch
+                         ? (RFLOAT*)TSFFTW_malloc(_nPxl * omp_get_max_threads() * sizeof(RFLOAT))
+                         : NULL;
+
+        long nInsert = 0;
+
+        #pragma omp parallel for reduction(+:nInsert)
         FOR_EACH_2D_IMAGE
         {
             RFLOAT* ctf;
@@ -6931,21 +9015,30 @@ void Optimiser::reconstructRef(const bool fscFlag,
 
             Complex* orignImgP = _datP + _nPxl * l;
 
-            for (int m = 0; m < _para.mReco; m++)
+            vector<RecoPose> pose;
+
+            int nPose = planInsert(pose, l, w);
+
+            nInsert += nPose;
+
+            for (int m = 0; m < nPose; m++)
             {
-                size_t cls;
-                dvec4 quat;
-                dvec2 tran;
-                double d;
+                size_t cls = pose[m].cls;
+                dvec4 quat(pose[m].quat[0], pose[m].quat[1], pose[m].quat[2], pose[m].quat[3]);
+                dvec2 tran(pose[m].tran[0], pose[m].tran[1]);
+                double d = pose[m].d;
 
-                if (_para.mode == MODE_2D)
-                {
-                    _par[l].rand(cls, quat, tran, d);
+                // poses are sorted by translation and defocus factor, thus the
+                // translated image and the CTF are only re-calculated on change
 
-                    dmat22 rot2D;
+                bool newTran = (m == 0)
+                            || (pose[m].tran[0] != pose[m - 1].tran[0])
+                            || (pose[m].tran[1] != pose[m - 1].tran[1]);
 
-                    rotate2D(rot2D, dvec2(quat(0), quat(1)));
+                bool newD = newTran || (pose[m].d != pose[m - 1].d);
 
+                if (newTran)
+                {
 #ifdef OPTIMISER_RECENTRE_IMAGE_EACH_ITERATION
                     translate(transImgP,
                               orignImgP,
@@ -6967,11 +9060,13 @@ void Optimiser::reconstructRef(const bool fscFlag,
                               _iRow,
                               _nPxl);
 #endif
+                }
 
-                    if (cSearch)
-                    {
-                        ctf = (RFLOAT*)TSFFTW_malloc(_nPxl * sizeof(RFLOAT));
+                if (cSearch)
+                {
+                    ctf = poolCTFP + _nPxl * omp_get_thread_num();
 
+                    if (newD)
                         CTF(ctf,
                             _para.pixelSize,
                             _ctfAttr[l].voltage,
@@ -6986,11 +9081,17 @@ void Optimiser::reconstructRef(const bool fscFlag,
                             _iCol,
                             _iRow,
                             _nPxl);
-                    }
-                    else
-                    {
-                        ctf = _ctfP + _nPxl * l;
-                    }
+                }
+                else
+                {
+                    ctf = _ctfP + _nPxl * _iCTFP[l];
+                }
+
+                if (_para.mode == MODE_2D)
+                {
+                    dmat22 rot2D;
+
+                    rotate2D(rot2D, dvec2(quat(0), quat(1)));
 
 #ifdef OPTIMISER_RECONSTRUCT_SIGMA_REGULARISE
                     vec sig = _sig.row(_groupID[l] - 1).transpose();
@@ -6998,78 +9099,27 @@ void Optimiser::reconstructRef(const bool fscFlag,
                     _model.reco(cls).insertP(transImgP,
                                              ctf,
                                              rot2D,
-                                             w,
+                                             pose[m].w,
                                              &sig);
 #else
                     _model.reco(cls).insertP(transImgP,
                                              ctf,
                                              rot2D,
-                                             w);
+                                             pose[m].w);
 #endif
 
-                    if (cSearch) TSFFTW_free(ctf);
-
 #ifdef OPTIMISER_RECENTRE_IMAGE_EACH_ITERATION
                     dvec2 dir = -rot2D * (tran - _offset[l]);
 #else
                     dvec2 dir = -rot2D * tran;
 #endif
-                    _model.reco(cls).insertDir(dir);
+                    _model.reco(cls).insertDir(dir, pose[m].count);
                 }
-
                 else if (_para.mode == MODE_3D)
                 {
-                    _par[l].rand(cls, quat, tran, d);
-
                     dmat33 rot3D;
 
                     rotate3D(rot3D, quat);
-                
-#ifdef OPTIMISER_RECENTRE_IMAGE_EACH_ITERATION
-                    translate(transImgP,
-                              orignImgP,
-                              -(tran - _offset[l])(0),
-                              -(tran - _offset[l])(1),
-                              _para.size,
-                              _para.size,
-                              _iCol,
-                              _iRow,
-                              _nPxl);
-#else
-                    translate(transImgP,
-                              orignImgP,
-                              -(tran)(0),
-                              -(tran)(1),
-                              _para.size,
-                              _para.size,
-                              _iCol,
-                              _iRow,
-                              _nPxl);
-#endif
-
-                    if (cSearch)
-                    {
-                        ctf = (RFLOAT*)TSFFTW_malloc(_nPxl * sizeof(RFLOAT));
-
-                        CTF(ctf,
-                            _para.pixelSize,
-                            _ctfAttr[l].voltage,
-                            _ctfAttr[l].defocusU * d,
-                            _ctfAttr[l].defocusV * d,
-                            _ctfAttr[l].defocusTheta,
-                            _ctfAttr[l].Cs,
-                            _ctfAttr[l].amplitudeContrast,
-                            _ctfAttr[l].phaseShift,
-                            _para.size,
-                            _para.size,
-                            _iCol,
-                            _iRow,
-                            _nPxl);
-                    }
-                    else
-                    {
-                        ctf = _ctfP + _nPxl * l;
-                    }
 
 #ifdef OPTIMISER_RECONSTRUCT_SIGMA_REGULARISE
                     vec sig = _sig.row(_groupID[l] - 1).transpose();
@@ -7077,17 +9127,15 @@ void Optimiser::reconstructRef(const bool fscFlag,
                     _model.reco(cls).insertP(transImgP,
                                              ctf,
                                              rot3D,
-                                             w,
+                                             pose[m].w,
                                              &sig);
 #else
                     _model.reco(cls).insertP(transImgP,
                                              ctf,
                                              rot3D,
-                                             w);
+                                             pose[m].w);
 #endif
 
-                    if (cSearch) TSFFTW_free(ctf);
-
 #ifdef OPTIMISER_RECENTRE_IMAGE_EACH_ITERATION
                     dvec3 dir = -rot3D * dvec3((tran - _offset[l])[0],
                                            (tran - _offset[l])[1],
@@ -7095,7 +9143,7 @@ void Optimiser::reconstructRef(const bool fscFlag,
 #else
                     dvec3 dir = -rot3D * dvec3(tran[0], tran[1], 0);
 #endif
-                    _model.reco(cls).insertDir(dir);
+                    _model.reco(cls).insertDir(dir, pose[m].count);
                 }
                 else
                 {
@@ -7105,6 +9153,26 @@ void Optimiser::reconstructRef(const bool fscFlag,
                 }
             }
         }
+
+        TSFFTW_free(poolTransImgP);
+
+        if (cSearch) TSFFTW_free(poolCTFP);
+
+        long nImg = _ID.size();
+
+        MPI_Allreduce(MPI_IN_PLACE, &nInsert, 1, MPI_LONG, MPI_SUM, _hemi);
+        MPI_Allreduce(MPI_IN_PLACE, &nImg, 1, MPI_LONG, MPI_SUM, _hemi);
+
+        ALOG(INFO, "LOGGER_ROUND") << "Effective Number of Insertions per Image : "
+                                   << (RFLOAT)nInsert / nImg
+                                   << " out of "
+                                   << _para.mReco
+                                   << " Draws";
+        BLOG(INFO, "LOGGER_ROUND") << "Effective Number of Insertions per Image : "
+                                   << (RFLOAT)nInsert / nImg
+                                   << " out of "
+                                   << _para.mReco
+                                   << " Draws";
 #endif
 
 #ifdef VERBOSE_LEVEL_2
@@ -7113,6 +9181,8 @@ void Optimiser::reconstructRef(const bool fscFlag,
 
         MPI_Barrier(_hemi);
 
+        switchStage(OPTIMISER_STAGE_RECONSTRUCT);
+
 #ifdef GPU_VERSION
         std::vector<int> gpus;
         getAviDevice(gpus);
@@ -7323,6 +9393,8 @@ void Optimiser::reconstructRef(const bool fscFlag,
 
         if (fscSave && (_para.saveRefEachIter || finished))
         {
+            switchStage(OPTIMISER_STAGE_SAVE);
+
             MLOG(INFO, "LOGGER_ROUND") << "Saving Reference(s)";
 
             if (_para.mode == MODE_2D)
@@ -7354,6 +9426,8 @@ void Optimiser::reconstructRef(const bool fscFlag,
 
                 abort();
             }
+
+            switchStage(OPTIMISER_STAGE_RECONSTRUCT);
         }
 
 #ifndef NAN_NO_CHECK
@@ -7410,11 +9484,15 @@ void Optimiser::reconstructRef(const bool fscFlag,
         }
 #endif
 
+        switchStage(OPTIMISER_STAGE_FSC);
+
 #ifdef RECONSTRUCTOR_WIENER_FILTER_FSC
         _model.compareTwoHemispheres(true, false, AVERAGE_TWO_HEMISPHERE_THRES);
 #else
         _model.compareTwoHemispheres(true, true, AVERAGE_TWO_HEMISPHERE_THRES);
 #endif
+
+        switchStage(OPTIMISER_STAGE_RECONSTRUCT);
     }
 
 #ifdef RECONSTRUCTOR_WIENER_FILTER_FSC
@@ -7550,6 +9628,8 @@ void Optimiser::reconstructRef(const bool fscFlag,
 
         if (avgSave && (_para.saveRefEachIter || finished))
         {
+            switchStage(OPTIMISER_STAGE_SAVE);
+
             MLOG(INFO, "LOGGER_ROUND") << "Saving Reference(s)";
 
             if (_para.mode == MODE_2D)
@@ -7581,6 +9661,8 @@ void Optimiser::reconstructRef(const bool fscFlag,
 
                 abort();
             }
+
+            switchStage(OPTIMISER_STAGE_RECONSTRUCT);
         }
 
         MPI_Barrier(MPI_COMM_WORLD);
@@ -7607,7 +9689,11 @@ void Optimiser::reconstructRef(const bool fscFlag,
 
 #endif
 
+        switchStage(OPTIMISER_STAGE_FSC);
+
         _model.compareTwoHemispheres(false, true, AVERAGE_TWO_HEMISPHERE_THRES);
+
+        switchStage(OPTIMISER_STAGE_RECONSTRUCT);
     }
 
 #endif
@@ -7624,6 +9710,8 @@ void Optimiser::reconstructRef(const bool fscFlag,
 
     MPI_Barrier(MPI_COMM_WORLD);
 
+    switchStage(OPTIMISER_STAGE_NONE);
+
     ALOG(INFO, "LOGGER_ROUND") << "Reference(s) Reconstructed";
     BLOG(INFO, "LOGGER_ROUND") << "Reference(s) Reconstructed";
 }
@@ -7857,80 +9945,324 @@ void Optimiser::allocPreCalIdx(const RFLOAT rU,
     RFLOAT rU2 = TSGSL_pow_2(rU);
     RFLOAT rL2 = TSGSL_pow_2(rL);
 
-    _nPxl = 0;
+    // pixels are sorted by shell, by counting the pixels of each shell first
 
-    IMAGE_FOR_PIXEL_R_FT(rU + 1)
-    {
-        if ((i == 0) && (j < 0)) continue;
+    _nShellP = CEIL(rU);
 
-        RFLOAT u = QUAD(i, j);
+    _offShellP = new int[_nShellP + 1];
 
-        if ((u < rU2) && (u >= rL2))
+    for (int v = 0; v <= _nShellP; v++)
+        _offShellP[v] = 0;
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        IMAGE_FOR_PIXEL_R_FT(rU + 1)
         {
-            int v = AROUND(NORM(i, j));
+            if ((i == 0) && (j < 0)) continue;
 
-            if ((v < rU) && (v >= rL))
+            RFLOAT u = QUAD(i, j);
+
+            if ((u < rU2) && (u >= rL2))
             {
-                _iPxl[_nPxl] = _imgOri[0].iFTHalf(i, j);
+                int v = AROUND(NORM(i, j));
+
+                if ((v < rU) && (v >= rL))
+                {
+                    if (pass == 0)
+                    {
+                        _offShellP[v + 1] += 1;
+
+                        continue;
+                    }
 
-                _iCol[_nPxl] = i;
+                    // the next slot of shell v, raster order within a shell
 
-                _iRow[_nPxl] = j;
+                    int k = _offShellP[v]++;
 
-                _iSig[_nPxl] = v;
+                    _iPxl[k] = _imgOri[0].iFTHalf(i, j);
 
-                _iColPad[_nPxl] = i * _para.pf;
+                    _iCol[k] = i;
 
-                _iRowPad[_nPxl] = j * _para.pf;
+                    _iRow[k] = j;
 
-                _nPxl++;
+                    _iSig[k] = v;
+
+                    _iColPad[k] = i * _para.pf;
+
+                    _iRowPad[k] = j * _para.pf;
+                }
             }
         }
+
+        if (pass == 0)
+        {
+            for (int v = 0; v < _nShellP; v++)
+                _offShellP[v + 1] += _offShellP[v];
+        }
+        else
+        {
+            // the slots have been advanced to the end of each shell
+
+            for (int v = _nShellP; v > 0; v--)
+                _offShellP[v] = _offShellP[v - 1];
+
+            _offShellP[0] = 0;
+        }
     }
+
+    _nPxl = _offShellP[_nShellP];
 }
 
+int Optimiser::nPxlBelow(const RFLOAT r) const
+{
+    // shells are integers, v < r if and only if v < ceil(r)
+
+    int v = GSL_MIN_INT(GSL_MAX_INT(CEIL(r), 0), _nShellP);
+
+    return _offShellP[v];
+}
+
+/**
+ * order of the columns of pixel major pre-calculated data, by sigma group and
+ * then by CTF
+ */
+struct PreCalColumnLess
+{
+    const int* _iSig;
+
+    const int* _iCTF;
+
+    PreCalColumnLess(const int* iSig,
+                     const int* iCTF) : _iSig(iSig), _iCTF(iCTF) {}
+
+    bool operator()(const int a, const int b) const
+    {
+        if (_iSig[a] != _iSig[b]) return _iSig[a] < _iSig[b];
+        if (_iCTF[a] != _iCTF[b]) return _iCTF[a] < _iCTF[b];
+
+        return a < b;
+    }
+};
+
 void Optimiser::allocPreCal(const bool mask,
                             const bool pixelMajor,
                             const bool ctf)
 {
     IF_MASTER return;
 
-    _datP = (Complex*)TSFFTW_malloc(_ID.size() * _nPxl * sizeof(Complex));
+    size_t nImg = _ID.size();
+
+    _iCTFP = new int[nImg];
+    _iSigP = new int[nImg];
+    _jImgP = new int[nImg];
+
+    vector<int> repCTF;
+
+    int nCTF = groupCTF(_iCTFP, repCTF);
+
+    // images of the same group share sigma, and images of the same micrograph
+    // share CTF, thus one row for each of them suffices
+
+#ifdef GPU_VERSION
+    // kernels on GPU require a row of CTF and sigma for each image
+
+    bool share = false;
+#else
+    bool share = true;
+#endif
+
+    _nSigP = _sig.rows();
+
+    FOR_EACH_2D_IMAGE
+        _iSigP[l] = _groupID[l] - 1;
+
+    vector<int> ord(nImg);
+
+    FOR_EACH_2D_IMAGE
+        ord[l] = l;
+
+    if (share && pixelMajor)
+    {
+        // sort the columns by sigma group and CTF, such that each segment of
+        // consecutive columns shares a row of CTF and sigma
+
+        std::sort(ord.begin(), ord.end(), PreCalColumnLess(_iSigP, _iCTFP));
+
+        _nSegP = 1;
+
+        for (size_t j = 1; j < nImg; j++)
+            if ((_iSigP[ord[j]] != _iSigP[ord[j - 1]]) ||
+                (_iCTFP[ord[j]] != _iCTFP[ord[j - 1]]))
+                _nSegP += 1;
+
+        if (nImg < (size_t)PRE_CAL_MIN_AVG_SEG_LEN * _nSegP)
+        {
+            // segments are too short to pay off
+
+            share = false;
+
+            FOR_EACH_2D_IMAGE
+                ord[l] = l;
+        }
+    }
+
+    if (share)
+    {
+        _nCTFP = nCTF;
+    }
+    else
+    {
+        _nCTFP = nImg;
+        _nSigP = nImg;
+
+        repCTF.resize(nImg);
+
+        FOR_EACH_2D_IMAGE
+        {
+            _iCTFP[l] = l;
+            _iSigP[l] = l;
+
+            repCTF[l] = l;
+        }
+    }
+
+    FOR_EACH_2D_IMAGE
+        _jImgP[ord[l]] = l;
+
+    _segP = new int[nImg + 1];
+    _segCTFP = new int[nImg];
+    _segSigP = new int[nImg];
+
+    _nSegP = 0;
+
+    for (size_t j = 0; j < nImg; j++)
+    {
+        int l = ord[j];
+
+        if ((j == 0) ||
+            (_iSigP[l] != _segSigP[_nSegP - 1]) ||
+            (_iCTFP[l] != _segCTFP[_nSegP - 1]))
+        {
+            _segP[_nSegP] = j;
+            _segCTFP[_nSegP] = _iCTFP[l];
+            _segSigP[_nSegP] = _iSigP[l];
+
+            _nSegP += 1;
+        }
+    }
+
+    _segP[_nSegP] = nImg;
+
+    ALOG(INFO, "LOGGER_ROUND") << "Pre-calculated CTF and Sigma Stored in "
+                               << _nCTFP
+                               << " and "
+                               << _nSigP
+                               << " Rows for "
+                               << nImg
+                               << " Images";
+    BLOG(INFO, "LOGGER_ROUND") << "Pre-calculated CTF and Sigma Stored in "
+                               << _nCTFP
+                               << " and "
+                               << _nSigP
+                               << " Rows for "
+                               << nImg
+                               << " Images";
+
+#ifdef OPTIMISER_COMPACT_PRE_CAL
+    // the pixel major data is only streamed by the global search, in which
+    // bfloat16 halves the memory and the bandwidth
+
+    bool compact = pixelMajor;
+#else
+    bool compact = false;
+#endif
+
+    // shared rows of CTF and sigma are small, keep them in RFLOAT
+
+    bool compactRow = compact && (_nSegP == (int)nImg);
+
+    _datP = NULL;
+    _ctfP = NULL;
+    _sigRcpP = NULL;
+
+    _datPC = NULL;
+    _ctfPC = NULL;
+    _sigRcpPC = NULL;
 
-    _sigP = (RFLOAT*)TSFFTW_malloc(_ID.size() * _nPxl * sizeof(RFLOAT));
+    // the pages are spread over the NUMA nodes of the threads, as the searches
+    // over them are parallel over images or poses, not in the order of filling
 
-    _sigRcpP = (RFLOAT*)TSFFTW_malloc(_ID.size() * _nPxl * sizeof(RFLOAT));
+    if (compact)
+        _datPC = (ComplexBF16*)mallocFirstTouch(nImg * _nPxl * sizeof(ComplexBF16));
+    else
+        _datP = (Complex*)mallocFirstTouch(nImg * _nPxl * sizeof(Complex));
+
+    _sigP = (RFLOAT*)mallocFirstTouch((size_t)_nSigP * _nPxl * sizeof(RFLOAT));
+
+    if (compactRow)
+        _sigRcpPC = (bf16*)mallocFirstTouch((size_t)_nSigP * _nPxl * sizeof(bf16));
+    else
+        _sigRcpP = (RFLOAT*)mallocFirstTouch((size_t)_nSigP * _nPxl * sizeof(RFLOAT));
 
     #pragma omp parallel for
     FOR_EACH_2D_IMAGE
     {
         for (int i = 0; i < _nPxl; i++)
         {
-            _datP[pixelMajor
-                ? (i * _ID.size() + l)
-                : (_nPxl * l + i)] = mask ? _img[l].iGetFT(_iPxl[i]) : _imgOri[l].iGetFT(_iPxl[i]);
+            size_t idx = pixelMajor
+                       ? (i * nImg + _jImgP[l])
+                       : (_nPxl * l + i);
+
+            Complex dat = mask ? _img[l].iGetFT(_iPxl[i]) : _imgOri[l].iGetFT(_iPxl[i]);
+
+            if (compact)
+                _datPC[idx] = COMPLEX_BF16(dat);
+            else
+                _datP[idx] = dat;
+        }
+    }
+
+    // row g of sigma is taken from group _groupID[l] - 1 of any image l in it
+
+    vector<int> repSig(_nSigP, 0);
+
+    FOR_EACH_2D_IMAGE
+        repSig[_iSigP[l]] = _groupID[l] - 1;
 
+    #pragma omp parallel for
+    for (int g = 0; g < _nSigP; g++)
+    {
+        for (int i = 0; i < _nPxl; i++)
+        {
             _sigP[pixelMajor
-                ? (i * _ID.size() + l)
-                : (_nPxl * l + i)] = _sig(_groupID[l] - 1, _iSig[i]);
+                ? (i * (size_t)_nSigP + g)
+                : (_nPxl * (size_t)g + i)] = _sig(repSig[g], _iSig[i]);
             
-            _sigRcpP[pixelMajor
-                   ? (i * _ID.size() + l)
-                   : (_nPxl * l + i)] = _sigRcp(_groupID[l] - 1, _iSig[i]);
+            size_t idx = pixelMajor
+                       ? (i * (size_t)_nSigP + g)
+                       : (_nPxl * (size_t)g + i);
+
+            if (compactRow)
+                _sigRcpPC[idx] = BF16(_sigRcp(repSig[g], _iSig[i]));
+            else
+                _sigRcpP[idx] = _sigRcp(repSig[g], _iSig[i]);
         }
     }
 
     if (!ctf)
     {
-        _ctfP = (RFLOAT*)TSFFTW_malloc(_ID.size() * _nPxl * sizeof(RFLOAT));
+        if (compactRow)
+            _ctfPC = (bf16*)mallocFirstTouch((size_t)_nCTFP * _nPxl * sizeof(bf16));
+        else
+            _ctfP = (RFLOAT*)mallocFirstTouch((size_t)_nCTFP * _nPxl * sizeof(RFLOAT));
 
-#ifdef OPTIMISER_CTF_ON_THE_FLY
         RFLOAT* poolCTF = (RFLOAT*)TSFFTW_malloc(_nPxl * omp_get_max_threads() * sizeof(RFLOAT));
-#endif
 
         #pragma omp parallel for
-        FOR_EACH_2D_IMAGE
+        for (int c = 0; c < _nCTFP; c++)
         {
+            int l = repCTF[c];
+
 #ifdef OPTIMISER_CTF_ON_THE_FLY
             RFLOAT* ctf = poolCTF + _nPxl * omp_get_thread_num();
 
@@ -7949,25 +10281,29 @@ void Optimiser::allocPreCal(const bool mask,
                 _iRow,
                 _nPxl);
 
-            for (int i = 0; i < _nPxl; i++)
-            {
-                _ctfP[pixelMajor
-                    ? (i * _ID.size() + l)
-                    : (_nPxl * l + i)] = ctf[i];
-            }
 #else
+            RFLOAT* ctf = poolCTF + _nPxl * omp_get_thread_num();
+
+            for (int i = 0; i < _nPxl; i++)
+                ctf[i] = REAL(_ctf[l].iGetFT(_iPxl[i]));
+#endif
+
             for (int i = 0; i < _nPxl; i++)
             {
-                _ctfP[pixelMajor
-                    ? (i * _ID.size() + l)
-                    : (_nPxl * l + i)] = REAL(_ctf[l].iGetFT(_iPxl[i]));
+                size_t idx = pixelMajor
+                           ? (i * (size_t)_nCTFP + c)
+                           : (_nPxl * (size_t)c + i);
+
+                if (compactRow)
+                    _ctfPC[idx] = BF16(ctf[i]);
+                else
+                    _ctfP[idx] = ctf[i];
             }
-#endif
         }
 
-#ifdef OPTIMISER_CTF_ON_THE_FLY
         TSFFTW_free(poolCTF);
-#endif
+
+        if (compact) reportCompactPreCal(mask);
     }
     else
     {
@@ -8015,6 +10351,40 @@ void Optimiser::allocPreCal(const bool mask,
             _K1[l] = M_PI * lambda;
             _K2[l] = M_PI_2 * _ctfAttr[l].Cs * TSGSL_pow_3(lambda);
         }
+
+        // particles sharing CTF parameters, e.g. from the same micrograph,
+        // share the factored CTF terms
+
+        _iCTFTerm = new int[_ID.size()];
+
+        vector<int> iImg;
+
+        _nCTFTerm = groupCTF(_iCTFTerm, iImg);
+
+        _ctfTermDf = (RFLOAT*)TSFFTW_malloc((size_t)_nCTFTerm * _nPxl * sizeof(RFLOAT));
+        _ctfTermC = (RFLOAT*)TSFFTW_malloc((size_t)_nCTFTerm * _nPxl * sizeof(RFLOAT));
+
+        #pragma omp parallel for
+        for (int t = 0; t < _nCTFTerm; t++)
+        {
+            int l = iImg[t];
+
+            CTFTerm(_ctfTermDf + (size_t)t * _nPxl,
+                    _ctfTermC + (size_t)t * _nPxl,
+                    _para.pixelSize,
+                    _ctfAttr[l].voltage,
+                    _ctfAttr[l].defocusU,
+                    _ctfAttr[l].defocusV,
+                    _ctfAttr[l].defocusTheta,
+                    _ctfAttr[l].Cs,
+                    _ctfAttr[l].amplitudeContrast,
+                    _ctfAttr[l].phaseShift,
+                    _para.size,
+                    _para.size,
+                    _iCol,
+                    _iRow,
+                    _nPxl);
+        }
     }
 }
 
@@ -8029,6 +10399,11 @@ void Optimiser::freePreCalIdx()
 
     delete[] _iColPad;
     delete[] _iRowPad;
+
+    delete[] _offShellP;
+
+    _offShellP = NULL;
+    _nShellP = 0;
 }
 
 void Optimiser::freePreCal(const bool ctf)
@@ -8039,6 +10414,17 @@ void Optimiser::freePreCal(const bool ctf)
     TSFFTW_free(_sigP);
     TSFFTW_free(_sigRcpP);
 
+    TSFFTW_free(_datPC);
+    TSFFTW_free(_sigRcpPC);
+
+    delete[] _iCTFP;
+    delete[] _iSigP;
+    delete[] _jImgP;
+
+    delete[] _segP;
+    delete[] _segCTFP;
+    delete[] _segSigP;
+
     /***
     delete[] _datP;
     delete[] _ctfP;
@@ -8048,6 +10434,7 @@ void Optimiser::freePreCal(const bool ctf)
     if (!ctf)
     {
         TSFFTW_free(_ctfP);
+        TSFFTW_free(_ctfPC);
     }
     else
     {
@@ -8059,1520 +10446,1447 @@ void Optimiser::freePreCal(const bool ctf)
         TSFFTW_free(_K2);
         //delete[] _K1;
         //delete[] _K2;
+
+        TSFFTW_free(_ctfTermDf);
+        TSFFTW_free(_ctfTermC);
+
+        delete[] _iCTFTerm;
     }
 }
 
-void Optimiser::saveDatabase(const bool finished,
-                             const bool subtract) const
+int Optimiser::groupCTF(int* iCTF,
+                        vector<int>& rep) const
 {
-    IF_MASTER return;
-
-    char filename[FILE_NAME_LENGTH];
-
-    if (subtract)
-        sprintf(filename, "%sMeta_Subtract.thu", _para.dstPrefix);
-    else if (finished)
-        sprintf(filename, "%sMeta_Final.thu", _para.dstPrefix);
-    else
-        sprintf(filename, "%sMeta_Round_%03d.thu", _para.dstPrefix, _iter);
-
-    bool flag;
-    MPI_Status status;
-    
-    if (_commRank != 1)
-        MPI_Recv(&flag, 1, MPI_C_BOOL, _commRank - 1, 0, MPI_COMM_WORLD, &status);
-
-    FILE* file = (_commRank == 1)
-               ? fopen(filename, "w")
-               : fopen(filename, "a");
+    std::map<CTFAttr, int, CTFAttrLess> ctfIdx;
 
-    size_t cls;
-    dvec4 quat;
-    dvec2 tran;
-    double df;
-
-    double k1, k2, k3, s0, s1, s;
-
-    char subtractPath[FILE_WORD_LENGTH];
+    rep.clear();
 
     FOR_EACH_2D_IMAGE
     {
-        _par[l].rank1st(cls, quat, tran, df);
-
-        //_par[l].vari(rVari, s0, s1, s);
-        _par[l].vari(k1, k2, k3, s0, s1, s);
+        std::map<CTFAttr, int, CTFAttrLess>::const_iterator it = ctfIdx.find(_ctfAttr[l]);
 
-        /***
-        rVari = 0;
-        s0 = 0;
-        s1 = 0;
-        s = 0;
-        ***/
+        if (it == ctfIdx.end())
+        {
+            iCTF[l] = (int)rep.size();
 
-        if (subtract)
-            snprintf(subtractPath,
-                     sizeof(subtractPath),
-                     "%012ld@Subtract_Rank_%06d.mrcs",
-                     l + 1,
-                     _commRank);
+            ctfIdx[_ctfAttr[l]] = iCTF[l];
 
-        fprintf(file,
-                "%18.9lf %18.9lf %18.9lf %18.9lf %18.9lf %18.9lf %18.9lf \
-                 %s %s %18.9lf %18.9lf \
-                 %6d %6lu \
-                 %18.9lf %18.9lf %18.9lf %18.9lf \
-                 %18.9lf %18.9lf %18.9lf \
-                 %18.9lf %18.9lf %18.9lf %18.9lf \
-                 %18.9lf %18.9lf \
-                 %18.9lf\n",
-                 _ctfAttr[l].voltage,
-                 _ctfAttr[l].defocusU,
-                 _ctfAttr[l].defocusV,
-                 _ctfAttr[l].defocusTheta,
-                 _ctfAttr[l].Cs,
-                 _ctfAttr[l].amplitudeContrast,
-                 _ctfAttr[l].phaseShift,
-                 subtract ? subtractPath : _db.path(_ID[l]).c_str(),
-                 _db.micrographPath(_ID[l]).c_str(),
-                 _db.coordX(_ID[l]),
-                 _db.coordY(_ID[l]),
-                 _groupID[l],
-                 cls,
-                 quat(0),
-                 quat(1),
-                 quat(2),
-                 quat(3),
-                 k1,
-                 k2,
-                 k3,
-#ifdef OPTIMISER_RECENTRE_IMAGE_EACH_ITERATION
-                 tran(0) - _offset[l](0),
-                 tran(1) - _offset[l](1),
-#else
-                 tran(0),
-                 tran(1),
-#endif
-                 s0,
-                 s1,
-                 df,
-                 s,
-                 _par[l].compressR());
+            rep.push_back(l);
+        }
+        else
+            iCTF[l] = it->second;
     }
 
-    fclose(file);
-
-    if (_commRank != _commSize - 1)
-        MPI_Send(&flag, 1, MPI_C_BOOL, _commRank + 1, 0, MPI_COMM_WORLD);
+    return (int)rep.size();
 }
 
-void Optimiser::saveSubtract()
+void Optimiser::reportCompactPreCal(const bool mask)
 {
-    IF_MASTER return;
-
-    char filename[FILE_NAME_LENGTH];
-
-    sprintf(filename, "%sSubtract_Rank_%06d.mrcs", _para.dstPrefix, _commRank);
+    vec absDev = vec::Zero(_ID.size());
+    vec relDev = vec::Zero(_ID.size());
 
-    ImageFile imf;
-
-    imf.openStack(filename, _para.size, _ID.size(), _para.pixelSize);
-
-    Image result(_para.size, _para.size, FT_SPACE);
-    Image diff(_para.size, _para.size, FT_SPACE);
+    bool compactRow = (_ctfPC != NULL);
 
-    size_t cls;
-    dmat22 rot2D;
-    dmat33 rot3D;
-    dvec2 tran;
-    double d;
+    Complex* poolPri = (Complex*)TSFFTW_malloc(_nPxl * omp_get_max_threads() * sizeof(Complex));
+    Complex* poolTra = (Complex*)TSFFTW_malloc(_nPxl * omp_get_max_threads() * sizeof(Complex));
+    RFLOAT* poolCTF = (RFLOAT*)TSFFTW_malloc(_nPxl * omp_get_max_threads() * sizeof(RFLOAT));
 
+    #pragma omp parallel for
     FOR_EACH_2D_IMAGE
     {
-        #pragma omp parallel for
-        SET_0_FT(result);
+        Complex* pri = poolPri + _nPxl * omp_get_thread_num();
+        Complex* tra = poolTra + _nPxl * omp_get_thread_num();
+        RFLOAT* ctf = poolCTF + _nPxl * omp_get_thread_num();
 
-        #pragma omp parallel for
-        SET_0_FT(diff);
+        // the projection of the reference at the most likely pose
+
+        size_t cls;
+        dvec2 tran;
+        double d;
 
         if (_para.mode == MODE_2D)
         {
-            ALOG(FATAL, "LOGGER_ROUND") << "SAVE SUBTRACT DOES NOT SUPPORT 2D MODE";
-            BLOG(FATAL, "LOGGER_ROUND") << "SAVE SUBTRACT DOES NOT SUPPORT 2D MODE";
+            dmat22 rot2D;
 
-            abort();
-            /***
             _par[l].rank1st(cls, rot2D, tran, d);
 
-            _model.proj(cls).projectMT(result, rot2D, tran - _offset[l]);
-            ***/
+            _model.proj(cls).project(pri, rot2D, _iCol, _iRow, _nPxl);
         }
-        else if (_para.mode == MODE_3D)
+        else
         {
+            dmat33 rot3D;
+
             _par[l].rank1st(cls, rot3D, tran, d);
 
-            _model.proj(cls).projectMT(result, rot3D, tran - _offset[l]);
+            _model.proj(cls).project(pri, rot3D, _iCol, _iRow, _nPxl);
         }
-        else
-        {
-            REPORT_ERROR("INEXISTENT MODE");
 
-            abort();
-        }
+        translate(tra,
+                  tran(0),
+                  tran(1),
+                  _para.size,
+                  _para.size,
+                  _iCol,
+                  _iRow,
+                  _nPxl);
 
-        #pragma omp parallel for
-        FOR_EACH_PIXEL_FT(diff)
+#ifdef OPTIMISER_CTF_ON_THE_FLY
+        CTF(ctf,
+            _para.pixelSize,
+            _ctfAttr[l].voltage,
+            _ctfAttr[l].defocusU,
+            _ctfAttr[l].defocusV,
+            _ctfAttr[l].defocusTheta,
+            _ctfAttr[l].Cs,
+            _ctfAttr[l].amplitudeContrast,
+            _ctfAttr[l].phaseShift,
+            _para.size,
+            _para.size,
+            _iCol,
+            _iRow,
+            _nPxl);
+#else
+        for (int i = 0; i < _nPxl; i++)
+            ctf[i] = REAL(_ctf[l].iGetFT(_iPxl[i]));
+#endif
+
+        double full = 0;
+        double compact = 0;
+
+        for (int i = 0; i < _nPxl; i++)
         {
-            diff[i] = _imgOri[l][i] - result[i] * REAL(_ctf[l][i]);
-            //diff[i] = _imgOri[l][i];
-        }
+            Complex p = tra[i] * pri[i];
 
-        dvec3 regionTrans = rot3D.transpose() * dvec3(_regionCentre(0),
-                                                      _regionCentre(1),
-                                                      _regionCentre(2));
+            Complex dat = mask ? _img[l].iGetFT(_iPxl[i]) : _imgOri[l].iGetFT(_iPxl[i]);
 
-        dvec2 tran = dvec2(regionTrans(0), regionTrans(1));
+            full += ABS2(dat - ctf[i] * p) * _sigRcp(_groupID[l] - 1, _iSig[i]);
 
-        translateMT(diff, diff, -tran(0), -tran(1));
+            ComplexBF16 datC = _datPC[i * _ID.size() + _jImgP[l]];
 
-        _par[l].setT(_par[l].t().rowwise() - tran.transpose());
+            size_t iCTF = i * (size_t)_nCTFP + _iCTFP[l];
+            size_t iSig = i * (size_t)_nSigP + _iSigP[l];
 
-        _par[l].setTopT(_par[l].topT() - tran);
-        _par[l].setTopTPrev(_par[l].topTPrev() - tran);
+            RFLOAT ctfC = compactRow ? RFLOAT_BF16(_ctfPC[iCTF]) : _ctfP[iCTF];
+            RFLOAT sigRcpC = compactRow ? RFLOAT_BF16(_sigRcpPC[iSig]) : _sigRcpP[iSig];
 
-        _fftImg.bwExecutePlanMT(diff);
+            compact += (TSGSL_pow_2(RFLOAT_BF16(datC.dat[0]) - ctfC * REAL(p))
+                      + TSGSL_pow_2(RFLOAT_BF16(datC.dat[1]) - ctfC * IMAG(p)))
+                     * sigRcpC;
+        }
 
-        imf.writeStack(diff, l);
+        // the log-likelihood is negative, as the reciprocal of sigma is
 
-        _fftImg.fwExecutePlanMT(diff);
+        absDev(l) = fabs(compact - full);
+        relDev(l) = (full == 0) ? 0 : absDev(l) / fabs(full);
     }
 
-    imf.closeStack();
+    TSFFTW_free(poolPri);
+    TSFFTW_free(poolTra);
+    TSFFTW_free(poolCTF);
+
+    ALOG(INFO, "LOGGER_ROUND") << "Deviation of Log-likelihood Caused by BFloat16 Storage, Mean: "
+                               << absDev.mean()
+                               << ", Max: "
+                               << absDev.maxCoeff()
+                               << ", Mean Relative: "
+                               << relDev.mean()
+                               << ", Max Relative: "
+                               << relDev.maxCoeff();
+    BLOG(INFO, "LOGGER_ROUND") << "Deviation of Log-likelihood Caused by BFloat16 Storage, Mean: "
+                               << absDev.mean()
+                               << ", Max: "
+                               << absDev.maxCoeff()
+                               << ", Mean Relative: "
+                               << relDev.mean()
+                               << ", Max Relative: "
+                               << relDev.maxCoeff();
 }
 
-void Optimiser::saveBestProjections()
+RFLOAT* Optimiser::logDataVSPriorP(RFLOAT* dst,
+                                   const Complex* pri,
+                                   const int nPxl) const
 {
-    IF_MASTER return;
+    int nImg = (int)_ID.size();
+
+#ifdef OPTIMISER_COMPACT_PRE_CAL
+    if (_nSegP < nImg)
+    {
+        return logDataVSPrior_m_n_seg(_datPC,
+                                      pri,
+                                      _ctfP,
+                                      _sigRcpP,
+                                      nImg,
+                                      nPxl,
+                                      _nCTFP,
+                                      _nSigP,
+                                      _nSegP,
+                                      _segP,
+                                      _segCTFP,
+                                      _segSigP,
+                                      dst);
+    }
+    else
+    {
+        return logDataVSPrior_m_n_huabin_BF16(_datPC,
+                                              pri,
+                                              _ctfPC,
+                                              _sigRcpPC,
+                                              nImg,
+                                              nPxl,
+                                              dst);
+    }
+#else
+    if (_nSegP < nImg)
+    {
+        // columns are grouped into segments sharing CTF and sigma
+
+        return logDataVSPrior_m_n_seg(_datP,
+                                      pri,
+                                      _ctfP,
+                                      _sigRcpP,
+                                      nImg,
+                                      nPxl,
+                                      _nCTFP,
+                                      _nSigP,
+                                      _nSegP,
+                                      _segP,
+                                      _segCTFP,
+                                      _segSigP,
+                                      dst);
+    }
+    else
+    {
+        return kernel().logDataVSPrior_m_n(_datP,
+                                           pri,
+                                           _ctfP,
+                                           _sigRcpP,
+                                           nImg,
+                                           nPxl,
+                                           dst);
+    }
+#endif
+}
 
-    FFT fft;
+RFLOAT* Optimiser::logDataVSPriorP(RFLOAT* dst,
+                                   const Complex* pri,
+                                   const int nIdx,
+                                   const int* idx,
+                                   const int* colCTF,
+                                   const int* colSig) const
+{
+#ifdef OPTIMISER_COMPACT_PRE_CAL
+    return kernel().logDataVSPrior_m_n_idx_BF16(_datPC,
+                                                pri,
+                                                _ctfP,
+                                                _sigRcpP,
+                                                (int)_ID.size(),
+                                                _nPxl,
+                                                _nCTFP,
+                                                _nSigP,
+                                                colCTF,
+                                                colSig,
+                                                nIdx,
+                                                idx,
+                                                dst);
+#else
+    return kernel().logDataVSPrior_m_n_idx(_datP,
+                                           pri,
+                                           _ctfP,
+                                           _sigRcpP,
+                                           (int)_ID.size(),
+                                           _nPxl,
+                                           _nCTFP,
+                                           _nSigP,
+                                           colCTF,
+                                           colSig,
+                                           nIdx,
+                                           idx,
+                                           dst);
+#endif
+}
 
-    Image result(_para.size, _para.size, FT_SPACE);
-    Image diff(_para.size, _para.size, FT_SPACE);
-    char filename[FILE_NAME_LENGTH];
+/**
+ * This function appends a number to a line as "%18.9lf" does. The integer and
+ * the fractional part are converted separately, thus exactly, falling back to
+ * snprintf for NaN, infinity, huge numbers and digits too close to a tie of
+ * rounding.
+ */
+static void appendFixed(string& dst,
+                        const double x)
+{
+    double a = fabs(x);
 
-    size_t cls;
-    dmat22 rot2D;
-    dmat33 rot3D;
-    dvec2 tran;
-    double d;
+    double ip = floor(a);
 
-    FOR_EACH_2D_IMAGE
+    double fp = (a - ip) * 1e9;
+
+    double frac = fp - floor(fp);
+
+    if (!(a < 1e15) || (fabs(frac - 0.5) < 1e-6))
     {
-        if (_ID[l] < N_SAVE_IMG)
-        {
-            #pragma omp parallel for
-            SET_0_FT(result);
+        char buf[FILE_WORD_LENGTH];
 
-            #pragma omp parallel for
-            SET_0_FT(diff);
+        snprintf(buf, sizeof(buf), "%18.9lf", x);
 
-            if (_para.mode == MODE_2D)
-            {
-                _par[l].rank1st(cls, rot2D, tran, d);
+        dst += buf;
 
-                _model.proj(cls).projectMT(result, rot2D, tran);
-            }
-            else if (_para.mode == MODE_3D)
-            {
-                _par[l].rank1st(cls, rot3D, tran, d);
+        return;
+    }
 
-                _model.proj(cls).projectMT(result, rot3D, tran);
-            }
-            else
-                REPORT_ERROR("INEXISTENT MODE");
+    unsigned long f = (unsigned long)floor(fp + 0.5);
+    unsigned long n = (unsigned long)ip;
 
-            sprintf(filename, "%sResult_%04d_Round_%03d.bmp", _para.dstPrefix, _ID[l], _iter);
+    if (f == 1000000000UL)
+    {
+        f = 0;
+        n += 1;
+    }
 
-            fft.bw(result);
-            result.saveRLToBMP(filename);
-            fft.fw(result);
+    char buf[32];
 
-#ifdef OPTIMISER_CTF_ON_THE_FLY
-            // TODO
-#else
-            #pragma omp parallel for
-            FOR_EACH_PIXEL_FT(diff)
-                diff[i] = _img[l][i] - result[i] * REAL(_ctf[l][i]);
-#endif
+    char* p = buf + sizeof(buf);
 
-            sprintf(filename, "%sDiff_%04d_Round_%03d.bmp", _para.dstPrefix, _ID[l], _iter);
-            fft.bw(diff);
-            diff.saveRLToBMP(filename);
-            fft.fw(diff);
-        }
+    for (int i = 0; i < 9; i++)
+    {
+        *--p = '0' + f % 10;
+        f /= 10;
     }
-}
 
-void Optimiser::saveImages()
-{
-    IF_MASTER return;
+    *--p = '.';
 
-    char filename[FILE_NAME_LENGTH];
-    FOR_EACH_2D_IMAGE
+    do
     {
-        if (_ID[l] < N_SAVE_IMG)
-        {
-            sprintf(filename, "Fourier_Image_%04d.bmp", _ID[l]);
+        *--p = '0' + n % 10;
+        n /= 10;
+    } while (n != 0);
 
-            _imgOri[l].saveFTToBMP(filename, 0.01);
+    if (signbit(x)) *--p = '-';
 
-            sprintf(filename, "Image_%04d.bmp", _ID[l]);
+    int len = buf + sizeof(buf) - p;
 
-            _fftImg.bwExecutePlanMT(_imgOri[l]);
-            _imgOri[l].saveRLToBMP(filename);
-            _fftImg.fwExecutePlanMT(_imgOri[l]);
-        }
-    }
+    if (len < 18) dst.append(18 - len, ' ');
+
+    dst.append(p, len);
 }
 
-void Optimiser::saveCTFs()
-{
-    IF_MASTER return;
+/**
+ * the separator between the groups of columns of a .thu line, 18 blanks as
+ * written by the token ring version of saveDatabase
+ */
+#define THU_GROUP_SEPARATOR "                  "
 
+void Optimiser::saveDatabase(const bool finished,
+                             const bool subtract) const
+{
     char filename[FILE_NAME_LENGTH];
+
+    if (subtract)
+        sprintf(filename, "%sMeta_Subtract.thu", _para.dstPrefix);
+    else if (finished)
+        sprintf(filename, "%sMeta_Final.thu", _para.dstPrefix);
+    else
+        sprintf(filename, "%sMeta_Round_%03d.thu", _para.dstPrefix, _iter);
+
+    // reading the source of each particle from the database, one line each
+
+    vector<string> path(_ID.size());
+    vector<string> micrographPath(_ID.size());
+    vector<RFLOAT> coordX(_ID.size());
+    vector<RFLOAT> coordY(_ID.size());
+
     FOR_EACH_2D_IMAGE
-    {
-        if (_ID[l] < N_SAVE_IMG)
-        {
-            sprintf(filename, "CTF_%04d.bmp", _ID[l]);
+        _db.source(path[l], micrographPath[l], coordX[l], coordY[l], _ID[l]);
 
-#ifdef OPTIMISER_CTF_ON_THE_FLY
-            // TODO
-#else
-            _ctf[l].saveFTToBMP(filename, 0.01);
-#endif
-        }
-    }
-}
+    // formatting the lines in parallel
 
-void Optimiser::saveMapHalf(const bool finished)
-{
-    if ((_commRank != HEMI_A_LEAD) &&
-        (_commRank != HEMI_B_LEAD))
-        return;
+    vector<string> line(_ID.size());
 
-    FFT fft;
+    #pragma omp parallel for
+    FOR_EACH_2D_IMAGE
+    {
+        size_t cls;
+        dvec4 quat;
+        dvec2 tran;
+        double df;
+
+        double k1, k2, k3, s0, s1, s;
 
-    ImageFile imf;
-    char filename[FILE_NAME_LENGTH];
+        _par[l].rank1st(cls, quat, tran, df);
 
-    for (int t = 0; t < _para.k; t++)
-    {
-        if (_para.mode == MODE_2D)
-        {
-            if (_commRank == HEMI_A_LEAD)
-            {
-                ALOG(INFO, "LOGGER_ROUND") << "Saving Reference " << t;
+        _par[l].vari(k1, k2, k3, s0, s1, s);
 
-                Image ref(_para.size,
-                          _para.size,
-                          FT_SPACE);
+#ifdef OPTIMISER_RECENTRE_IMAGE_EACH_ITERATION
+        tran -= _offset[l];
+#endif
 
-                SLC_EXTRACT_FT(ref, _model.ref(t), 0);
+        char word[FILE_WORD_LENGTH];
 
-                /***
-                if (finished)
-                    sprintf(filename, "%sFT_Reference_%03d_A_Final.bmp", _para.dstPrefix, t);
-                else
-                    sprintf(filename, "%sFT_Reference_%03d_A_Round_%03d.bmp", _para.dstPrefix, t, _iter);
+        string& dst = line[l];
 
-                ref.saveFTToBMP(filename, 0.001);
-                ***/
+        dst.reserve(512);
 
-                fft.bwMT(ref);
+        appendFixed(dst, _ctfAttr[l].voltage); dst += ' ';
+        appendFixed(dst, _ctfAttr[l].defocusU); dst += ' ';
+        appendFixed(dst, _ctfAttr[l].defocusV); dst += ' ';
+        appendFixed(dst, _ctfAttr[l].defocusTheta); dst += ' ';
+        appendFixed(dst, _ctfAttr[l].Cs); dst += ' ';
+        appendFixed(dst, _ctfAttr[l].amplitudeContrast); dst += ' ';
+        appendFixed(dst, _ctfAttr[l].phaseShift); dst += THU_GROUP_SEPARATOR;
 
-                softMask(ref,
-                         ref,
-                         _para.maskRadius / _para.pixelSize,
-                         EDGE_WIDTH_RL,
-                         0);
+        if (subtract)
+        {
+            snprintf(word,
+                     sizeof(word),
+                     "%012ld@Subtract_Rank_%06d.mrcs",
+                     l + 1,
+                     _commRank);
 
-                if (finished)
-                    sprintf(filename, "%sReference_%03d_A_Final.bmp", _para.dstPrefix, t);
-                else
-                    sprintf(filename, "%sReference_%03d_A_Round_%03d.bmp", _para.dstPrefix, t, _iter);
+            dst += word;
+        }
+        else
+            dst += path[l];
 
-                ref.saveRLToBMP(filename);
-            }
-            else if (_commRank == HEMI_B_LEAD)
-            {
-                BLOG(INFO, "LOGGER_ROUND") << "Saving Reference " << t;
+        dst += ' ';
+        dst += micrographPath[l]; dst += ' ';
+        appendFixed(dst, coordX[l]); dst += ' ';
+        appendFixed(dst, coordY[l]); dst += THU_GROUP_SEPARATOR;
 
-                Image ref(_para.size,
-                          _para.size,
-                          FT_SPACE);
+        snprintf(word, sizeof(word), "%6d %6lu", _groupID[l], cls);
 
-                SLC_EXTRACT_FT(ref, _model.ref(t), 0);
+        dst += word; dst += THU_GROUP_SEPARATOR;
 
-                /***
-                if (finished)
-                    sprintf(filename, "%sFT_Reference_%03d_B_Final.bmp", _para.dstPrefix, t);
-                else
-                    sprintf(filename, "%sFT_Reference_%03d_B_Round_%03d.bmp", _para.dstPrefix, t, _iter);
+        appendFixed(dst, quat(0)); dst += ' ';
+        appendFixed(dst, quat(1)); dst += ' ';
+        appendFixed(dst, quat(2)); dst += ' ';
+        appendFixed(dst, quat(3)); dst += THU_GROUP_SEPARATOR;
 
-                ref.saveFTToBMP(filename, 0.001);
-                ***/
+        appendFixed(dst, k1); dst += ' ';
+        appendFixed(dst, k2); dst += ' ';
+        appendFixed(dst, k3); dst += THU_GROUP_SEPARATOR;
 
-                fft.bwMT(ref);
+        appendFixed(dst, tran(0)); dst += ' ';
+        appendFixed(dst, tran(1)); dst += ' ';
+        appendFixed(dst, s0); dst += ' ';
+        appendFixed(dst, s1); dst += THU_GROUP_SEPARATOR;
 
-                softMask(ref,
-                         ref,
-                         _para.maskRadius / _para.pixelSize,
-                         EDGE_WIDTH_RL,
-                         0);
+        appendFixed(dst, df); dst += ' ';
+        appendFixed(dst, s); dst += THU_GROUP_SEPARATOR;
 
-                if (finished)
-                    sprintf(filename, "%sReference_%03d_B_Final.bmp", _para.dstPrefix, t);
-                else
-                    sprintf(filename, "%sReference_%03d_B_Round_%03d.bmp", _para.dstPrefix, t, _iter);
+        appendFixed(dst, _par[l].compressR()); dst += '\n';
+    }
 
-                ref.saveRLToBMP(filename);
-            }
-        }
-        else if (_para.mode == MODE_3D)
-        {
-            Volume lowPass(_para.size,
-                           _para.size,
-                           _para.size,
-                           FT_SPACE);
+    string block;
 
-            if (finished)
-            {
-                lowPass = _model.ref(t).copyVolume();
+    size_t size = 0;
 
-                fft.bwMT(lowPass);
-            }
-            else
-            {
-#ifdef OPTIMISER_SAVE_LOW_PASS_REFERENCE
-                lowPassFilter(lowPass,
-                              _model.ref(t),
-                              (RFLOAT)_resReport / _para.size,
-                              (RFLOAT)EDGE_WIDTH_FT / _para.size);
-#else
-                lowPass = _model.ref(t).copyVolume();
-#endif
+    FOR_EACH_2D_IMAGE size += line[l].size();
 
-                fft.bwMT(lowPass);
-            }
+    block.reserve(size);
 
-            if (_commRank == HEMI_A_LEAD)
-            {
-                ALOG(INFO, "LOGGER_ROUND") << "Saving Reference " << t;
+    FOR_EACH_2D_IMAGE block += line[l];
 
-                if (finished)
-                {
-                    sprintf(filename, "%sReference_%03d_A_Final.mrc", _para.dstPrefix, t);
-                }
-                else
-                {
-                    sprintf(filename, "%sReference_%03d_A_Round_%03d.mrc", _para.dstPrefix, t, _iter);
-                }
+#ifdef OPTIMISER_SAVE_DATABASE_MPI_IO
 
-                imf.readMetaData(lowPass);
-                imf.writeVolume(filename, lowPass, _para.pixelSize);
-            }
-            else if (_commRank == HEMI_B_LEAD)
-            {
-                BLOG(INFO, "LOGGER_ROUND") << "Saving Reference " << t;
+    // the block of each process is placed after those of the processes of lower
+    // ranks, the master contributing nothing
 
-                if (finished)
-                {
-                    sprintf(filename, "%sReference_%03d_B_Final.mrc", _para.dstPrefix, t);
-                }
-                else
-                {
-                    sprintf(filename, "%sReference_%03d_B_Round_%03d.mrc", _para.dstPrefix, t, _iter);
-                }
+    long long offset = 0;
+    long long bytes = block.size();
 
-                imf.readMetaData(lowPass);
-                imf.writeVolume(filename, lowPass, _para.pixelSize);
-            }
-        }
-    }
-}
+    MPI_Exscan(&bytes, &offset, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
 
-void Optimiser::saveMapJoin(const bool finished)
-{
-    FFT fft;
+    IF_MASTER offset = 0;
 
-    ImageFile imf;
-    char filename[FILE_NAME_LENGTH];
+    MPI_File file;
 
-    if (_para.mode == MODE_2D)
+    if (MPI_File_open(MPI_COMM_WORLD,
+                      filename,
+                      MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                      MPI_INFO_NULL,
+                      &file) != MPI_SUCCESS)
     {
-        IF_MASTER
-        {
-            MLOG(INFO, "LOGGER_ROUND") << "Saving Stack of Reference(s)";
+        REPORT_ERROR("FAIL TO OPEN .thu FILE");
 
-            if (finished)
-                sprintf(filename, "%sReference_Final.mrcs", _para.dstPrefix);
-            else
-                sprintf(filename, "%sReference_Round_%03d.mrcs", _para.dstPrefix, _iter);
+        abort();
+    }
 
-            imf.openStack(filename, _para.size, _para.k, _para.pixelSize);
-        }
+    MPI_File_set_size(file, 0);
 
-        for (int l = 0; l < _para.k; l++)
-        {
-            IF_MASTER
-            {
-                Image ref(_para.size, _para.size, FT_SPACE);
+    long long nChunk = (bytes + SAVE_DATABASE_CHUNK - 1) / SAVE_DATABASE_CHUNK;
 
-                Image A(_para.size, _para.size, FT_SPACE);
-                Image B(_para.size, _para.size, FT_SPACE);
+    MPI_Allreduce(MPI_IN_PLACE, &nChunk, 1, MPI_LONG_LONG, MPI_MAX, MPI_COMM_WORLD);
 
-                MLOG(INFO, "LOGGER_ROUND") << "Receiving Reference " << l << " from Hemisphere A";
+    MPI_Status status;
 
-                MPI_Recv_Large(&A[0],
-                               A.sizeFT(),
-                               TS_MPI_DOUBLE_COMPLEX,
-                               HEMI_A_LEAD,
-                               l,
-                               MPI_COMM_WORLD);
+    for (long long i = 0; i < nChunk; i++)
+    {
+        long long begin = std::min(i * SAVE_DATABASE_CHUNK, bytes);
+        long long end = std::min(begin + SAVE_DATABASE_CHUNK, bytes);
 
-                MLOG(INFO, "LOGGER_ROUND") << "Receiving Reference " << l << " from Hemisphere B";
+        MPI_File_write_at_all(file,
+                              offset + begin,
+                              block.data() + begin,
+                              end - begin,
+                              MPI_CHAR,
+                              &status);
+    }
 
-                MPI_Recv_Large(&B[0],
-                               B.sizeFT(),
-                               TS_MPI_DOUBLE_COMPLEX,
-                               HEMI_B_LEAD,
-                               l,
-                               MPI_COMM_WORLD);
+    MPI_File_close(&file);
 
-                MLOG(INFO, "LOGGER_ROUND") << "Averaging Two Hemispheres";
-                FOR_EACH_PIXEL_FT(ref)
-                    ref[i] = (A[i] + B[i]) / 2;
+#else
 
-                fft.bwMT(ref);
+    IF_MASTER return;
 
-                softMask(ref,
-                         ref,
-                         _para.maskRadius / _para.pixelSize,
-                         EDGE_WIDTH_RL,
-                         0);
+    bool flag;
+    MPI_Status status;
+    
+    if (_commRank != 1)
+        MPI_Recv(&flag, 1, MPI_C_BOOL, _commRank - 1, 0, MPI_COMM_WORLD, &status);
 
-                imf.writeStack(ref, l);
-            }
-            else
-            {
-                if ((_commRank == HEMI_A_LEAD) ||
-                    (_commRank == HEMI_B_LEAD))
-                {
-                    ALOG(INFO, "LOGGER_ROUND") << "Sending Reference "
-                                                 << l
-                                                 << " from Hemisphere A";
+    FILE* file = (_commRank == 1)
+               ? fopen(filename, "w")
+               : fopen(filename, "a");
 
-                    BLOG(INFO, "LOGGER_ROUND") << "Sending Reference "
-                                                 << l
-                                                 << " from Hemisphere B";
+    fwrite(block.data(), 1, block.size(), file);
 
-                    MPI_Ssend_Large(&_model.ref(l)[0],
-                                    _model.ref(l).sizeFT(),
-                                    TS_MPI_DOUBLE_COMPLEX,
-                                    MASTER_ID,
-                                    l,
-                                    MPI_COMM_WORLD);
-                }
-            }
-        }
+    fclose(file);
 
-        IF_MASTER imf.closeStack();
-    }
-    else if (_para.mode == MODE_3D)
-    {
-        for (int l = 0; l < _para.k; l++)
-        {
-            IF_MASTER
-            {
-                Volume ref(_para.size, _para.size, _para.size, FT_SPACE);
+    if (_commRank != _commSize - 1)
+        MPI_Send(&flag, 1, MPI_C_BOOL, _commRank + 1, 0, MPI_COMM_WORLD);
 
-                Volume A(_para.size, _para.size, _para.size, FT_SPACE);
-                Volume B(_para.size, _para.size, _para.size, FT_SPACE);
+#endif
+}
 
-                MLOG(INFO, "LOGGER_ROUND") << "Receiving Reference " << l << " from Hemisphere A";
+void Optimiser::saveSubtract()
+{
+    IF_MASTER return;
 
-                MPI_Recv_Large(&A[0],
-                               A.sizeFT(),
-                               TS_MPI_DOUBLE_COMPLEX,
-                               HEMI_A_LEAD,
-                               l,
-                               MPI_COMM_WORLD);
+    char filename[FILE_NAME_LENGTH];
 
-                MLOG(INFO, "LOGGER_ROUND") << "Receiving Reference " << l << " from Hemisphere B";
+    sprintf(filename, "%sSubtract_Rank_%06d.mrcs", _para.dstPrefix, _commRank);
 
-                MPI_Recv_Large(&B[0],
-                               B.sizeFT(),
-                               TS_MPI_DOUBLE_COMPLEX,
-                               HEMI_B_LEAD,
-                               l,
-                               MPI_COMM_WORLD);
+    ImageFile imf;
 
-                MLOG(INFO, "LOGGER_ROUND") << "Averaging Two Hemispheres";
-                FOR_EACH_PIXEL_FT(ref)
-                    ref[i] = (A[i] + B[i]) / 2;
+    imf.openStack(filename, _para.size, _ID.size(), _para.pixelSize);
+
+    Image result(_para.size, _para.size, FT_SPACE);
+    Image diff(_para.size, _para.size, FT_SPACE);
+
+    size_t cls;
+    dmat22 rot2D;
+    dmat33 rot3D;
+    dvec2 tran;
+    double d;
 
-                fft.bwMT(ref);
+    FOR_EACH_2D_IMAGE
+    {
+        #pragma omp parallel for
+        SET_0_FT(result);
 
-                if (finished)
-                    sprintf(filename, "%sReference_%03d_Final.mrc", _para.dstPrefix, l);
-                else
-                    sprintf(filename, "%sReference_%03d_Round_%03d.mrc", _para.dstPrefix, l, _iter);
+        #pragma omp parallel for
+        SET_0_FT(diff);
 
-                imf.readMetaData(ref);
-                imf.writeVolume(filename, ref, _para.pixelSize);
-            }
-            else
-            {
-                if ((_commRank == HEMI_A_LEAD) ||
-                    (_commRank == HEMI_B_LEAD))
-                {
-                    ALOG(INFO, "LOGGER_ROUND") << "Sending Reference "
-                                                 << l
-                                                 << " from Hemisphere A";
+        if (_para.mode == MODE_2D)
+        {
+            ALOG(FATAL, "LOGGER_ROUND") << "SAVE SUBTRACT DOES NOT SUPPORT 2D MODE";
+            BLOG(FATAL, "LOGGER_ROUND") << "SAVE SUBTRACT DOES NOT SUPPORT 2D MODE";
 
-                    BLOG(INFO, "LOGGER_ROUND") << "Sending Reference "
-                                                 << l
-                                                 << " from Hemisphere B";
+            abort();
+            /***
+            _par[l].rank1st(cls, rot2D, tran, d);
 
-                    MPI_Ssend_Large(&_model.ref(l)[0],
-                                    _model.ref(l).sizeFT(),
-                                    TS_MPI_DOUBLE_COMPLEX,
-                                    MASTER_ID,
-                                    l,
-                                    MPI_COMM_WORLD);
-                }
-            }
+            _model.proj(cls).projectMT(result, rot2D, tran - _offset[l]);
+            ***/
         }
-    }
-    else
-    {
-        REPORT_ERROR("INEXISTENT MODE");
+        else if (_para.mode == MODE_3D)
+        {
+            _par[l].rank1st(cls, rot3D, tran, d);
 
-        abort();
-    }
-}
+            _model.proj(cls).projectMT(result, rot3D, tran - _offset[l]);
+        }
+        else
+        {
+            REPORT_ERROR("INEXISTENT MODE");
 
-void Optimiser::saveFSC(const bool finished) const
-{
-    NT_MASTER return;
+            abort();
+        }
 
-    char filename[FILE_NAME_LENGTH];
+        #pragma omp parallel for
+        FOR_EACH_PIXEL_FT(diff)
+        {
+            diff[i] = _imgOri[l][i] - result[i] * REAL(_ctf[l][i]);
+            //diff[i] = _imgOri[l][i];
+        }
 
-    if (finished)
-        sprintf(filename, "%sFSC_Final.txt", _para.dstPrefix);
-    else
-        sprintf(filename, "%sFSC_Round_%03d.txt", _para.dstPrefix, _iter);
+        dvec3 regionTrans = rot3D.transpose() * dvec3(_regionCentre(0),
+                                                      _regionCentre(1),
+                                                      _regionCentre(2));
 
-    FILE* file = fopen(filename, "w");
+        dvec2 tran = dvec2(regionTrans(0), regionTrans(1));
 
-    for (int i = 1; i < _model.rU(); i++)
-    {
-        fprintf(file,
-                "%05d   %10.6lf",
-                i,
-                1.0 / resP2A(i, _para.size, _para.pixelSize));
-        for (int t = 0; t < _para.k; t++)
-            fprintf(file,
-                    "   %10.6lf",
-                    (_model.fsc(t))(i));
-        fprintf(file, "\n");
-    }
-    
-    fclose(file);
-}
+        translateMT(diff, diff, -tran(0), -tran(1));
 
-void Optimiser::saveClassInfo(const bool finished) const
-{
-    NT_MASTER return;
+        _par[l].setT(_par[l].t().rowwise() - tran.transpose());
 
-    char filename[FILE_NAME_LENGTH];
+        _par[l].setTopT(_par[l].topT() - tran);
+        _par[l].setTopTPrev(_par[l].topTPrev() - tran);
 
-    if (finished)
-        sprintf(filename, "%sClass_Info_Final.txt", _para.dstPrefix);
-    else
-        sprintf(filename, "%sClass_Info_Round_%03d.txt", _para.dstPrefix, _iter);
+        _fftImg.bwExecutePlanMT(diff);
 
-    FILE* file = fopen(filename, "w");
+        imf.writeStack(diff, l);
 
-    for (int t = 0; t < _para.k; t++)
-    {
-        fprintf(file,
-                "%05d   %10.6lf   %10.6lf\n",
-                t,
-                1.0 / _model.resolutionA(t, _para.thresReportFSC),
-                _cDistr(t));
+        _fftImg.fwExecutePlanMT(diff);
     }
 
-    fclose(file);
+    imf.closeStack();
 }
 
-void Optimiser::saveSig() const
+void Optimiser::saveBestProjections()
 {
-    if ((_commRank != HEMI_A_LEAD) &&
-        (_commRank != HEMI_B_LEAD))
-        return;
+    IF_MASTER return;
 
+    FFT fft;
+
+    Image result(_para.size, _para.size, FT_SPACE);
+    Image diff(_para.size, _para.size, FT_SPACE);
     char filename[FILE_NAME_LENGTH];
 
-    if (_commRank == HEMI_A_LEAD)
-        sprintf(filename, "%sSig_A_Round_%03d.txt", _para.dstPrefix, _iter);
-    else
-        sprintf(filename, "%sSig_B_Round_%03d.txt", _para.dstPrefix, _iter);
+    size_t cls;
+    dmat22 rot2D;
+    dmat33 rot3D;
+    dvec2 tran;
+    double d;
 
-    FILE* file = fopen(filename, "w");
+    FOR_EACH_2D_IMAGE
+    {
+        if (_ID[l] < N_SAVE_IMG)
+        {
+            #pragma omp parallel for
+            SET_0_FT(result);
 
-    for (int i = 0; i < maxR(); i++)
-        fprintf(file,
-                "%05d   %10.6lf   %10.6lf\n",
-                i,
-                1.0 / resP2A(i, _para.size, _para.pixelSize),
-                _sig(_groupID[0] - 1, i));
+            #pragma omp parallel for
+            SET_0_FT(diff);
 
-    fclose(file);
+            if (_para.mode == MODE_2D)
+            {
+                _par[l].rank1st(cls, rot2D, tran, d);
 
-    if (_commRank == HEMI_A_LEAD)
-        sprintf(filename, "%sSVD_A_Round_%03d.txt", _para.dstPrefix, _iter);
-    else
-        sprintf(filename, "%sSVD_B_Round_%03d.txt", _para.dstPrefix, _iter);
+                _model.proj(cls).projectMT(result, rot2D, tran);
+            }
+            else if (_para.mode == MODE_3D)
+            {
+                _par[l].rank1st(cls, rot3D, tran, d);
 
-    file = fopen(filename, "w");
+                _model.proj(cls).projectMT(result, rot3D, tran);
+            }
+            else
+                REPORT_ERROR("INEXISTENT MODE");
 
-    for (int i = 0; i < maxR(); i++)
-        fprintf(file,
-                "%05d   %10.6lf   %10.6lf\n",
-                i,
-                1.0 / resP2A(i, _para.size, _para.pixelSize),
-                _svd(_groupID[0] - 1, i));
+            sprintf(filename, "%sResult_%04d_Round_%03d.bmp", _para.dstPrefix, _ID[l], _iter);
 
-    fclose(file);
+            fft.bw(result);
+            result.saveRLToBMP(filename);
+            fft.fw(result);
+
+#ifdef OPTIMISER_CTF_ON_THE_FLY
+            // TODO
+#else
+            #pragma omp parallel for
+            FOR_EACH_PIXEL_FT(diff)
+                diff[i] = _img[l][i] - result[i] * REAL(_ctf[l][i]);
+#endif
+
+            sprintf(filename, "%sDiff_%04d_Round_%03d.bmp", _para.dstPrefix, _ID[l], _iter);
+            fft.bw(diff);
+            diff.saveRLToBMP(filename);
+            fft.fw(diff);
+        }
+    }
 }
 
-void Optimiser::saveTau() const
+void Optimiser::saveImages()
 {
-    if ((_commRank != HEMI_A_LEAD) &&
-        (_commRank != HEMI_B_LEAD))
-        return;
+    IF_MASTER return;
 
     char filename[FILE_NAME_LENGTH];
+    FOR_EACH_2D_IMAGE
+    {
+        if (_ID[l] < N_SAVE_IMG)
+        {
+            sprintf(filename, "Fourier_Image_%04d.bmp", _ID[l]);
 
-    if (_commRank == HEMI_A_LEAD)
-        sprintf(filename, "%sTau_A_Round_%03d.txt", _para.dstPrefix, _iter);
-    else if (_commRank == HEMI_B_LEAD)
-        sprintf(filename, "%sTau_B_Round_%03d.txt", _para.dstPrefix, _iter);
-
-    FILE* file = fopen(filename, "w");
+            _imgOri[l].saveFTToBMP(filename, 0.01);
 
-    for (int i = 1; i < maxR() * _para.pf - 1; i++)
-        fprintf(file,
-                "%05d   %10.6lf   %10.6lf\n",
-                i,
-                1.0 / resP2A(i, _para.size * _para.pf, _para.pixelSize),
-                _model.tau(0)(i));
+            sprintf(filename, "Image_%04d.bmp", _ID[l]);
 
-    fclose(file);
+            _fftImg.bwExecutePlanMT(_imgOri[l]);
+            _imgOri[l].saveRLToBMP(filename);
+            _fftImg.fwExecutePlanMT(_imgOri[l]);
+        }
+    }
 }
 
+void Optimiser::saveCTFs()
+{
+    IF_MASTER return;
 
-/**
- *  This function is add by huabin
- */
-//Change by huabin doubleToRFLOAT
-RFLOAT logDataVSPrior_m_huabin(const Complex* dat, const Complex* pri, const RFLOAT* ctf, const RFLOAT* sigRcp, const int m)
+    char filename[FILE_NAME_LENGTH];
+    FOR_EACH_2D_IMAGE
+    {
+        if (_ID[l] < N_SAVE_IMG)
+        {
+            sprintf(filename, "CTF_%04d.bmp", _ID[l]);
+
+#ifdef OPTIMISER_CTF_ON_THE_FLY
+            // TODO
+#else
+            _ctf[l].saveFTToBMP(filename, 0.01);
+#endif
+        }
+    }
+}
+
+void Optimiser::saveMapHalf(const bool finished)
 {
+#ifdef OPTIMISER_MASTER_SAVE_MAP
+    if ((_para.mode == MODE_3D) && (!finished))
+    {
+        // the master process receives the half maps, and writes them in the
+        // background, thus the leads only wait for the transfer
+
+        char filename[FILE_NAME_LENGTH];
+
+        for (int t = 0; t < _para.k; t++)
+        {
+            IF_MASTER
+            {
+                for (int h = 0; h < 2; h++)
+                {
+                    Volume ref(_para.size, _para.size, _para.size, FT_SPACE);
 
-   RFLOAT result2 = 0.0;
-   RFLOAT tmpReal = 0.0;
-   RFLOAT tmpImag = 0.0;
-   RFLOAT tmp1Real = 0.0;
-   RFLOAT tmp1Imag = 0.0;
-   RFLOAT tmp2;
-   for (int i = 0; i < m; i++)
-   {
-            
-       tmpReal = ctf[i] * pri[i].dat[0];
-       tmpImag = ctf[i] * pri[i].dat[1];
-       tmp1Real = dat[i].dat[0] - tmpReal;
-       tmp1Imag = dat[i].dat[1] - tmpImag;
+                    writeMapQueue(ref.sizeFT() * sizeof(Complex));
 
-       tmp2 = tmp1Real * tmp1Real + tmp1Imag * tmp1Imag;
-       result2 += (tmp2 * sigRcp[i]);
+                    _mapQueue.push_back(boost::move(ref));
 
-       //tmp3 = tmp2 * sigRcp[i];
-       //result2 += tmp3;
+                    MPI_Recv_Large(&_mapQueue.back()[0],
+                                   _mapQueue.back().sizeFT(),
+                                   TS_MPI_DOUBLE_COMPLEX,
+                                   (h == 0) ? HEMI_A_LEAD : HEMI_B_LEAD,
+                                   t,
+                                   MPI_COMM_WORLD);
 
-   }
+                    sprintf(filename,
+                            "%sReference_%03d_%c_Round_%03d.mrc",
+                            _para.dstPrefix,
+                            t,
+                            (h == 0) ? 'A' : 'B',
+                            _iter);
 
-   return result2;
-}
+                    _mapQueueName.push_back(filename);
 
+#ifdef OPTIMISER_SAVE_LOW_PASS_REFERENCE
+                    _mapQueueLowPass.push_back((RFLOAT)_resReport / _para.size);
+#else
+                    _mapQueueLowPass.push_back(-1);
+#endif
 
-/**
- *  SIMD256Float() and SIMD256Double() are added by huabin
- */
+                    writeMapQueue(0);
+                }
+            }
+            else if ((_commRank == HEMI_A_LEAD) ||
+                     (_commRank == HEMI_B_LEAD))
+            {
+                ALOG(INFO, "LOGGER_ROUND") << "Sending Reference " << t << " to Master";
+                BLOG(INFO, "LOGGER_ROUND") << "Sending Reference " << t << " to Master";
+
+                MPI_Ssend_Large(&_model.ref(t)[0],
+                                _model.ref(t).sizeFT(),
+                                TS_MPI_DOUBLE_COMPLEX,
+                                MASTER_ID,
+                                t,
+                                MPI_COMM_WORLD);
+            }
+        }
 
-#ifdef ENABLE_SIMD_256
-#ifdef SINGLE_PRECISION
-RFLOAT* SIMD256Float(Complex* dat, const Complex* pri, const RFLOAT* ctf, const RFLOAT* sigRcp, const int n, const int m, RFLOAT *SIMDResult)
-{
+        return;
+    }
+#endif
 
-    //vec resultSIMDFloat = vec::Zero(n);
-    RFLOAT* resultSIMDFloat = SIMDResult;
-    //memset(resultSIMDFloat, '\0', _ID.size() * sizeof(RFLOAT));
+    if ((_commRank != HEMI_A_LEAD) &&
+        (_commRank != HEMI_B_LEAD))
+        return;
 
-    __m256 ymm1, ymm2, ymm3, ymm4, ymm5,ymm6;
-    __m256 xmm4, xmm5;
-    int i = 0;
-    int j = 0;
-    int idx = 0;
-    RFLOAT  tmp[8] __attribute__((aligned(64)));
-    RFLOAT tmpReal  = 0.0;
-    RFLOAT tmpImag  = 0.0;
-    RFLOAT tmp1Real = 0.0;
-    RFLOAT tmp1Imag = 0.0;
-    RFLOAT tmp1     = 0.0;
-    RFLOAT tmp2     = 0.0;
-
-
-    for(i = 0; i < m; i ++)
-    {   
-        xmm4 = _mm256_set_ps(pri[i].dat[0], pri[i].dat[0], pri[i].dat[0],pri[i].dat[0], pri[i].dat[0], pri[i].dat[0], pri[i].dat[0],pri[i].dat[0]);//pri[i].dat[0]
-        xmm5 = _mm256_set_ps(pri[i].dat[1], pri[i].dat[1], pri[i].dat[1],pri[i].dat[1], pri[i].dat[1], pri[i].dat[1], pri[i].dat[1],pri[i].dat[1]);//pri[i].dat[1]
-        for(j = 0; j <= (n - 8); j += 8)
-        {
-            ymm6 = _mm256_setzero_ps();
-            idx = i * n + j;
-            ymm1 = _mm256_set_ps(ctf[idx+7], ctf[idx+6], ctf[idx+5], ctf[idx + 4], ctf[idx+3], ctf[idx+2], ctf[idx+1], ctf[idx]); //ctf[idx]
-            ymm2 = _mm256_set_ps(dat[idx + 7].dat[0], dat[idx + 6].dat[0], dat[idx + 5].dat[0],dat[idx + 4].dat[0], dat[idx + 3].dat[0], dat[idx + 2].dat[0], dat[idx + 1].dat[0],dat[idx].dat[0]);//dat[idx].dat[0]
-            ymm3 = _mm256_set_ps(dat[idx + 7].dat[1], dat[idx + 6].dat[1], dat[idx + 5].dat[1],dat[idx + 4].dat[1], dat[idx + 3].dat[1], dat[idx + 2].dat[1], dat[idx + 1].dat[1],dat[idx].dat[1]);//dat[idx].dat[1]
-            //ymm4 = _mm256_set_ps(pri[i].dat[0], pri[i].dat[0], pri[i].dat[0],pri[i].dat[0], pri[i].dat[0], pri[i].dat[0], pri[i].dat[0],pri[i].dat[0]);//pri[i].dat[0]
-            //ymm5 = _mm256_set_ps(pri[i].dat[1], pri[i].dat[1], pri[i].dat[1],pri[i].dat[1], pri[i].dat[1], pri[i].dat[1], pri[i].dat[1],pri[i].dat[1]);//pri[i].dat[1]
-            //ymm4 = _mm256_mul_ps(ymm1, ymm4); //tmpReal
-            //ymm5 = _mm256_mul_ps(ymm1, ymm5);//tmpImag
-                    
-            ymm4 = _mm256_mul_ps(ymm1, xmm4); //tmpReal
-            ymm5 = _mm256_mul_ps(ymm1, xmm5);//tmpImag
+    FFT fft;
 
-            ymm4 = _mm256_sub_ps(ymm2, ymm4);//tmp1Real
-            ymm5 = _mm256_sub_ps(ymm3, ymm5); //tmp1Imag
+    ImageFile imf;
+    char filename[FILE_NAME_LENGTH];
 
-            ymm4 = _mm256_mul_ps(ymm4, ymm4);
-            ymm5 = _mm256_mul_ps(ymm5, ymm5);
+    for (int t = 0; t < _para.k; t++)
+    {
+        if (_para.mode == MODE_2D)
+        {
+            if (_commRank == HEMI_A_LEAD)
+            {
+                ALOG(INFO, "LOGGER_ROUND") << "Saving Reference " << t;
 
-            ymm4 = _mm256_add_ps(ymm4, ymm5); //tmp1
+                Image ref(_para.size,
+                          _para.size,
+                          FT_SPACE);
 
-            ymm5 = _mm256_set_ps(sigRcp[idx+7], sigRcp[idx+6], sigRcp[idx+5], sigRcp[idx + 4], sigRcp[idx+3], sigRcp[idx+2], sigRcp[idx+1], sigRcp[idx]); //sigRcp
+                SLC_EXTRACT_FT(ref, _model.ref(t), 0);
 
-            ymm4 = _mm256_mul_ps(ymm4, ymm5);//tmp2
+                /***
+                if (finished)
+                    sprintf(filename, "%sFT_Reference_%03d_A_Final.bmp", _para.dstPrefix, t);
+                else
+                    sprintf(filename, "%sFT_Reference_%03d_A_Round_%03d.bmp", _para.dstPrefix, t, _iter);
 
-            ymm6 = _mm256_add_ps(ymm6, ymm4);//result2
+                ref.saveFTToBMP(filename, 0.001);
+                ***/
 
-            _mm256_store_ps(tmp, ymm6);
-            resultSIMDFloat[j]+= tmp[0];
-            resultSIMDFloat[j + 1] += tmp[1];
-            resultSIMDFloat[j + 2] += tmp[2];
-            resultSIMDFloat[j + 3] += tmp[3];
-            resultSIMDFloat[j + 4] += tmp[4];
-            resultSIMDFloat[j + 5] += tmp[5];
-            resultSIMDFloat[j + 6] += tmp[6];
-            resultSIMDFloat[j + 7] += tmp[7];
-        }
+                fft.bwMT(ref);
 
-        //Process remainning value 
-        for(; j < n; j ++)
-        {
-            int idx       = i * n + j;
-            tmpReal  = ctf[idx] * pri[i].dat[0];
-            tmpImag  = ctf[idx] * pri[i].dat[1];
+                softMask(ref,
+                         ref,
+                         _para.maskRadius / _para.pixelSize,
+                         EDGE_WIDTH_RL,
+                         0);
 
-            tmp1Real = dat[idx].dat[0] - tmpReal; //temp.real
-            tmp1Imag = dat[idx].dat[1] - tmpImag;//temp.imag
+                if (finished)
+                    sprintf(filename, "%sReference_%03d_A_Final.bmp", _para.dstPrefix, t);
+                else
+                    sprintf(filename, "%sReference_%03d_A_Round_%03d.bmp", _para.dstPrefix, t, _iter);
 
-            tmp1          = tmp1Real * tmp1Real + tmp1Imag * tmp1Imag; //tmp1
-            tmp2          = tmp1 * sigRcp[idx];//temp2
-            resultSIMDFloat[j]    += tmp2;
+                ref.saveRLToBMP(filename);
+            }
+            else if (_commRank == HEMI_B_LEAD)
+            {
+                BLOG(INFO, "LOGGER_ROUND") << "Saving Reference " << t;
 
-        }
-        
-    }
+                Image ref(_para.size,
+                          _para.size,
+                          FT_SPACE);
 
-    return resultSIMDFloat;
-}
-#else
+                SLC_EXTRACT_FT(ref, _model.ref(t), 0);
 
-RFLOAT* SIMD256Double(Complex* dat, const Complex* pri, const RFLOAT* ctf, const RFLOAT* sigRcp, const int n, const int m, RFLOAT *SIMDResult)
-{
+                /***
+                if (finished)
+                    sprintf(filename, "%sFT_Reference_%03d_B_Final.bmp", _para.dstPrefix, t);
+                else
+                    sprintf(filename, "%sFT_Reference_%03d_B_Round_%03d.bmp", _para.dstPrefix, t, _iter);
 
-    //vec resultSIMDDouble = vec::Zero(n);
-    RFLOAT *resultSIMDDouble = SIMDResult;
-    //memset(resultSIMDDouble, '\0', _ID.size() * sizeof(RFLOAT));
-    __m256d ymm1, ymm2, ymm3, ymm4, ymm5,ymm6;
-    __m256d xmm4, xmm5;
-    int i = 0;
-    int j = 0;
-    int idx = 0;
-    RFLOAT  tmp[4] __attribute__((aligned(64)));
-    RFLOAT tmpReal  = 0.0;
-    RFLOAT tmpImag  = 0.0;
-    RFLOAT tmp1Real = 0.0;
-    RFLOAT tmp1Imag = 0.0;
-    RFLOAT tmp1     = 0.0;
-    RFLOAT tmp2     = 0.0;
-
-
-    for(i = 0; i < m; i ++)
-    {   
-        xmm4 = _mm256_set_pd(pri[i].dat[0], pri[i].dat[0], pri[i].dat[0],pri[i].dat[0]);//pri[i].dat[0]
-        xmm5 = _mm256_set_pd(pri[i].dat[1], pri[i].dat[1], pri[i].dat[1],pri[i].dat[1]);//pri[i].dat[1]
-        for(j = 0; j <= (n -4); j += 4)
-        {
-            ymm6 = _mm256_setzero_pd();
-            idx = i * n + j;
-            ymm1 = _mm256_set_pd(ctf[idx+3], ctf[idx+2], ctf[idx+1], ctf[idx]); //ctf[idx]
-            ymm2 = _mm256_set_pd(dat[idx + 3].dat[0], dat[idx + 2].dat[0], dat[idx + 1].dat[0],dat[idx].dat[0]);//dat[idx].dat[0]
-            ymm3 = _mm256_set_pd(dat[idx + 3].dat[1], dat[idx + 2].dat[1], dat[idx + 1].dat[1],dat[idx].dat[1]);//dat[idx].dat[1]
-            //ymm4 = _mm256_set_pd(pri[i].dat[0], pri[i].dat[0], pri[i].dat[0],pri[i].dat[0]);//pri[i].dat[0]
-            //ymm5 = _mm256_set_pd(pri[i].dat[1], pri[i].dat[1], pri[i].dat[1],pri[i].dat[1]);//pri[i].dat[1]
-            //ymm4 = _mm256_mul_pd(ymm1, ymm4); //tmpReal
-            //ymm5 = _mm256_mul_pd(ymm1, ymm5);//tmpImag
-                    
-            ymm4 = _mm256_mul_pd(ymm1, xmm4); //tmpReal
-            ymm5 = _mm256_mul_pd(ymm1, xmm5);//tmpImag
+                ref.saveFTToBMP(filename, 0.001);
+                ***/
 
+                fft.bwMT(ref);
 
-            ymm4 = _mm256_sub_pd(ymm2, ymm4);//tmp1Real
-            ymm5 = _mm256_sub_pd(ymm3, ymm5); //tmp1Imag
+                softMask(ref,
+                         ref,
+                         _para.maskRadius / _para.pixelSize,
+                         EDGE_WIDTH_RL,
+                         0);
 
-            ymm4 = _mm256_mul_pd(ymm4, ymm4);
-            ymm5 = _mm256_mul_pd(ymm5, ymm5);
+                if (finished)
+                    sprintf(filename, "%sReference_%03d_B_Final.bmp", _para.dstPrefix, t);
+                else
+                    sprintf(filename, "%sReference_%03d_B_Round_%03d.bmp", _para.dstPrefix, t, _iter);
 
-            ymm4 = _mm256_add_pd(ymm4, ymm5); //tmp1
+                ref.saveRLToBMP(filename);
+            }
+        }
+        else if (_para.mode == MODE_3D)
+        {
+            Volume lowPass(_para.size,
+                           _para.size,
+                           _para.size,
+                           FT_SPACE);
 
-            ymm5 = _mm256_set_pd(sigRcp[idx+3], sigRcp[idx+2], sigRcp[idx+1], sigRcp[idx]); //sigRcp
+            if (finished)
+            {
+                lowPass = _model.ref(t).copyVolume();
 
-            ymm4 = _mm256_mul_pd(ymm4, ymm5);//tmp2
+                fft.bwMT(lowPass);
+            }
+            else
+            {
+#ifdef OPTIMISER_SAVE_LOW_PASS_REFERENCE
+                lowPassFilter(lowPass,
+                              _model.ref(t),
+                              (RFLOAT)_resReport / _para.size,
+                              (RFLOAT)EDGE_WIDTH_FT / _para.size);
+#else
+                lowPass = _model.ref(t).copyVolume();
+#endif
 
-            ymm6 = _mm256_add_pd(ymm6, ymm4);//result2
+                fft.bwMT(lowPass);
+            }
 
-            _mm256_store_pd(tmp, ymm6);
-            resultSIMDDouble[j] += tmp[0];
-            resultSIMDDouble[j + 1] += tmp[1];
-            resultSIMDDouble[j + 2] += tmp[2];
-            resultSIMDDouble[j + 3] += tmp[3];
-        }
+            if (_commRank == HEMI_A_LEAD)
+            {
+                ALOG(INFO, "LOGGER_ROUND") << "Saving Reference " << t;
 
-        //Process remainning value 
-        for(; j < n; j ++)
-        {
-            int idx       = i * n + j;
-            tmpReal  = ctf[idx] * pri[i].dat[0];
-            tmpImag  = ctf[idx] * pri[i].dat[1];
+                if (finished)
+                {
+                    sprintf(filename, "%sReference_%03d_A_Final.mrc", _para.dstPrefix, t);
+                }
+                else
+                {
+                    sprintf(filename, "%sReference_%03d_A_Round_%03d.mrc", _para.dstPrefix, t, _iter);
+                }
 
-            tmp1Real = dat[idx].dat[0] - tmpReal; //temp.real
-            tmp1Imag = dat[idx].dat[1] - tmpImag;//temp.imag
+                imf.readMetaData(lowPass);
+                imf.writeVolume(filename, lowPass, _para.pixelSize);
+            }
+            else if (_commRank == HEMI_B_LEAD)
+            {
+                BLOG(INFO, "LOGGER_ROUND") << "Saving Reference " << t;
 
-            tmp1          = tmp1Real * tmp1Real + tmp1Imag * tmp1Imag; //tmp1
-            tmp2          = tmp1 * sigRcp[idx];//temp2
-            resultSIMDDouble[j]    += tmp2;//resultFoo
+                if (finished)
+                {
+                    sprintf(filename, "%sReference_%03d_B_Final.mrc", _para.dstPrefix, t);
+                }
+                else
+                {
+                    sprintf(filename, "%sReference_%03d_B_Round_%03d.mrc", _para.dstPrefix, t, _iter);
+                }
 
+                imf.readMetaData(lowPass);
+                imf.writeVolume(filename, lowPass, _para.pixelSize);
+            }
         }
-        
     }
-
-    return resultSIMDDouble;
 }
 
-#endif
-#endif
-
+void Optimiser::saveMapJoin(const bool finished)
+{
+    FFT fft;
 
-#ifdef ENABLE_SIMD_256
-RFLOAT* logDataVSPrior_m_n_huabin_SIMD256(Complex* dat, const Complex* pri, const RFLOAT* ctf, const RFLOAT* sigRcp, const int n, const int m, RFLOAT *SIMDResult)
+    ImageFile imf;
+    char filename[FILE_NAME_LENGTH];
 
-{
-#ifdef SINGLE_PRECISION
-    return SIMD256Float(dat, pri, ctf, sigRcp, n, m, SIMDResult);
-#else
-    return SIMD256Double(dat, pri, ctf, sigRcp, n, m, SIMDResult);
-#endif
-}
-#endif
+    if (_para.mode == MODE_2D)
+    {
+        IF_MASTER
+        {
+            MLOG(INFO, "LOGGER_ROUND") << "Saving Stack of Reference(s)";
 
+            if (finished)
+                sprintf(filename, "%sReference_Final.mrcs", _para.dstPrefix);
+            else
+                sprintf(filename, "%sReference_Round_%03d.mrcs", _para.dstPrefix, _iter);
 
-#ifdef ENABLE_SIMD_256
-#ifdef SINGLE_PRECISION
-RFLOAT SIMD256Float(Complex* dat, const Complex* pri, const RFLOAT* ctf, const RFLOAT* sigRcp, const int m)
-{
+            imf.openStack(filename, _para.size, _para.k, _para.pixelSize);
+        }
 
-    __m256 ymm1, ymm2, ymm3, ymm4, ymm5,ymm6;
-    ymm6 = _mm256_setzero_ps();
-    int i = 0;
-    for(i = 0; i <= (m - 8); i +=8)
-    {
-        ymm1 = _mm256_set_ps(ctf[i+7], ctf[i+6], ctf[i+5], ctf[i + 4], ctf[i+3], ctf[i+2], ctf[i+1], ctf[i]); //ctf[i]
-        ymm2 = _mm256_set_ps(dat[i+7].dat[0], dat[i+6].dat[0], dat[i+5].dat[0],dat[i + 4].dat[0], dat[i+3].dat[0], dat[i+2].dat[0], dat[i+1].dat[0],dat[i].dat[0]);//dat[i].dat[0]
-        ymm3 = _mm256_set_ps(dat[i+7].dat[1], dat[i+6].dat[1], dat[i+5].dat[1],dat[i + 4].dat[1], dat[i+3].dat[1], dat[i+2].dat[1], dat[i+1].dat[1],dat[i].dat[1]);//dat[i].dat[1]
-        ymm4 = _mm256_set_ps(pri[i+7].dat[0], pri[i+6].dat[0], pri[i+5].dat[0],pri[i + 4].dat[0], pri[i+3].dat[0], pri[i+2].dat[0], pri[i+1].dat[0],pri[i].dat[0]);//pri[i].dat[0]
-        ymm5 = _mm256_set_ps(pri[i+7].dat[1], pri[i+6].dat[1], pri[i+5].dat[1],pri[i + 4].dat[1], pri[i+3].dat[1], pri[i+2].dat[1], pri[i+1].dat[1],pri[i].dat[1]);//pri[i].dat[1]
-        
-        ymm4 = _mm256_mul_ps(ymm1, ymm4); //tmpReal
-        ymm5 = _mm256_mul_ps(ymm1, ymm5);//tmpImag
+        for (int l = 0; l < _para.k; l++)
+        {
+            IF_MASTER
+            {
+                Image ref(_para.size, _para.size, FT_SPACE);
 
-        ymm4 = _mm256_sub_ps(ymm2, ymm4);//tmp1Real
-        ymm5 = _mm256_sub_ps(ymm3, ymm5); //tmp1Imag
+                Image A(_para.size, _para.size, FT_SPACE);
+                Image B(_para.size, _para.size, FT_SPACE);
 
-        ymm4 = _mm256_mul_ps(ymm4, ymm4);
-        ymm5 = _mm256_mul_ps(ymm5, ymm5);
+                MLOG(INFO, "LOGGER_ROUND") << "Receiving Reference " << l << " from Hemisphere A";
 
-        ymm4 = _mm256_add_ps(ymm4, ymm5); //tmp2
-        ymm5 = _mm256_set_ps(sigRcp[i+7], sigRcp[i+6], sigRcp[i+5], sigRcp[i + 4], sigRcp[i+3], sigRcp[i+2], sigRcp[i+1], sigRcp[i]); //sigRcp
+                MPI_Recv_Large(&A[0],
+                               A.sizeFT(),
+                               TS_MPI_DOUBLE_COMPLEX,
+                               HEMI_A_LEAD,
+                               l,
+                               MPI_COMM_WORLD);
 
-        ymm4 = _mm256_mul_ps(ymm4, ymm5);//tmp3
-        ymm6 = _mm256_add_ps(ymm6, ymm4);//result2
+                MLOG(INFO, "LOGGER_ROUND") << "Receiving Reference " << l << " from Hemisphere B";
 
-    }
+                MPI_Recv_Large(&B[0],
+                               B.sizeFT(),
+                               TS_MPI_DOUBLE_COMPLEX,
+                               HEMI_B_LEAD,
+                               l,
+                               MPI_COMM_WORLD);
 
+                MLOG(INFO, "LOGGER_ROUND") << "Averaging Two Hemispheres";
+                FOR_EACH_PIXEL_FT(ref)
+                    ref[i] = (A[i] + B[i]) / 2;
 
-    float tmp[8] __attribute__((aligned(64)));
-    _mm256_store_ps(tmp, ymm6);
+                fft.bwMT(ref);
 
-    RFLOAT result = tmp[0] + tmp[1] + tmp[2] + tmp[3] + tmp[4] + tmp[5] + tmp[6] + tmp[7];
-    RFLOAT tmpReal = 0.0;
-    RFLOAT tmpImag = 0.0;
-    RFLOAT tmp1Real = 0.0;
-    RFLOAT tmp1Imag = 0.0;
-    RFLOAT tmp2;
-    RFLOAT tmp3;
+                softMask(ref,
+                         ref,
+                         _para.maskRadius / _para.pixelSize,
+                         EDGE_WIDTH_RL,
+                         0);
 
-    for (; i < m; i++)
-    {
-            
-        tmpReal = ctf[i] * pri[i].dat[0];
-        tmpImag = ctf[i] * pri[i].dat[1];
-        tmp1Real = dat[i].dat[0] - tmpReal;
-        tmp1Imag = dat[i].dat[1] - tmpImag;
+                imf.writeStack(ref, l);
+            }
+            else
+            {
+                if ((_commRank == HEMI_A_LEAD) ||
+                    (_commRank == HEMI_B_LEAD))
+                {
+                    ALOG(INFO, "LOGGER_ROUND") << "Sending Reference "
+                                                 << l
+                                                 << " from Hemisphere A";
 
-        tmp2 = tmp1Real * tmp1Real + tmp1Imag * tmp1Imag;
-        tmp3 = tmp2 * sigRcp[i];
+                    BLOG(INFO, "LOGGER_ROUND") << "Sending Reference "
+                                                 << l
+                                                 << " from Hemisphere B";
 
-        
-        result += tmp3;
+                    MPI_Ssend_Large(&_model.ref(l)[0],
+                                    _model.ref(l).sizeFT(),
+                                    TS_MPI_DOUBLE_COMPLEX,
+                                    MASTER_ID,
+                                    l,
+                                    MPI_COMM_WORLD);
+                }
+            }
+        }
 
+        IF_MASTER imf.closeStack();
     }
+    else if (_para.mode == MODE_3D)
+    {
+        for (int l = 0; l < _para.k; l++)
+        {
+            IF_MASTER
+            {
+                Volume ref(_para.size, _para.size, _para.size, FT_SPACE);
 
-    return result;
+                Volume A(_para.size, _para.size, _para.size, FT_SPACE);
+                Volume B(_para.size, _para.size, _para.size, FT_SPACE);
 
-}
-#else
-RFLOAT SIMD256Double(Complex* dat, const Complex* pri, const RFLOAT* ctf, const RFLOAT* sigRcp, const int m)
-{
+                MLOG(INFO, "LOGGER_ROUND") << "Receiving Reference " << l << " from Hemisphere A";
 
-    __m256d ymm1, ymm2, ymm3, ymm4, ymm5,ymm6;
-    ymm6 = _mm256_setzero_pd();
-    int i = 0;
-    for(i = 0; i <= (m - 4); i +=4)
-    {
-        ymm1 = _mm256_set_pd(ctf[i+3], ctf[i+2], ctf[i+1], ctf[i]); //ctf[i]
-        ymm2 = _mm256_set_pd(dat[i+3].dat[0], dat[i+2].dat[0], dat[i+1].dat[0],dat[i].dat[0]);//dat[i].dat[0]
-        ymm3 = _mm256_set_pd(dat[i+3].dat[1], dat[i+2].dat[1], dat[i+1].dat[1],dat[i].dat[1]);//dat[i].dat[1]
-        ymm4 = _mm256_set_pd(pri[i+3].dat[0], pri[i+2].dat[0], pri[i+1].dat[0],pri[i].dat[0]);//pri[i].dat[0]
-        ymm5 = _mm256_set_pd(pri[i+3].dat[1], pri[i+2].dat[1], pri[i+1].dat[1],pri[i].dat[1]);//pri[i].dat[1]
-        
-        
-        ymm4 = _mm256_mul_pd(ymm1, ymm4); //tmpReal
-        ymm5 = _mm256_mul_pd(ymm1, ymm5);//tmpImag
-                
-        ymm4 = _mm256_sub_pd(ymm2, ymm4);//tmp1Real
-        ymm5 = _mm256_sub_pd(ymm3, ymm5); //tmp1Imag
+                MPI_Recv_Large(&A[0],
+                               A.sizeFT(),
+                               TS_MPI_DOUBLE_COMPLEX,
+                               HEMI_A_LEAD,
+                               l,
+                               MPI_COMM_WORLD);
 
-        ymm4 = _mm256_mul_pd(ymm4, ymm4);
-        ymm5 = _mm256_mul_pd(ymm5, ymm5);
+                MLOG(INFO, "LOGGER_ROUND") << "Receiving Reference " << l << " from Hemisphere B";
 
-        ymm4 = _mm256_add_pd(ymm4, ymm5); //tmp2
+                MPI_Recv_Large(&B[0],
+                               B.sizeFT(),
+                               TS_MPI_DOUBLE_COMPLEX,
+                               HEMI_B_LEAD,
+                               l,
+                               MPI_COMM_WORLD);
 
-        ymm5 = _mm256_set_pd(sigRcp[i+3], sigRcp[i+2], sigRcp[i+1], sigRcp[i]); //sigRcp
+                MLOG(INFO, "LOGGER_ROUND") << "Averaging Two Hemispheres";
+                FOR_EACH_PIXEL_FT(ref)
+                    ref[i] = (A[i] + B[i]) / 2;
 
-        ymm4 = _mm256_mul_pd(ymm4, ymm5);//tmp3
+#ifdef OPTIMISER_MASTER_SAVE_MAP
+                if (!finished)
+                {
+                    // written while the other processes perform the next
+                    // expectation
 
-        ymm6 = _mm256_add_pd(ymm6, ymm4);//result2
+                    sprintf(filename, "%sReference_%03d_Round_%03d.mrc", _para.dstPrefix, l, _iter);
 
-    }
+                    writeMapQueue(ref.sizeFT() * sizeof(Complex));
 
+                    _mapQueue.push_back(boost::move(ref));
+                    _mapQueueName.push_back(filename);
+                    _mapQueueLowPass.push_back(-1);
 
-   double  tmp[4] __attribute__((aligned(64)));
-    _mm256_store_pd(tmp, ymm6);
+                    writeMapQueue(0);
 
-    RFLOAT result = tmp[0] + tmp[1] + tmp[2] + tmp[3];
+                    continue;
+                }
+#endif
 
-    RFLOAT tmpReal = 0.0;
-    RFLOAT tmpImag = 0.0;
-    RFLOAT tmp1Real = 0.0;
-    RFLOAT tmp1Imag = 0.0;
-    RFLOAT tmp2;
-    RFLOAT tmp3;
+                fft.bwMT(ref);
 
-    for (; i < m; i++)
-    {
-            
-        tmpReal = ctf[i] * pri[i].dat[0];
-        tmpImag = ctf[i] * pri[i].dat[1];
-        tmp1Real = dat[i].dat[0] - tmpReal;
-        tmp1Imag = dat[i].dat[1] - tmpImag;
+                if (finished)
+                    sprintf(filename, "%sReference_%03d_Final.mrc", _para.dstPrefix, l);
+                else
+                    sprintf(filename, "%sReference_%03d_Round_%03d.mrc", _para.dstPrefix, l, _iter);
 
-        tmp2 = tmp1Real * tmp1Real + tmp1Imag * tmp1Imag;
-        tmp3 = tmp2 * sigRcp[i];
+                imf.readMetaData(ref);
+                imf.writeVolume(filename, ref, _para.pixelSize);
+            }
+            else
+            {
+                if ((_commRank == HEMI_A_LEAD) ||
+                    (_commRank == HEMI_B_LEAD))
+                {
+                    ALOG(INFO, "LOGGER_ROUND") << "Sending Reference "
+                                                 << l
+                                                 << " from Hemisphere A";
 
-        
-        result += tmp3;
+                    BLOG(INFO, "LOGGER_ROUND") << "Sending Reference "
+                                                 << l
+                                                 << " from Hemisphere B";
 
+                    MPI_Ssend_Large(&_model.ref(l)[0],
+                                    _model.ref(l).sizeFT(),
+                                    TS_MPI_DOUBLE_COMPLEX,
+                                    MASTER_ID,
+                                    l,
+                                    MPI_COMM_WORLD);
+                }
+            }
+        }
     }
+    else
+    {
+        REPORT_ERROR("INEXISTENT MODE");
 
-    return result;
-
+        abort();
+    }
 }
-#endif
-#endif
 
-#ifdef ENABLE_SIMD_256
-RFLOAT logDataVSPrior_m_huabin_SIMD256(Complex* dat, const Complex* pri, const RFLOAT* ctf, const RFLOAT* sigRcp, const int m)
+static void* writeMaps(void* arg)
 {
+    MapWriter* writer = (MapWriter*)arg;
 
-#ifdef SINGLE_PRECISION
-    return SIMD256Float(dat, pri, ctf, sigRcp, m);
-#else
-    return SIMD256Double(dat, pri, ctf, sigRcp, m);
-#endif
-}
-#endif
+    FFT fft;
 
+    ImageFile imf;
 
+    for (size_t i = 0; i < writer->map.size(); i++)
+    {
+        CLOG(INFO, "LOGGER_ROUND") << "MASTER: Writing " << writer->name[i];
 
-/* *************************************************************************************************** */
+        Volume& ref = writer->map[i];
 
+        if (writer->lowPass[i] > 0)
+        {
+            Volume lowPass(ref.nColRL(), ref.nRowRL(), ref.nSlcRL(), FT_SPACE);
 
-#ifdef ENABLE_SIMD_512
-#ifdef SINGLE_PRECISION
-RFLOAT* SIMD512Float(Complex* dat, const Complex* pri, const RFLOAT* ctf, const RFLOAT* sigRcp, const int n, const int m, RFLOAT *SIMDResult)
-{
+            lowPassFilter(lowPass,
+                          ref,
+                          writer->lowPass[i],
+                          (RFLOAT)EDGE_WIDTH_FT / ref.nColRL());
 
-    //vec resultSIMDFloat = vec::Zero(n);
-    RFLOAT *resultSIMDFloat = SIMDResult;
-    //memset(resultSIMDFloat, '\0', _ID.size() * sizeof(RFLOAT));
-    __m512 ymm1, ymm2, ymm3, ymm4, ymm5,ymm6;
-    __m512 xmm4, xmm5;
-    int i = 0;
-    int j = 0;
-    int idx = 0;
-    RFLOAT  tmp[16] __attribute__((aligned(64)));
-    RFLOAT tmpReal  = 0.0;
-    RFLOAT tmpImag  = 0.0;
-    RFLOAT tmp1Real = 0.0;
-    RFLOAT tmp1Imag = 0.0;
-    RFLOAT tmp1     = 0.0;
-    RFLOAT tmp2     = 0.0;
-
-
-    for(i = 0; i < m; i ++)
-    {   
-            xmm4 = _mm512_set_ps(pri[i].dat[0], pri[i].dat[0], pri[i].dat[0],pri[i].dat[0], pri[i].dat[0], pri[i].dat[0], pri[i].dat[0],pri[i].dat[0],\
-                                 pri[i].dat[0], pri[i].dat[0], pri[i].dat[0],pri[i].dat[0], pri[i].dat[0], pri[i].dat[0], pri[i].dat[0],pri[i].dat[0]);//pri[i].dat[0]
-            xmm5 = _mm512_set_ps(pri[i].dat[1], pri[i].dat[1], pri[i].dat[1],pri[i].dat[1], pri[i].dat[1], pri[i].dat[1], pri[i].dat[1],pri[i].dat[1],\
-                                 pri[i].dat[1], pri[i].dat[1], pri[i].dat[1],pri[i].dat[1], pri[i].dat[1], pri[i].dat[1], pri[i].dat[1],pri[i].dat[1]);//pri[i].dat[1]
-
-        for(j = 0; j <= (n - 16); j += 16)
-        {
-            ymm6 = _mm512_setzero_ps();
-            idx = i * n + j;
-            ymm1 = _mm512_set_ps(ctf[idx+15], ctf[idx+14], ctf[idx+13], ctf[idx+12], ctf[idx+11], ctf[idx+10], ctf[idx+9], ctf[idx+8],\
-                                 ctf[idx+7],  ctf[idx+6],  ctf[idx+5],  ctf[idx+4],  ctf[idx+3],  ctf[idx+2],  ctf[idx+1], ctf[idx]); //ctf[idx]
-            ymm2 = _mm512_set_ps(dat[idx+15].dat[0], dat[idx+14].dat[0], dat[idx+13].dat[0],dat[idx+12].dat[0], dat[idx+11].dat[0], dat[idx+10].dat[0], dat[idx+9].dat[0],dat[idx+8].dat[0],\
-                                 dat[idx+7].dat[0], dat[idx+6].dat[0], dat[idx+5].dat[0],dat[idx+4].dat[0], dat[idx+3].dat[0], dat[idx+2].dat[0], dat[idx+1].dat[0],dat[idx].dat[0]);//dat[idx].dat[0]
-            ymm3 = _mm512_set_ps(dat[idx+15].dat[1], dat[idx+14].dat[1], dat[idx+13].dat[1],dat[idx+12].dat[1], dat[idx+11].dat[1], dat[idx+10].dat[1], dat[idx+9].dat[1],dat[idx+8].dat[1],\
-                                 dat[idx+7].dat[1], dat[idx+6].dat[1], dat[idx+5].dat[1],dat[idx+4].dat[1], dat[idx+3].dat[1], dat[idx+2].dat[1], dat[idx+1].dat[1],dat[idx].dat[1]);//dat[idx].dat[1]
-            //Following two lines seems can be moved to outter loop
-            //ymm4 = _mm512_set_ps(pri[i].dat[0], pri[i].dat[0], pri[i].dat[0],pri[i].dat[0], pri[i].dat[0], pri[i].dat[0], pri[i].dat[0],pri[i].dat[0], pri[i].dat[0], pri[i].dat[0], pri[i].dat[0],pri[i].dat[0], pri[i].dat[0], pri[i].dat[0], pri[i].dat[0],pri[i].dat[0]);//pri[i].dat[0]
-            //ymm5 = _mm512_set_ps(pri[i].dat[1], pri[i].dat[1], pri[i].dat[1],pri[i].dat[1], pri[i].dat[1], pri[i].dat[1], pri[i].dat[1],pri[i].dat[1],                     pri[i].dat[1], pri[i].dat[1], pri[i].dat[1],pri[i].dat[1], pri[i].dat[1], pri[i].dat[1], pri[i].dat[1],pri[i].dat[1]);//pri[i].dat[1]
-            
-            
-            ymm4 = _mm512_mul_ps(ymm1, xmm4); //tmpReal
-            ymm5 = _mm512_mul_ps(ymm1, xmm5);//tmpImag
-                    
-            ymm4 = _mm512_sub_ps(ymm2, ymm4);//tmp1Real
-            ymm5 = _mm512_sub_ps(ymm3, ymm5); //tmp1Imag
+            ref.swap(lowPass);
+        }
 
-            ymm4 = _mm512_mul_ps(ymm4, ymm4);
-            ymm5 = _mm512_mul_ps(ymm5, ymm5);
+        fft.bwMT(ref);
 
-            ymm4 = _mm512_add_ps(ymm4, ymm5); //tmp1
+        imf.readMetaData(ref);
+        imf.writeVolume(writer->name[i].c_str(), ref, writer->pixelSize);
 
-            ymm5 = _mm512_set_ps(sigRcp[idx+15], sigRcp[idx+14], sigRcp[idx+13], sigRcp[idx+12], sigRcp[idx+11], sigRcp[idx+10], sigRcp[idx+9], sigRcp[idx+8],\
-                                 sigRcp[idx+7],  sigRcp[idx+6],  sigRcp[idx+5],  sigRcp[idx+4],  sigRcp[idx+3],  sigRcp[idx+2],  sigRcp[idx+1], sigRcp[idx]); //sigRcp
+        // released as soon as written
 
-            ymm4 = _mm512_mul_ps(ymm4, ymm5);//tmp2
+        Volume().swap(ref);
+    }
 
-            ymm6 = _mm512_add_ps(ymm6, ymm4);//result2
+    __sync_lock_test_and_set(&writer->done, 1);
 
-            _mm512_store_ps(tmp, ymm6);
-            resultSIMDFloat[j]+= tmp[0];
-            resultSIMDFloat[j + 1] += tmp[1];
-            resultSIMDFloat[j + 2] += tmp[2];
-            resultSIMDFloat[j + 3] += tmp[3];
-            resultSIMDFloat[j + 4] += tmp[4];
-            resultSIMDFloat[j + 5] += tmp[5];
-            resultSIMDFloat[j + 6] += tmp[6];
-            resultSIMDFloat[j + 7] += tmp[7];
-            resultSIMDFloat[j + 8] += tmp[8];
-            resultSIMDFloat[j + 9] += tmp[9];
-            resultSIMDFloat[j + 10] += tmp[10];
-            resultSIMDFloat[j + 11] += tmp[11];
-            resultSIMDFloat[j + 12] += tmp[12];
-            resultSIMDFloat[j + 13] += tmp[13];
-            resultSIMDFloat[j + 14] += tmp[14];
-            resultSIMDFloat[j + 15] += tmp[15];
-        }
+    return NULL;
+}
 
-        //Process remainning value 
-        for(; j < n; j ++)
-        {
-            int idx       = i * n + j;
-            tmpReal  = ctf[idx] * pri[i].dat[0];
-            tmpImag  = ctf[idx] * pri[i].dat[1];
+static void* writeMapsThread(void* arg)
+{
+    // the thread runs alongside expectation, on a few threads of its own, as
+    // the number of threads set by thunder only applies to the main thread,
+    // the transforms are planned on as many threads
 
-            tmp1Real = dat[idx].dat[0] - tmpReal; //temp.real
-            tmp1Imag = dat[idx].dat[1] - tmpImag;//temp.imag
+    omp_set_num_threads(MAP_WRITER_N_THREAD);
 
-            tmp1          = tmp1Real * tmp1Real + tmp1Imag * tmp1Imag; //tmp1
-            tmp2          = tmp1 * sigRcp[idx];//temp2
-            resultSIMDFloat[j]    += tmp2;
+    writeMaps(arg);
 
-        }
-        
-    }
+    // the cache of this thread would otherwise be kept until the process exits
 
-    return resultSIMDFloat;
-}
+    arenaRelease();
 
-#else
+    return NULL;
+}
 
-RFLOAT* SIMD512Double(Complex* dat, const Complex* pri, const RFLOAT* ctf, const RFLOAT* sigRcp, const int n, const int m, RFLOAT *SIMDFloat)
+void Optimiser::writeMapQueue(const size_t bytes)
 {
+    NT_MASTER return;
 
-    //vec resultSIMDDouble = vec::Zero(n);
-    RFLOAT *resultSIMDDouble = SIMDFloat;
-    //memset(resultSIMDDouble, '\0', _ID.size() * sizeof(RFLOAT));
-    __m512d ymm1, ymm2, ymm3, ymm4, ymm5,ymm6;
-    __m512d xmm4, xmm5;
-    int i = 0;
-    int j = 0;
-    int idx = 0;
-    RFLOAT  tmp[8] __attribute__((aligned(64)));
-    RFLOAT tmpReal  = 0.0;
-    RFLOAT tmpImag  = 0.0;
-    RFLOAT tmp1Real = 0.0;
-    RFLOAT tmp1Imag = 0.0;
-    RFLOAT tmp1     = 0.0;
-    RFLOAT tmp2     = 0.0;
-
-
-    for(i = 0; i < m; i ++)
-    {   
-        xmm4 = _mm512_set_pd(pri[i].dat[0], pri[i].dat[0], pri[i].dat[0],pri[i].dat[0],pri[i].dat[0], pri[i].dat[0], pri[i].dat[0],pri[i].dat[0]);//pri[i].dat[0]
-        xmm5 = _mm512_set_pd(pri[i].dat[1], pri[i].dat[1], pri[i].dat[1],pri[i].dat[1], pri[i].dat[1], pri[i].dat[1], pri[i].dat[1],pri[i].dat[1]);//pri[i].dat[1]
-        for(j = 0; j <= (n - 8); j += 8)
-        {
-            ymm6 = _mm512_setzero_pd();
-            idx = i * n + j;
-            ymm1 = _mm512_set_pd(ctf[idx+7], ctf[idx+6], ctf[idx+5], ctf[idx+4],\
-                                 ctf[idx+3], ctf[idx+2], ctf[idx+1], ctf[idx]); //ctf[idx]
-            ymm2 = _mm512_set_pd(dat[idx+7].dat[0], dat[idx+6].dat[0], dat[idx+5].dat[0],dat[idx+4].dat[0],\
-                                 dat[idx+3].dat[0], dat[idx+2].dat[0], dat[idx+1].dat[0],dat[idx].dat[0]);//dat[idx].dat[0]
-            ymm3 = _mm512_set_pd(dat[idx+7].dat[1], dat[idx+6].dat[1], dat[idx+5].dat[1],dat[idx+4].dat[1],\
-                                 dat[idx+3].dat[1], dat[idx+2].dat[1], dat[idx+1].dat[1],dat[idx].dat[1]);//dat[idx].dat[1]
-            //ymm4 = _mm512_set_pd(pri[i].dat[0], pri[i].dat[0], pri[i].dat[0],pri[i].dat[0], pri[i].dat[0], pri[i].dat[0], pri[i].dat[0],pri[i].dat[0]);//pri[i].dat[0]
-            //ymm5 = _mm512_set_pd(pri[i].dat[1], pri[i].dat[1], pri[i].dat[1],pri[i].dat[1], pri[i].dat[1], pri[i].dat[1], pri[i].dat[1],pri[i].dat[1]);//pri[i].dat[1]
-            
-            
-            ymm4 = _mm512_mul_pd(ymm1, xmm4); //tmpReal
-            ymm5 = _mm512_mul_pd(ymm1, xmm5);//tmpImag
-                    
-            ymm4 = _mm512_sub_pd(ymm2, ymm4);//tmp1Real
-            ymm5 = _mm512_sub_pd(ymm3, ymm5); //tmp1Imag
+    if (_mapWriter.pending)
+    {
+        size_t held = 0;
 
-            ymm4 = _mm512_mul_pd(ymm4, ymm4);
-            ymm5 = _mm512_mul_pd(ymm5, ymm5);
+        for (size_t i = 0; i < _mapQueue.size(); i++)
+            held += _mapQueue[i].sizeFT() * sizeof(Complex);
 
-            ymm4 = _mm512_add_pd(ymm4, ymm5); //tmp1
+        for (size_t i = 0; i < _mapWriter.map.size(); i++)
+            held += _mapWriter.map[i].sizeFT() * sizeof(Complex);
 
-            ymm5 = _mm512_set_pd(sigRcp[idx+7], sigRcp[idx+6], sigRcp[idx+5], sigRcp[idx+4],\
-                                 sigRcp[idx+3], sigRcp[idx+2], sigRcp[idx+1], sigRcp[idx]); //sigRcp
+        if (__sync_fetch_and_add(&_mapWriter.done, 0) ||
+            (held + bytes > MAP_QUEUE_MEMORY))
+            joinMapWriter();
+    }
 
-            ymm4 = _mm512_mul_pd(ymm4, ymm5);//tmp2
+    if (_mapWriter.pending || _mapQueue.empty()) return;
 
-            ymm6 = _mm512_add_pd(ymm6, ymm4);//result2
+    _mapWriter.map.swap(_mapQueue);
+    _mapWriter.name.swap(_mapQueueName);
+    _mapWriter.lowPass.swap(_mapQueueLowPass);
 
-            _mm512_store_pd(tmp, ymm6);
-            resultSIMDDouble[j]     += tmp[0];
-            resultSIMDDouble[j + 1] += tmp[1];
-            resultSIMDDouble[j + 2] += tmp[2];
-            resultSIMDDouble[j + 3] += tmp[3];
-            resultSIMDDouble[j + 4] += tmp[4];
-            resultSIMDDouble[j + 5] += tmp[5];
-            resultSIMDDouble[j + 6] += tmp[6];
-            resultSIMDDouble[j + 7] += tmp[7];
-        }
+    _mapWriter.pixelSize = _para.pixelSize;
 
-        //Process remainning value 
-        for(; j < n; j ++)
-        {
-            int idx       = i * n + j;
-            tmpReal  = ctf[idx] * pri[i].dat[0];
-            tmpImag  = ctf[idx] * pri[i].dat[1];
+    _mapWriter.done = 0;
 
-            tmp1Real = dat[idx].dat[0] - tmpReal; //temp.real
-            tmp1Imag = dat[idx].dat[1] - tmpImag;//temp.imag
+    _mapWriter.pending = (pthread_create(&_mapWriter.thread, NULL, writeMapsThread, &_mapWriter) == 0);
 
-            tmp1          = tmp1Real * tmp1Real + tmp1Imag * tmp1Imag; //tmp1
-            tmp2          = tmp1 * sigRcp[idx];//temp2
-            resultSIMDDouble[j]    += tmp2;//resultFoo
+    if (!_mapWriter.pending)
+    {
+        writeMaps(&_mapWriter);
 
-        }
-        
+        _mapWriter.map.clear();
+        _mapWriter.name.clear();
+        _mapWriter.lowPass.clear();
     }
-
-    return resultSIMDDouble;
 }
 
-#endif
-#endif
+void Optimiser::joinMapWriter()
+{
+    if (!_mapWriter.pending) return;
 
+    pthread_join(_mapWriter.thread, NULL);
 
-#ifdef ENABLE_SIMD_512
-RFLOAT* logDataVSPrior_m_n_huabin_SIMD512(Complex* dat, const Complex* pri, const RFLOAT* ctf, const RFLOAT* sigRcp, const int n, const int m, RFLOAT *SIMDResult)
+    _mapWriter.pending = false;
 
-{
-#ifdef SINGLE_PRECISION
-    return SIMD512Float(dat, pri, ctf, sigRcp, n, m, SIMDResult);
-#else
-    return SIMD512Double(dat, pri, ctf, sigRcp, n, m, SIMDResult);
-#endif
+    _mapWriter.map.clear();
+    _mapWriter.name.clear();
+    _mapWriter.lowPass.clear();
 }
-#endif
-
 
-#ifdef ENABLE_SIMD_512
-#ifdef SINGLE_PRECISION
-RFLOAT SIMD512Float(Complex* dat, const Complex* pri, const RFLOAT* ctf, const RFLOAT* sigRcp, const int m)
+void Optimiser::flushMapQueue()
 {
+    NT_MASTER return;
 
-    __m512 ymm1, ymm2, ymm3, ymm4, ymm5,ymm6;
-    ymm6 = _mm512_setzero_ps();
-    int i = 0;
-    for(i = 0; i <= (m - 16); i +=16)
+    while (_mapWriter.pending || !_mapQueue.empty())
     {
-        ymm1 = _mm512_set_ps(ctf[i+15], ctf[i+14], ctf[i+13], ctf[i+12], ctf[i+11], ctf[i+10], ctf[i+9], ctf[i+8],ctf[i+7], ctf[i+6], ctf[i+5], ctf[i+4], ctf[i+3], ctf[i+2], ctf[i+1], ctf[i]); //ctf[i]
-
-        ymm2 = _mm512_set_ps(dat[i+15].dat[0], dat[i+14].dat[0], dat[i+13].dat[0],dat[i+12].dat[0], dat[i+11].dat[0], dat[i+10].dat[0], dat[i+9].dat[0],dat[i+8].dat[0],\
-                             dat[i+7].dat[0],  dat[i+6].dat[0],  dat[i+5].dat[0], dat[i+4].dat[0],  dat[i +3].dat[0], dat[i +2].dat[0], dat[i+1].dat[0],dat[i].dat[0]);//dat[i].dat[0]
+        writeMapQueue(0);
 
-        ymm3 = _mm512_set_ps(dat[i+15].dat[1], dat[i+14].dat[1], dat[i+13].dat[1],dat[i+12].dat[1], dat[i+11].dat[1], dat[i+10].dat[1], dat[i+9].dat[1],dat[i+8].dat[1],\
-                             dat[i+7].dat[1],  dat[i+6].dat[1],  dat[i+5].dat[1], dat[i+4].dat[1],  dat[i+3].dat[1],  dat[i+2].dat[1],  dat[i+1].dat[1],dat[i].dat[1]);//dat[i].dat[1]
-        
-        ymm4 = _mm512_set_ps(pri[i+15].dat[0], pri[i+14].dat[0], pri[i+13].dat[0],pri[i+12].dat[0], pri[i+11].dat[0], pri[i+10].dat[0], pri[i+9].dat[0],pri[i+8].dat[0],\
-                             pri[i+7].dat[0],  pri[i+6].dat[0],  pri[i+5].dat[0], pri[i+4].dat[0],  pri[i+3].dat[0],  pri[i+2].dat[0],  pri[i+1].dat[0],pri[i].dat[0]);//pri[i].dat[0]
-        
-        ymm5 = _mm512_set_ps(pri[i+15].dat[1], pri[i+14].dat[1], pri[i+13].dat[1],pri[i+12].dat[1], pri[i+11].dat[1], pri[i+10].dat[1], pri[i+9].dat[1],pri[i+8].dat[1],\
-                             pri[i+7].dat[1],  pri[i+6].dat[1],  pri[i+5].dat[1], pri[i+4].dat[1],  pri[i+3].dat[1],  pri[i+2].dat[1],  pri[i+1].dat[1],pri[i].dat[1]);//pri[i].dat[1]
-        
-        ymm4 = _mm512_mul_ps(ymm1, ymm4); //tmpReal
-        ymm5 = _mm512_mul_ps(ymm1, ymm5);//tmpImag
+        joinMapWriter();
+    }
+}
 
-        ymm4 = _mm512_sub_ps(ymm2, ymm4);//tmp1Real
-        ymm5 = _mm512_sub_ps(ymm3, ymm5); //tmp1Imag
+void Optimiser::saveFSC(const bool finished) const
+{
+    NT_MASTER return;
 
-        ymm4 = _mm512_mul_ps(ymm4, ymm4);
-        ymm5 = _mm512_mul_ps(ymm5, ymm5);
+    char filename[FILE_NAME_LENGTH];
 
-        ymm4 = _mm512_add_ps(ymm4, ymm5); //tmp2
-        ymm5 = _mm512_set_ps(sigRcp[i+15], sigRcp[i+14], sigRcp[i+13], sigRcp[i+12], sigRcp[i+11], sigRcp[i+10], sigRcp[i+9], sigRcp[i+8],\
-                             sigRcp[i+7],  sigRcp[i+6],  sigRcp[i+5],  sigRcp[i + 4], sigRcp[i+3], sigRcp[i+2], sigRcp[i+1], sigRcp[i]); //sigRcp
+    if (finished)
+        sprintf(filename, "%sFSC_Final.txt", _para.dstPrefix);
+    else
+        sprintf(filename, "%sFSC_Round_%03d.txt", _para.dstPrefix, _iter);
 
-        ymm4 = _mm512_mul_ps(ymm4, ymm5);//tmp3
-        ymm6 = _mm512_add_ps(ymm6, ymm4);//result2
+    FILE* file = fopen(filename, "w");
 
+    for (int i = 1; i < _model.rU(); i++)
+    {
+        fprintf(file,
+                "%05d   %10.6lf",
+                i,
+                1.0 / resP2A(i, _para.size, _para.pixelSize));
+        for (int t = 0; t < _para.k; t++)
+            fprintf(file,
+                    "   %10.6lf",
+                    (_model.fsc(t))(i));
+        fprintf(file, "\n");
     }
+    
+    fclose(file);
+}
 
+void Optimiser::saveClassInfo(const bool finished) const
+{
+    NT_MASTER return;
 
-    float tmp[16] __attribute__((aligned(64)));
-    _mm512_store_ps(tmp, ymm6);
-
-    RFLOAT result = tmp[0] + tmp[1] + tmp[2] + tmp[3] + tmp[4] + tmp[5] + tmp[6] + tmp[7] + \
-                    tmp[8] + tmp[9] + tmp[10] + tmp[11] + tmp[12] + tmp[13] + tmp[14] + tmp[15];
-    RFLOAT tmpReal = 0.0;
-    RFLOAT tmpImag = 0.0;
-    RFLOAT tmp1Real = 0.0;
-    RFLOAT tmp1Imag = 0.0;
-    RFLOAT tmp2;
-    RFLOAT tmp3;
-
-    for (; i < m; i++)
-    {
-            
-        tmpReal = ctf[i] * pri[i].dat[0];
-        tmpImag = ctf[i] * pri[i].dat[1];
-        tmp1Real = dat[i].dat[0] - tmpReal;
-        tmp1Imag = dat[i].dat[1] - tmpImag;
+    char filename[FILE_NAME_LENGTH];
 
-        tmp2 = tmp1Real * tmp1Real + tmp1Imag * tmp1Imag;
-        tmp3 = tmp2 * sigRcp[i];
+    if (finished)
+        sprintf(filename, "%sClass_Info_Final.txt", _para.dstPrefix);
+    else
+        sprintf(filename, "%sClass_Info_Round_%03d.txt", _para.dstPrefix, _iter);
 
-        
-        result += tmp3;
+    FILE* file = fopen(filename, "w");
 
+    for (int t = 0; t < _para.k; t++)
+    {
+        fprintf(file,
+                "%05d   %10.6lf   %10.6lf\n",
+                t,
+                1.0 / _model.resolutionA(t, _para.thresReportFSC),
+                _cDistr(t));
     }
 
-    return result;
-
+    fclose(file);
 }
 
-#else
-RFLOAT SIMD512Double(Complex* dat, const Complex* pri, const RFLOAT* ctf, const RFLOAT* sigRcp, const int m)
+void Optimiser::saveSig() const
 {
+    if ((_commRank != HEMI_A_LEAD) &&
+        (_commRank != HEMI_B_LEAD))
+        return;
 
-    __m512d ymm1, ymm2, ymm3, ymm4, ymm5,ymm6;
-    ymm6 = _mm512_setzero_pd();
-    int i = 0;
-    for(i = 0; i <= (m - 8); i +=8)
-    {
-        ymm1 = _mm512_set_pd(ctf[i+7], ctf[i+6], ctf[i+5], ctf[i + 4], ctf[i+3], ctf[i+2], ctf[i+1], ctf[i]); //ctf[i]
-        ymm2 = _mm512_set_pd(dat[i+7].dat[0], dat[i+6].dat[0], dat[i+5].dat[0],dat[i + 4].dat[0],dat[i+3].dat[0], dat[i+2].dat[0], dat[i+1].dat[0],dat[i].dat[0]);//dat[i].dat[0]
-        ymm3 = _mm512_set_pd(dat[i+7].dat[1], dat[i+6].dat[1], dat[i+5].dat[1],dat[i + 4].dat[1],dat[i+3].dat[1], dat[i+2].dat[1], dat[i+1].dat[1],dat[i].dat[1]);//dat[i].dat[1]
-        ymm4 = _mm512_set_pd(pri[i+7].dat[0], pri[i+6].dat[0], pri[i+5].dat[0],pri[i + 4].dat[0],pri[i+3].dat[0], pri[i+2].dat[0], pri[i+1].dat[0],pri[i].dat[0]);//pri[i].dat[0]
-        ymm5 = _mm512_set_pd(pri[i+7].dat[1], pri[i+6].dat[1], pri[i+5].dat[1],pri[i + 4].dat[1],pri[i+3].dat[1], pri[i+2].dat[1], pri[i+1].dat[1],pri[i].dat[1]);//pri[i].dat[1]
-        
-        
-        ymm4 = _mm512_mul_pd(ymm1, ymm4); //tmpReal
-        ymm5 = _mm512_mul_pd(ymm1, ymm5);//tmpImag
-                
-        ymm4 = _mm512_sub_pd(ymm2, ymm4);//tmp1Real
-        ymm5 = _mm512_sub_pd(ymm3, ymm5); //tmp1Imag
+    char filename[FILE_NAME_LENGTH];
 
-        ymm4 = _mm512_mul_pd(ymm4, ymm4);
-        ymm5 = _mm512_mul_pd(ymm5, ymm5);
+    if (_commRank == HEMI_A_LEAD)
+        sprintf(filename, "%sSig_A_Round_%03d.txt", _para.dstPrefix, _iter);
+    else
+        sprintf(filename, "%sSig_B_Round_%03d.txt", _para.dstPrefix, _iter);
 
-        ymm4 = _mm512_add_pd(ymm4, ymm5); //tmp2
+    FILE* file = fopen(filename, "w");
 
-        ymm5 = _mm512_set_pd(sigRcp[i+7], sigRcp[i+6], sigRcp[i+5], sigRcp[i+4], sigRcp[i+3], sigRcp[i+2], sigRcp[i+1], sigRcp[i]); //sigRcp
+    for (int i = 0; i < maxR(); i++)
+        fprintf(file,
+                "%05d   %10.6lf   %10.6lf\n",
+                i,
+                1.0 / resP2A(i, _para.size, _para.pixelSize),
+                _sig(_groupID[0] - 1, i));
 
-        ymm4 = _mm512_mul_pd(ymm4, ymm5);//tmp3
+    fclose(file);
 
-        ymm6 = _mm512_add_pd(ymm6, ymm4);//result2
+    if (_commRank == HEMI_A_LEAD)
+        sprintf(filename, "%sSVD_A_Round_%03d.txt", _para.dstPrefix, _iter);
+    else
+        sprintf(filename, "%sSVD_B_Round_%03d.txt", _para.dstPrefix, _iter);
 
-    }
+    file = fopen(filename, "w");
 
+    for (int i = 0; i < maxR(); i++)
+        fprintf(file,
+                "%05d   %10.6lf   %10.6lf\n",
+                i,
+                1.0 / resP2A(i, _para.size, _para.pixelSize),
+                _svd(_groupID[0] - 1, i));
 
-   double  tmp[8] __attribute__((aligned(64)));
-    _mm512_store_pd(tmp, ymm6);
+    fclose(file);
+}
 
-    RFLOAT result = tmp[0] + tmp[1] + tmp[2] + tmp[3] + tmp[4] + tmp[5] + tmp[6] + tmp[7];
+void Optimiser::saveTau() const
+{
+    if ((_commRank != HEMI_A_LEAD) &&
+        (_commRank != HEMI_B_LEAD))
+        return;
 
-    RFLOAT tmpReal = 0.0;
-    RFLOAT tmpImag = 0.0;
-    RFLOAT tmp1Real = 0.0;
-    RFLOAT tmp1Imag = 0.0;
-    RFLOAT tmp2;
-    RFLOAT tmp3;
+    char filename[FILE_NAME_LENGTH];
 
-    for (; i < m; i++)
-    {
-            
-        tmpReal = ctf[i] * pri[i].dat[0];
-        tmpImag = ctf[i] * pri[i].dat[1];
-        tmp1Real = dat[i].dat[0] - tmpReal;
-        tmp1Imag = dat[i].dat[1] - tmpImag;
+    if (_commRank == HEMI_A_LEAD)
+        sprintf(filename, "%sTau_A_Round_%03d.txt", _para.dstPrefix, _iter);
+    else if (_commRank == HEMI_B_LEAD)
+        sprintf(filename, "%sTau_B_Round_%03d.txt", _para.dstPrefix, _iter);
 
-        tmp2 = tmp1Real * tmp1Real + tmp1Imag * tmp1Imag;
-        tmp3 = tmp2 * sigRcp[i];
+    FILE* file = fopen(filename, "w");
 
-        
-        result += tmp3;
+    for (int i = 1; i < maxR() * _para.pf - 1; i++)
+        fprintf(file,
+                "%05d   %10.6lf   %10.6lf\n",
+                i,
+                1.0 / resP2A(i, _para.size * _para.pf, _para.pixelSize),
+                _model.tau(0)(i));
 
-    }
+    fclose(file);
+}
 
-    return result;
+RFLOAT* logDataVSPrior_m_n_seg(const Complex* dat,
+                               const Complex* pri,
+                               const RFLOAT* ctf,
+                               const RFLOAT* sigRcp,
+                               const int n,
+                               const int m,
+                               const int nCTF,
+                               const int nSig,
+                               const int nSeg,
+                               const int* seg,
+                               const int* segCTF,
+                               const int* segSig,
+                               RFLOAT* result)
+{
+    return kernel().logDataVSPrior_m_n_seg(dat, pri, ctf, sigRcp, n, m, nCTF, nSig, nSeg, seg, segCTF, segSig, result);
+}
 
+RFLOAT* logDataVSPrior_m_n_seg(const ComplexBF16* dat,
+                               const Complex* pri,
+                               const RFLOAT* ctf,
+                               const RFLOAT* sigRcp,
+                               const int n,
+                               const int m,
+                               const int nCTF,
+                               const int nSig,
+                               const int nSeg,
+                               const int* seg,
+                               const int* segCTF,
+                               const int* segSig,
+                               RFLOAT* result)
+{
+    return kernel().logDataVSPrior_m_n_seg_BF16(dat, pri, ctf, sigRcp, n, m, nCTF, nSig, nSeg, seg, segCTF, segSig, result);
 }
 
-#endif
-#endif
+RFLOAT* logDataVSPrior_m_n_huabin_BF16(const ComplexBF16* dat,
+                                       const Complex* pri,
+                                       const bf16* ctf,
+                                       const bf16* sigRcp,
+                                       const int n,
+                                       const int m,
+                                       RFLOAT* result)
+{
+    return kernel().logDataVSPrior_m_n_BF16(dat, pri, ctf, sigRcp, n, m, result);
+}
 
-#ifdef ENABLE_SIMD_512
-RFLOAT logDataVSPrior_m_huabin_SIMD512(Complex* dat, const Complex* pri, const RFLOAT* ctf, const RFLOAT* sigRcp, const int m)
+void logDataVSPriorTrans(RFLOAT* dst,
+                         Complex* buf,
+                         TSFFTW_PLAN plan,
+                         const Complex* dat,
+                         const Complex* pri,
+                         const RFLOAT* ctf,
+                         const RFLOAT* sigRcp,
+                         const int sDat,
+                         const int sCTF,
+                         const int sSig,
+                         const int nCol,
+                         const int nRow,
+                         const int* iCol,
+                         const int* iRow,
+                         const int m)
 {
+    int nColFT = nCol / 2 + 1;
 
-    #ifdef SINGLE_PRECISION
-        return SIMD512Float(dat, pri, ctf, sigRcp, m);
-    #else
-        return SIMD512Double(dat, pri, ctf, sigRcp, m);
-    #endif
-}
-#endif
+    memset(buf, '\0', (size_t)nRow * nColFT * sizeof(Complex));
 
-/* **************************************************************************************************** */
+    // the terms independent of the translation
 
-/**
- *  This function is add by huabin
- */
-RFLOAT* logDataVSPrior_m_n_huabin(const Complex* dat, const Complex* pri, const RFLOAT* ctf, const RFLOAT* sigRcp, const int n, const int m, RFLOAT *result)
-{
+    RFLOAT base = 0;
+
+    for (int i = 0; i < m; i++)
+    {
+        Complex x = dat[(size_t)i * sDat];
+        Complex p = pri[i];
 
+        RFLOAT c = ctf[(size_t)i * sCTF];
+        RFLOAT s = sigRcp[(size_t)i * sSig];
 
-    //vec result2 = vec::Zero(n);
-    RFLOAT *result2 = result;
-    //memset(result2, '\0', _ID.size() * sizeof(RFLOAT));
+        base += (ABS2(x) + c * c * ABS2(p)) * s;
 
-//Change by huabin doubleToRFLOAT
-    RFLOAT tmpCPMulReal  = 0.0;
-//Change by huabin doubleToRFLOAT
-    RFLOAT tmpCPMulImag  = 0.0;
-//Change by huabin doubleToRFLOAT
-    RFLOAT tmpDSubCPReal = 0.0;
-//Change by huabin doubleToRFLOAT
-    RFLOAT tmpDSubCPImag = 0.0;
-//Change by huabin doubleToRFLOAT
-    RFLOAT tmp1          = 0.0;
-//Change by huabin doubleToRFLOAT
-    //RFLOAT tmp2          = 0.0;
+        Complex a = x * CONJUGATE(p) * (c * s);
 
+        int j = iRow[i];
 
-    for(int i = 0; i < m; i ++)
-    {
-        for(int j = 0; j < n; j++)
-        {
-            int idx = i * n + j;
+        buf[(j >= 0 ? j : j + nRow) * nColFT + iCol[i]] += a;
 
-            tmpCPMulReal  = ctf[idx] * pri[i].dat[0];
-            tmpCPMulImag  = ctf[idx] * pri[i].dat[1];
+        // the complex to real transform takes twice the real part of the sum
+        // over the stored half, except for the columns of frequency 0 and
+        // Nyquist, which are summed over the full column, thus the conjugate is
+        // added to the mirror to make it so
 
-            tmpDSubCPReal = dat[idx].dat[0] - tmpCPMulReal; //temp.real
-            tmpDSubCPImag = dat[idx].dat[1] - tmpCPMulImag;//temp.imag
+        if ((iCol[i] == 0) || (2 * iCol[i] == nCol))
+        {
+            j = -j;
 
-            tmp1          = tmpDSubCPReal * tmpDSubCPReal + tmpDSubCPImag * tmpDSubCPImag; //tmp1
-            result2[j]    += (tmp1 * sigRcp[idx]);//temp2
-            //tmp2          = tmp1 * sigRcp[idx];//temp2
-            //result2(j)    += tmp2;//result2
+            buf[(j >= 0 ? j : j + nRow) * nColFT + iCol[i]] += CONJUGATE(a);
         }
     }
-    
-    return result2;
+
+    TSFFTW_execute_dft_c2r(plan, (TSFFTW_COMPLEX*)buf, dst);
+
+    // the phase image of translate() is conjugated in the cross term, the
+    // same sign as the inverse transform
+
+    for (size_t i = 0; i < (size_t)nCol * nRow; i++)
+        dst[i] = base - dst[i];
 }
 
 RFLOAT logDataVSPrior(const Image& dat,
@@ -9658,12 +11972,17 @@ RFLOAT logDataVSPrior(const Complex* dat,
 {
     RFLOAT result = 0;
 
+    RFLOAT amp = TS_SQRT(TSGSL_pow_2(w1) + TSGSL_pow_2(w2));
+    RFLOAT phi = atan2(w1, w2);
+
     for (int i = 0; i < m; i++)
     {
         RFLOAT ki = K1 * defocus[i] * df * TSGSL_pow_2(frequency[i])
                   + K2 * TSGSL_pow_4(frequency[i]);
 
-        RFLOAT ctf = -w1 * sin(ki) + w2 * cos(ki);
+        // -w1 * sin(ki) + w2 * cos(ki)
+
+        RFLOAT ctf = amp * CTFFastCos(ki + phi);
 
         result += ABS2(dat[i] - ctf * pri[i])
                 * sigRcp[i];
@@ -9673,6 +11992,27 @@ RFLOAT logDataVSPrior(const Complex* dat,
     return result;
 }
 
+RFLOAT logDataVSPrior(const Complex* dat,
+                      const Complex* pri,
+                      const RFLOAT* dfTerm,
+                      const RFLOAT* cTerm,
+                      const RFLOAT df,
+                      const RFLOAT* sigRcp,
+                      const int m)
+{
+    RFLOAT result = 0;
+
+    for (int i = 0; i < m; i++)
+    {
+        RFLOAT ctf = CTFFastCos(df * dfTerm[i] + cTerm[i]);
+
+        result += ABS2(dat[i] - ctf * pri[i])
+                * sigRcp[i];
+    }
+
+    return result;
+}
+
 RFLOAT logDataVSPrior(const Image& dat,
                       const Image& pri,
                       const Image& tra,
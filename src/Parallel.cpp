@@ -10,7 +10,10 @@
 
 #include <exception>
 
-Parallel::Parallel() {}
+Parallel::Parallel() : _hemi(MPI_COMM_NULL),
+                       _slav(MPI_COMM_NULL),
+                       _node(MPI_COMM_NULL),
+                       _lead(MPI_COMM_NULL) {}
 
 Parallel::~Parallel() {}
 
@@ -56,6 +59,31 @@ void Parallel::setMPIEnv()
 
     if (S != MPI_COMM_NULL) { _slav = S; };
 
+    _node = MPI_COMM_NULL;
+    _lead = MPI_COMM_NULL;
+
+#ifdef PARALLEL_NODE_SHARED
+    if (_hemi != MPI_COMM_NULL)
+    {
+        int hemiRank;
+        MPI_Comm_rank(_hemi, &hemiRank);
+
+        MPI_Comm_split_type(_hemi,
+                            MPI_COMM_TYPE_SHARED,
+                            hemiRank,
+                            MPI_INFO_NULL,
+                            &_node);
+
+        int nodeRank;
+        MPI_Comm_rank(_node, &nodeRank);
+
+        MPI_Comm_split(_hemi,
+                       (nodeRank == 0) ? 0 : MPI_UNDEFINED,
+                       hemiRank,
+                       &_lead);
+    }
+#endif
+
     MPI_Group_free(&wGroup);
     MPI_Group_free(&aGroup);
     MPI_Group_free(&bGroup);
@@ -69,12 +97,16 @@ void Parallel::setMPIEnv()
 void Parallel::setMPIEnv(const int commSize,
                          const int commRank,
                          const MPI_Comm& hemi,
-                         const MPI_Comm& slav)
+                         const MPI_Comm& slav,
+                         const MPI_Comm& node,
+                         const MPI_Comm& lead)
 {
     setCommSize(commSize);
     setCommRank(commRank);
     setHemi(hemi);
     setSlav(slav);
+    setNode(node);
+    setLead(lead);
 }
 
 bool Parallel::isMaster() const
@@ -136,6 +168,26 @@ void Parallel::setSlav(const MPI_Comm& slav)
     _slav = slav;
 }
 
+MPI_Comm Parallel::node() const
+{
+    return _node;
+}
+
+void Parallel::setNode(const MPI_Comm& node)
+{
+    _node = node;
+}
+
+MPI_Comm Parallel::lead() const
+{
+    return _lead;
+}
+
+void Parallel::setLead(const MPI_Comm& lead)
+{
+    _lead = lead;
+}
+
 void display(const Parallel& parallel)
 {
     if (parallel.isMaster())
@@ -345,3 +397,93 @@ void MPI_Allreduce_Large(void* buf,
         ptr += MPI_MAX_BUF;
     }
 }
+
+void MPI_Allreduce_Node(void* buf,
+                        size_t count,
+                        MPI_Datatype datatype,
+                        MPI_Op op,
+                        MPI_Comm comm,
+                        MPI_Comm node,
+                        MPI_Comm lead)
+{
+    if (node == MPI_COMM_NULL)
+    {
+        MPI_Allreduce_Large(buf, count, datatype, op, comm);
+
+        return;
+    }
+
+    int nodeRank;
+    MPI_Comm_rank(node, &nodeRank);
+
+    int dataTypeSize;
+    MPI_Type_size(datatype, &dataTypeSize);
+
+    int nBlock = (count - 1) / (MPI_MAX_BUF / dataTypeSize) + 1;
+
+    char* ptr = static_cast<char*>(buf);
+
+    // reduce within the node, through shared memory
+
+    for (int i = 0; i < nBlock; i++)
+    {
+        int blockSize = (i != nBlock - 1)
+                      ? (MPI_MAX_BUF / dataTypeSize)
+                      : count - (size_t)(MPI_MAX_BUF / dataTypeSize)
+                              * (nBlock - 1);
+
+        MPI_Reduce((nodeRank == 0) ? MPI_IN_PLACE : ptr,
+                   ptr,
+                   blockSize,
+                   datatype,
+                   op,
+                   0,
+                   node);
+
+        ptr += MPI_MAX_BUF;
+    }
+
+    // among the leaders, across the network
+
+    if (lead != MPI_COMM_NULL)
+        MPI_Allreduce_Large(buf, count, datatype, op, lead);
+
+    MPI_Bcast_Large(buf, count, datatype, 0, node);
+}
+
+void* MPI_Alloc_Shared(MPI_Win& win,
+                       size_t size,
+                       MPI_Comm node)
+{
+    int nodeRank;
+    MPI_Comm_rank(node, &nodeRank);
+
+    // the segment of each process is placed on its own NUMA node, only the one
+    // of rank 0 is used
+
+    MPI_Info info;
+    MPI_Info_create(&info);
+    MPI_Info_set(info, "alloc_shared_noncontig", "true");
+
+    void* ptr;
+
+    if (MPI_Win_allocate_shared((nodeRank == 0) ? size : 0,
+                                1,
+                                info,
+                                node,
+                                &ptr,
+                                &win) != MPI_SUCCESS)
+    {
+        REPORT_ERROR("FAIL TO ALLOCATE SHARED MEMORY");
+        abort();
+    }
+
+    MPI_Info_free(&info);
+
+    MPI_Aint sizeQuery;
+    int dispUnit;
+
+    MPI_Win_shared_query(win, 0, &sizeQuery, &dispUnit, &ptr);
+
+    return ptr;
+}
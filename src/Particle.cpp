@@ -1045,9 +1045,25 @@ void Particle::calVari(const ParticleType pt)
             ***/
 
 
+            // warm start from the estimate of the previous phase, of which the
+            // mean is close to the top quaternion
+
+            dmat44 prev = dmat44::Zero();
+
+            prev.diagonal() << 1, _k1, _k2, _k3;
+
 #ifdef PARTICLE_ROT_MEAN_USING_STAT_CAL_VARI
 
-            inferACG(mean, _r);
+            dmat44 rot;
+
+            for (int i = 0; i < 4; i++)
+            {
+                quaternion_mul(quat, _topR, dvec4::Unit(i));
+
+                rot.col(i) = quat;
+            }
+
+            inferACG(mean, _r, rot * prev * rot.transpose());
 
             for (int i = 0; i < _nR; i++)
             {
@@ -1060,7 +1076,7 @@ void Particle::calVari(const ParticleType pt)
 
 #endif
 
-            inferACG(_k1, _k2, _k3, _r);
+            inferACG(_k1, _k2, _k3, _r, prev);
 
 #ifdef PARTICLE_ROT_MEAN_USING_STAT_CAL_VARI
 
@@ -1139,22 +1155,9 @@ void Particle::perturb(const double pf,
     }
     else if (pt == PAR_R)
     {
-        dmat4 d(_nR, 4);
-
         if (_mode == MODE_2D)
         {
-            sampleVMS(d, dvec4(1, 0, 0, 0), GSL_MIN_DBL(PERTURB_K_MAX, _k1 * pf), _nR);
-
-            dvec4 quat;
-
-            for (int i = 0; i < _nR; i++)
-            {
-                quat = _r.row(i).transpose();
-
-                quaternion_mul(quat, quat, d.row(i).transpose());
-
-                _r.row(i) = quat.transpose();
-            }
+            perturbVMS(_r, GSL_MIN_DBL(PERTURB_K_MAX, _k1 * pf));
 
 #ifdef PARTICLE_BALANCE_WEIGHT_R
         balanceWeight(PAR_R);
@@ -1162,19 +1165,20 @@ void Particle::perturb(const double pf,
         }
         else if (_mode == MODE_3D)
         {
+            dmat44 A = dmat44::Zero();
+
 #ifdef PARTICLE_ROTATION_KAPPA
             double kappa = GSL_MIN_DBL(PERTURB_K_MAX, GSL_MAX_DBL(_k1, GSL_MAX_DBL(_k2, _k3)));
-            sampleACG(d,
-                      gsl_pow_2(pf) * kappa,
-                      gsl_pow_2(pf) * kappa,
-                      gsl_pow_2(pf) * kappa,
-                      _nR);
+
+            A(0, 0) = 1;
+            A(1, 1) = gsl_pow_2(pf) * kappa;
+            A(2, 2) = gsl_pow_2(pf) * kappa;
+            A(3, 3) = gsl_pow_2(pf) * kappa;
 #else
-            sampleACG(d,
-                      gsl_pow_2(pf) * GSL_MIN_DBL(PERTURB_K_MAX, _k1),
-                      gsl_pow_2(pf) * GSL_MIN_DBL(PERTURB_K_MAX, _k2),
-                      gsl_pow_2(pf) * GSL_MIN_DBL(PERTURB_K_MAX, _k3),
-                      _nR);
+            A(0, 0) = 1;
+            A(1, 1) = gsl_pow_2(pf) * GSL_MIN_DBL(PERTURB_K_MAX, _k1);
+            A(2, 2) = gsl_pow_2(pf) * GSL_MIN_DBL(PERTURB_K_MAX, _k2);
+            A(3, 3) = gsl_pow_2(pf) * GSL_MIN_DBL(PERTURB_K_MAX, _k3);
 #endif
 
             dvec4 mean;
@@ -1185,35 +1189,9 @@ void Particle::perturb(const double pf,
             mean = _topR;
 #endif
 
-            dvec4 quat;
-
-            for (int i = 0; i < _nR; i++)
-            {
-                quat = _r.row(i).transpose();
-
-                quaternion_mul(quat, quaternion_conj(mean), quat);
-
-                _r.row(i) = quat.transpose();
-            }
-
-            dvec4 pert;
-           
-            for (int i = 0; i < _nR; i++)
-            {
-                quat = _r.row(i).transpose();
-                pert = d.row(i).transpose();
-                quaternion_mul(quat, pert, quat);
-                _r.row(i) = quat.transpose();
-            }
-
-            for (int i = 0; i < _nR; i++)
-            {
-                quat = _r.row(i).transpose();
-
-                quaternion_mul(quat, mean, quat);
+            // r <- mean * d * mean^-1 * r, sampled and composed in one pass
 
-                _r.row(i) = quat.transpose();
-            }
+            perturbACG(_r, A, mean);
 
             symmetrise(&mean);
         }
@@ -2396,32 +2374,118 @@ Particle Particle::copy() const
     return that;
 }
 
+void Particle::pack(vector<double>& dst) const
+{
+    dst.push_back(_mode);
+    dst.push_back(_nC);
+    dst.push_back(_nR);
+    dst.push_back(_nT);
+    dst.push_back(_nD);
+
+    dst.push_back(_transS);
+    dst.push_back(_transQ);
+
+    dst.push_back(_peakFactorC);
+    dst.push_back(_peakFactorR);
+    dst.push_back(_peakFactorT);
+    dst.push_back(_peakFactorD);
+
+    packMatrix(dst, _c);
+    packMatrix(dst, _r);
+    packMatrix(dst, _t);
+    packMatrix(dst, _d);
+
+    packMatrix(dst, _wC);
+    packMatrix(dst, _wR);
+    packMatrix(dst, _wT);
+    packMatrix(dst, _wD);
+
+    packMatrix(dst, _uC);
+    packMatrix(dst, _uR);
+    packMatrix(dst, _uT);
+    packMatrix(dst, _uD);
+
+    dst.push_back(_k1);
+    dst.push_back(_k2);
+    dst.push_back(_k3);
+    dst.push_back(_s0);
+    dst.push_back(_s1);
+    dst.push_back(_rho);
+    dst.push_back(_s);
+    dst.push_back(_score);
+
+    dst.push_back(_topCPrev);
+    dst.push_back(_topC);
+    packMatrix(dst, _topRPrev);
+    packMatrix(dst, _topR);
+    packMatrix(dst, _topTPrev);
+    packMatrix(dst, _topT);
+    dst.push_back(_topDPrev);
+    dst.push_back(_topD);
+}
+
+const double* Particle::unpack(const double* src,
+                               const Symmetry* sym)
+{
+    _mode = (int)*src++;
+    _nC = (int)*src++;
+    _nR = (int)*src++;
+    _nT = (int)*src++;
+    _nD = (int)*src++;
+
+    _transS = *src++;
+    _transQ = *src++;
+
+    _peakFactorC = *src++;
+    _peakFactorR = *src++;
+    _peakFactorT = *src++;
+    _peakFactorD = *src++;
+
+    src = unpackMatrix(_c, src);
+    src = unpackMatrix(_r, src);
+    src = unpackMatrix(_t, src);
+    src = unpackMatrix(_d, src);
+
+    src = unpackMatrix(_wC, src);
+    src = unpackMatrix(_wR, src);
+    src = unpackMatrix(_wT, src);
+    src = unpackMatrix(_wD, src);
+
+    src = unpackMatrix(_uC, src);
+    src = unpackMatrix(_uR, src);
+    src = unpackMatrix(_uT, src);
+    src = unpackMatrix(_uD, src);
+
+    _k1 = *src++;
+    _k2 = *src++;
+    _k3 = *src++;
+    _s0 = *src++;
+    _s1 = *src++;
+    _rho = *src++;
+    _s = *src++;
+    _score = *src++;
+
+    _topCPrev = (size_t)*src++;
+    _topC = (size_t)*src++;
+    src = unpackMatrix(_topRPrev, src);
+    src = unpackMatrix(_topR, src);
+    src = unpackMatrix(_topTPrev, src);
+    src = unpackMatrix(_topT, src);
+    _topDPrev = *src++;
+    _topD = *src++;
+
+    _sym = sym;
+
+    return src;
+}
+
 void Particle::symmetrise(const dvec4* anchor)
 {
     if (_sym == NULL) return;
 
     if (asymmetry(*_sym)) return;
 
-    /***
-    dvec4 mean;
-
-    inferACG(mean, _r);
-    ***/
-
-    dvec4 quat;
-
-    for (int i = 0; i < _nR; i++)
-    {
-        dvec4 quat = _r.row(i).transpose();
-
-        // quaternion_mul(quat, quaternion_conj(mean), quat);
-
-        symmetryCounterpart(quat, *_sym, anchor);
-
-        // quaternion_mul(quat, mean, quat);
-
-        _r.row(i) = quat.transpose();
-    }
+    symmetryCounterpart(_r, *_sym, anchor);
 }
 
 void Particle::reCentre()
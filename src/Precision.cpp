@@ -489,6 +489,14 @@ int TSFFTW_init_threads()
 	return fftw_init_threads();
 #endif
 }
+void TSFFTW_make_planner_thread_safe(void)
+{
+#ifdef SINGLE_PRECISION
+	fftwf_make_planner_thread_safe();
+#else
+	fftw_make_planner_thread_safe();
+#endif
+}
 void TSFFTW_cleanup_threads(void)
 {
 #ifdef SINGLE_PRECISION
@@ -538,6 +546,15 @@ void TSFFTW_execute_dft_c2r( const TSFFTW_PLAN p, TSFFTW_COMPLEX *in, RFLOAT *ou
 	fftw_execute_dft_c2r( p, in, out);
 #endif
 } 
+void TSFFTW_execute_dft( const TSFFTW_PLAN p, TSFFTW_COMPLEX *in, TSFFTW_COMPLEX *out)
+{
+#ifdef SINGLE_PRECISION
+	fftwf_execute_dft( p, in, out);
+#else
+	fftw_execute_dft( p, in, out);
+#endif
+}
+
 void *TSFFTW_malloc(size_t n)
 {
 #ifdef SINGLE_PRECISION
@@ -563,6 +580,33 @@ TSFFTW_PLAN TSFFTW_plan_dft_r2c_2d(int n0, int n1, RFLOAT *in, TSFFTW_COMPLEX *o
 	return fftw_plan_dft_r2c_2d(n0, n1, in, out, flags);
 #endif
 }
+TSFFTW_PLAN TSFFTW_plan_dft_r2c_1d(int n, RFLOAT *in, TSFFTW_COMPLEX *out, unsigned flags)
+{
+#ifdef SINGLE_PRECISION
+	return fftwf_plan_dft_r2c_1d(n, in, out, flags);
+#else
+	return fftw_plan_dft_r2c_1d(n, in, out, flags);
+#endif
+}
+
+TSFFTW_PLAN TSFFTW_plan_dft_1d(int n, TSFFTW_COMPLEX *in, TSFFTW_COMPLEX *out, int sign, unsigned flags)
+{
+#ifdef SINGLE_PRECISION
+	return fftwf_plan_dft_1d(n, in, out, sign, flags);
+#else
+	return fftw_plan_dft_1d(n, in, out, sign, flags);
+#endif
+}
+
+TSFFTW_PLAN TSFFTW_plan_many_dft(int rank, const int *n, int howmany, TSFFTW_COMPLEX *in, const int *inembed, int istride, int idist, TSFFTW_COMPLEX *out, const int *onembed, int ostride, int odist, int sign, unsigned flags)
+{
+#ifdef SINGLE_PRECISION
+	return fftwf_plan_many_dft(rank, n, howmany, in, inembed, istride, idist, out, onembed, ostride, odist, sign, flags);
+#else
+	return fftw_plan_many_dft(rank, n, howmany, in, inembed, istride, idist, out, onembed, ostride, odist, sign, flags);
+#endif
+}
+
 TSFFTW_PLAN TSFFTW_plan_dft_r2c_3d(int n0, int n1, int n2, RFLOAT *in, TSFFTW_COMPLEX *out, unsigned flags)
 {
 #ifdef SINGLE_PRECISION
@@ -96,15 +96,25 @@ const Volume& Projector::projectee3D() const
 
 void Projector::setProjectee(Image src)
 {
-    FFT fft;
-    fft.bwMT(src);
+    int maxRadius = src.nColRL() / 2 - 1;
+
+    setProjectee(boost::move(src), maxRadius);
+}
+
+void Projector::setProjectee(Volume src)
+{
+    int maxRadius = src.nColRL() / 2 - 1;
 
-    IMG_PAD_RL(_projectee2D, src, _pf);
+    setProjectee(boost::move(src), maxRadius);
+}
 
-    if (_projectee2D.isEmptyRL()) REPORT_ERROR("REAL SPACE EMPTY");
+void Projector::setProjectee(Image src,
+                             const int maxRadius)
+{
+    _maxRadius = GSL_MIN_INT(maxRadius, src.nColRL() / 2 - 1);
 
-    _maxRadius = floor(MIN(_projectee2D.nColRL(),
-                           _projectee2D.nRowRL()) / _pf / 2 - 1);
+    FFT fft;
+    fft.bwMT(src);
 
 #ifdef VERBOSE_LEVEL_3
     CLOG(INFO, "LOGGER_SYS") << "Performing Grid Correction";
@@ -112,39 +122,63 @@ void Projector::setProjectee(Image src)
 
 #ifdef PROJECTOR_CORRECT_CONVOLUTION_KERNEL
 
-    gridCorrection();
+    gridCorrection(src);
 
 #endif
 
-    fft.fwMT(_projectee2D);
-    _projectee2D.clearRL();
+    fft.fwPadMT(_projectee2D, src, _pf, _pf * _maxRadius + PROJECTOR_PAD_MARGIN);
 }
 
-void Projector::setProjectee(Volume src)
+void Projector::setProjectee(Volume src,
+                             const int maxRadius)
 {
+    _maxRadius = GSL_MIN_INT(maxRadius, src.nColRL() / 2 - 1);
+
     FFT fft;
     fft.bwMT(src);
 
-    VOL_PAD_RL(_projectee3D, src, _pf);
-
-    if (_projectee3D.isEmptyRL()) REPORT_ERROR("RL SPACE EMPTY");
-
-    _maxRadius = floor(MIN_3(_projectee3D.nColRL(),
-                             _projectee3D.nRowRL(),
-                             _projectee3D.nSlcRL()) / _pf / 2 - 1);
-
 #ifdef VERBOSE_LEVEL_3
     CLOG(INFO, "LOGGER_SYS") << "Performing Grid Correction";
 #endif
 
 #ifdef PROJECTOR_CORRECT_CONVOLUTION_KERNEL
 
-    gridCorrection();
+    gridCorrection(src);
 
 #endif
 
-    fft.fwMT(_projectee3D);
-    _projectee3D.clearRL();
+    fft.fwPadMT(_projectee3D, src, _pf, _pf * _maxRadius + PROJECTOR_PAD_MARGIN);
+}
+
+void Projector::setProjectee(Volume src,
+                             const int maxRadius,
+                             Complex* data)
+{
+    int p = _pf * src.nColRL();
+
+    // FFT::fwPadMT keeps the space of the projectee of the right size
+
+    _projectee3D.attachFT(data, p, p, p);
+
+    setProjectee(boost::move(src), maxRadius);
+}
+
+void Projector::attachProjectee(Complex* data,
+                                const int size,
+                                const int maxRadius)
+{
+    _maxRadius = GSL_MIN_INT(maxRadius, size / 2 - 1);
+
+    int p = _pf * size;
+
+    _projectee3D.attachFT(data, p, p, p);
+}
+
+size_t Projector::sizeFTPad(const int size) const
+{
+    size_t p = _pf * size;
+
+    return (p / 2 + 1) * p * p;
 }
 
 void Projector::project(Image& dst,
@@ -225,6 +259,21 @@ void Projector::project(Complex* dst,
                         const int* iRow,
                         const int nPxl) const
 {
+    if (_interp == LINEAR_INTERP)
+    {
+        kernel().project2D(dst,
+                           _projectee2D.dataFT(),
+                           _projectee2D.nColFT(),
+                           _projectee2D.nRowFT(),
+                           mat.data(),
+                           _pf,
+                           iCol,
+                           iRow,
+                           nPxl);
+
+        return;
+    }
+
     for (int i = 0; i < nPxl; i++)
     {
         dvec2 newCor((double)(iCol[i] * _pf), (double)(iRow[i] * _pf));
@@ -242,6 +291,22 @@ void Projector::project(Complex* dst,
                         const int* iRow,
                         const int nPxl) const
 {
+    if (_interp == LINEAR_INTERP)
+    {
+        kernel().project3D(dst,
+                           _projectee3D.dataFT(),
+                           _projectee3D.nColFT(),
+                           _projectee3D.nRowFT(),
+                           _projectee3D.nSlcFT(),
+                           mat.data(),
+                           _pf,
+                           iCol,
+                           iRow,
+                           nPxl);
+
+        return;
+    }
+
     for (int i = 0; i < nPxl; i++)
     {
         dvec3 newCor((double)(iCol[i] * _pf), (double)(iRow[i] * _pf), 0);
@@ -509,86 +574,66 @@ void Projector::projectMT(Complex* dst,
     translateMT(dst, dst, t(0), t(1), nCol, nRow, iCol, iRow, nPxl);
 }
 
-void Projector::gridCorrection()
+void Projector::gridCorrection(Image& img) const
 {
-        if (_mode == MODE_2D)
-        {
-#ifdef VERBOSE_LEVEL_3
-            CLOG(INFO, "LOGGER_SYS") << "Inverse Fourier Transform in Grid Correction";
-#endif
+    // the padded image is nColRL() x _pf in size
 
 #ifdef PROJECTOR_REMOVE_NEG
-            #pragma omp parallel for
-            REMOVE_NEG(_projectee2D);
+    #pragma omp parallel for
+    REMOVE_NEG(img);
 #endif
 
-        if (_interp == LINEAR_INTERP)
-        {
-            #pragma omp parallel for schedule(dynamic)
-            IMAGE_FOR_EACH_PIXEL_RL(_projectee2D)
-                _projectee2D.setRL(_projectee2D.getRL(i, j)
-                                 / TIK_RL(NORM(i, j)
-                                        / (_pf * _projectee2D.nColRL())),
-                                   i,
-                                   j);
-        }
-        else if (_interp == NEAREST_INTERP)
-        {
-            #pragma omp parallel for schedule(dynamic)
-            IMAGE_FOR_EACH_PIXEL_RL(_projectee2D)
-                _projectee2D.setRL(_projectee2D.getRL(i, j)
-                                 / NIK_RL(NORM(i, j)
-                                        / (_pf * _projectee2D.nColRL())),
-                                   i,
-                                   j);
-        }
+    if (_interp == LINEAR_INTERP)
+    {
+        #pragma omp parallel for schedule(dynamic)
+        IMAGE_FOR_EACH_PIXEL_RL(img)
+            img.setRL(img.getRL(i, j)
+                    / TIK_RL(NORM(i, j)
+                           / (_pf * _pf * img.nColRL())),
+                      i,
+                      j);
+    }
+    else if (_interp == NEAREST_INTERP)
+    {
+        #pragma omp parallel for schedule(dynamic)
+        IMAGE_FOR_EACH_PIXEL_RL(img)
+            img.setRL(img.getRL(i, j)
+                    / NIK_RL(NORM(i, j)
+                           / (_pf * _pf * img.nColRL())),
+                      i,
+                      j);
+    }
+}
 
-#ifdef VERBOSE_LEVEL_3
-            CLOG(INFO, "LOGGER_SYS") << "Fourier Transform in Grid Correction";
-#endif
-        }
-        else if (_mode == MODE_3D)
-        {
-#ifdef VERBOSE_LEVEL_3
-            CLOG(INFO, "LOGGER_SYS") << "Inverse Fourier Transform in Grid Correction";
-#endif
+void Projector::gridCorrection(Volume& vol) const
+{
+    // the padded volume is nColRL() x _pf in size
 
 #ifdef PROJECTOR_REMOVE_NEG
-            #pragma omp parallel for
-            REMOVE_NEG(_projectee3D);
+    #pragma omp parallel for
+    REMOVE_NEG(vol);
 #endif
 
-        if (_interp == LINEAR_INTERP)
-        {
-            #pragma omp parallel for schedule(dynamic)
-            VOLUME_FOR_EACH_PIXEL_RL(_projectee3D)
-                _projectee3D.setRL(_projectee3D.getRL(i, j, k)
-                                 / TIK_RL(NORM_3(i, j, k)
-                                        / (_pf * _projectee3D.nColRL())),
-                                   i,
-                                   j,
-                                   k);
-        }
-        else if (_interp == NEAREST_INTERP)
-        {
-            #pragma omp parallel for schedule(dynamic)
-            VOLUME_FOR_EACH_PIXEL_RL(_projectee3D)
-                _projectee3D.setRL(_projectee3D.getRL(i, j, k)
-                                 / NIK_RL(NORM_3(i, j, k)
-                                        / (_pf * _projectee3D.nColRL())),
-                                   i,
-                                   j,
-                                   k);
-        }
-
-#ifdef VERBOSE_LEVEL_3
-            CLOG(INFO, "LOGGER_SYS") << "Fourier Transform in Grid Correction";
-#endif
-        }
-        else
-        {
-            REPORT_ERROR("INEXISTENT_MODE");
-
-            abort();
-        }
+    if (_interp == LINEAR_INTERP)
+    {
+        #pragma omp parallel for schedule(dynamic)
+        VOLUME_FOR_EACH_PIXEL_RL(vol)
+            vol.setRL(vol.getRL(i, j, k)
+                    / TIK_RL(NORM_3(i, j, k)
+                           / (_pf * _pf * vol.nColRL())),
+                      i,
+                      j,
+                      k);
+    }
+    else if (_interp == NEAREST_INTERP)
+    {
+        #pragma omp parallel for schedule(dynamic)
+        VOLUME_FOR_EACH_PIXEL_RL(vol)
+            vol.setRL(vol.getRL(i, j, k)
+                    / NIK_RL(NORM_3(i, j, k)
+                           / (_pf * _pf * vol.nColRL())),
+                      i,
+                      j,
+                      k);
+    }
 }
@@ -407,18 +407,38 @@ void Reconstructor::insertDir(const dvec3& dir)
 void Reconstructor::insertDir(const double ox,
                               const double oy,
                               const double oz)
+{
+    insertDir(ox, oy, oz, 1);
+}
+
+void Reconstructor::insertDir(const dvec2& dir,
+                              const int count)
+{
+    insertDir(dir(0), dir(1), 0, count);
+}
+
+void Reconstructor::insertDir(const dvec3& dir,
+                              const int count)
+{
+    insertDir(dir(0), dir(1), dir(2), count);
+}
+
+void Reconstructor::insertDir(const double ox,
+                              const double oy,
+                              const double oz,
+                              const int count)
 {
     #pragma omp atomic
-    _ox += ox;
+    _ox += count * ox;
 
     #pragma omp atomic
-    _oy += oy;
+    _oy += count * oy;
 
     #pragma omp atomic
-    _oz += oz;
+    _oz += count * oz;
 
     #pragma omp atomic
-    _counter +=1;
+    _counter += count;
 }
 
 void Reconstructor::insert(const Image& src,
@@ -2356,11 +2376,13 @@ void Reconstructor::allReduceF()
         SEGMENT_NAN_CHECK_COMPLEX(&_F2D[0], _F2D.sizeFT());
 #endif
 
-        MPI_Allreduce_Large(&_F2D[0],
-                            _F2D.sizeFT(),
-                            TS_MPI_DOUBLE_COMPLEX,
-                            MPI_SUM,
-                            _hemi);
+        MPI_Allreduce_Node(&_F2D[0],
+                           _F2D.sizeFT(),
+                           TS_MPI_DOUBLE_COMPLEX,
+                           MPI_SUM,
+                           _hemi,
+                           _node,
+                           _lead);
 
 #ifndef NAN_NO_CHECK
         SEGMENT_NAN_CHECK_COMPLEX(&_F2D[0], _F2D.sizeFT());
@@ -2374,11 +2396,13 @@ void Reconstructor::allReduceF()
         SEGMENT_NAN_CHECK_COMPLEX(&_F3D[0], _F3D.sizeFT());
 #endif
 
-        MPI_Allreduce_Large(&_F3D[0],
-                            _F3D.sizeFT(),
-                            TS_MPI_DOUBLE_COMPLEX,
-                            MPI_SUM,
-                            _hemi);
+        MPI_Allreduce_Node(&_F3D[0],
+                           _F3D.sizeFT(),
+                           TS_MPI_DOUBLE_COMPLEX,
+                           MPI_SUM,
+                           _hemi,
+                           _node,
+                           _lead);
 
 #ifndef NAN_NO_CHECK
         SEGMENT_NAN_CHECK_COMPLEX(&_F3D[0], _F3D.sizeFT());
@@ -2409,11 +2433,13 @@ void Reconstructor::allReduceT()
         SEGMENT_NAN_CHECK_COMPLEX(&_T2D[0], _T2D.sizeFT());
 #endif
 
-        MPI_Allreduce_Large(&_T2D[0],
-                            _T2D.sizeFT(),
-                            TS_MPI_DOUBLE_COMPLEX,
-                            MPI_SUM,
-                            _hemi);
+        MPI_Allreduce_Node(&_T2D[0],
+                           _T2D.sizeFT(),
+                           TS_MPI_DOUBLE_COMPLEX,
+                           MPI_SUM,
+                           _hemi,
+                           _node,
+                           _lead);
 
 #ifndef NAN_NO_CHECK
         SEGMENT_NAN_CHECK_COMPLEX(&_T2D[0], _T2D.sizeFT());
@@ -2427,11 +2453,13 @@ void Reconstructor::allReduceT()
         SEGMENT_NAN_CHECK_COMPLEX(&_T3D[0], _T3D.sizeFT());
 #endif
 
-        MPI_Allreduce_Large(&_T3D[0],
-                            _T3D.sizeFT(),
-                            TS_MPI_DOUBLE_COMPLEX,
-                            MPI_SUM,
-                            _hemi);
+        MPI_Allreduce_Node(&_T3D[0],
+                           _T3D.sizeFT(),
+                           TS_MPI_DOUBLE_COMPLEX,
+                           MPI_SUM,
+                           _hemi,
+                           _node,
+                           _lead);
 
 #ifndef NAN_NO_CHECK
         SEGMENT_NAN_CHECK_COMPLEX(&_T2D[0], _T3D.sizeFT());
@@ -0,0 +1,289 @@
+/*******************************************************************************
+ * Author:
+ * Dependecy:
+ * Test:
+ * Execution:
+ * Description:
+ * ****************************************************************************/
+
+#include "SlabPostprocess.h"
+
+SlabPostprocess::SlabPostprocess() {}
+
+SlabPostprocess::SlabPostprocess(const char mapAFilename[],
+                                 const char mapBFilename[],
+                                 const char maskFilename[],
+                                 const RFLOAT pixelSize,
+                                 const char scratch[])
+{
+    _pixelSize = pixelSize;
+
+    _scratch = scratch;
+
+    CLOG(INFO, "LOGGER_SYS") << "Mapping Two Half Maps";
+
+    _mapA.openMRC(mapAFilename, false, scratch);
+    _mapB.openMRC(mapBFilename, false, scratch);
+    _mask.openMRC(maskFilename, false, scratch);
+
+    // REMOVE_NEG(_mapA);
+    // REMOVE_NEG(_mapB);
+
+    _size = _mapA.nColRL();
+
+    if ((_size != _mapA.nRowRL()) ||
+        (_size != _mapA.nSlcRL()) ||
+        (_size != _mapB.nColRL()) ||
+        (_size != _mapB.nRowRL()) ||
+        (_size != _mapB.nSlcRL()) ||
+        (_size != _mask.nColRL()) ||
+        (_size != _mask.nRowRL()) ||
+        (_size != _mask.nSlcRL()))
+        CLOG(FATAL, "LOGGER_SYS") << "Invalid Input Half Maps in Postprocessing";
+}
+
+void SlabPostprocess::run()
+{
+    CLOG(INFO, "LOGGER_SYS") << "Masking Reference A and B";
+
+    _mapAMasked.createMRC("Reference_A_Masked.mrc", _size, _size, _size, _pixelSize);
+    _mapBMasked.createMRC("Reference_B_Masked.mrc", _size, _size, _size, _pixelSize);
+
+    maskAB();
+
+    CLOG(INFO, "LOGGER_SYS") << "Performing Fourier Transform";
+
+    _mapA.openFT(_scratch.c_str());
+    _mapA.fw();
+
+    _mapB.openFT(_scratch.c_str());
+    _mapB.fw();
+
+    _mapAMasked.openFT(_scratch.c_str());
+    _mapAMasked.fw();
+
+    _mapBMasked.openFT(_scratch.c_str());
+    _mapBMasked.fw();
+
+    CLOG(INFO, "LOGGER_SYS") << "Determining FSCUnmask & FSCMask";
+
+    _FSCUnmask.resize(maxR());
+
+    _FSCMask.resize(maxR());
+
+    FSC(_FSCUnmask, _mapA, _mapB);
+
+    FSC(_FSCMask, _mapAMasked, _mapBMasked);
+
+    _mapAMasked.closeFT();
+    _mapBMasked.closeFT();
+
+    int randomPhaseThres = resP(_FSCUnmask, 0.8, 1, 1, false);
+
+    CLOG(INFO, "LOGGER_SYS") << "Performing Random Phase From "
+                             << 1.0 / resP2A(randomPhaseThres,
+                                             _size,
+                                             _pixelSize);
+
+    randomPhaseAB(randomPhaseThres);
+
+    CLOG(INFO, "LOGGER_SYS") << "Determing FSCRFMask";
+
+    _mapARFMask.bw();
+    _mapBRFMask.bw();
+
+    maskABRF();
+
+    _mapARFMask.fw();
+    _mapBRFMask.fw();
+
+    _FSCRFMask.resize(maxR());
+
+    FSC(_FSCRFMask, _mapARFMask, _mapBRFMask);
+
+    _mapARFMask.closeFT();
+    _mapARFMask.closeMRC();
+    _mapBRFMask.closeFT();
+    _mapBRFMask.closeMRC();
+
+    CLOG(INFO, "LOGGER_SYS") << "Calculating True FSC";
+
+    _FSC.resize(maxR());
+
+    for (int i = 0; i < maxR(); i++)
+    {
+        if (i < randomPhaseThres + 2)
+            _FSC(i) = _FSCMask(i);
+        else
+            _FSC(i) = (_FSCMask(i) - _FSCRFMask(i)) / (1 - _FSCRFMask(i));
+    }
+
+    CLOG(INFO, "LOGGER_SYS") << "Saving FSC";
+
+    saveFSC();
+
+    _res = resP(_FSC, 0.143, 1, 1, false);
+
+    CLOG(INFO, "LOGGER_SYS") << "Resolution: "
+                             << 1.0 / resP2A(_res,
+                                             _size,
+                                             _pixelSize);
+
+    CLOG(INFO, "LOGGER_SYS") << "Merging Two References";
+
+    _mapI.createMRC("Reference_Average.mrc", _size, _size, _size, _pixelSize);
+    _mapI.openFT(_scratch.c_str());
+
+    mergeAB(_mapI);
+
+    _mapI.bw();
+
+    // the Fourier space of the average is destroyed by the inverse transform,
+    // the sharpened map is merged again from the half maps
+
+    _mapI.createMRC("Reference_Sharp.mrc", _size, _size, _size, _pixelSize);
+    _mapI.openFT(_scratch.c_str());
+
+    mergeAB(_mapI);
+
+    _mapA.closeFT();
+    _mapB.closeFT();
+
+    CLOG(INFO, "LOGGER_SYS") << "Applying FSC Weighting";
+
+    vector<FilterStage> stage(1);
+
+    stage[0].type = FILTER_FSC_WEIGHTING;
+    stage[0].fsc = _FSC;
+
+    fusedFilter(_mapI, stage);
+
+    CLOG(INFO, "LOGGER_SYS") << "Estimating B-Factor";
+
+    RFLOAT bFactor;
+    
+    bFactorEst(bFactor,
+               _mapI,
+               _res,
+               AROUND(resA2P(1.0 / B_FACTOR_EST_LOW_RES, _size, _pixelSize)));
+
+    //bFactor = -40;
+
+    CLOG(INFO, "LOGGER_SYS") << "B-Factor : " << bFactor;
+
+    CLOG(INFO, "LOGGER_SYS") << "Performing Sharpening";
+
+    // B-factor filtering and low-pass filtering in one sweep, as sharpen(),
+    // the low-pass first, thus the weight of a sharpening B-factor, which
+    // overflows at high frequency, is not evaluated where it is cut off
+
+    stage.resize(2);
+
+    stage[0].type = FILTER_LOW_PASS;
+    stage[0].thres = (RFLOAT)_res / _size;
+    stage[0].ew = (RFLOAT)EDGE_WIDTH_FT / _size;
+
+    stage[1].type = FILTER_B_FACTOR;
+    stage[1].bFactor = bFactor;
+
+    fusedFilter(_mapI, stage);
+
+    //CLOG(INFO, "LOGGER_SYS") << "Compensating B-Factor Filtering";
+
+    //bFactorFilter(_mapI, _mapI, COMPENSATE_B_FACTOR / TSGSL_pow_2(_pixelSize));
+
+    CLOG(INFO, "LOGGER_SYS") << "Saving Result";
+
+    _mapI.bw();
+
+    softMask(_mapI, _mask, 0);
+
+    //REMOVE_NEG(_mapI);
+
+    _mapI.closeFT();
+    _mapI.closeMRC();
+}
+
+void SlabPostprocess::maskAB()
+{
+    #pragma omp parallel for
+    for (int k = 0; k < _size; k++)
+    {
+        memcpy(_mapAMasked.slcRL(k), _mapA.slcRL(k), _mapA.slcSizeRL() * sizeof(float));
+        memcpy(_mapBMasked.slcRL(k), _mapB.slcRL(k), _mapB.slcSizeRL() * sizeof(float));
+    }
+
+    softMask(_mapAMasked, _mask, 0);
+    softMask(_mapBMasked, _mask, 0);
+}
+
+void SlabPostprocess::maskABRF()
+{
+    softMask(_mapARFMask, _mask, 0);
+    softMask(_mapBRFMask, _mask, 0);
+}
+
+void SlabPostprocess::randomPhaseAB(const int randomPhaseThres)
+{
+    createScratch(_mapARFMask);
+    createScratch(_mapBRFMask);
+
+    randomPhase(_mapARFMask, _mapA, randomPhaseThres);
+    randomPhase(_mapBRFMask, _mapB, randomPhaseThres);
+}
+
+void SlabPostprocess::mergeAB(SlabVolume& dst)
+{
+    #pragma omp parallel for
+    for (int k = 0; k < _size; k++)
+    {
+        Complex* slc = dst.slcFT(k);
+        const Complex* slcA = _mapA.slcFT(k);
+        const Complex* slcB = _mapB.slcFT(k);
+
+        for (size_t i = 0; i < dst.slcSizeFT(); i++)
+            slc[i] = (slcA[i] + slcB[i]) / 2;
+    }
+}
+
+void SlabPostprocess::createScratch(SlabVolume& dst)
+{
+    char path[FILE_NAME_LENGTH];
+
+    snprintf(path, FILE_NAME_LENGTH, "%s/.thunder_map_XXXXXX", _scratch.c_str());
+
+    int fd = mkstemp(path);
+
+    if (fd == -1)
+    {
+        REPORT_ERROR("FAIL TO CREATE SCRATCH FILE");
+        abort();
+    }
+
+    close(fd);
+
+    dst.createMRC(path, _size, _size, _size, _pixelSize);
+
+    unlink(path);
+
+    dst.openFT(_scratch.c_str());
+}
+
+int SlabPostprocess::maxR()
+{
+    return _size / 2 - 1;
+}
+
+void SlabPostprocess::saveFSC() const
+{
+    FILE* file = fopen("Postprocess_FSC.txt", "w");
+
+    for (int i = 1; i < _FSC.size(); i++)
+        fprintf(file,
+                "%05d   %10.6lf   %10.6lf\n",
+                i,
+                1.0 / resP2A(i, _size, _pixelSize),
+                _FSC(i));
+
+    fclose(file);
+}
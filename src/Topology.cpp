@@ -0,0 +1,379 @@
+/*******************************************************************************
+ * Author:
+ * Dependency:
+ * Test:
+ * Execution:
+ * Description:
+ *
+ * Manual:
+ * ****************************************************************************/
+
+#include "Topology.h"
+
+#include <dirent.h>
+
+/**
+ * This function reads an integer from a file of sysfs, returning -1 if it fails.
+ */
+static int readSysfsInt(const char path[])
+{
+    FILE* file = fopen(path, "r");
+
+    if (file == NULL) return -1;
+
+    int value;
+
+    if (fscanf(file, "%d", &value) != 1) value = -1;
+
+    fclose(file);
+
+    return value;
+}
+
+/**
+ * This function parses a list of CPUs in the format of sysfs, e.g. "0-3,8-11",
+ * marking them in flag.
+ */
+static void parseCPUList(std::vector<bool>& flag,
+                         const char* list)
+{
+    const char* p = list;
+
+    while (*p != '\0')
+    {
+        char* end;
+
+        int begin = (int)strtol(p, &end, 10);
+
+        if (end == p) break;
+
+        int last = begin;
+
+        if (*end == '-')
+        {
+            p = end + 1;
+
+            last = (int)strtol(p, &end, 10);
+        }
+
+        for (int i = begin; i <= last; i++)
+        {
+            if (i >= (int)flag.size()) flag.resize(i + 1, false);
+
+            flag[i] = true;
+        }
+
+        p = (*end == ',') ? end + 1 : end;
+
+        if (*p == '\n') break;
+    }
+}
+
+struct TopologyEntry
+{
+    int cpu;
+
+    int coreID;
+
+    int node;
+
+    int socket;
+
+    int core;
+
+    /**
+     * the rank of this hardware thread in its core
+     */
+    int sibling;
+};
+
+static bool lessPhysical(const TopologyEntry& a,
+                         const TopologyEntry& b)
+{
+    if (a.node != b.node) return a.node < b.node;
+    if (a.socket != b.socket) return a.socket < b.socket;
+    if (a.coreID != b.coreID) return a.coreID < b.coreID;
+
+    return a.cpu < b.cpu;
+}
+
+static bool lessPlacement(const TopologyEntry& a,
+                          const TopologyEntry& b)
+{
+    if (a.sibling != b.sibling) return a.sibling < b.sibling;
+
+    return a.core < b.core;
+}
+
+static void fillTopology(Topology& dst,
+                         const std::vector<TopologyEntry>& entry)
+{
+    dst.cpu.clear();
+    dst.core.clear();
+    dst.node.clear();
+    dst.socket.clear();
+
+    std::vector<int> nodes, sockets;
+
+    for (size_t i = 0; i < entry.size(); i++)
+    {
+        dst.cpu.push_back(entry[i].cpu);
+        dst.core.push_back(entry[i].core);
+        dst.node.push_back(entry[i].node);
+        dst.socket.push_back(entry[i].socket);
+
+        nodes.push_back(entry[i].node);
+        sockets.push_back(entry[i].socket);
+    }
+
+    std::sort(nodes.begin(), nodes.end());
+    std::sort(sockets.begin(), sockets.end());
+
+    dst.nNode = std::unique(nodes.begin(), nodes.end()) - nodes.begin();
+    dst.nSocket = std::unique(sockets.begin(), sockets.end()) - sockets.begin();
+
+    dst.nCore = 0;
+
+    for (size_t i = 0; i < entry.size(); i++)
+        if (entry[i].sibling == 0) dst.nCore += 1;
+}
+
+void detectTopology(Topology& dst)
+{
+    cpu_set_t mask;
+
+    CPU_ZERO(&mask);
+
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &mask) != 0)
+    {
+        REPORT_ERROR("FAIL TO GET AFFINITY OF PROCESS");
+        abort();
+    }
+
+    // NUMA node of each CPU
+
+    std::vector<int> nodeOf(CPU_SETSIZE, 0);
+
+    DIR* dir = opendir(TOPOLOGY_SYSFS_NODE);
+
+    if (dir != NULL)
+    {
+        struct dirent* ent;
+
+        while ((ent = readdir(dir)) != NULL)
+        {
+            int node;
+
+            if (sscanf(ent->d_name, "node%d", &node) != 1) continue;
+
+            char path[FILE_NAME_LENGTH];
+
+            snprintf(path, sizeof(path), "%s/%s/cpulist", TOPOLOGY_SYSFS_NODE, ent->d_name);
+
+            FILE* file = fopen(path, "r");
+
+            if (file == NULL) continue;
+
+            char list[FILE_LINE_LENGTH];
+
+            if (fgets(list, sizeof(list), file) != NULL)
+            {
+                std::vector<bool> flag;
+
+                parseCPUList(flag, list);
+
+                for (int i = 0; i < (int)flag.size() && i < CPU_SETSIZE; i++)
+                    if (flag[i]) nodeOf[i] = node;
+            }
+
+            fclose(file);
+        }
+
+        closedir(dir);
+    }
+
+    std::vector<TopologyEntry> entry;
+
+    for (int i = 0; i < CPU_SETSIZE; i++)
+    {
+        if (!CPU_ISSET(i, &mask)) continue;
+
+        char path[FILE_NAME_LENGTH];
+
+        TopologyEntry e;
+
+        e.cpu = i;
+        e.node = nodeOf[i];
+
+        snprintf(path, sizeof(path), "%s/cpu%d/topology/physical_package_id", TOPOLOGY_SYSFS_CPU, i);
+        e.socket = GSL_MAX_INT(0, readSysfsInt(path));
+
+        // without topology, each CPU is taken as a core
+
+        snprintf(path, sizeof(path), "%s/cpu%d/topology/core_id", TOPOLOGY_SYSFS_CPU, i);
+        e.coreID = readSysfsInt(path);
+
+        if (e.coreID < 0) e.coreID = i;
+
+        entry.push_back(e);
+    }
+
+    // number the cores, and the hardware threads within each core
+
+    std::sort(entry.begin(), entry.end(), lessPhysical);
+
+    int nCore = 0;
+
+    for (size_t i = 0; i < entry.size(); i++)
+    {
+        if ((i > 0) &&
+            (entry[i].socket == entry[i - 1].socket) &&
+            (entry[i].coreID == entry[i - 1].coreID))
+        {
+            entry[i].core = entry[i - 1].core;
+            entry[i].sibling = entry[i - 1].sibling + 1;
+        }
+        else
+        {
+            entry[i].core = nCore++;
+            entry[i].sibling = 0;
+        }
+    }
+
+    std::stable_sort(entry.begin(), entry.end(), lessPlacement);
+
+    fillTopology(dst, entry);
+
+    dst.bound = ((long)entry.size() < sysconf(_SC_NPROCESSORS_ONLN));
+
+    // MemAvailable of /proc/meminfo, in kB
+
+    dst.memAvailable = 0;
+
+    FILE* file = fopen("/proc/meminfo", "r");
+
+    if (file != NULL)
+    {
+        char line[FILE_LINE_LENGTH];
+
+        while (fgets(line, sizeof(line), file) != NULL)
+        {
+            unsigned long kB;
+
+            if (sscanf(line, "MemAvailable: %lu kB", &kB) == 1)
+            {
+                dst.memAvailable = (size_t)kB * 1024;
+
+                break;
+            }
+        }
+
+        fclose(file);
+    }
+}
+
+int hashTopology(const Topology& topo)
+{
+    unsigned int hash = 0;
+
+    for (size_t i = 0; i < topo.cpu.size(); i++)
+        hash ^= (unsigned int)topo.cpu[i] * 2654435761u + (hash << 6) + (hash >> 2);
+
+    // non-negative, as the colour of MPI_Comm_split
+
+    return (int)(hash & 0x7FFFFFFF);
+}
+
+void shareTopology(Topology& dst,
+                   const Topology& src,
+                   const int i,
+                   const int n)
+{
+    if (n <= 1)
+    {
+        dst = src;
+
+        return;
+    }
+
+    // a contiguous block of cores, at least one
+
+    int begin = (int)((long)src.nCore * i / n);
+    int end = (int)((long)src.nCore * (i + 1) / n);
+
+    if (end == begin) end = begin + 1;
+
+    std::vector<TopologyEntry> entry;
+
+    for (size_t j = 0; j < src.cpu.size(); j++)
+        if ((src.core[j] >= begin) && (src.core[j] < end))
+        {
+            TopologyEntry e;
+
+            e.cpu = src.cpu[j];
+            e.coreID = src.core[j];
+            e.node = src.node[j];
+            e.socket = src.socket[j];
+            e.core = src.core[j];
+
+            // the first hardware threads of the cores come first in src
+
+            e.sibling = (int)(j / src.nCore);
+
+            entry.push_back(e);
+        }
+
+    fillTopology(dst, entry);
+
+    dst.bound = true;
+    dst.memAvailable = src.memAvailable;
+}
+
+void bindThreads(const Topology& topo)
+{
+    if (topo.cpu.empty()) return;
+
+    #pragma omp parallel
+    {
+        int t = omp_get_thread_num();
+
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+
+        if (t == 0)
+        {
+            for (size_t i = 0; i < topo.cpu.size(); i++)
+                CPU_SET(topo.cpu[i], &set);
+        }
+        else
+            CPU_SET(topo.cpu[t % topo.cpu.size()], &set);
+
+        if (sched_setaffinity(0, sizeof(cpu_set_t), &set) != 0)
+            CLOG(WARNING, "LOGGER_SYS") << "Fail to Bind Thread " << t;
+    }
+}
+
+void* mallocFirstTouch(const size_t size)
+{
+    char* ptr = (char*)TSFFTW_malloc(size);
+
+    if (ptr == NULL)
+    {
+        REPORT_ERROR("FAIL TO ALLOCATE SPACE");
+        abort();
+    }
+
+    #pragma omp parallel
+    {
+        int t = omp_get_thread_num();
+        int n = omp_get_num_threads();
+
+        size_t begin = size / n * t + GSL_MIN((size_t)t, size % n);
+        size_t end = size / n * (t + 1) + GSL_MIN((size_t)(t + 1), size % n);
+
+        memset(ptr + begin, 0, end - begin);
+    }
+
+    return ptr;
+}